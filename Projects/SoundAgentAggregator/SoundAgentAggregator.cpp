@@ -0,0 +1,489 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <thread>
+
+#include "BinaryEventCodec.h"
+#include "FleetIndex.h"
+#include "SoundDevice.h"
+
+// Keeps the device state of a fleet of agents in a FleetIndex, fed by their BinaryEventCodec streams.
+// This build feeds it from simulated agents: each agent streams a snapshot, then a random mix of volume,
+// default and attach / detach events. The streams are generated up front, then ingested by a number of
+// threads, interleaved across agents in small batches as they would arrive from the network.
+// Reports the ingest throughput and the query latency, and exits with 1 if the index disagrees with
+// the agents' own final state.
+
+namespace
+{
+    using ed::audio::BinaryEventCodec;
+    using ed::audio::FleetIndex;
+    using ed::audio::SoundDevice;
+
+    struct CommandLineOptions
+    {
+        size_t Agents = 10'000;
+        size_t EventsPerAgent = 100;
+        size_t DevicesPerAgent = 6;
+        size_t Threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t Queries = 1000;
+    };
+
+    bool ParseCount(std::wstring_view text, size_t & value, size_t minimum, size_t maximum)
+    {
+        const std::wstring copy(text);
+        wchar_t * end = nullptr;
+        const auto parsed = std::wcstoull(copy.c_str(), &end, 10);
+        if (copy.empty() || end != copy.c_str() + copy.size() || parsed < minimum || parsed > maximum)
+        {
+            return false;
+        }
+        value = static_cast<size_t>(parsed);
+        return true;
+    }
+
+    bool ParseCommandLine(int argc, _TCHAR * argv[], CommandLineOptions & options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::wstring_view arg = argv[i];
+            std::wstring_view value;
+            const auto isOption = [arg, &value](std::wstring_view prefix)
+            {
+                value = arg.starts_with(prefix) ? arg.substr(prefix.size()) : std::wstring_view();
+                return arg.starts_with(prefix);
+            };
+
+            if (isOption(L"--agents="))
+            {
+                if (!ParseCount(value, options.Agents, 1, 1'000'000)) return false;
+            }
+            else if (isOption(L"--events="))
+            {
+                if (!ParseCount(value, options.EventsPerAgent, 0, 100'000)) return false;
+            }
+            else if (isOption(L"--devices="))
+            {
+                if (!ParseCount(value, options.DevicesPerAgent, 2, 64)) return false;
+            }
+            else if (isOption(L"--threads="))
+            {
+                if (!ParseCount(value, options.Threads, 1, 256)) return false;
+            }
+            else if (isOption(L"--queries="))
+            {
+                if (!ParseCount(value, options.Queries, 1, 10'000'000)) return false;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    struct DeviceModel
+    {
+        std::string_view Name;
+        SoundDeviceFlowType Flow;
+    };
+
+    // A small catalog, so that many hosts share device names, as in a real fleet.
+    constexpr std::array device_models = {
+        DeviceModel{ "Speakers (Realtek(R) Audio)", SoundDeviceFlowType::Render },
+        DeviceModel{ "Speakers (USB Audio Device)", SoundDeviceFlowType::Render },
+        DeviceModel{ "DELL U2720Q (NVIDIA High Definition Audio)", SoundDeviceFlowType::Render },
+        DeviceModel{ "Headphones (Jabra Evolve2 65)", SoundDeviceFlowType::Render },
+        DeviceModel{ "Microphone Array (Intel Smart Sound)", SoundDeviceFlowType::Capture },
+        DeviceModel{ "Microphone (Yeti Stereo Microphone)", SoundDeviceFlowType::Capture },
+        DeviceModel{ "Microphone (Jabra Evolve2 65)", SoundDeviceFlowType::Capture },
+        DeviceModel{ "Headset (Poly BT700)", SoundDeviceFlowType::RenderAndCapture },
+        DeviceModel{ "Echo Cancelling Speakerphone (Jabra Speak 510)", SoundDeviceFlowType::RenderAndCapture },
+    };
+
+    bool HasFlow(const DeviceModel & model, SoundDeviceFlowType flow)
+    {
+        return model.Flow == flow || model.Flow == SoundDeviceFlowType::RenderAndCapture;
+    }
+
+    // One simulated agent: its devices, its stream cut into batches, and the defaults it ends with.
+    class SimulatedAgent
+    {
+    public:
+        static constexpr size_t frames_per_batch = 8;
+
+        SimulatedAgent(size_t number, const CommandLineOptions & options)
+            : hostName_(std::format("ws-{:06}.corp.example", number))
+            , random_(20240611 + number) // fixed seed per agent: runs are comparable, whatever the thread count
+        {
+            for (size_t i = 0; i < options.DevicesPerAgent; ++i)
+            {
+                // one render and one capture device at least
+                const auto modelIndex = i < 2 ? i * 4 : std::uniform_int_distribution<size_t>(0, device_models.size() - 1)(random_);
+                devices_.push_back({ CreatePnpId(), &device_models[modelIndex] });
+            }
+            defaultRender_ = 0;
+            defaultCapture_ = 1;
+            AppendSnapshot();
+            for (size_t i = 0; i < options.EventsPerAgent; ++i)
+            {
+                AppendEvent();
+            }
+            if (!pending_.empty())
+            {
+                batches_.push_back(std::move(pending_));
+            }
+        }
+
+        [[nodiscard]] const std::string & GetHostName() const { return hostName_; }
+        [[nodiscard]] const std::vector<std::string> & GetBatches() const { return batches_; }
+        [[nodiscard]] uint64_t GetFrameCount() const { return stateVersion_; }
+
+        // The device the agent ends with as its default for flow, if any.
+        [[nodiscard]] const std::string * GetDefaultPnpId(SoundDeviceFlowType flow) const
+        {
+            const auto & index = flow == SoundDeviceFlowType::Render ? defaultRender_ : defaultCapture_;
+            return index.has_value() ? &devices_[*index].PnpId : nullptr;
+        }
+
+        [[nodiscard]] std::optional<std::string_view> GetDefaultName(SoundDeviceFlowType flow) const
+        {
+            const auto & index = flow == SoundDeviceFlowType::Render ? defaultRender_ : defaultCapture_;
+            return index.has_value() ? std::optional(devices_[*index].Model->Name) : std::nullopt;
+        }
+
+    private:
+        struct Device
+        {
+            std::string PnpId;
+            const DeviceModel * Model;
+            uint16_t RenderVolume = 500;
+            uint16_t CaptureVolume = 500;
+            bool Present = true;
+        };
+
+        std::string CreatePnpId()
+        {
+            std::uniform_int_distribution<uint64_t> draw;
+            const auto high = draw(random_);
+            const auto low = draw(random_);
+            return std::format("{:08X}-{:04X}-{:04X}-{:04X}-{:012X}", high >> 32, (high >> 16) & 0xFFFF, high & 0xFFFF,
+                low >> 48, low & 0xFFFF'FFFF'FFFF);
+        }
+
+        [[nodiscard]] SoundDevice ToSoundDevice(const Device & device) const
+        {
+            const auto isDefault = [this, &device](const std::optional<size_t> & index)
+            {
+                return index.has_value() && &devices_[*index] == &device;
+            };
+            return { device.PnpId, std::string(device.Model->Name), device.Model->Flow,
+                HasFlow(*device.Model, SoundDeviceFlowType::Render) ? device.RenderVolume : uint16_t{ 0 },
+                HasFlow(*device.Model, SoundDeviceFlowType::Capture) ? device.CaptureVolume : uint16_t{ 0 },
+                isDefault(defaultRender_), isDefault(defaultCapture_) };
+        }
+
+        void AppendSnapshot()
+        {
+            SoundDeviceCollectionSnapshot snapshot{ .StateVersion = ++stateVersion_ };
+            for (const auto & device : devices_)
+            {
+                snapshot.Devices.push_back(std::make_unique<SoundDevice>(ToSoundDevice(device)));
+            }
+            snapshot.DefaultRenderDevicePnpId = devices_[*defaultRender_].PnpId;
+            snapshot.DefaultCaptureDevicePnpId = devices_[*defaultCapture_].PnpId;
+            BinaryEventCodec::AppendSnapshotFrame(pending_, snapshot);
+            EndFrame();
+        }
+
+        void AppendEvent(SoundDeviceEventType event, const Device & device, bool withDevice)
+        {
+            const auto soundDevice = ToSoundDevice(device);
+            BinaryEventCodec::AppendEventFrame(pending_, event, device.PnpId, ++stateVersion_, withDevice ? &soundDevice : nullptr);
+            EndFrame();
+        }
+
+        void AppendDefaultCleared(SoundDeviceEventType event)
+        {
+            BinaryEventCodec::AppendEventFrame(pending_, event, std::string(), ++stateVersion_, nullptr);
+            EndFrame();
+        }
+
+        // 80% volume changes, 10% default changes, 10% attach / detach.
+        void AppendEvent()
+        {
+            const auto index = std::uniform_int_distribution<size_t>(0, devices_.size() - 1)(random_);
+            auto & device = devices_[index];
+            const auto percent = std::uniform_int_distribution<int>(0, 99)(random_);
+
+            if (!device.Present || percent >= 90)
+            {
+                ToggleAttached(index);
+                return;
+            }
+
+            const bool render = device.Model->Flow == SoundDeviceFlowType::RenderAndCapture
+                ? percent % 2 == 0
+                : device.Model->Flow == SoundDeviceFlowType::Render;
+            if (percent < 80)
+            {
+                auto & volume = render ? device.RenderVolume : device.CaptureVolume;
+                volume = static_cast<uint16_t>((volume + 1 + std::uniform_int_distribution<int>(0, 998)(random_)) % 1001);
+                AppendEvent(render ? SoundDeviceEventType::VolumeRenderChanged : SoundDeviceEventType::VolumeCaptureChanged, device, true);
+                return;
+            }
+            (render ? defaultRender_ : defaultCapture_) = index;
+            AppendEvent(render ? SoundDeviceEventType::DefaultRenderChanged : SoundDeviceEventType::DefaultCaptureChanged, device, false);
+        }
+
+        void ToggleAttached(size_t index)
+        {
+            auto & device = devices_[index];
+            device.Present = !device.Present;
+            if (device.Present)
+            {
+                AppendEvent(SoundDeviceEventType::Discovered, device, true);
+                return;
+            }
+            AppendEvent(SoundDeviceEventType::Detached, device, false);
+            if (defaultRender_ == index)
+            {
+                defaultRender_.reset();
+                AppendDefaultCleared(SoundDeviceEventType::DefaultRenderChanged);
+            }
+            if (defaultCapture_ == index)
+            {
+                defaultCapture_.reset();
+                AppendDefaultCleared(SoundDeviceEventType::DefaultCaptureChanged);
+            }
+        }
+
+        void EndFrame()
+        {
+            if (stateVersion_ % frames_per_batch == 0)
+            {
+                batches_.push_back(std::move(pending_));
+                pending_.clear();
+            }
+        }
+
+    private:
+        const std::string hostName_;
+        std::mt19937_64 random_;
+        std::vector<Device> devices_;
+        std::optional<size_t> defaultRender_;
+        std::optional<size_t> defaultCapture_;
+        uint64_t stateVersion_ = 0;
+        std::string pending_;
+        std::vector<std::string> batches_;
+    };
+
+    // Runs work(thread) on each of threadCount threads and returns when all are done.
+    template <typename Work>
+    void RunOnThreads(size_t threadCount, Work work)
+    {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back(work, t);
+        }
+        for (auto & thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    double Percentile(const std::vector<double> & sorted, double fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0.0;
+        }
+        const auto rank = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    struct QueryReport
+    {
+        double MeanMicroseconds = 0.0;
+        double P99Microseconds = 0.0;
+        double HostsPerQuery = 0.0;
+    };
+
+    template <typename Query>
+    QueryReport MeasureQueries(size_t count, Query query)
+    {
+        std::vector<double> samples;
+        samples.reserve(count);
+        size_t hosts = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto start = Clock::now();
+            hosts += query(i).size();
+            samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        std::ranges::sort(samples);
+        double total = 0.0;
+        for (const auto sample : samples)
+        {
+            total += sample;
+        }
+        return { total / static_cast<double>(count), Percentile(samples, 0.99), static_cast<double>(hosts) / static_cast<double>(count) };
+    }
+}
+
+int _tmain(int argc, _TCHAR * argv[])
+{
+    CommandLineOptions options;
+    if (!ParseCommandLine(argc, argv, options))
+    {
+        std::cerr << "Usage: SoundAgentAggregator [--agents=<count>] [--events=<per agent>] [--devices=<per agent>]\n"
+            "  [--threads=<ingest threads>] [--queries=<count>]\n";
+        return 2;
+    }
+
+    // generate the streams of all agents
+    const auto generationStart = Clock::now();
+    std::vector<std::unique_ptr<SimulatedAgent>> agents(options.Agents);
+    RunOnThreads(options.Threads, [&agents, &options](size_t thread)
+    {
+        for (size_t i = thread; i < agents.size(); i += options.Threads)
+        {
+            agents[i] = std::make_unique<SimulatedAgent>(i, options);
+        }
+    });
+    uint64_t frameCount = 0;
+    size_t byteCount = 0;
+    size_t maxBatches = 0;
+    for (const auto & agent : agents)
+    {
+        frameCount += agent->GetFrameCount();
+        maxBatches = std::max(maxBatches, agent->GetBatches().size());
+        for (const auto & batch : agent->GetBatches())
+        {
+            byteCount += batch.size();
+        }
+    }
+    const auto generationSeconds = std::chrono::duration<double>(Clock::now() - generationStart).count();
+
+    FleetIndex index;
+    std::vector<FleetIndex::HostId> hostIds;
+    hostIds.reserve(agents.size());
+    for (const auto & agent : agents)
+    {
+        hostIds.push_back(index.AddHost(agent->GetHostName()));
+    }
+
+    // ingest: thread t serves agents t, t + threads, ... one batch of each in turn
+    std::vector<double> threadSeconds(options.Threads);
+    std::vector<size_t> incompleteBatches(options.Threads);
+    const auto ingestStart = Clock::now();
+    RunOnThreads(options.Threads, [&](size_t thread)
+    {
+        const auto start = Clock::now();
+        BinaryEventCodec::Frame frame;
+        for (size_t round = 0; round < maxBatches; ++round)
+        {
+            for (size_t i = thread; i < agents.size(); i += options.Threads)
+            {
+                const auto & batches = agents[i]->GetBatches();
+                if (round < batches.size() && index.Ingest(hostIds[i], batches[round], frame) != batches[round].size())
+                {
+                    ++incompleteBatches[thread];
+                }
+            }
+        }
+        threadSeconds[thread] = std::chrono::duration<double>(Clock::now() - start).count();
+    });
+    const auto ingestSeconds = std::chrono::duration<double>(Clock::now() - ingestStart).count();
+    const auto statistics = index.GetStatistics();
+
+    double threadSecondsTotal = 0.0;
+    for (const auto seconds : threadSeconds)
+    {
+        threadSecondsTotal += seconds;
+    }
+    std::cout << std::format("agents:     {} hosts, {} devices each, {} frames ({:.1f} MB) generated in {:.2f} s\n",
+        agents.size(), options.DevicesPerAgent, frameCount, static_cast<double>(byteCount) / 1e6, generationSeconds);
+    std::cout << std::format("ingest:     {} frames in {:.3f} s on {} threads: {:.0f} frames/s, {:.0f} frames/s per thread\n",
+        frameCount, ingestSeconds, options.Threads, static_cast<double>(frameCount) / ingestSeconds,
+        static_cast<double>(frameCount) / threadSecondsTotal);
+    std::cout << std::format("index:      {} hosts, {} devices, {} interned strings; {} frames applied, {} stale\n",
+        statistics.Hosts, statistics.Devices, statistics.InternedStrings, statistics.FramesApplied, statistics.StaleFramesDropped);
+
+    // the index must agree with each agent's own view
+    bool passed = statistics.FramesApplied == frameCount && statistics.StaleFramesDropped == 0;
+    for (const auto count : incompleteBatches)
+    {
+        passed = passed && count == 0;
+    }
+    for (const auto flow : { SoundDeviceFlowType::Render, SoundDeviceFlowType::Capture })
+    {
+        std::map<std::string_view, size_t> expected;
+        for (const auto & agent : agents)
+        {
+            if (const auto name = agent->GetDefaultName(flow))
+            {
+                ++expected[*name];
+            }
+        }
+        for (const auto & model : device_models)
+        {
+            const auto found = index.FindHostsWithDefault(FleetIndex::DeviceKey::Name, model.Name, flow).size();
+            if (found != expected[model.Name])
+            {
+                std::cout << std::format("FAILED: {} hosts with default {} device \"{}\", expected {}\n",
+                    found, flow == SoundDeviceFlowType::Render ? "render" : "capture", model.Name, expected[model.Name]);
+                passed = false;
+            }
+        }
+        for (size_t i = 0; i < agents.size(); ++i)
+        {
+            if (const auto pnpId = agents[i]->GetDefaultPnpId(flow))
+            {
+                const auto hosts = index.FindHostsWithDefault(FleetIndex::DeviceKey::PnpId, *pnpId, flow);
+                if (hosts.size() != 1 || hosts[0] != agents[i]->GetHostName())
+                {
+                    std::cout << std::format("FAILED: default device {} of {} not found\n", *pnpId, agents[i]->GetHostName());
+                    passed = false;
+                }
+            }
+        }
+    }
+
+    std::mt19937_64 random(20240611);
+    std::vector<size_t> picks(options.Queries);
+    for (auto & pick : picks)
+    {
+        pick = std::uniform_int_distribution<size_t>(0, agents.size() - 1)(random);
+    }
+    const auto byName = MeasureQueries(options.Queries, [&index](size_t i)
+    {
+        return index.FindHostsWithDefault(FleetIndex::DeviceKey::Name, device_models[i % device_models.size()].Name,
+            HasFlow(device_models[i % device_models.size()], SoundDeviceFlowType::Render) ? SoundDeviceFlowType::Render : SoundDeviceFlowType::Capture);
+    });
+    const auto byPnpId = MeasureQueries(options.Queries, [&index, &agents, &picks](size_t i)
+    {
+        const auto pnpId = agents[picks[i]]->GetDefaultPnpId(SoundDeviceFlowType::Capture);
+        return index.FindHostsWithDevice(FleetIndex::DeviceKey::PnpId, pnpId != nullptr ? *pnpId : std::string());
+    });
+    std::cout << std::format("query:      default by device name: mean {:.1f} us, p99 {:.1f} us, {:.0f} hosts per query\n",
+        byName.MeanMicroseconds, byName.P99Microseconds, byName.HostsPerQuery);
+    std::cout << std::format("query:      device by PnP id: mean {:.1f} us, p99 {:.1f} us, {:.2f} hosts per query\n",
+        byPnpId.MeanMicroseconds, byPnpId.P99Microseconds, byPnpId.HostsPerQuery);
+
+    if (statistics.FramesApplied != frameCount || statistics.StaleFramesDropped != 0)
+    {
+        std::cout << std::format("FAILED: {} of {} frames applied\n", statistics.FramesApplied, frameCount);
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#include "stdafx.h"
+
+#include "DllObserver.h"
+
+
+DllObserver::DllObserver(ed::audio::SoundDeviceCollection& deviceCollection
+    , TSaaDefaultChangedCallback defaultRenderChangedCallback
+    , TSaaDefaultChangedCallback defaultCaptureChangedCallback)
+    : deviceCollection_(deviceCollection)
+    , defaultRenderChangedCallback_(defaultRenderChangedCallback)
+    , defaultCaptureChangedCallback_(defaultCaptureChangedCallback)
+{
+}
+
+DllObserver::~DllObserver() = default;
+
+void DllObserver::Subscribe()
+{
+    deviceCollection_.SubscribeHandlers<
+        SoundDeviceEventType::DefaultRenderChanged,
+        SoundDeviceEventType::DefaultCaptureChanged,
+        SoundDeviceEventType::VolumeRenderChanged,
+        SoundDeviceEventType::VolumeCaptureChanged>(*this);
+}
+
+void DllObserver::Unsubscribe()
+{
+    deviceCollection_.UnsubscribeHandlers(*this, true);
+}
+
+template <SoundDeviceEventType Event>
+void DllObserver::OnEvent(const std::string& devicePnpId, uint64_t /*stateVersion*/)
+{
+    constexpr auto route = saa_event_routes[static_cast<size_t>(Event)];
+    static_assert(route.Kind != SaaRouteKind::None, "Subscribed to an event without a C event");
+
+    if constexpr (route.Kind == SaaRouteKind::DefaultRender)
+    {
+        if (defaultRenderChangedCallback_ != nullptr)
+        {
+            defaultRenderChangedCallback_(devicePnpId.empty() ? route.Detached : route.Attached);
+        }
+    }
+    else if constexpr (route.Kind == SaaRouteKind::DefaultCapture)
+    {
+        if (defaultCaptureChangedCallback_ != nullptr)
+        {
+            defaultCaptureChangedCallback_(devicePnpId.empty() ? route.Detached : route.Attached);
+        }
+    }
+    else if constexpr (route.Kind == SaaRouteKind::Volume)
+    {
+        if (defaultRenderChangedCallback_ != nullptr
+            && deviceCollection_.ReadDefaultRenderDevicePnpId(defaultPnpId_) && defaultPnpId_ == devicePnpId)
+        {
+            defaultRenderChangedCallback_(route.Volume);
+        }
+        if (defaultCaptureChangedCallback_ != nullptr
+            && deviceCollection_.ReadDefaultCaptureDevicePnpId(defaultPnpId_) && defaultPnpId_ == devicePnpId)
+        {
+            defaultCaptureChangedCallback_(route.Volume);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "SoundAgentApi.h"
+#include "SoundDeviceCollection.h"
+#include "ApiClient/common/ClassDefHelper.h"
+
+// How a collection event reaches the callbacks of SaaRegisterCallbacks.
+enum class SaaRouteKind : uint8_t
+{
+    None = 0,       // no C event; ContentReset among them: callers of SaaRegisterCallbacks re-read anyway
+    DefaultRender,  // to the render callback, Attached or Detached by whether the flow has a default device
+    DefaultCapture, // to the capture callback, likewise
+    Volume          // Volume to the callback of each flow whose default device it is
+};
+
+struct SaaEventRoute {
+    SaaRouteKind Kind = SaaRouteKind::None;
+    SaaEventType Attached = {};
+    SaaEventType Detached = {};
+    SaaEventType Volume = {};
+};
+
+// Indexed by SoundDeviceEventType.
+inline constexpr std::array<SaaEventRoute, ed::audio::ObserverRegistry::event_type_count> saa_event_routes = []
+{
+    std::array<SaaEventRoute, ed::audio::ObserverRegistry::event_type_count> routes{};
+    routes[static_cast<size_t>(SoundDeviceEventType::DefaultRenderChanged)] =
+        { SaaRouteKind::DefaultRender, SaaDefaultRenderAttached, SaaDefaultRenderDetached, {} };
+    routes[static_cast<size_t>(SoundDeviceEventType::DefaultCaptureChanged)] =
+        { SaaRouteKind::DefaultCapture, SaaDefaultCaptureAttached, SaaDefaultCaptureDetached, {} };
+    routes[static_cast<size_t>(SoundDeviceEventType::VolumeRenderChanged)] =
+        { SaaRouteKind::Volume, {}, {}, SaaVolumeRenderChanged };
+    routes[static_cast<size_t>(SoundDeviceEventType::VolumeCaptureChanged)] =
+        { SaaRouteKind::Volume, {}, {}, SaaVolumeCaptureChanged };
+    return routes;
+}();
+
+// Forwards the collection events to the C callbacks. Subscribed with a handler per routed event type,
+// each specialized at compile time on its route.
+class DllObserver final {
+public:
+    DllObserver(ed::audio::SoundDeviceCollection & deviceCollection
+        , TSaaDefaultChangedCallback defaultRenderChangedCallback
+        , TSaaDefaultChangedCallback defaultCaptureChangedCallback);
+    DISALLOW_COPY_MOVE(DllObserver);
+    ~DllObserver();
+
+    void Subscribe();
+    // Returns after the callbacks running on this observer finished.
+    void Unsubscribe();
+
+    template <SoundDeviceEventType Event>
+    void OnEvent(const std::string& devicePnpId, uint64_t stateVersion);
+
+private:
+    ed::audio::SoundDeviceCollection& deviceCollection_;
+    TSaaDefaultChangedCallback defaultRenderChangedCallback_;
+    TSaaDefaultChangedCallback defaultCaptureChangedCallback_;
+    // Reused for the default device PnP ids; the events come on the collection's delivery thread only.
+    std::string defaultPnpId_;
+};
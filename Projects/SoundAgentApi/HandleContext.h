@@ -0,0 +1,61 @@
+#pragma once
+
+#include <memory>
+
+#include "ComExecutor.h"
+#include "DllObserver.h"
+#include "EndpointSimulator.h"
+#include "SerialWorker.h"
+#include "SoundAgentApi.h"
+#include "SoundDeviceCollection.h"
+#include "WarmStart.h"
+#include "public/SoundAgentInterface.h"
+
+// Internal state behind a SaaHandle.
+struct HandleContext {
+    // Runs the COM work of the handle, whatever thread calls: the set-up, the enumerations and the tear-down.
+    // Shared by the handles of the process; declared first to outlive the COM objects of the members below.
+    std::shared_ptr<ed::audio::ComExecutor> Executor = ed::audio::ComExecutor::AcquireShared();
+    // Set for handles from SaaSimInitialize only; declared before the collection using it, to outlive it.
+    std::unique_ptr<ed::audio::EndpointSimulator> Simulator;
+    std::unique_ptr<ed::audio::SoundDeviceCollection> DeviceCollection;
+    std::unique_ptr<DllObserver> DeviceCollectionObserver;
+    // Set for handles from SaaInitialize only; declared last to stop enumerating before the collection goes away.
+    std::unique_ptr<ed::audio::WarmStart> WarmStart;
+    // Whether the first registration of callbacks, refreshed by the warm start's enumeration, happened.
+    bool CallbacksRegistered = false;
+    // Set for handles from SaaInitializeAsync; runs the set-up and the registrations behind the calls.
+    // Declared last to finish its tasks first.
+    std::unique_ptr<ed::audio::SerialWorker> Worker;
+};
+
+inline HandleContext* GetHandleContextOrNull(const SaaHandle handle)
+{
+    return reinterpret_cast<HandleContext*>(handle);
+}
+
+// Success if the collection of the handle can be read; otherwise InvalidHandle, or NotReady (InternalError if the
+// set-up failed) while an asynchronous initialization has not published a first snapshot.
+inline SaaResult CheckCollectionReady(const HandleContext* context)
+{
+    if (context == nullptr)
+    {
+        return SaaResultCodeInvalidHandle;
+    }
+    if (context->Worker != nullptr)
+    {
+        switch (context->Worker->GetReadiness())
+        {
+        case ed::audio::SerialWorker::Readiness::Pending:
+            return SaaResultCodeNotReady;
+        case ed::audio::SerialWorker::Readiness::Failed:
+            return SaaResultCodeInternalError;
+        case ed::audio::SerialWorker::Readiness::Ready:
+            break;
+        }
+    }
+    return context->DeviceCollection != nullptr ? SaaResultCodeSuccess : SaaResultCodeInvalidHandle;
+}
+
+// Configures logging for a new handle; shared by SaaInitialize and SaaSimInitialize.
+void SetUpLog(TSaaGotLogMessageCallback gotLogMessageCallback, const CHAR* appName, const CHAR* appVersion);
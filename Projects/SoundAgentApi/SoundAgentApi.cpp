@@ -1,128 +1,121 @@
 #include "stdafx.h"
 
 #include "SoundAgentApi.h"
+#include "DllObserver.h"
+#include "HandleContext.h"
 
 #include "public/SoundAgentInterface.h"
 #include "OsInfo.h"
+#include "SoundDeviceCollection.h"
 #include "ApiClient/common/ClassDefHelper.h"
 
 #include "VersionInformation.h"
 
 #include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <crtdbg.h>
+#include <filesystem>
 #include <intsafe.h>
 
 #include "ApiClient/common/SpdLogger/Logger.h"
 
-namespace {
-    struct HandleContext {
-        std::unique_ptr<SoundDeviceCollectionInterface> DeviceCollection;
-        std::unique_ptr<SoundDeviceObserverInterface> DeviceCollectionObserver;
-    };
+#include <spdlog/spdlog.h>
 
-    HandleContext* GetHandleContextOrNull(const SaaHandle handle)
+namespace  {
+    TSaaGotLogMessageCallback got_log_message_callback = nullptr;
+
+    void LoggerMessageBridge(const std::string& timestamp, const std::string& level, const std::string& message)
     {
-        return reinterpret_cast<HandleContext*>(handle);
+        if (got_log_message_callback == nullptr) return;
+        SaaLogMessage out{}; // zero-init
+        strncpy_s(out.Timestamp, _countof(out.Timestamp), timestamp.c_str(), _TRUNCATE);
+        strncpy_s(out.Level, _countof(out.Level), level.c_str(), _TRUNCATE);
+        strncpy_s(out.Content, _countof(out.Content), message.c_str(), _TRUNCATE);
+        got_log_message_callback(out);
     }
-}
 
-class DllObserver final : public SoundDeviceObserverInterface {
-public:
-    explicit DllObserver(SoundDeviceCollectionInterface* deviceCollection
-        , TSaaDefaultChangedCallback defaultRenderChangedCallback
-        , TSaaDefaultChangedCallback defaultCaptureChangedCallback)
-        : deviceCollection_(deviceCollection)
-        , defaultRenderChangedCallback_(defaultRenderChangedCallback)
-        , defaultCaptureChangedCallback_(defaultCaptureChangedCallback)
+    // Per user and application; a cache, so the temporary directory will do.
+    std::filesystem::path GetSnapshotPath(const CHAR* appName)
     {
+        auto fileName = appName != nullptr ? std::string(appName) : std::string(RESOURCE_FILENAME_ATTRIBUTE);
+        std::ranges::replace_if(fileName, [](char c) { return std::isalnum(static_cast<unsigned char>(c)) == 0 && c != '-'; }, '_');
+        std::error_code ignored;
+        return std::filesystem::temp_directory_path(ignored) / "SoundAgentApi" / (fileName + ".devices");
     }
-    DISALLOW_COPY_MOVE(DllObserver);
-    ~DllObserver() override;
-
-    void OnCollectionChanged(SoundDeviceEventType event, const std::string& devicePnpId) override;
-
-private:
-    SoundDeviceCollectionInterface* deviceCollection_;
-    TSaaDefaultChangedCallback defaultRenderChangedCallback_;
-    TSaaDefaultChangedCallback defaultCaptureChangedCallback_;
-};
-
-DllObserver::~DllObserver() = default;
 
+    // Shared by SaaInitialize and SaaInitializeAsync; the latter runs it on the handle's worker.
+    void SetUpCollection(HandleContext* context, const std::filesystem::path& snapshotPath)
+    {
+        auto deviceCollection = context->Executor->Invoke([] { return std::make_unique<ed::audio::SoundDeviceCollection>(); });
+        context->WarmStart = std::make_unique<ed::audio::WarmStart>(*deviceCollection, snapshotPath, context->Executor.get());
+        // Polls the devices where the endpoint notifications are unavailable, e.g. on locked-down hosts. Only the
+        // polls do COM work, so the loop is started here, not on the executor, whose thread runs them.
+        deviceCollection->UseComExecutor(context->Executor.get());
+        deviceCollection->ActivateAndStartLoop();
+        context->DeviceCollection = std::move(deviceCollection);
+    }
 
-void DllObserver::OnCollectionChanged(SoundDeviceEventType event, const std::string& devicePnpId)
-{
-    if (defaultRenderChangedCallback_ != nullptr)
+    // Shared by SaaRegisterCallbacks and SaaRegisterCallbacksAsync; runs on the handle's worker if it has one.
+    void RegisterCallbacks(HandleContext* context
+        , TSaaDefaultChangedCallback defaultRenderChangedCallback
+        , TSaaDefaultChangedCallback defaultCaptureChangedCallback
+    )
     {
-        if (event == SoundDeviceEventType::DefaultRenderChanged)
-        {
-            defaultRenderChangedCallback_(devicePnpId.empty() ? SaaDefaultRenderDetached : SaaDefaultRenderAttached);
-        }
-        if (
-            (event == SoundDeviceEventType::VolumeRenderChanged || event == SoundDeviceEventType::VolumeCaptureChanged)
-            && deviceCollection_ != nullptr && deviceCollection_->GetDefaultRenderDevicePnpId() == devicePnpId
-        )
+        if (context->DeviceCollectionObserver != nullptr)
         {
-            defaultRenderChangedCallback_(event == SoundDeviceEventType::VolumeRenderChanged
-                ? SaaVolumeRenderChanged
-                : SaaVolumeCaptureChanged);
+            // The old observer is destroyed below; let callbacks running on it finish first.
+            context->DeviceCollectionObserver->Unsubscribe();
         }
-    }
-    if (defaultCaptureChangedCallback_ != nullptr)
-    {
-        if (event == SoundDeviceEventType::DefaultCaptureChanged)
+
+        context->DeviceCollectionObserver = std::make_unique<DllObserver>(*context->DeviceCollection,
+            defaultRenderChangedCallback,
+            defaultCaptureChangedCallback);
+        context->DeviceCollectionObserver->Subscribe();
+        // The first registration is refreshed by the warm start's enumeration, which notifies the differences
+        // to the persisted devices served so far; the defaults are notified in any case, as the initial state.
+        if (context->WarmStart != nullptr && !context->CallbacksRegistered)
         {
-            defaultCaptureChangedCallback_(devicePnpId.empty() ? SaaDefaultCaptureDetached : SaaDefaultCaptureAttached);
+            context->WarmStart->JoinReconciliation();
+            context->DeviceCollection->NotifyCurrentDefaults();
         }
-        if (
-            (event == SoundDeviceEventType::VolumeCaptureChanged || event == SoundDeviceEventType::VolumeRenderChanged)
-            && deviceCollection_ != nullptr && deviceCollection_->GetDefaultCaptureDevicePnpId() == devicePnpId
-        )
+        else
         {
-            defaultCaptureChangedCallback_(event == SoundDeviceEventType::VolumeCaptureChanged
-                ? SaaVolumeCaptureChanged
-                : SaaVolumeRenderChanged);
+            context->Executor->Invoke([context] { context->DeviceCollection->ResetContent(); });
         }
+        context->CallbacksRegistered = true;
     }
-}
-
-
-namespace  {
-    TSaaGotLogMessageCallback got_log_message_callback = nullptr;
 
-    void LoggerMessageBridge(const std::string& timestamp, const std::string& level, const std::string& message)
+    // Clamped to the range of the clock, so INT64_MIN / INT64_MAX stand for an open range.
+    std::chrono::system_clock::time_point MillisecondsToTimePoint(INT64 milliseconds)
     {
-        if (got_log_message_callback == nullptr) return;
-        SaaLogMessage out{}; // zero-init
-        strncpy_s(out.Timestamp, _countof(out.Timestamp), timestamp.c_str(), _TRUNCATE);
-        strncpy_s(out.Level, _countof(out.Level), level.c_str(), _TRUNCATE);
-        strncpy_s(out.Content, _countof(out.Content), message.c_str(), _TRUNCATE);
-        got_log_message_callback(out);
+        constexpr auto min = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::duration::min()).count() + 1;
+        constexpr auto max = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::duration::max()).count() - 1;
+        return std::chrono::system_clock::time_point(std::chrono::milliseconds(std::clamp<INT64>(milliseconds, min, max)));
     }
+}
 
-    void SetUpLog
-        (
-        TSaaGotLogMessageCallback gotLogMessageCallback,
-        const CHAR* appName,
-        const CHAR* appVersion
-        )
-    {
-        const auto appNameString = appName != nullptr ? std::string(appName) : std::string(RESOURCE_FILENAME_ATTRIBUTE);
-        const auto appVersionString = appVersion != nullptr ? std::string(appVersion) : std::string(PRODUCT_VERSION_ATTRIBUTE);
+void SetUpLog
+    (
+    TSaaGotLogMessageCallback gotLogMessageCallback,
+    const CHAR* appName,
+    const CHAR* appVersion
+    )
+{
+    const auto appNameString = appName != nullptr ? std::string(appName) : std::string(RESOURCE_FILENAME_ATTRIBUTE);
+    const auto appVersionString = appVersion != nullptr ? std::string(appVersion) : std::string(PRODUCT_VERSION_ATTRIBUTE);
 
-        got_log_message_callback = gotLogMessageCallback;
+    got_log_message_callback = gotLogMessageCallback;
 
+    ed::model::Logger::Inst()
+        .ConfigureAppNameAndVersion(appNameString, appVersionString)
+        .SetOutputToConsole(false);
+    if (gotLogMessageCallback != nullptr)
+    {
         ed::model::Logger::Inst()
-            .ConfigureAppNameAndVersion(appNameString, appVersionString)
-            .SetOutputToConsole(false);
-        if (gotLogMessageCallback != nullptr)
-        {
-            ed::model::Logger::Inst()
-                .SetMessageCallback(
-                    LoggerMessageBridge
-                );
-        }
-
+            .SetMessageCallback(
+                LoggerMessageBridge
+            );
     }
 
 }
@@ -143,11 +136,55 @@ SaaResult SaaInitialize(SaaHandle* handle,
     SetUpLog(gotLogMessageCallback, appName, appVersion);
 
     auto context = std::make_unique<HandleContext>();
-    context->DeviceCollection = SoundAgent::CreateDeviceCollection();
-    if (context->DeviceCollection == nullptr)
+    SetUpCollection(context.get(), GetSnapshotPath(appName));
+    *handle = reinterpret_cast<SaaHandle>(context.release());
+
+    return SaaResultCodeSuccess;
+}
+
+SaaResult SaaInitializeAsync(SaaHandle* handle,
+    TSaaGotLogMessageCallback gotLogMessageCallback,
+    const CHAR* appName,
+    const CHAR* appVersion,
+    TSaaReadyCallback readyCallback
+)
+{
+    if (handle == nullptr)
     {
-        return SaaResultCodeInternalError;
+        return SaaResultCodeInvalidArgument;
     }
+
+    *handle = 0;
+
+    SetUpLog(gotLogMessageCallback, appName, appVersion);
+
+    auto context = std::make_unique<HandleContext>();
+    context->Worker = std::make_unique<ed::audio::SerialWorker>();
+    const auto newHandle = reinterpret_cast<SaaHandle>(context.get());
+    context->Worker->Post([context = context.get(), newHandle, snapshotPath = GetSnapshotPath(appName), readyCallback]
+        {
+            SaaResult result = SaaResultCodeSuccess;
+            try
+            {
+                SetUpCollection(context, snapshotPath);
+                // Without persisted devices, the first snapshot is the enumerated one.
+                if (!context->WarmStart->IsSnapshotLoaded())
+                {
+                    context->WarmStart->JoinReconciliation();
+                }
+                context->Worker->SetReadiness(ed::audio::SerialWorker::Readiness::Ready);
+            }
+            catch (const std::exception& ex)
+            {
+                spdlog::error("Asynchronous initialization failed: {}", ex.what());
+                context->Worker->SetReadiness(ed::audio::SerialWorker::Readiness::Failed);
+                result = SaaResultCodeInternalError;
+            }
+            if (readyCallback != nullptr)
+            {
+                readyCallback(newHandle, result);
+            }
+        });
     *handle = reinterpret_cast<SaaHandle>(context.release());
 
     return SaaResultCodeSuccess;
@@ -159,30 +196,106 @@ SaaResult SaaRegisterCallbacks(SaaHandle handle
 )
 {
     const auto context = GetHandleContextOrNull(handle);
-    if (context == nullptr || context->DeviceCollection == nullptr)
+    if (context == nullptr)
     {
         return SaaResultCodeInvalidHandle;
     }
 
-    if (context->DeviceCollectionObserver != nullptr)
+    if (context->Worker != nullptr && !context->Worker->IsWorkerThread())
     {
-        context->DeviceCollection->Unsubscribe(*context->DeviceCollectionObserver);
+        // After the set-up and in order with asynchronous registrations.
+        context->Worker->Post([context, defaultRenderChangedCallback, defaultCaptureChangedCallback]
+            {
+                if (context->DeviceCollection != nullptr)
+                {
+                    RegisterCallbacks(context, defaultRenderChangedCallback, defaultCaptureChangedCallback);
+                }
+            });
+        context->Worker->WaitUntilIdle();
+        return CheckCollectionReady(context);
     }
 
-    context->DeviceCollectionObserver = std::make_unique<DllObserver>(context->DeviceCollection.get(),
-        defaultRenderChangedCallback,
-        defaultCaptureChangedCallback);
-    context->DeviceCollection->Subscribe(*context->DeviceCollectionObserver);
-    context->DeviceCollection->ResetContent();
+    // From a callback on the worker: the tasks before it have run, so the registration can run at once.
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
+    {
+        return readiness;
+    }
+    RegisterCallbacks(context, defaultRenderChangedCallback, defaultCaptureChangedCallback);
 
     return SaaResultCodeSuccess;
 }
 
+SaaResult SaaRegisterCallbacksAsync(SaaHandle handle
+    , TSaaDefaultChangedCallback defaultRenderChangedCallback
+    , TSaaDefaultChangedCallback defaultCaptureChangedCallback
+    , TSaaReadyCallback registeredCallback
+)
+{
+    const auto context = GetHandleContextOrNull(handle);
+    if (context == nullptr)
+    {
+        return SaaResultCodeInvalidHandle;
+    }
+
+    if (context->Worker == nullptr)
+    {
+        const auto result = SaaRegisterCallbacks(handle, defaultRenderChangedCallback, defaultCaptureChangedCallback);
+        if (registeredCallback != nullptr)
+        {
+            registeredCallback(handle, result);
+        }
+        return result;
+    }
+
+    context->Worker->Post([context, handle, defaultRenderChangedCallback, defaultCaptureChangedCallback, registeredCallback]
+        {
+            SaaResult result = SaaResultCodeInternalError;
+            if (context->DeviceCollection != nullptr)
+            {
+                RegisterCallbacks(context, defaultRenderChangedCallback, defaultCaptureChangedCallback);
+                result = SaaResultCodeSuccess;
+            }
+            if (registeredCallback != nullptr)
+            {
+                registeredCallback(handle, result);
+            }
+        });
+
+    return SaaResultCodeSuccess;
+}
+
+SaaResult SaaWaitUntilReady(SaaHandle handle, DWORD timeoutMs)
+{
+    const auto context = GetHandleContextOrNull(handle);
+    if (context == nullptr)
+    {
+        return SaaResultCodeInvalidHandle;
+    }
+
+    if (context->Worker != nullptr)
+    {
+        if (timeoutMs == INFINITE)
+        {
+            while (context->Worker->WaitForReadiness(std::chrono::hours(1)) == ed::audio::SerialWorker::Readiness::Pending)
+            {
+            }
+        }
+        else
+        {
+            context->Worker->WaitForReadiness(std::chrono::milliseconds(timeoutMs));
+        }
+    }
+
+    return CheckCollectionReady(context);
+}
+
 namespace
 {
     SaaResult GetDeviceOnPnpId(const SoundDeviceCollectionInterface* deviceCollection,
         SaaDescription* description,
         const std::optional<std::string>& pnpId);
+
+    void FillDescription(SaaDescription* description, const SoundDeviceInterface* device);
 }
 
 
@@ -193,9 +306,9 @@ SaaResult SaaGetDefaultRender(SaaHandle handle, SaaDescription* description)
         return SaaResultCodeInvalidArgument;
     }
     const auto context = GetHandleContextOrNull(handle);
-    if (context == nullptr || context->DeviceCollection == nullptr)
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
     {
-        return SaaResultCodeInvalidHandle;
+        return readiness;
     }
     const auto pnpId = context->DeviceCollection->GetDefaultRenderDevicePnpId();
 
@@ -209,15 +322,212 @@ SaaResult SaaGetDefaultCapture(SaaHandle handle, SaaDescription* description)
         return SaaResultCodeInvalidArgument;
     }
     const auto context = GetHandleContextOrNull(handle);
-    if (context == nullptr || context->DeviceCollection == nullptr)
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
     {
-        return SaaResultCodeInvalidHandle;
+        return readiness;
     }
     const auto pnpId = context->DeviceCollection->GetDefaultCaptureDevicePnpId();
 
     return GetDeviceOnPnpId(context->DeviceCollection.get(), description, pnpId);
 }
 
+SaaResult SaaGetStateVersion(SaaHandle handle, UINT64* stateVersion)
+{
+    if (stateVersion == nullptr)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+    const auto context = GetHandleContextOrNull(handle);
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
+    {
+        return readiness;
+    }
+    *stateVersion = context->DeviceCollection->GetStateVersion();
+
+    return SaaResultCodeSuccess;
+}
+
+SaaResult SaaIsStale(SaaHandle handle, BOOL* isStale)
+{
+    if (isStale == nullptr)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+    const auto context = GetHandleContextOrNull(handle);
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
+    {
+        return readiness;
+    }
+    *isStale = context->DeviceCollection->CreateSnapshot().IsStale ? TRUE : FALSE;
+
+    return SaaResultCodeSuccess;
+}
+
+SaaResult SaaGetSnapshot(SaaHandle handle, SaaSnapshotInfo* info, SaaDescription* devices, UINT32 capacity)
+{
+    if (info == nullptr || (devices == nullptr && capacity != 0))
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+    const auto context = GetHandleContextOrNull(handle);
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
+    {
+        return readiness;
+    }
+
+    const auto snapshot = context->DeviceCollection->CreateSnapshot();
+    const auto findIndex = [&snapshot](const std::optional<std::string>& pnpId) -> INT32
+    {
+        if (pnpId.has_value())
+        {
+            for (size_t i = 0; i < snapshot.Devices.size(); ++i)
+            {
+                if (snapshot.Devices[i]->GetPnpId() == *pnpId)
+                {
+                    return static_cast<INT32>(i);
+                }
+            }
+        }
+        return -1;
+    };
+
+    info->StateVersion = snapshot.StateVersion;
+    info->DeviceCount = static_cast<UINT32>(snapshot.Devices.size());
+    info->DefaultRenderIndex = findIndex(snapshot.DefaultRenderDevicePnpId);
+    info->DefaultCaptureIndex = findIndex(snapshot.DefaultCaptureDevicePnpId);
+
+    if (capacity < info->DeviceCount)
+    {
+        return SaaResultCodeBufferTooSmall;
+    }
+    for (size_t i = 0; i < snapshot.Devices.size(); ++i)
+    {
+        FillDescription(devices + i, snapshot.Devices[i].get());
+    }
+
+    return SaaResultCodeSuccess;
+}
+
+SaaResult SaaGetHistory(SaaHandle handle, const CHAR* pnpId, SaaHistoryKind kind, INT64 fromMs, INT64 toMs,
+    SaaHistorySample* samples, UINT32 capacity, UINT32* count)
+{
+    if (pnpId == nullptr || count == nullptr || (samples == nullptr && capacity != 0)
+        || kind < SaaHistoryRenderVolume || kind > SaaHistoryCaptureDefault)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+    const auto context = GetHandleContextOrNull(handle);
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
+    {
+        return readiness;
+    }
+
+    const auto history = context->DeviceCollection->GetHistory(pnpId, static_cast<SoundDeviceHistoryKind>(kind),
+        MillisecondsToTimePoint(fromMs), MillisecondsToTimePoint(toMs));
+
+    *count = static_cast<UINT32>(history.size());
+    if (capacity < *count)
+    {
+        return SaaResultCodeBufferTooSmall;
+    }
+    for (size_t i = 0; i < history.size(); ++i)
+    {
+        samples[i].TimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(history[i].Time.time_since_epoch()).count();
+        samples[i].Value = history[i].Value;
+    }
+
+    return SaaResultCodeSuccess;
+}
+
+SaaResult SaaFindDevices(SaaHandle handle, const SaaDeviceQuery* query, SaaDescription* devices, UINT32 capacity, UINT32* count)
+{
+    if (query == nullptr || count == nullptr || (devices == nullptr && capacity != 0)
+        || query->FormFactor < -1 || query->FormFactor > SaaFormFactorUnknown)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+    const auto context = GetHandleContextOrNull(handle);
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
+    {
+        return readiness;
+    }
+
+    ed::audio::DeviceQuery deviceQuery;
+    deviceQuery.Renders = query->IsRender != FALSE;
+    deviceQuery.Captures = query->IsCapture != FALSE;
+    deviceQuery.IsRenderDefault = query->IsDefaultRender != FALSE;
+    deviceQuery.IsCaptureDefault = query->IsDefaultCapture != FALSE;
+    if (query->FormFactor != -1)
+    {
+        deviceQuery.FormFactor = static_cast<SoundDeviceFormFactor>(query->FormFactor);
+    }
+    if (query->NameContains != nullptr)
+    {
+        deviceQuery.NameContains = query->NameContains;
+    }
+
+    UINT32 filled = 0;
+    const auto matches = context->DeviceCollection->FindDevices(deviceQuery, [devices, capacity, &filled](const ed::audio::SoundDevice& device)
+    {
+        if (filled < capacity)
+        {
+            FillDescription(devices + filled++, &device);
+        }
+    });
+    *count = static_cast<UINT32>(matches);
+
+    return matches > capacity ? SaaResultCodeBufferTooSmall : SaaResultCodeSuccess;
+}
+
+SaaResult SaaSetVolume(SaaHandle handle, const CHAR* pnpId, BOOL isRender, UINT16 volume)
+{
+    if (pnpId == nullptr || volume > 1000)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+    const auto context = GetHandleContextOrNull(handle);
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
+    {
+        return readiness;
+    }
+
+    return context->DeviceCollection->SetVolume(pnpId, isRender != FALSE ? SoundDeviceFlowType::Render : SoundDeviceFlowType::Capture, volume)
+        ? SaaResultCodeSuccess : SaaResultCodeInvalidArgument;
+}
+
+SaaResult SaaSetMute(SaaHandle handle, const CHAR* pnpId, BOOL isRender, BOOL mute)
+{
+    if (pnpId == nullptr)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+    const auto context = GetHandleContextOrNull(handle);
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
+    {
+        return readiness;
+    }
+
+    return context->DeviceCollection->SetMute(pnpId, isRender != FALSE ? SoundDeviceFlowType::Render : SoundDeviceFlowType::Capture, mute != FALSE)
+        ? SaaResultCodeSuccess : SaaResultCodeInvalidArgument;
+}
+
+SaaResult SaaRampVolume(SaaHandle handle, const CHAR* pnpId, BOOL isRender, UINT16 volume, UINT32 durationMs)
+{
+    if (pnpId == nullptr || volume > 1000)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+    const auto context = GetHandleContextOrNull(handle);
+    if (const auto readiness = CheckCollectionReady(context); readiness != SaaResultCodeSuccess)
+    {
+        return readiness;
+    }
+
+    return context->DeviceCollection->RampVolume(pnpId, isRender != FALSE ? SoundDeviceFlowType::Render : SoundDeviceFlowType::Capture,
+        volume, std::chrono::milliseconds(durationMs))
+        ? SaaResultCodeSuccess : SaaResultCodeInvalidArgument;
+}
+
 SaaResult SaaGetOperationSystemName(SaaHandle handle, SaaOsInfo* osInfo)
 {
     if (osInfo == nullptr)
@@ -244,39 +554,46 @@ namespace
         SaaDescription* description,
         const std::optional<std::string>& pnpId)
     {
-        std::ranges::fill(description->PnpId, '\0');
-        std::ranges::fill(description->Name, '\0');
-        description->IsRender = FALSE;
-        description->IsCapture = FALSE;
-        description->RenderVolume = 0;
-        description->CaptureVolume = 0;
+        FillDescription(description, nullptr);
         if (deviceCollection != nullptr && pnpId.has_value())
         {
             if (const auto device = deviceCollection->CreateItem(*pnpId)
                 ; device != nullptr)
             {
-                {
-
-                    const auto devicePnpId = device->GetPnpId();
-                    const auto deviceName = device->GetName();
-                    strncpy_s(description->PnpId, _countof(description->PnpId), devicePnpId.c_str(),_TRUNCATE);
-                    strncpy_s(description->Name, _countof(description->Name), deviceName.c_str(), _TRUNCATE);
-                }
-                description->IsRender = device->GetFlow() == SoundDeviceFlowType::Render || device->GetFlow() ==
-                                        SoundDeviceFlowType::RenderAndCapture
-                                            ? TRUE
-                                            : FALSE;
-                description->IsCapture = device->GetFlow() == SoundDeviceFlowType::Capture || device->GetFlow() ==
-                                         SoundDeviceFlowType::RenderAndCapture
-                                             ? TRUE
-                                             : FALSE;
-                description->RenderVolume = device->GetCurrentRenderVolume();
-                description->CaptureVolume = device->GetCurrentCaptureVolume();
+                FillDescription(description, device.get());
             }
             return SaaResultCodeSuccess;
         }
         return SaaResultCodeSuccess;
     }
+
+    // Zeroes the description if device is null.
+    void FillDescription(SaaDescription* description, const SoundDeviceInterface* device)
+    {
+        std::ranges::fill(description->PnpId, '\0');
+        std::ranges::fill(description->Name, '\0');
+        description->IsRender = FALSE;
+        description->IsCapture = FALSE;
+        description->RenderVolume = 0;
+        description->CaptureVolume = 0;
+        if (device != nullptr)
+        {
+            const auto devicePnpId = device->GetPnpId();
+            const auto deviceName = device->GetName();
+            strncpy_s(description->PnpId, _countof(description->PnpId), devicePnpId.c_str(), _TRUNCATE);
+            strncpy_s(description->Name, _countof(description->Name), deviceName.c_str(), _TRUNCATE);
+            description->IsRender = device->GetFlow() == SoundDeviceFlowType::Render || device->GetFlow() ==
+                                    SoundDeviceFlowType::RenderAndCapture
+                                        ? TRUE
+                                        : FALSE;
+            description->IsCapture = device->GetFlow() == SoundDeviceFlowType::Capture || device->GetFlow() ==
+                                     SoundDeviceFlowType::RenderAndCapture
+                                         ? TRUE
+                                         : FALSE;
+            description->RenderVolume = device->GetCurrentRenderVolume();
+            description->CaptureVolume = device->GetCurrentCaptureVolume();
+        }
+    }
 }
 
 
@@ -284,12 +601,26 @@ SaaResult SaaUnInitialize(SaaHandle handle)
 {
     if (const auto context = GetHandleContextOrNull(handle); context != nullptr)
     {
+        if (context->Worker != nullptr && context->Worker->IsWorkerThread())
+        {
+            // From a callback on the worker, which can not join itself
+            return SaaResultCodeWrongThread;
+        }
+        // Runs the pending set-up and registrations; they need the members below.
+        context->Worker.reset();
         if (context->DeviceCollection != nullptr && context->DeviceCollectionObserver != nullptr)
         {
-            context->DeviceCollection->Unsubscribe(*context->DeviceCollectionObserver);
+            context->DeviceCollectionObserver->Unsubscribe();
             context->DeviceCollectionObserver.reset();
         }
-        context->DeviceCollection.reset();
+        context->WarmStart.reset();
+        if (context->DeviceCollection != nullptr)
+        {
+            // A running poll waits for the executor: stopped before the executor waits for it.
+            context->DeviceCollection->DeactivateAndStopLoop();
+        }
+        // Unregisters the endpoint callbacks; the executor goes with the context, after the last COM object.
+        context->Executor->Invoke([context] { context->DeviceCollection.reset(); });
         delete context;
     }
     return SaaResultCodeSuccess;
@@ -9,7 +9,14 @@
  * 2. (Optional) ::SaaRegisterCallbacks to receive change events.
  * 3. Call ::SaaGetDefaultRender / ::SaaGetDefaultCapture to query devices.
  * 4. Call ::SaaUnInitialize before exit / unloading.
- * Threading: Serialize initialize/uninitialize. Callbacks may fire on worker thread; keep them fast and thread-safe.
+ * Asynchronous start: ::SaaInitializeAsync and ::SaaRegisterCallbacksAsync return at once and do the COM set-up,
+ * the enumeration and the registration on an internal worker thread, in call order. Until the first snapshot is
+ * published the getters return ::SaaResultCodeNotReady; readiness is signalled by a callback and ::SaaWaitUntilReady.
+ * Warm start: ::SaaInitialize serves the devices persisted by the previous run at once, marked stale (::SaaIsStale),
+ * while the devices are enumerated in the background; the enumeration notifies the differences only.
+ * Resync: the collection state carries a version, increased by every change. A consumer that fell behind
+ * compares ::SaaGetStateVersion with the version it last read and, if it differs, re-reads all via ::SaaGetSnapshot.
+ * Threading: Serialize initialize/uninitialize. Callbacks fire on an internal delivery thread; keep them fast and thread-safe.
  * Errors: 0 = success. See ::SaaResultCode for named values.
  * Strings: ANSI, truncated with null terminator.
  * Logging: Supply log callback at init to receive async log messages.
@@ -38,7 +45,10 @@
         SaaResultCodeSuccess = 0,
         SaaResultCodeInvalidArgument = 1,
         SaaResultCodeInvalidHandle = 2,
-        SaaResultCodeInternalError = 3
+        SaaResultCodeInternalError = 3,
+        SaaResultCodeBufferTooSmall = 4,
+        SaaResultCodeNotReady = 5,
+        SaaResultCodeWrongThread = 6
     } SaaResultCode;
 
     /** Device description. Unused fields zeroed. BOOL uses Win32 TRUE/FALSE. */
@@ -51,6 +61,53 @@
         UINT16 CaptureVolume;      /**< Current capture volume (implementation units). */
     } SaaDescription;
 
+    /** Header of a consistent collection snapshot. */
+    typedef struct {
+        UINT64 StateVersion;        /**< Collection state version the snapshot was taken at. */
+        UINT32 DeviceCount;         /**< Number of devices in the snapshot. */
+        INT32  DefaultRenderIndex;  /**< Index of default render device in the snapshot, -1 if none. */
+        INT32  DefaultCaptureIndex; /**< Index of default capture device in the snapshot, -1 if none. */
+    } SaaSnapshotInfo;
+
+    /** Form factor of a device, as Windows reports it for its endpoint. */
+    typedef enum {
+        SaaFormFactorRemoteNetworkDevice = 0,
+        SaaFormFactorSpeakers = 1,
+        SaaFormFactorLineLevel = 2,
+        SaaFormFactorHeadphones = 3,
+        SaaFormFactorMicrophone = 4,
+        SaaFormFactorHeadset = 5,
+        SaaFormFactorHandset = 6,
+        SaaFormFactorUnknownDigitalPassthrough = 7,
+        SaaFormFactorSpdif = 8,
+        SaaFormFactorDigitalAudioDisplayDevice = 9,
+        SaaFormFactorUnknown = 10
+    } SaaFormFactor;
+
+    /** Conditions of ::SaaFindDevices; a device must meet all that are set. */
+    typedef struct {
+        BOOL        IsRender;         /**< TRUE: only devices that can render audio. */
+        BOOL        IsCapture;        /**< TRUE: only devices that can capture audio. */
+        BOOL        IsDefaultRender;  /**< TRUE: only the default render device. */
+        BOOL        IsDefaultCapture; /**< TRUE: only the default capture device. */
+        INT32       FormFactor;       /**< A ::SaaFormFactor, or -1 for any. */
+        const CHAR* NameContains;     /**< Part of the name, UTF-8, case-insensitive for ASCII letters; NULL or empty for any. */
+    } SaaDeviceQuery;
+
+    /** Kind of device history, see ::SaaGetHistory. */
+    typedef enum {
+        SaaHistoryRenderVolume = 0,   /**< Render volume; 0 while muted. */
+        SaaHistoryCaptureVolume = 1,  /**< Capture volume; 0 while muted. */
+        SaaHistoryRenderDefault = 2,  /**< 1 while the device is the default render device, 0 otherwise. */
+        SaaHistoryCaptureDefault = 3  /**< 1 while the device is the default capture device, 0 otherwise. */
+    } SaaHistoryKind;
+
+    /** Transition in a device history. */
+    typedef struct {
+        INT64  TimeMs;             /**< Milliseconds since 1970-01-01 UTC. */
+        UINT16 Value;              /**< New value. */
+    } SaaHistorySample;
+
     /** OS info. */
     typedef struct {
         CHAR   Name[256];          /**< Extended operating system name. */
@@ -78,6 +135,18 @@
         _In_ SaaEventType event
         );
 
+    /**
+     * Completion of an asynchronous call: ::SaaResultCodeSuccess, or ::SaaResultCodeInternalError if it failed.
+     * Called on the handle's worker thread, which runs the asynchronous calls one after another: while it runs, they
+     * wait. It may call ::SaaRegisterCallbacks, which then registers at once. It must not call ::SaaUnInitialize,
+     * which then returns ::SaaResultCodeWrongThread and leaves the handle alone, nor wait for anything that another
+     * asynchronous call of the handle does.
+     */
+    typedef void(__stdcall* TSaaReadyCallback)(
+        _In_ SaaHandle handle,
+        _In_ SaaResult result
+        );
+
     /** Asynchronous log message callback. */
     typedef void(__stdcall* TSaaGotLogMessageCallback)(
         _In_ SaaLogMessage message
@@ -97,7 +166,8 @@
 
     /**
      * Register or replace callbacks for default render/capture changes. Pass NULL to disable each.
-     * Implicitly refreshes internal device list.
+     * Implicitly refreshes internal device list: the first call waits for the enumeration started by ::SaaInitialize.
+     * Replaced callbacks are not invoked after return: the call waits for running ones to finish.
      */
     SAA_EXPORT_IMPORT_DECL
         SaaResult __stdcall SaaRegisterCallbacks(
@@ -106,6 +176,45 @@
             _In_opt_ TSaaDefaultChangedCallback defaultCaptureChangedCallback
         );
 
+    /**
+     * Like ::SaaInitialize, but returns the handle at once; the set-up runs on an internal worker thread.
+     * readyCallback: optional, called on that thread once the first snapshot is published (the persisted devices
+     * of the previous run, or else the enumerated ones) or the set-up failed. Until then getters return
+     * ::SaaResultCodeNotReady.
+     */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaInitializeAsync(
+            _Out_ SaaHandle* handle,
+            _In_opt_ TSaaGotLogMessageCallback gotLogMessageCallback,
+            _In_opt_ const CHAR* appName,
+            _In_opt_ const CHAR* appVersion,
+            _In_opt_ TSaaReadyCallback readyCallback
+        );
+
+    /**
+     * Like ::SaaRegisterCallbacks. On a handle of ::SaaInitializeAsync it returns at once: the registration and the
+     * refresh run on the worker thread after the set-up. On other handles they run before the return.
+     * registeredCallback: optional, called once the callbacks are registered and the device list is refreshed, or
+     * the registration failed; on other handles before the return, with the result returned.
+     */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaRegisterCallbacksAsync(
+            _In_ SaaHandle handle,
+            _In_opt_ TSaaDefaultChangedCallback defaultRenderChangedCallback,
+            _In_opt_ TSaaDefaultChangedCallback defaultCaptureChangedCallback,
+            _In_opt_ TSaaReadyCallback registeredCallback
+        );
+
+    /**
+     * Wait up to timeoutMs (INFINITE allowed) for the first snapshot of a handle of ::SaaInitializeAsync.
+     * Returns ::SaaResultCodeNotReady on timeout. Handles of ::SaaInitialize are ready at once.
+     */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaWaitUntilReady(
+            _In_ SaaHandle handle,
+            _In_ DWORD timeoutMs
+        );
+
     /** Get current default render device (or zeroed struct if none). description must be non-null. */
     SAA_EXPORT_IMPORT_DECL
         SaaResult __stdcall SaaGetDefaultRender(
@@ -120,6 +229,103 @@
             _Out_ SaaDescription* description
         );
 
+    /** Get current collection state version. Cheap; increases with every device, default or volume change. */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaGetStateVersion(
+            _In_ SaaHandle handle,
+            _Out_ UINT64* stateVersion
+        );
+
+    /**
+     * Tell whether the devices are still those persisted by the previous run: TRUE until the enumeration started by
+     * ::SaaInitialize finished. isStale must be non-null.
+     */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaIsStale(
+            _In_ SaaHandle handle,
+            _Out_ BOOL* isStale
+        );
+
+    /**
+     * Get all devices and defaults as one consistent snapshot, tagged with its state version. info must be non-null.
+     * If capacity is less than info->DeviceCount, returns ::SaaResultCodeBufferTooSmall with only info filled.
+     */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaGetSnapshot(
+            _In_ SaaHandle handle,
+            _Out_ SaaSnapshotInfo* info,
+            _Out_writes_opt_(capacity) SaaDescription* devices,
+            _In_ UINT32 capacity
+        );
+
+    /**
+     * Get the transitions of a device's volume or default role with fromMs <= time < toMs, oldest first.
+     * The history is kept in memory since ::SaaInitialize and bounded: the oldest transitions are dropped.
+     * pnpId and count must be non-null; an unknown device has no transitions.
+     * If capacity is less than the number of transitions, returns ::SaaResultCodeBufferTooSmall with only count filled.
+     */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaGetHistory(
+            _In_ SaaHandle handle,
+            _In_ const CHAR* pnpId,
+            _In_ SaaHistoryKind kind,
+            _In_ INT64 fromMs,
+            _In_ INT64 toMs,
+            _Out_writes_opt_(capacity) SaaHistorySample* samples,
+            _In_ UINT32 capacity,
+            _Out_ UINT32* count
+        );
+
+    /**
+     * Get the devices meeting the conditions of query, found through indexes of the collection rather than a scan.
+     * query and count must be non-null; count receives the number of matches.
+     * If capacity is less than that, returns ::SaaResultCodeBufferTooSmall with the first capacity matches filled.
+     */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaFindDevices(
+            _In_ SaaHandle handle,
+            _In_ const SaaDeviceQuery* query,
+            _Out_writes_opt_(capacity) SaaDescription* devices,
+            _In_ UINT32 capacity,
+            _Out_ UINT32* count
+        );
+
+    /**
+     * Set the render (isRender TRUE) or capture volume of a device, 0 to 1000, through its endpoint of that flow.
+     * Returns once the write is queued; a later ::SaaSetVolume or ::SaaRampVolume of the endpoint replaces one not
+     * written yet. The written volume is taken without a ::SaaVolumeRenderChanged / ::SaaVolumeCaptureChanged event.
+     * pnpId must be non-null; a device without an endpoint of the flow gives ::SaaResultCodeInvalidArgument.
+     */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaSetVolume(
+            _In_ SaaHandle handle,
+            _In_ const CHAR* pnpId,
+            _In_ BOOL isRender,
+            _In_ UINT16 volume
+        );
+
+    /** Mute or unmute the endpoint of a flow of a device, like ::SaaSetVolume. A muted device reads as volume 0. */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaSetMute(
+            _In_ SaaHandle handle,
+            _In_ const CHAR* pnpId,
+            _In_ BOOL isRender,
+            _In_ BOOL mute
+        );
+
+    /**
+     * Fade the volume of the endpoint of a flow of a device from its current volume to volume, 0 to 1000, linearly
+     * over durationMs, written every 10 ms; otherwise like ::SaaSetVolume.
+     */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaRampVolume(
+            _In_ SaaHandle handle,
+            _In_ const CHAR* pnpId,
+            _In_ BOOL isRender,
+            _In_ UINT16 volume,
+            _In_ UINT32 durationMs
+        );
+
     /** Get operating system name (or zeroed struct if unavailable). osInfo must be non-null. */
     SAA_EXPORT_IMPORT_DECL
         SaaResult __stdcall SaaGetOperationSystemName(
@@ -127,7 +333,11 @@
             _Out_ SaaOsInfo* osInfo
         );
 
-    /** Uninitialize library. Invalidate handle. Safe to call multiple times (idempotent). */
+    /**
+     * Uninitialize library. Invalidate handle. Safe to call multiple times (idempotent).
+     * Returns once the handle is torn down. From a ::TSaaReadyCallback, which runs on the handle's worker thread,
+     * returns ::SaaResultCodeWrongThread without tearing anything down: call it from another thread.
+     */
     SAA_EXPORT_IMPORT_DECL
         SaaResult __stdcall SaaUnInitialize(
             _In_ SaaHandle handle
@@ -0,0 +1,157 @@
+#include "stdafx.h"
+
+#include "SoundAgentApiSimulation.h"
+#include "HandleContext.h"
+
+#include "EndpointSimulator.h"
+#include "SoundDeviceCollection.h"
+
+#include <optional>
+
+
+namespace
+{
+    std::optional<std::wstring> Utf8ToWide(const CHAR* text)
+    {
+        if (text == nullptr)
+        {
+            return std::nullopt;
+        }
+        const int size = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, text, -1, nullptr, 0);
+        if (size <= 0)
+        {
+            return std::nullopt;
+        }
+        std::wstring result(static_cast<size_t>(size), L'\0');
+        MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, text, -1, result.data(), size);
+        result.resize(static_cast<size_t>(size) - 1);
+        return result;
+    }
+
+    ed::audio::EndpointSimulator* GetSimulatorOrNull(const SaaHandle handle)
+    {
+        const auto context = GetHandleContextOrNull(handle);
+        return context != nullptr ? context->Simulator.get() : nullptr;
+    }
+
+    SaaResult ToResult(bool done)
+    {
+        return done ? SaaResultCodeSuccess : SaaResultCodeInvalidArgument;
+    }
+}
+
+SaaResult SaaSimInitialize(SaaHandle* handle,
+    TSaaGotLogMessageCallback gotLogMessageCallback,
+    const CHAR* appName,
+    const CHAR* appVersion
+)
+{
+    if (handle == nullptr)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+
+    *handle = 0;
+
+    SetUpLog(gotLogMessageCallback, appName, appVersion);
+
+    auto context = std::make_unique<HandleContext>();
+    context->Simulator = std::make_unique<ed::audio::EndpointSimulator>();
+    context->DeviceCollection = context->Executor->Invoke([simulator = context->Simulator.get()]
+        {
+            return std::make_unique<ed::audio::SoundDeviceCollection>(simulator->GetEnumerator());
+        });
+    context->DeviceCollection->UseComExecutor(context->Executor.get());
+    *handle = reinterpret_cast<SaaHandle>(context.release());
+
+    return SaaResultCodeSuccess;
+}
+
+SaaResult SaaSimAddDevice(SaaHandle handle, const CHAR* endpointId, const CHAR* name, BOOL isRender, UINT16 volume)
+{
+    const auto simulator = GetSimulatorOrNull(handle);
+    if (simulator == nullptr)
+    {
+        return SaaResultCodeInvalidHandle;
+    }
+    const auto wideEndpointId = Utf8ToWide(endpointId);
+    const auto wideName = Utf8ToWide(name);
+    if (!wideEndpointId.has_value() || wideEndpointId->empty() || !wideName.has_value() || volume > 1000)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+
+    return ToResult(simulator->AddEndpoint(*wideEndpointId, *wideName, isRender ? eRender : eCapture, volume));
+}
+
+SaaResult SaaSimRemoveDevice(SaaHandle handle, const CHAR* endpointId)
+{
+    const auto simulator = GetSimulatorOrNull(handle);
+    if (simulator == nullptr)
+    {
+        return SaaResultCodeInvalidHandle;
+    }
+    const auto wideEndpointId = Utf8ToWide(endpointId);
+    if (!wideEndpointId.has_value())
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+
+    return ToResult(simulator->RemoveEndpoint(*wideEndpointId));
+}
+
+SaaResult SaaSimSetDefaultDevice(SaaHandle handle, const CHAR* endpointId)
+{
+    const auto simulator = GetSimulatorOrNull(handle);
+    if (simulator == nullptr)
+    {
+        return SaaResultCodeInvalidHandle;
+    }
+    const auto wideEndpointId = Utf8ToWide(endpointId);
+    if (!wideEndpointId.has_value())
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+
+    return ToResult(simulator->SetDefaultEndpoint(*wideEndpointId));
+}
+
+SaaResult SaaSimSetVolume(SaaHandle handle, const CHAR* endpointId, UINT16 volume)
+{
+    const auto simulator = GetSimulatorOrNull(handle);
+    if (simulator == nullptr)
+    {
+        return SaaResultCodeInvalidHandle;
+    }
+    const auto wideEndpointId = Utf8ToWide(endpointId);
+    if (!wideEndpointId.has_value() || volume > 1000)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+
+    return ToResult(simulator->SetVolume(*wideEndpointId, volume));
+}
+
+SaaResult SaaSimGetDeliveryStatistics(SaaHandle handle, SaaSimDeliveryStatistics* statistics)
+{
+    if (statistics == nullptr)
+    {
+        return SaaResultCodeInvalidArgument;
+    }
+    const auto context = GetHandleContextOrNull(handle);
+    const auto collection = context != nullptr && context->Simulator != nullptr
+        ? context->DeviceCollection.get()
+        : nullptr;
+    if (collection == nullptr)
+    {
+        return SaaResultCodeInvalidHandle;
+    }
+
+    const auto delivery = collection->GetDeliveryStatistics();
+    statistics->Posted = delivery.Posted;
+    statistics->Delivered = delivery.Delivered;
+    statistics->Coalesced = delivery.Coalesced;
+    statistics->DiscardedAsStale = delivery.DiscardedAsStale;
+
+    return SaaResultCodeSuccess;
+}
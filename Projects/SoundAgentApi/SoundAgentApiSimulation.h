@@ -0,0 +1,80 @@
+#ifndef SOUND_AGENT_API_SIMULATION_H
+#define SOUND_AGENT_API_SIMULATION_H
+
+/**
+ * @file SoundAgentApiSimulation.h
+ * @brief Simulated endpoint backend for load tests and integration tests without audio hardware.
+ * ::SaaSimInitialize returns a regular handle usable with all functions of SoundAgentApi.h,
+ * whose devices come from a simulated endpoint stack instead of the system one.
+ * The SaaSim* change functions raise the same notifications the OS raises, synchronously on the calling thread;
+ * callbacks still arrive on the internal delivery thread. Do not call them concurrently with ::SaaUnInitialize.
+ * Endpoint ids and names: UTF-8. Volume: 0 to 1000. Each endpoint is a device of its own.
+ */
+
+#include "SoundAgentApi.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+    /** Event delivery counters of a handle. */
+    typedef struct {
+        UINT64 Posted;           /**< Events raised by the collection. */
+        UINT64 Delivered;        /**< Events delivered to the internal observers. */
+        UINT64 Coalesced;        /**< Volume events merged into a newer pending one. */
+        UINT64 DiscardedAsStale; /**< Volume events dropped as their device went away. */
+    } SaaSimDeliveryStatistics;
+
+    /** Like ::SaaInitialize, on a simulated endpoint stack that starts empty. */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaSimInitialize(
+            _Out_ SaaHandle* handle,
+            _In_opt_ TSaaGotLogMessageCallback gotLogMessageCallback,
+            _In_opt_ const CHAR* appName,
+            _In_opt_ const CHAR* appVersion
+        );
+
+    /** Add an active endpoint, or re-activate a removed one. Returns ::SaaResultCodeInvalidArgument if it is active. */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaSimAddDevice(
+            _In_ SaaHandle handle,
+            _In_ const CHAR* endpointId,
+            _In_ const CHAR* name,
+            _In_ BOOL isRender,
+            _In_ UINT16 volume
+        );
+
+    /** Remove an active endpoint. A default endpoint leaves its flow without default. */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaSimRemoveDevice(
+            _In_ SaaHandle handle,
+            _In_ const CHAR* endpointId
+        );
+
+    /** Make an active endpoint the default of its flow. */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaSimSetDefaultDevice(
+            _In_ SaaHandle handle,
+            _In_ const CHAR* endpointId
+        );
+
+    /** Set the volume of an active endpoint. */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaSimSetVolume(
+            _In_ SaaHandle handle,
+            _In_ const CHAR* endpointId,
+            _In_ UINT16 volume
+        );
+
+    /** Get the event delivery counters. statistics must be non-null. */
+    SAA_EXPORT_IMPORT_DECL
+        SaaResult __stdcall SaaSimGetDeliveryStatistics(
+            _In_ SaaHandle handle,
+            _Out_ SaaSimDeliveryStatistics* statistics
+        );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SOUND_AGENT_API_SIMULATION_H
@@ -2,12 +2,22 @@
 
 #include "ApiClient/common/TimeUtil.h"
 
+#include "BufferedLineWriter.h"
+#include "EventSpool.h"
+#include "EventStreamPublisher.h"
+#include "HttpStateService.h"
+#include "LocalHttpServer.h"
+#include "NdjsonEventWriter.h"
 #include "OsInfo.h"
 #include "public/CoInitRaiiHelper.h"
 #include "public/SoundAgentInterface.h"
 
+#include <atomic>
+#include <fcntl.h>
 #include <filesystem>
+#include <io.h>
 #include <memory>
+#include <optional>
 #include <tchar.h>
 #include <magic_enum/magic_enum.hpp>
 
@@ -19,12 +29,13 @@ public:
     explicit ServiceObserver(SoundDeviceCollectionInterface & collection)
         : collection_(collection)
     {
-        SetUpLog();
+        SetUpLog(true);
     }
 
-    static void SetUpLog()
+    // In daemon mode the console (stdout) carries the event stream, so logs go to the log file only.
+    static void SetUpLog(bool outputToConsole)
     {
-        ed::model::Logger::Inst().SetOutputToConsole(true);
+        ed::model::Logger::Inst().SetOutputToConsole(outputToConsole);
         try
         {
             if (std::filesystem::path logFile;
@@ -83,11 +94,12 @@ public:
         spdlog::info("Press Enter to regenerate device list; To stop, type S or Q and press Enter");
     }
 
-    void OnCollectionChanged(SoundDeviceEventType event, const std::string& devicePnpId) override
+    void OnCollectionChanged(SoundDeviceEventType event, const std::string& devicePnpId, uint64_t stateVersion) override
     {
-        spdlog::info("Event caught: {}. Device PnP id: {}",
+        spdlog::info("Event caught: {}. Device PnP id: {}, state version {}",
             magic_enum::enum_name(event),
-            devicePnpId);
+            devicePnpId,
+            stateVersion);
 
         spdlog::info("Print collection...");
         PrintCollection();
@@ -100,6 +112,366 @@ private:
 
 namespace
 {
+    struct CommandLineOptions
+    {
+        bool Daemon = false;
+        bool FormatNdjson = false;
+        bool Server = false;
+        std::basic_string<_TCHAR> PipeName = _T(R"(\\.\pipe\SoundAgentCli)");
+        bool PipeNameSet = false;
+        ed::audio::EventStreamPublisher::LagPolicy LagPolicy = ed::audio::EventStreamPublisher::LagPolicy::CoalesceToSnapshot;
+        bool LagPolicySet = false;
+        std::optional<uint16_t> HttpPort;
+        std::basic_string<_TCHAR> SpoolDirectory;
+    };
+
+    bool ParseCommandLine(int argc, _TCHAR * argv[], CommandLineOptions & options)
+    {
+        constexpr std::basic_string_view<_TCHAR> pipeOption = _T("--pipe=");
+        constexpr std::basic_string_view<_TCHAR> httpPortOption = _T("--http-port=");
+        constexpr std::basic_string_view<_TCHAR> spoolOption = _T("--spool=");
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::basic_string_view<_TCHAR> argument(argv[i]);
+            if (argument == _T("--daemon"))
+            {
+                options.Daemon = true;
+            }
+            else if (argument == _T("--format=ndjson"))
+            {
+                options.FormatNdjson = true;
+            }
+            else if (argument == _T("--server"))
+            {
+                options.Server = true;
+            }
+            else if (argument.starts_with(pipeOption) && argument.size() > pipeOption.size())
+            {
+                options.PipeName = argument.substr(pipeOption.size());
+                options.PipeNameSet = true;
+            }
+            else if (argument == _T("--lag-policy=snapshot"))
+            {
+                options.LagPolicy = ed::audio::EventStreamPublisher::LagPolicy::CoalesceToSnapshot;
+                options.LagPolicySet = true;
+            }
+            else if (argument == _T("--lag-policy=disconnect"))
+            {
+                options.LagPolicy = ed::audio::EventStreamPublisher::LagPolicy::Disconnect;
+                options.LagPolicySet = true;
+            }
+            else if (argument.starts_with(httpPortOption))
+            {
+                _TCHAR * end = nullptr;
+                const auto port = _tcstoul(argv[i] + httpPortOption.size(), &end, 10);
+                if (end == argv[i] + httpPortOption.size() || *end != 0 || port == 0 || port > 65535)
+                {
+                    return false;
+                }
+                options.HttpPort = static_cast<uint16_t>(port);
+            }
+            else if (argument.starts_with(spoolOption) && argument.size() > spoolOption.size())
+            {
+                options.SpoolDirectory = argument.substr(spoolOption.size());
+            }
+            else
+            {
+                return false;
+            }
+        }
+        if (options.Daemon && options.Server)
+        {
+            return false;
+        }
+        // ndjson is the only (and the default) daemon format; it makes no sense interactively.
+        // The pipe options only apply to the server.
+        return (options.Daemon || !options.FormatNdjson) && (options.Server || !options.PipeNameSet && !options.LagPolicySet);
+    }
+
+    HANDLE stop_requested_event = nullptr;
+    HANDLE daemon_stopped_event = nullptr;
+
+    BOOL WINAPI OnConsoleControl(DWORD controlType)
+    {
+        switch (controlType)
+        {
+        case CTRL_C_EVENT:
+        case CTRL_BREAK_EVENT:
+            SetEvent(stop_requested_event);
+            return TRUE;
+        case CTRL_CLOSE_EVENT:
+        case CTRL_LOGOFF_EVENT:
+        case CTRL_SHUTDOWN_EVENT:
+            // The process is terminated as soon as the handler returns; give the daemon time to flush.
+            SetEvent(stop_requested_event);
+            WaitForSingleObject(daemon_stopped_event, 5000);
+            return TRUE;
+        default:
+            return FALSE;
+        }
+    }
+
+    bool WriteToStdout(std::string_view batch)
+    {
+        return fwrite(batch.data(), 1, batch.size(), stdout) == batch.size() && fflush(stdout) == 0;
+    }
+
+    // Writes an initial snapshot, then one NDJSON line per change, until a console control signal arrives
+    // or the stdout reader goes away.
+    int RunDaemon(SoundDeviceCollectionInterface & collection)
+    {
+        constexpr size_t flushThresholdBytes = 64 * 1024;
+        constexpr auto flushInterval = std::chrono::milliseconds(100);
+
+        stop_requested_event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        daemon_stopped_event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        SetConsoleCtrlHandler(OnConsoleControl, TRUE);
+        // no CR-LF translation: lines end with '\n' only
+        _setmode(_fileno(stdout), _O_BINARY);
+
+        {
+            ed::audio::BufferedLineWriter output(WriteToStdout, flushThresholdBytes, flushInterval);
+            ed::audio::NdjsonEventWriter eventWriter(collection, output);
+
+            collection.Subscribe(eventWriter);
+            eventWriter.WriteSnapshot();
+            spdlog::info("Daemon started, streaming NDJSON to stdout.");
+
+            while (WaitForSingleObject(stop_requested_event, 250) == WAIT_TIMEOUT)
+            {
+                if (output.IsSinkBroken())
+                {
+                    spdlog::warn("Output stream closed by reader.");
+                    break;
+                }
+            }
+
+            collection.Unsubscribe(eventWriter, true);
+            output.Flush();
+            const auto statistics = output.GetStatistics();
+            spdlog::info("Daemon stopped: {} lines, {} bytes, {} flushes written, {} lines dropped.",
+                statistics.Lines, statistics.Bytes, statistics.Flushes, statistics.LinesDropped);
+        }
+
+        SetEvent(daemon_stopped_event);
+        return 0;
+    }
+
+    // One connected pipe instance. Writes are overlapped, so that Abort can interrupt a write
+    // that is blocked by a client which does not read.
+    class PipeConnection final {
+    public:
+        explicit PipeConnection(HANDLE pipe)
+            : pipe_(pipe)
+            , writeDone_(CreateEvent(nullptr, TRUE, FALSE, nullptr))
+            , aborted_(CreateEvent(nullptr, TRUE, FALSE, nullptr))
+        {
+        }
+
+        DISALLOW_COPY_MOVE(PipeConnection);
+
+        ~PipeConnection()
+        {
+            DisconnectNamedPipe(pipe_);
+            CloseHandle(pipe_);
+            CloseHandle(writeDone_);
+            CloseHandle(aborted_);
+        }
+
+        bool Send(std::string_view batch) const
+        {
+            OVERLAPPED overlapped{};
+            overlapped.hEvent = writeDone_;
+            if (!WriteFile(pipe_, batch.data(), static_cast<DWORD>(batch.size()), nullptr, &overlapped)
+                && GetLastError() != ERROR_IO_PENDING)
+            {
+                return false;
+            }
+
+            const HANDLE waitHandles[] = { writeDone_, aborted_ };
+            if (WaitForMultipleObjects(static_cast<DWORD>(std::size(waitHandles)), waitHandles, FALSE, INFINITE) != WAIT_OBJECT_0)
+            {
+                CancelIoEx(pipe_, &overlapped);
+            }
+            DWORD written = 0;
+            return GetOverlappedResult(pipe_, &overlapped, &written, TRUE) && written == batch.size();
+        }
+
+        void Abort() const
+        {
+            SetEvent(aborted_);
+        }
+
+    private:
+        const HANDLE pipe_;
+        const HANDLE writeDone_;
+        const HANDLE aborted_;
+    };
+
+    // Waits for the next client on a new pipe instance. Returns nullptr if the stop was requested or on failure.
+    std::shared_ptr<PipeConnection> AcceptPipeClient(const std::basic_string<_TCHAR> & pipeName, bool firstInstance, HANDLE connectedEvent)
+    {
+        constexpr DWORD outBufferSize = 64 * 1024;
+        const HANDLE pipe = CreateNamedPipe(pipeName.c_str(),
+            PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED | (firstInstance ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+            PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES, outBufferSize, 0, 0, nullptr);
+        if (pipe == INVALID_HANDLE_VALUE)
+        {
+            spdlog::error("Can not create the named pipe, error {}.", GetLastError());
+            return nullptr;
+        }
+
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = connectedEvent;
+        ResetEvent(connectedEvent);
+        bool connected = ConnectNamedPipe(pipe, &overlapped) != FALSE;
+        if (const auto error = GetLastError(); !connected && error == ERROR_PIPE_CONNECTED)
+        {
+            connected = true;
+        }
+        else if (!connected && error == ERROR_IO_PENDING)
+        {
+            const HANDLE waitHandles[] = { connectedEvent, stop_requested_event };
+            if (WaitForMultipleObjects(static_cast<DWORD>(std::size(waitHandles)), waitHandles, FALSE, INFINITE) != WAIT_OBJECT_0)
+            {
+                CancelIoEx(pipe, &overlapped);
+            }
+            DWORD unused = 0;
+            connected = GetOverlappedResult(pipe, &overlapped, &unused, TRUE) != FALSE;
+        }
+
+        if (!connected)
+        {
+            CloseHandle(pipe);
+            return nullptr;
+        }
+        return std::make_shared<PipeConnection>(pipe);
+    }
+
+    // Accepts local clients on the named pipe and streams BinaryEventCodec frames to each of them
+    // (a snapshot, then one frame per change) until a console control signal arrives.
+    int RunServer(SoundDeviceCollectionInterface & collection, const CommandLineOptions & options)
+    {
+        constexpr size_t clientQueueLimitBytes = 1024 * 1024;
+
+        stop_requested_event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        daemon_stopped_event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        SetConsoleCtrlHandler(OnConsoleControl, TRUE);
+        const HANDLE connectedEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+
+        int result = 0;
+        {
+            ed::audio::EventStreamPublisher publisher(collection, clientQueueLimitBytes, options.LagPolicy);
+            collection.Subscribe(publisher);
+            spdlog::info("Server started, lag policy {}.", magic_enum::enum_name(options.LagPolicy));
+
+            for (bool firstInstance = true; WaitForSingleObject(stop_requested_event, 0) == WAIT_TIMEOUT; firstInstance = false)
+            {
+                const auto connection = AcceptPipeClient(options.PipeName, firstInstance, connectedEvent);
+                if (connection == nullptr)
+                {
+                    if (firstInstance)
+                    {
+                        // e.g. another server owns the pipe name
+                        result = 3;
+                        break;
+                    }
+                    continue;
+                }
+                publisher.AddClient(
+                    [connection](std::string_view batch) { return connection->Send(batch); },
+                    [connection] { connection->Abort(); });
+            }
+
+            collection.Unsubscribe(publisher, true);
+            const auto statistics = publisher.GetStatistics();
+            spdlog::info("Server stopped: {} clients accepted, {} frames published, {} bytes sent, "
+                "{} lagging clients resynchronized, {} disconnected.",
+                statistics.ClientsAccepted, statistics.FramesPublished, statistics.BytesSent,
+                statistics.SnapshotsForLaggingClients, statistics.ClientsDisconnectedAsLagging);
+        }
+
+        CloseHandle(connectedEvent);
+        SetEvent(daemon_stopped_event);
+        return result;
+    }
+
+    // The localhost HTTP state endpoint; it serves next to whichever mode runs.
+    class HttpEndpoint final {
+    public:
+        // Throws std::runtime_error if the port can not be listened on.
+        HttpEndpoint(SoundDeviceCollectionInterface & collection, uint16_t port)
+            : collection_(collection)
+            , service_(collection)
+            , server_(service_, port, std::chrono::seconds(30))
+        {
+            collection_.Subscribe(service_);
+        }
+
+        DISALLOW_COPY_MOVE(HttpEndpoint);
+
+        ~HttpEndpoint()
+        {
+            collection_.Unsubscribe(service_, true);
+        }
+
+    private:
+        SoundDeviceCollectionInterface & collection_;
+        ed::audio::HttpStateService service_;
+        ed::audio::LocalHttpServer server_;
+    };
+
+    // Appends every event to an EventSpool in the directory, for an uploader to forward later; like the HTTP
+    // endpoint it records next to whichever mode runs.
+    class SpoolRecorder final : public SoundDeviceObserverInterface {
+    public:
+        // Throws std::runtime_error if the spool directory can not be used.
+        SpoolRecorder(SoundDeviceCollectionInterface & collection, const std::filesystem::path & directory)
+            : collection_(collection)
+            , spool_(directory, ed::audio::EventSpool::Options{})
+        {
+            collection_.Subscribe(*this);
+        }
+
+        DISALLOW_COPY_MOVE(SpoolRecorder);
+
+        ~SpoolRecorder() override
+        {
+            collection_.Unsubscribe(*this, true);
+            spool_.Flush();
+            const auto statistics = spool_.GetStatistics();
+            spdlog::info("Spool closed: {} records appended, {} segments sealed, {} records dropped.",
+                statistics.RecordsAppended, statistics.SegmentsSealed, statistics.RecordsDropped);
+        }
+
+        void OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t) override
+        {
+            uint16_t volume = 0;
+            if (event == SoundDeviceEventType::VolumeRenderChanged || event == SoundDeviceEventType::VolumeCaptureChanged)
+            {
+                if (const auto device = collection_.CreateItem(devicePnpId); device != nullptr)
+                {
+                    volume = event == SoundDeviceEventType::VolumeRenderChanged
+                        ? device->GetCurrentRenderVolume()
+                        : device->GetCurrentCaptureVolume();
+                }
+            }
+            try
+            {
+                spool_.Append(event, devicePnpId, volume, std::chrono::system_clock::now());
+            }
+            catch (const std::exception & ex)
+            {
+                spdlog::error("Event not spooled: {}", ex.what());
+            }
+        }
+
+    private:
+        SoundDeviceCollectionInterface & collection_;
+        ed::audio::EventSpool spool_;
+    };
+
     bool StopAndWaitForInput()
     {
         for (;;)
@@ -128,11 +500,77 @@ int _tmain(int argc, _TCHAR * argv[])
     _CrtSetReportFile(_CRT_WARN, _CRTDBG_FILE_STDOUT);
     _CrtSetReportFile(_CRT_ERROR, _CRTDBG_FILE_STDERR);
 
+    CommandLineOptions options;
+    if (!ParseCommandLine(argc, argv, options))
+    {
+        std::cerr << "Usage: SoundAgentCli [--daemon [--format=ndjson] | --server [--pipe=<name>] [--lag-policy=snapshot|disconnect]]"
+            " [--http-port=<port>] [--spool=<directory>]\n";
+        return 2;
+    }
+
     ed::CoInitRaiiHelper coInitHelper;
 
     const auto coll(SoundAgent::CreateDeviceCollection());
 
+    std::unique_ptr<HttpEndpoint> httpEndpoint;
+    std::unique_ptr<SpoolRecorder> spoolRecorder;
+    // The HTTP endpoint and the spool recorder; call after the log is set up.
+    const auto startOptionalServices = [&httpEndpoint, &spoolRecorder, &coll, &options]
+    {
+        if (!options.SpoolDirectory.empty())
+        {
+            try
+            {
+                spoolRecorder = std::make_unique<SpoolRecorder>(*coll, std::filesystem::path(options.SpoolDirectory));
+            }
+            catch (const std::exception & ex)
+            {
+                spdlog::error("Event spool not opened: {}", ex.what());
+                return false;
+            }
+        }
+        if (!options.HttpPort.has_value())
+        {
+            return true;
+        }
+        try
+        {
+            httpEndpoint = std::make_unique<HttpEndpoint>(*coll, *options.HttpPort);
+            return true;
+        }
+        catch (const std::exception & ex)
+        {
+            spdlog::error("HTTP endpoint not started: {}", ex.what());
+            return false;
+        }
+    };
+
+    if (options.Daemon)
+    {
+        ServiceObserver::SetUpLog(false);
+        coll->ResetContent();
+        if (!startOptionalServices())
+        {
+            return 3;
+        }
+        return RunDaemon(*coll);
+    }
+    if (options.Server)
+    {
+        ServiceObserver::SetUpLog(true);
+        coll->ResetContent();
+        if (!startOptionalServices())
+        {
+            return 3;
+        }
+        return RunServer(*coll, options);
+    }
+
     ServiceObserver o(*coll);
+    if (!startOptionalServices())
+    {
+        return 3;
+    }
     coll->Subscribe(o);
 
     bool continueLoop = true;
@@ -147,7 +585,7 @@ int _tmain(int argc, _TCHAR * argv[])
     spdlog::info("Print collection final state...");
     o.PrintCollection();
 
-    coll->Unsubscribe(o);
+    coll->Unsubscribe(o, true);
 
     return 0;
 }
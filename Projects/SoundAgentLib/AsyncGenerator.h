@@ -0,0 +1,107 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+
+namespace ed::audio {
+// A coroutine producing values over time: it may co_await between its co_yield's. Consume it from a coroutine:
+//     while (co_await generator.Next()) { Use(generator.Current()); }
+// The consumer continues on the thread the generator yields from. Do not destroy a generator while it awaits.
+template <typename T>
+class AsyncGenerator final {
+public:
+    struct promise_type {
+        std::optional<T> Value;
+        std::coroutine_handle<> Consumer;
+        std::exception_ptr Exception;
+
+        AsyncGenerator get_return_object()
+        {
+            return AsyncGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept { return ResumeConsumer{}; }
+
+        auto yield_value(T value)
+        {
+            Value = std::move(value);
+            return ResumeConsumer{};
+        }
+
+        void return_void() {}
+        void unhandled_exception() { Exception = std::current_exception(); }
+    };
+
+private:
+    // Suspends the generator and continues its consumer.
+    struct ResumeConsumer {
+        bool await_ready() noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> generator) noexcept
+        {
+            return generator.promise().Consumer;
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    struct NextAwaiter {
+        std::coroutine_handle<promise_type> Generator;
+
+        bool await_ready() noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept
+        {
+            Generator.promise().Consumer = consumer;
+            Generator.promise().Value.reset();
+            return Generator;
+        }
+
+        bool await_resume()
+        {
+            if (Generator.promise().Exception)
+            {
+                std::rethrow_exception(Generator.promise().Exception);
+            }
+            return !Generator.done();
+        }
+    };
+
+public:
+    AsyncGenerator(AsyncGenerator && other) noexcept
+        : handle_(std::exchange(other.handle_, {}))
+    {
+    }
+
+    AsyncGenerator(const AsyncGenerator &) = delete;
+    AsyncGenerator & operator=(const AsyncGenerator &) = delete;
+    AsyncGenerator & operator=(AsyncGenerator &&) = delete;
+
+    ~AsyncGenerator()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+public:
+    // Runs the generator up to its next value; false once it has finished.
+    [[nodiscard]] NextAwaiter Next() { return NextAwaiter{ handle_ }; }
+    // The value of the last Next that returned true.
+    [[nodiscard]] T & Current() { return *handle_.promise().Value; }
+
+private:
+    explicit AsyncGenerator(std::coroutine_handle<promise_type> handle)
+        : handle_(handle)
+    {
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+}
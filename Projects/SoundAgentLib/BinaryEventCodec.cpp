@@ -0,0 +1,188 @@
+#include "os-dependencies.h"
+
+#include "BinaryEventCodec.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace
+{
+    template <typename T>
+    void AppendInteger(std::string & out, T value)
+    {
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            out.push_back(static_cast<char>(static_cast<uint64_t>(value) >> (8 * i) & 0xFF));
+        }
+    }
+
+    void AppendString(std::string & out, std::string_view value)
+    {
+        // longer strings are truncated; PnP ids and names are far below this
+        const auto length = std::min<size_t>(value.size(), UINT16_MAX);
+        AppendInteger(out, static_cast<uint16_t>(length));
+        out.append(value.substr(0, length));
+    }
+
+    size_t BeginFrame(std::string & out)
+    {
+        const auto start = out.size();
+        AppendInteger(out, uint32_t{ 0 });
+        return start;
+    }
+
+    void EndFrame(std::string & out, size_t start)
+    {
+        const auto payloadLength = static_cast<uint32_t>(out.size() - start - ed::audio::BinaryEventCodec::frame_header_size);
+        for (size_t i = 0; i < sizeof(payloadLength); ++i)
+        {
+            out[start + i] = static_cast<char>(payloadLength >> (8 * i) & 0xFF);
+        }
+    }
+
+    class Reader {
+    public:
+        explicit Reader(std::string_view data)
+            : data_(data)
+        {
+        }
+
+        template <typename T>
+        T ReadInteger()
+        {
+            const auto bytes = Take(sizeof(T));
+            uint64_t value = 0;
+            for (size_t i = 0; i < sizeof(T); ++i)
+            {
+                value |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+            }
+            return static_cast<T>(value);
+        }
+
+        std::string ReadString()
+        {
+            const auto length = ReadInteger<uint16_t>();
+            return std::string(Take(length));
+        }
+
+        [[nodiscard]] bool AtEnd() const { return data_.empty(); }
+
+    private:
+        std::string_view Take(size_t size)
+        {
+            if (data_.size() < size)
+            {
+                throw std::runtime_error("Binary event frame truncated");
+            }
+            const auto taken = data_.substr(0, size);
+            data_.remove_prefix(size);
+            return taken;
+        }
+
+    private:
+        std::string_view data_;
+    };
+
+    ed::audio::BinaryEventCodec::Device ReadDevice(Reader & reader)
+    {
+        ed::audio::BinaryEventCodec::Device device;
+        device.PnpId = reader.ReadString();
+        device.Name = reader.ReadString();
+        device.Flow = static_cast<SoundDeviceFlowType>(reader.ReadInteger<uint8_t>());
+        device.RenderVolume = reader.ReadInteger<uint16_t>();
+        device.CaptureVolume = reader.ReadInteger<uint16_t>();
+        return device;
+    }
+}
+
+void ed::audio::BinaryEventCodec::AppendSnapshotFrame(std::string & out, const SoundDeviceCollectionSnapshot & snapshot)
+{
+    const auto start = BeginFrame(out);
+    AppendInteger(out, static_cast<uint8_t>(FrameType::Snapshot));
+    AppendInteger(out, snapshot.StateVersion);
+    AppendString(out, snapshot.DefaultRenderDevicePnpId.value_or(""));
+    AppendString(out, snapshot.DefaultCaptureDevicePnpId.value_or(""));
+    const auto deviceCount = std::min<size_t>(snapshot.Devices.size(), UINT16_MAX);
+    AppendInteger(out, static_cast<uint16_t>(deviceCount));
+    for (size_t i = 0; i < deviceCount; ++i)
+    {
+        AppendDevice(out, *snapshot.Devices[i]);
+    }
+    EndFrame(out, start);
+}
+
+void ed::audio::BinaryEventCodec::AppendEventFrame(std::string & out, SoundDeviceEventType event, const std::string & devicePnpId,
+    uint64_t stateVersion, const SoundDeviceInterface * device)
+{
+    const auto start = BeginFrame(out);
+    AppendInteger(out, static_cast<uint8_t>(FrameType::Event));
+    AppendInteger(out, stateVersion);
+    AppendInteger(out, static_cast<uint8_t>(event));
+    AppendString(out, devicePnpId);
+    AppendInteger(out, static_cast<uint8_t>(device != nullptr ? 1 : 0));
+    if (device != nullptr)
+    {
+        AppendDevice(out, *device);
+    }
+    EndFrame(out, start);
+}
+
+size_t ed::audio::BinaryEventCodec::DecodeFrame(std::string_view data, Frame & frame)
+{
+    if (data.size() < frame_header_size)
+    {
+        return 0;
+    }
+    const auto payloadLength = Reader(data).ReadInteger<uint32_t>();
+    if (data.size() - frame_header_size < payloadLength)
+    {
+        return 0;
+    }
+
+    Reader reader(data.substr(frame_header_size, payloadLength));
+    frame = Frame{};
+    frame.Type = static_cast<FrameType>(reader.ReadInteger<uint8_t>());
+    frame.StateVersion = reader.ReadInteger<uint64_t>();
+    switch (frame.Type)
+    {
+    case FrameType::Snapshot:
+    {
+        frame.Event = SoundDeviceEventType::ContentReset;
+        frame.DefaultRenderDevicePnpId = reader.ReadString();
+        frame.DefaultCaptureDevicePnpId = reader.ReadString();
+        const auto deviceCount = reader.ReadInteger<uint16_t>();
+        frame.Devices.reserve(deviceCount);
+        for (uint16_t i = 0; i < deviceCount; ++i)
+        {
+            frame.Devices.push_back(ReadDevice(reader));
+        }
+        break;
+    }
+    case FrameType::Event:
+        frame.Event = static_cast<SoundDeviceEventType>(reader.ReadInteger<uint8_t>());
+        frame.DevicePnpId = reader.ReadString();
+        if (reader.ReadInteger<uint8_t>() != 0)
+        {
+            frame.Devices.push_back(ReadDevice(reader));
+        }
+        break;
+    default:
+        throw std::runtime_error("Unknown binary event frame type");
+    }
+    if (!reader.AtEnd())
+    {
+        throw std::runtime_error("Binary event frame has trailing bytes");
+    }
+
+    return frame_header_size + payloadLength;
+}
+
+void ed::audio::BinaryEventCodec::AppendDevice(std::string & out, const SoundDeviceInterface & device)
+{
+    AppendString(out, device.GetPnpId());
+    AppendString(out, device.GetName());
+    AppendInteger(out, static_cast<uint8_t>(device.GetFlow()));
+    AppendInteger(out, device.GetCurrentRenderVolume());
+    AppendInteger(out, device.GetCurrentCaptureVolume());
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "public/SoundAgentInterface.h"
+
+
+namespace ed::audio {
+// Compact length-prefixed framing of the collection for local stream clients. Integers are little-endian.
+//   frame    = u32 payloadLength | payload
+//   snapshot = u8 1 | u64 version | str defaultRender | str defaultCapture | u16 deviceCount | device...
+//   event    = u8 2 | u64 version | u8 SoundDeviceEventType | str pnpId | u8 hasDevice | [device]
+//   device   = str pnpId | str name | u8 SoundDeviceFlowType | u16 renderVolume | u16 captureVolume
+//   str      = u16 length | UTF-8 bytes; no default is an empty string
+class BinaryEventCodec final {
+public:
+    enum class FrameType : uint8_t { Snapshot = 1, Event = 2 };
+
+    struct Device {
+        std::string PnpId;
+        std::string Name;
+        SoundDeviceFlowType Flow = SoundDeviceFlowType::None;
+        uint16_t RenderVolume = 0;
+        uint16_t CaptureVolume = 0;
+    };
+
+    // Either kind of frame; members of the other kind stay empty.
+    struct Frame {
+        FrameType Type = FrameType::Event;
+        uint64_t StateVersion = 0;
+        SoundDeviceEventType Event = SoundDeviceEventType::Confirmed;
+        std::string DevicePnpId;
+        std::string DefaultRenderDevicePnpId;
+        std::string DefaultCaptureDevicePnpId;
+        // the snapshot's devices, or the event's device if it has one
+        std::vector<Device> Devices;
+    };
+
+    static constexpr size_t frame_header_size = sizeof(uint32_t);
+
+public:
+    static void AppendSnapshotFrame(std::string & out, const SoundDeviceCollectionSnapshot & snapshot);
+    // device: the state after the change, or null to send the event without one.
+    static void AppendEventFrame(std::string & out, SoundDeviceEventType event, const std::string & devicePnpId,
+        uint64_t stateVersion, const SoundDeviceInterface * device);
+
+    // Decodes the frame at the start of data. Returns its size, or 0 if data does not hold a complete frame yet.
+    // Throws std::runtime_error on a malformed frame.
+    static size_t DecodeFrame(std::string_view data, Frame & frame);
+
+private:
+    static void AppendDevice(std::string & out, const SoundDeviceInterface & device);
+};
+}
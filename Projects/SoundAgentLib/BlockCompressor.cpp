@@ -0,0 +1,233 @@
+#include "os-dependencies.h"
+
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace
+{
+    // Each block: u32 raw size | u32 stored size | data. A block that does not shrink is stored as is,
+    // with the stored size equal to the raw size.
+    constexpr size_t block_header_size = 2 * sizeof(uint32_t);
+    constexpr size_t min_match = 4;
+    constexpr size_t max_offset = 65535;
+    constexpr int hash_bits = 12;
+
+    uint32_t Read32(const char * data)
+    {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    void AppendU32(std::string & out, uint32_t value)
+    {
+        for (size_t i = 0; i < sizeof(value); ++i)
+        {
+            out.push_back(static_cast<char>(value >> (8 * i) & 0xFF));
+        }
+    }
+
+    uint32_t ReadU32(std::string_view data, size_t offset)
+    {
+        uint32_t value = 0;
+        for (size_t i = 0; i < sizeof(value); ++i)
+        {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(data[offset + i])) << (8 * i);
+        }
+        return value;
+    }
+
+    // 15 in the token nibble, then the rest in bytes of 255 and a final smaller one.
+    void AppendLength(std::string & out, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            out.push_back(static_cast<char>(255));
+        }
+        out.push_back(static_cast<char>(length));
+    }
+
+    void AppendSequence(std::string & out, std::string_view literals, size_t offset, size_t matchLength)
+    {
+        const auto literalNibble = std::min<size_t>(literals.size(), 15);
+        const auto matchNibble = matchLength == 0 ? 0 : std::min<size_t>(matchLength - min_match, 15);
+        out.push_back(static_cast<char>(literalNibble << 4 | matchNibble));
+        if (literalNibble == 15)
+        {
+            AppendLength(out, literals.size() - 15);
+        }
+        out.append(literals);
+        if (matchLength == 0)
+        {
+            return;
+        }
+        out.push_back(static_cast<char>(offset & 0xFF));
+        out.push_back(static_cast<char>(offset >> 8));
+        if (matchNibble == 15)
+        {
+            AppendLength(out, matchLength - min_match - 15);
+        }
+    }
+
+    void CompressBlock(std::string_view block, std::string & out)
+    {
+        // positions + 1 of the last occurrence of each 4-byte hash; 0 is none
+        std::array<uint32_t, 1 << hash_bits> table{};
+        const char * data = block.data();
+        size_t anchor = 0;
+        for (size_t i = 0; i + min_match <= block.size();)
+        {
+            const auto value = Read32(data + i);
+            const auto hash = value * 2654435761u >> (32 - hash_bits);
+            const auto candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(i + 1);
+            if (candidate == 0 || i - (candidate - 1) > max_offset || Read32(data + candidate - 1) != value)
+            {
+                ++i;
+                continue;
+            }
+
+            const size_t match = candidate - 1;
+            size_t length = min_match;
+            while (i + length < block.size() && data[match + length] == data[i + length])
+            {
+                ++length;
+            }
+            AppendSequence(out, block.substr(anchor, i - anchor), i - match, length);
+            i += length;
+            anchor = i;
+        }
+        AppendSequence(out, block.substr(anchor), 0, 0);
+    }
+
+    class BlockReader {
+    public:
+        explicit BlockReader(std::string_view data)
+            : data_(data)
+        {
+        }
+
+        [[nodiscard]] bool AtEnd() const { return position_ == data_.size(); }
+
+        uint8_t ReadByte()
+        {
+            Require(1);
+            return static_cast<uint8_t>(data_[position_++]);
+        }
+
+        size_t ReadLength(size_t nibble)
+        {
+            if (nibble < 15)
+            {
+                return nibble;
+            }
+            size_t length = nibble;
+            for (uint8_t byte = 255; byte == 255;)
+            {
+                byte = ReadByte();
+                length += byte;
+            }
+            return length;
+        }
+
+        std::string_view Take(size_t size)
+        {
+            Require(size);
+            const auto taken = data_.substr(position_, size);
+            position_ += size;
+            return taken;
+        }
+
+    private:
+        void Require(size_t size) const
+        {
+            if (data_.size() - position_ < size)
+            {
+                throw std::runtime_error("Compressed block truncated");
+            }
+        }
+
+        std::string_view data_;
+        size_t position_ = 0;
+    };
+
+    void DecompressBlock(std::string_view block, size_t rawSize, std::string & out)
+    {
+        const auto start = out.size();
+        out.reserve(start + rawSize);
+        BlockReader reader(block);
+        while (!reader.AtEnd())
+        {
+            const auto token = reader.ReadByte();
+            out.append(reader.Take(reader.ReadLength(token >> 4)));
+            if (reader.AtEnd())
+            {
+                break;
+            }
+
+            const size_t offset = reader.ReadByte() | static_cast<size_t>(reader.ReadByte()) << 8;
+            const auto length = reader.ReadLength(token & 0x0F) + min_match;
+            if (offset == 0 || offset > out.size() - start || out.size() - start + length > rawSize)
+            {
+                throw std::runtime_error("Compressed block corrupt");
+            }
+            // byte by byte: the match may overlap the bytes it produces
+            for (size_t i = 0, from = out.size() - offset; i < length; ++i)
+            {
+                out.push_back(out[from + i]);
+            }
+        }
+        if (out.size() - start != rawSize)
+        {
+            throw std::runtime_error("Compressed block has the wrong size");
+        }
+    }
+}
+
+void ed::audio::BlockCompressor::Compress(std::string_view input, std::string & out)
+{
+    std::string compressed;
+    for (size_t offset = 0; offset < input.size(); offset += block_size)
+    {
+        const auto block = input.substr(offset, block_size);
+        compressed.clear();
+        CompressBlock(block, compressed);
+        const bool stored = compressed.size() >= block.size();
+        AppendU32(out, static_cast<uint32_t>(block.size()));
+        AppendU32(out, static_cast<uint32_t>(stored ? block.size() : compressed.size()));
+        out.append(stored ? block : std::string_view(compressed));
+    }
+}
+
+void ed::audio::BlockCompressor::Decompress(std::string_view compressed, std::string & out)
+{
+    for (size_t offset = 0; offset < compressed.size();)
+    {
+        if (compressed.size() - offset < block_header_size)
+        {
+            throw std::runtime_error("Compressed block header truncated");
+        }
+        const auto rawSize = ReadU32(compressed, offset);
+        const auto storedSize = ReadU32(compressed, offset + sizeof(uint32_t));
+        offset += block_header_size;
+        if (rawSize > block_size || storedSize > rawSize || compressed.size() - offset < storedSize)
+        {
+            throw std::runtime_error("Compressed block header corrupt");
+        }
+        const auto block = compressed.substr(offset, storedSize);
+        if (storedSize == rawSize)
+        {
+            out.append(block);
+        }
+        else
+        {
+            DecompressBlock(block, rawSize, out);
+        }
+        offset += storedSize;
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+
+namespace ed::audio {
+// Fast LZ77 compression of byte blocks, in the sequence format of LZ4 (literals, then a back reference
+// of at least 4 bytes within the last 64 KiB). Trades ratio for speed; enough for the repetitive
+// records of the event spool without another dependency.
+class BlockCompressor final {
+public:
+    // The input is cut into blocks of this size, compressed independently.
+    static constexpr size_t block_size = 64 * 1024;
+
+    // Appends the compressed input to out.
+    static void Compress(std::string_view input, std::string & out);
+    // Appends the decompressed data to out. Throws std::runtime_error on corrupt data.
+    static void Decompress(std::string_view compressed, std::string & out);
+};
+}
@@ -0,0 +1,109 @@
+#include "os-dependencies.h"
+
+#include "BufferedLineWriter.h"
+
+
+ed::audio::BufferedLineWriter::BufferedLineWriter(SinkFunctionT sink, size_t flushThresholdBytes, std::chrono::milliseconds flushInterval)
+    : sink_(std::move(sink))
+    , flushThresholdBytes_(flushThresholdBytes)
+    , flushInterval_(flushInterval)
+    , intervalFlusher_(&BufferedLineWriter::RunIntervalFlusher, this)
+{
+    buffer_.reserve(flushThresholdBytes_ + 256);
+    batch_.reserve(flushThresholdBytes_ + 256);
+}
+
+ed::audio::BufferedLineWriter::~BufferedLineWriter()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopRequested_ = true;
+    }
+    wakeUp_.notify_all();
+    intervalFlusher_.join();
+    Flush();
+}
+
+void ed::audio::BufferedLineWriter::WriteLine(std::string_view line)
+{
+    bool thresholdReached;
+    {
+        std::lock_guard lock(mutex_);
+        if (sinkBroken_)
+        {
+            ++statistics_.LinesDropped;
+            return;
+        }
+        const bool wasEmpty = buffer_.empty();
+        buffer_.append(line);
+        buffer_.push_back('\n');
+        ++statistics_.Lines;
+        thresholdReached = buffer_.size() >= flushThresholdBytes_;
+        if (wasEmpty && !thresholdReached)
+        {
+            // arms the interval flusher
+            wakeUp_.notify_one();
+        }
+    }
+    if (thresholdReached)
+    {
+        Flush();
+    }
+}
+
+void ed::audio::BufferedLineWriter::Flush()
+{
+    std::lock_guard sinkLock(sinkMutex_);
+    {
+        std::lock_guard lock(mutex_);
+        if (buffer_.empty() || sinkBroken_)
+        {
+            return;
+        }
+        batch_.swap(buffer_);
+    }
+
+    const bool written = sink_(batch_);
+
+    std::lock_guard lock(mutex_);
+    statistics_.Bytes += batch_.size();
+    ++statistics_.Flushes;
+    sinkBroken_ = !written;
+    batch_.clear();
+}
+
+bool ed::audio::BufferedLineWriter::IsSinkBroken() const
+{
+    std::lock_guard lock(mutex_);
+    return sinkBroken_;
+}
+
+ed::audio::BufferedLineWriter::Statistics ed::audio::BufferedLineWriter::GetStatistics() const
+{
+    std::lock_guard lock(mutex_);
+    return statistics_;
+}
+
+void ed::audio::BufferedLineWriter::RunIntervalFlusher()
+{
+    std::unique_lock lock(mutex_);
+    for (;;)
+    {
+        wakeUp_.wait(lock, [this]
+            {
+                return stopRequested_ || !buffer_.empty();
+            });
+        if (stopRequested_)
+        {
+            break;
+        }
+        // Give the batch time to fill up; an earlier threshold flush makes this one a no-op.
+        if (wakeUp_.wait_for(lock, flushInterval_, [this] { return stopRequested_; }))
+        {
+            break;
+        }
+        lock.unlock();
+        Flush();
+        lock.lock();
+    }
+}
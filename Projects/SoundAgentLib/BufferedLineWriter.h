@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+
+namespace ed::audio {
+// Collects text lines and hands them to a sink in batches: when the buffer reaches flushThresholdBytes,
+// or at the latest flushInterval after the first line written since the last flush.
+// A writer that fills the buffer flushes it itself, so a slow sink slows the writers down instead of
+// letting the buffer grow without bound.
+class BufferedLineWriter final {
+public:
+    // Returns false if the sink is broken (e.g. the pipe reader went away); further output is then dropped.
+    using SinkFunctionT = std::function<bool(std::string_view)>;
+
+    struct Statistics {
+        uint64_t Lines = 0;
+        uint64_t Bytes = 0;
+        uint64_t Flushes = 0;
+        uint64_t LinesDropped = 0;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(BufferedLineWriter);
+    BufferedLineWriter(SinkFunctionT sink, size_t flushThresholdBytes, std::chrono::milliseconds flushInterval);
+    // Flushes what is left.
+    ~BufferedLineWriter();
+
+public:
+    // Appends a line; the '\n' terminator is added here.
+    void WriteLine(std::string_view line);
+    void Flush();
+
+    [[nodiscard]] bool IsSinkBroken() const;
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    void RunIntervalFlusher();
+
+private:
+    SinkFunctionT sink_;
+    const size_t flushThresholdBytes_;
+    const std::chrono::milliseconds flushInterval_;
+
+    // guards buffer_, statistics_ and the flusher state
+    mutable std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    std::string buffer_;
+    Statistics statistics_;
+    bool sinkBroken_ = false;
+    bool stopRequested_ = false;
+
+    // serializes sink calls, keeps batches in order; taken before mutex_
+    std::mutex sinkMutex_;
+    std::string batch_;
+
+    std::thread intervalFlusher_;
+};
+}
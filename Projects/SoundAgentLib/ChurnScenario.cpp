@@ -0,0 +1,268 @@
+#include "os-dependencies.h"
+
+#include "ChurnScenario.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <utility>
+
+
+namespace
+{
+    size_t FlowIndex(EDataFlow flow)
+    {
+        return flow == eRender ? 0 : 1;
+    }
+}
+
+ed::audio::ChurnScenario::ChurnScenario(EndpointSimulator & simulator, const Options & options)
+    : simulator_(simulator)
+    , options_(options)
+    , random_(options.Seed)
+{
+    AddEndpoint(L"{0.0.0.00000000}.{builtin-speakers}", L"Speakers", eRender, {}, 500);
+    AddEndpoint(L"{0.0.1.00000000}.{builtin-microphone}", L"Microphone Array", eCapture, {}, 700);
+    for (size_t i = 0; i < options_.Headsets; ++i)
+    {
+        const auto number = std::to_wstring(i);
+        const auto container = L"bluetooth-headset-" + number;
+        AddEndpoint(L"{0.0.0.00000000}.{headset-" + number + L"-render}", L"Headset " + number, eRender, container, 350);
+        AddEndpoint(L"{0.0.1.00000000}.{headset-" + number + L"-capture}", L"Headset " + number + L" Hands-Free", eCapture, container, 800);
+        headsets_.emplace_back(endpoints_.size() - 2, endpoints_.size() - 1);
+    }
+    for (size_t i = 0; i < options_.DockPairs; ++i)
+    {
+        const auto number = std::to_wstring(i);
+        const auto container = L"dock-jack-" + number;
+        AddEndpoint(L"{0.0.0.00000000}.{dock-" + number + L"-render}", L"Dock Headphones " + number, eRender, container, 400);
+        AddEndpoint(L"{0.0.1.00000000}.{dock-" + number + L"-capture}", L"Dock Microphone " + number, eCapture, container, 600);
+        dockPairs_.emplace_back(endpoints_.size() - 2, endpoints_.size() - 1);
+    }
+
+    SetActive(0, true);
+    SetActive(1, true);
+    for (const auto & [render, capture] : dockPairs_)
+    {
+        SetActive(render, true);
+        SetActive(capture, true);
+    }
+    for (const size_t endpoint : { size_t{ 0 }, size_t{ 1 } })
+    {
+        simulator_.SetDefaultEndpoint(endpoints_[endpoint].Id);
+        defaults_[FlowIndex(endpoints_[endpoint].Flow)] = endpoint;
+    }
+
+    for (size_t i = 0; i < headsets_.size(); ++i)
+    {
+        ScheduleRecurring(EventKind::ToggleHeadset, i, options_.HeadsetInterval);
+    }
+    ScheduleRecurring(EventKind::ToggleDock, 0, options_.DockInterval);
+    ScheduleRecurring(EventKind::FlapDefault, 0, options_.DefaultFlapInterval);
+    ScheduleRecurring(EventKind::DragSlider, 0, options_.SliderDragInterval);
+}
+
+void ed::audio::ChurnScenario::Advance(std::chrono::milliseconds duration)
+{
+    const auto until = now_ + duration;
+    while (!events_.empty() && events_.top().At <= until)
+    {
+        const auto event = events_.top();
+        events_.pop();
+        now_ = event.At;
+        Apply(event);
+    }
+    now_ = until;
+}
+
+size_t ed::audio::ChurnScenario::GetActiveEndpointCount() const
+{
+    return static_cast<size_t>(std::ranges::count_if(endpoints_, [](const Endpoint & endpoint) { return endpoint.Active; }));
+}
+
+size_t ed::audio::ChurnScenario::GetActiveDeviceCount() const
+{
+    std::set<std::wstring> containers;
+    size_t ownDevices = 0;
+    for (const auto & endpoint : endpoints_)
+    {
+        if (!endpoint.Active)
+        {
+            continue;
+        }
+        if (endpoint.ContainerKey.empty())
+        {
+            ++ownDevices;
+        }
+        else
+        {
+            containers.insert(endpoint.ContainerKey);
+        }
+    }
+    return ownDevices + containers.size();
+}
+
+size_t ed::audio::ChurnScenario::GetDeviceCount() const
+{
+    return 2 + headsets_.size() + dockPairs_.size();
+}
+
+void ed::audio::ChurnScenario::AddEndpoint(std::wstring id, std::wstring name, EDataFlow flow, std::wstring containerKey, uint16_t volume)
+{
+    endpoints_.push_back({ std::move(id), std::move(name), flow, std::move(containerKey), volume, false });
+}
+
+void ed::audio::ChurnScenario::SetActive(size_t endpoint, bool active)
+{
+    auto & state = endpoints_[endpoint];
+    if (state.Active == active)
+    {
+        return;
+    }
+    state.Active = active;
+    if (active)
+    {
+        simulator_.AddEndpoint(state.Id, state.Name, state.Flow, state.Volume, state.ContainerKey);
+        ++statistics_.Connects;
+        return;
+    }
+    simulator_.RemoveEndpoint(state.Id);
+    ++statistics_.Disconnects;
+    // as on Windows, the flow has no default until one is set
+    if (auto & flowDefault = defaults_[FlowIndex(state.Flow)]; flowDefault == endpoint)
+    {
+        flowDefault = npos;
+    }
+}
+
+void ed::audio::ChurnScenario::Apply(Event event)
+{
+    switch (event.Kind)
+    {
+    case EventKind::ToggleHeadset:
+    {
+        const auto [render, capture] = headsets_[event.Target];
+        const bool connect = !endpoints_[render].Active;
+        // a headset's endpoints come and go one after the other, in either order
+        const bool renderFirst = std::bernoulli_distribution(0.5)(random_);
+        SetActive(renderFirst ? render : capture, connect);
+        SetActive(renderFirst ? capture : render, connect);
+        // a connected headset usually takes over the defaults
+        if (connect && std::bernoulli_distribution(0.7)(random_))
+        {
+            for (const auto endpoint : { render, capture })
+            {
+                simulator_.SetDefaultEndpoint(endpoints_[endpoint].Id);
+                defaults_[FlowIndex(endpoints_[endpoint].Flow)] = endpoint;
+                ++statistics_.DefaultChanges;
+            }
+        }
+        ScheduleRecurring(EventKind::ToggleHeadset, event.Target, options_.HeadsetInterval);
+        break;
+    }
+    case EventKind::ToggleDock:
+        docked_ = !docked_;
+        for (const auto & [render, capture] : dockPairs_)
+        {
+            SetActive(render, docked_);
+            SetActive(capture, docked_);
+        }
+        ++statistics_.DockBursts;
+        ScheduleRecurring(EventKind::ToggleDock, 0, options_.DockInterval);
+        break;
+    case EventKind::FlapDefault:
+    {
+        if (event.StepsLeft == 0)
+        {
+            ScheduleRecurring(EventKind::FlapDefault, 0, options_.DefaultFlapInterval);
+            if (options_.DefaultFlapSwitches == 0)
+            {
+                break;
+            }
+            event.Target = std::bernoulli_distribution(0.5)(random_) ? FlowIndex(eRender) : FlowIndex(eCapture);
+            event.StepsLeft = options_.DefaultFlapSwitches;
+        }
+        const auto flow = event.Target == FlowIndex(eRender) ? eRender : eCapture;
+        if (const auto endpoint = PickActive(flow, defaults_[event.Target]); endpoint != npos)
+        {
+            simulator_.SetDefaultEndpoint(endpoints_[endpoint].Id);
+            defaults_[event.Target] = endpoint;
+            ++statistics_.DefaultChanges;
+        }
+        if (event.StepsLeft > 1)
+        {
+            Schedule(now_ + options_.DefaultFlapStep, EventKind::FlapDefault, event.Target, event.StepsLeft - 1);
+        }
+        break;
+    }
+    case EventKind::DragSlider:
+    {
+        if (event.StepsLeft == 0)
+        {
+            ScheduleRecurring(EventKind::DragSlider, 0, options_.SliderDragInterval);
+            const auto flow = std::bernoulli_distribution(0.5)(random_) ? eRender : eCapture;
+            event.Target = PickActive(flow, npos);
+            event.StepsLeft = options_.SliderDragSteps;
+            event.Volume = static_cast<uint16_t>(std::uniform_int_distribution<int>(0, 1000)(random_));
+            if (event.Target == npos || event.StepsLeft == 0)
+            {
+                break;
+            }
+        }
+        // a drag ends with its endpoint
+        auto & endpoint = endpoints_[event.Target];
+        if (!endpoint.Active)
+        {
+            break;
+        }
+        const auto distance = static_cast<int>(event.Volume) - static_cast<int>(endpoint.Volume);
+        endpoint.Volume = static_cast<uint16_t>(endpoint.Volume + distance / static_cast<int>(event.StepsLeft));
+        simulator_.SetVolume(endpoint.Id, endpoint.Volume);
+        ++statistics_.VolumeSteps;
+        if (event.StepsLeft > 1)
+        {
+            Schedule(now_ + options_.SliderDragStep, EventKind::DragSlider, event.Target, event.StepsLeft - 1, event.Volume);
+        }
+        break;
+    }
+    }
+}
+
+void ed::audio::ChurnScenario::Schedule(std::chrono::milliseconds at, EventKind kind, size_t target, size_t stepsLeft, uint16_t volume)
+{
+    events_.push({ at, nextSequence_++, kind, target, stepsLeft, volume });
+}
+
+void ed::audio::ChurnScenario::ScheduleRecurring(EventKind kind, size_t target, std::chrono::minutes meanInterval)
+{
+    Schedule(now_ + RandomInterval(meanInterval), kind, target);
+}
+
+size_t ed::audio::ChurnScenario::PickActive(EDataFlow flow, size_t other)
+{
+    size_t candidates = 0;
+    for (size_t i = 0; i < endpoints_.size(); ++i)
+    {
+        candidates += endpoints_[i].Active && endpoints_[i].Flow == flow && i != other ? 1 : 0;
+    }
+    if (candidates == 0)
+    {
+        return npos;
+    }
+    auto pick = std::uniform_int_distribution<size_t>(0, candidates - 1)(random_);
+    for (size_t i = 0; i < endpoints_.size(); ++i)
+    {
+        if (endpoints_[i].Active && endpoints_[i].Flow == flow && i != other && pick-- == 0)
+        {
+            return i;
+        }
+    }
+    return npos;
+}
+
+// Exponential around the mean, as of independent arrivals, and at least a millisecond.
+std::chrono::milliseconds ed::audio::ChurnScenario::RandomInterval(std::chrono::milliseconds mean)
+{
+    const auto interval = std::exponential_distribution<double>(1.0 / static_cast<double>(mean.count()))(random_);
+    return std::chrono::milliseconds(std::max<int64_t>(1, std::llround(interval)));
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <mmdeviceapi.h>
+#include <queue>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "EndpointSimulator.h"
+
+
+namespace ed::audio {
+// Drives an EndpointSimulator through the churn of a busy desk, on a virtual clock: Bluetooth headsets, whose render
+// and capture endpoints share a container, connect and disconnect; a dock plugs its endpoints in and out in one
+// burst; the defaults flap between endpoints; volume sliders are dragged through many small steps.
+// Each kind of churn recurs after a random interval around its mean, from a seeded generator, so a run replays
+// exactly. Advance applies the changes due without waiting for them: a week of churn takes as long as its changes.
+class ChurnScenario final {
+public:
+    struct Options {
+        uint32_t Seed = 1;
+        size_t Headsets = 4;
+        // pairs of a render and a capture endpoint in one container, like the jack of a dock
+        size_t DockPairs = 3;
+        // the mean intervals; a headset's is between its own connections and disconnections
+        std::chrono::minutes HeadsetInterval{ 20 };
+        std::chrono::minutes DockInterval{ 180 };
+        std::chrono::minutes DefaultFlapInterval{ 30 };
+        std::chrono::minutes SliderDragInterval{ 3 };
+        // a flap switches the default of a flow back and forth this many times, one step apart
+        size_t DefaultFlapSwitches = 4;
+        std::chrono::milliseconds DefaultFlapStep{ 300 };
+        size_t SliderDragSteps = 25;
+        std::chrono::milliseconds SliderDragStep{ 40 };
+    };
+
+    struct Statistics {
+        uint64_t Connects = 0;
+        uint64_t Disconnects = 0;
+        uint64_t DockBursts = 0;
+        uint64_t DefaultChanges = 0;
+        uint64_t VolumeSteps = 0;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(ChurnScenario);
+    // Adds the built-in speakers and microphone, which stay, and the dock, plugged in, to the simulator.
+    // The simulator must outlive the scenario.
+    ChurnScenario(EndpointSimulator & simulator, const Options & options);
+    ~ChurnScenario() = default;
+
+public:
+    // Applies the changes due until GetNow() + duration, in time order.
+    void Advance(std::chrono::milliseconds duration);
+
+    [[nodiscard]] std::chrono::milliseconds GetNow() const { return now_; }
+    [[nodiscard]] const Statistics & GetStatistics() const { return statistics_; }
+
+    // The endpoints present now, and the devices they form: one per container.
+    [[nodiscard]] size_t GetActiveEndpointCount() const;
+    [[nodiscard]] size_t GetActiveDeviceCount() const;
+    // Of every endpoint the scenario may add: the bounds of a collection following it.
+    [[nodiscard]] size_t GetEndpointCount() const { return endpoints_.size(); }
+    [[nodiscard]] size_t GetDeviceCount() const;
+
+private:
+    enum class EventKind : uint8_t {
+        ToggleHeadset = 0,
+        ToggleDock,
+        FlapDefault,
+        DragSlider
+    };
+
+    struct Event {
+        std::chrono::milliseconds At;
+        // breaks the ties of At in the order of scheduling
+        uint64_t Sequence;
+        EventKind Kind;
+        // the headset of ToggleHeadset, the endpoint of DragSlider and the flow of FlapDefault
+        size_t Target;
+        // of a flap or a drag; 0 starts one
+        size_t StepsLeft;
+        // the end of a drag
+        uint16_t Volume;
+
+        auto operator<=>(const Event & other) const { return std::tie(At, Sequence) <=> std::tie(other.At, other.Sequence); }
+        bool operator==(const Event & other) const { return At == other.At && Sequence == other.Sequence; }
+    };
+
+    struct Endpoint {
+        std::wstring Id;
+        std::wstring Name;
+        EDataFlow Flow;
+        // empty for an endpoint that is a device of its own
+        std::wstring ContainerKey;
+        uint16_t Volume;
+        bool Active;
+    };
+
+private:
+    void AddEndpoint(std::wstring id, std::wstring name, EDataFlow flow, std::wstring containerKey, uint16_t volume);
+    void SetActive(size_t endpoint, bool active);
+    void Apply(Event event);
+    void Schedule(std::chrono::milliseconds at, EventKind kind, size_t target, size_t stepsLeft = 0, uint16_t volume = 0);
+    void ScheduleRecurring(EventKind kind, size_t target, std::chrono::minutes meanInterval);
+    // An active endpoint of the flow other than the given one, at random; npos if there is none.
+    [[nodiscard]] size_t PickActive(EDataFlow flow, size_t other);
+    std::chrono::milliseconds RandomInterval(std::chrono::milliseconds mean);
+
+private:
+    static constexpr size_t npos = SIZE_MAX;
+
+    EndpointSimulator & simulator_;
+    const Options options_;
+    std::mt19937 random_;
+    std::chrono::milliseconds now_{ 0 };
+    uint64_t nextSequence_ = 0;
+    std::priority_queue<Event, std::vector<Event>, std::greater<>> events_;
+
+    std::vector<Endpoint> endpoints_;
+    // into endpoints_: the render and capture endpoint of each headset, then of each pair of the dock
+    std::vector<std::pair<size_t, size_t>> headsets_;
+    std::vector<std::pair<size_t, size_t>> dockPairs_;
+    bool docked_ = true;
+    // the default endpoint of each flow, as set by the scenario; npos once removed
+    std::array<size_t, 2> defaults_{ npos, npos };
+    Statistics statistics_;
+};
+}
@@ -0,0 +1,151 @@
+#include "os-dependencies.h"
+
+#include "ComExecutor.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <mutex>
+
+
+namespace
+{
+    class MultithreadedApartment final : public ed::audio::ComExecutor::Apartment {
+    public:
+        DISALLOW_COPY_MOVE(MultithreadedApartment);
+        MultithreadedApartment() = default;
+        ~MultithreadedApartment() override = default;
+
+        bool Enter() override
+        {
+            return SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED | COINIT_DISABLE_OLE1DDE));
+        }
+
+        void Leave() override
+        {
+            CoUninitialize();
+        }
+    };
+}
+
+ed::audio::ComExecutor::ComExecutor()
+    : ComExecutor(std::make_unique<MultithreadedApartment>())
+{
+}
+
+ed::audio::ComExecutor::ComExecutor(std::unique_ptr<Apartment> apartment)
+    : apartment_(std::move(apartment))
+    , worker_(&ComExecutor::Run, this)
+{
+}
+
+ed::audio::ComExecutor::~ComExecutor()
+{
+    stopRequested_.store(true, std::memory_order_release);
+    wakeUps_.fetch_add(1, std::memory_order_release);
+    wakeUps_.notify_one();
+    worker_.join();
+}
+
+std::shared_ptr<ed::audio::ComExecutor> ed::audio::ComExecutor::AcquireShared()
+{
+    static std::mutex mutex;
+    static std::weak_ptr<ComExecutor> shared;
+
+    std::lock_guard lock(mutex);
+    auto executor = shared.lock();
+    if (executor == nullptr)
+    {
+        executor = std::make_shared<ComExecutor>();
+        shared = executor;
+    }
+    return executor;
+}
+
+// Requests are submitted after the constructor, so worker_ is set by the time a request asks.
+bool ed::audio::ComExecutor::IsExecutorThread() const
+{
+    return std::this_thread::get_id() == worker_.get_id();
+}
+
+ed::audio::ComExecutor::Statistics ed::audio::ComExecutor::GetStatistics() const
+{
+    Statistics statistics;
+    statistics.Requests = requests_.load(std::memory_order_relaxed);
+    statistics.Batches = batches_.load(std::memory_order_relaxed);
+    statistics.LargestBatch = largestBatch_.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+void ed::audio::ComExecutor::Push(Request * request)
+{
+    auto * newest = submitted_.load(std::memory_order_relaxed);
+    do
+    {
+        request->Next = newest;
+    }
+    while (!submitted_.compare_exchange_weak(newest, request, std::memory_order_release, std::memory_order_relaxed));
+
+    // Only a submission to an empty stack may find the thread asleep; the others join the batch it takes next.
+    if (newest == nullptr)
+    {
+        wakeUps_.fetch_add(1, std::memory_order_release);
+        wakeUps_.notify_one();
+    }
+}
+
+void ed::audio::ComExecutor::Run()
+{
+    const bool entered = apartment_->Enter();
+    if (!entered)
+    {
+        spdlog::warn("The COM executor thread could not enter the multithreaded apartment.");
+    }
+
+    for (;;)
+    {
+        // read before taking the stack: a submission after the take bumps it, and the wait below returns at once
+        const auto wakeUps = wakeUps_.load(std::memory_order_acquire);
+        if (auto * newest = submitted_.exchange(nullptr, std::memory_order_acquire); newest != nullptr)
+        {
+            RunBatch(newest);
+            continue;
+        }
+        if (stopRequested_.load(std::memory_order_acquire))
+        {
+            break;
+        }
+        wakeUps_.wait(wakeUps, std::memory_order_acquire);
+    }
+
+    if (entered)
+    {
+        apartment_->Leave();
+    }
+}
+
+void ed::audio::ComExecutor::RunBatch(Request * newest)
+{
+    Request * oldest = nullptr;
+    uint64_t count = 0;
+    while (newest != nullptr)
+    {
+        auto * next = newest->Next;
+        newest->Next = oldest;
+        oldest = newest;
+        newest = next;
+        ++count;
+    }
+    // counted before they run, so that a caller reading the statistics after its request finds it counted
+    requests_.fetch_add(count, std::memory_order_relaxed);
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    largestBatch_.store(std::max(largestBatch_.load(std::memory_order_relaxed), count), std::memory_order_relaxed);
+
+    while (oldest != nullptr)
+    {
+        const std::unique_ptr<Request> request(oldest);
+        oldest = oldest->Next;
+        // a packaged task: the exception of the function goes to its future
+        request->Run();
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+
+namespace ed::audio {
+// Runs the COM work of the API on one thread of its own, which enters the multithreaded apartment once for its
+// lifetime, whatever threads the calls come from: Go goroutines migrate between OS threads, .NET calls from pool
+// threads. Requests are queued without a lock and answered by futures. The thread takes all the requests queued
+// when it wakes up and runs them as one batch, in the order of submission.
+class ComExecutor final {
+public:
+    // Enters and leaves the apartment of the executor thread; tests replace the COM one with a fake.
+    class Apartment {
+    public:
+        DISALLOW_COPY_MOVE(Apartment);
+        Apartment() = default;
+        virtual ~Apartment() = default;
+
+        // On the executor thread, before the first request. The requests run either way; false is logged.
+        virtual bool Enter() = 0;
+        // On the executor thread after the last request, if Enter returned true.
+        virtual void Leave() = 0;
+    };
+
+    struct Statistics {
+        uint64_t Requests = 0;
+        // the wake-ups that found requests; Requests / Batches is the mean batch size
+        uint64_t Batches = 0;
+        uint64_t LargestBatch = 0;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(ComExecutor);
+    // In the multithreaded apartment of COM.
+    ComExecutor();
+    explicit ComExecutor(std::unique_ptr<Apartment> apartment);
+    // Runs the requests submitted so far, then leaves the apartment and stops the thread. Not from a request.
+    ~ComExecutor();
+
+    // The executor of the process: created by the first caller, stopped when the last one releases it.
+    static std::shared_ptr<ComExecutor> AcquireShared();
+
+public:
+    // Queues function; its result, or its exception, comes by the future.
+    // Waiting for the future on the executor thread deadlocks: requests use Invoke.
+    template <typename FunctionT>
+    std::future<std::invoke_result_t<std::decay_t<FunctionT> &>> Submit(FunctionT && function)
+    {
+        using ResultT = std::invoke_result_t<std::decay_t<FunctionT> &>;
+        auto request = std::make_unique<Task<ResultT>>(std::forward<FunctionT>(function));
+        auto future = request->Function.get_future();
+        Push(request.release());
+        return future;
+    }
+
+    // Runs function on the executor thread and waits for it; at once if called there.
+    template <typename FunctionT>
+    std::invoke_result_t<std::decay_t<FunctionT> &> Invoke(FunctionT && function)
+    {
+        if (IsExecutorThread())
+        {
+            return std::invoke(function);
+        }
+        return Submit(std::forward<FunctionT>(function)).get();
+    }
+
+    [[nodiscard]] bool IsExecutorThread() const;
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    // A queued request; a node of the list of submitted ones.
+    class Request {
+    public:
+        DISALLOW_COPY_MOVE(Request);
+        Request() = default;
+        virtual ~Request() = default;
+
+        virtual void Run() = 0;
+
+        Request * Next = nullptr;
+    };
+
+    template <typename ResultT>
+    class Task final : public Request {
+    public:
+        DISALLOW_COPY_MOVE(Task);
+        template <typename FunctionT>
+        explicit Task(FunctionT && function) : Function(std::forward<FunctionT>(function)) {}
+        ~Task() override = default;
+
+        void Run() override { Function(); }
+
+        std::packaged_task<ResultT()> Function;
+    };
+
+private:
+    void Push(Request * request);
+    void Run();
+    // Runs the requests taken from the list, newest first, in the order of submission.
+    void RunBatch(Request * newest);
+
+private:
+    std::unique_ptr<Apartment> apartment_;
+
+    // Lock-free stack of the submitted requests, newest first; the executor thread takes it whole.
+    std::atomic<Request *> submitted_ = nullptr;
+    // bumped by a submission to an empty stack and by the destructor; the executor thread sleeps on it
+    std::atomic<uint32_t> wakeUps_ = 0;
+    std::atomic<bool> stopRequested_ = false;
+
+    std::atomic<uint64_t> requests_ = 0;
+    std::atomic<uint64_t> batches_ = 0;
+    std::atomic<uint64_t> largestBatch_ = 0;
+
+    std::thread worker_;
+};
+}
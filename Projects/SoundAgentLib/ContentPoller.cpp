@@ -0,0 +1,120 @@
+#include "os-dependencies.h"
+
+#include "ContentPoller.h"
+
+#include "public/CoInitRaiiHelper.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+
+namespace
+{
+    template <typename CharT>
+    uint64_t HashCodeUnits(std::basic_string_view<CharT> text)
+    {
+        constexpr uint64_t fnv_offset_basis = 0xCBF29CE484222325ULL;
+        constexpr uint64_t fnv_prime = 0x100000001B3ULL;
+
+        uint64_t hash = fnv_offset_basis;
+        for (const auto c : text)
+        {
+            hash = (hash ^ static_cast<std::make_unsigned_t<CharT>>(c)) * fnv_prime;
+        }
+        return hash;
+    }
+}
+
+uint64_t ed::audio::Fingerprint::Of(std::string_view text)
+{
+    return Combine(HashCodeUnits(text), text.size());
+}
+
+uint64_t ed::audio::Fingerprint::Of(std::wstring_view text)
+{
+    return Combine(HashCodeUnits(text), text.size());
+}
+
+uint64_t ed::audio::Fingerprint::Combine(uint64_t seed, uint64_t value)
+{
+    auto mixed = seed + 0x9E3779B97F4A7C15ULL + value;
+    mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBULL;
+    return mixed ^ (mixed >> 31);
+}
+
+ed::audio::PollingSchedule::PollingSchedule(const Options & options)
+    : options_(options)
+    , interval_(options.Min)
+{
+}
+
+std::chrono::milliseconds ed::audio::PollingSchedule::Next(bool changed)
+{
+    interval_ = changed ? options_.Min : std::min(interval_ * 2, options_.Max);
+    return interval_;
+}
+
+ed::audio::ContentPoller::ContentPoller(PollFunctionT poll, const PollingSchedule::Options & options, ComExecutor * executor)
+    : poll_(std::move(poll))
+    , schedule_(options)
+    , executor_(executor)
+    , worker_(&ContentPoller::Run, this)
+{
+}
+
+ed::audio::ContentPoller::~ContentPoller()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopRequested_ = true;
+    }
+    wakeUp_.notify_all();
+    worker_.join();
+}
+
+ed::audio::ContentPoller::Statistics ed::audio::ContentPoller::GetStatistics() const
+{
+    std::lock_guard lock(mutex_);
+    return statistics_;
+}
+
+void ed::audio::ContentPoller::Run()
+{
+    // only needed if the polls run here
+    std::optional<CoInitRaiiHelper> coInitHelper;
+    if (executor_ == nullptr)
+    {
+        coInitHelper.emplace();
+    }
+    std::unique_lock lock(mutex_);
+    for (auto interval = schedule_.GetInterval();;)
+    {
+        if (wakeUp_.wait_for(lock, interval, [this] { return stopRequested_; }))
+        {
+            return;
+        }
+        lock.unlock();
+        const auto start = std::chrono::steady_clock::now();
+        bool changed = false;
+        try
+        {
+            changed = executor_ != nullptr ? executor_->Invoke(poll_) : poll_();
+        }
+        catch (const std::exception & ex)
+        {
+            spdlog::error("Polling the audio devices failed: {}", ex.what());
+        }
+        const auto busyTime = std::chrono::steady_clock::now() - start;
+        lock.lock();
+
+        ++statistics_.Polls;
+        statistics_.Changes += changed ? 1 : 0;
+        statistics_.BusyTime += busyTime;
+        interval = schedule_.Next(changed);
+    }
+}
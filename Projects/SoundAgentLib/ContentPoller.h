@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "ComExecutor.h"
+
+
+namespace ed::audio {
+// Cheap 64-bit fingerprints of polled state: FNV-1a over the text, mixed by the splitmix64 finalizer.
+// A set fingerprints as the sum of the fingerprints of its elements, so that the order of an enumeration does not count.
+class Fingerprint final {
+public:
+    DISALLOW_COPY_MOVE(Fingerprint);
+    Fingerprint() = delete;
+    ~Fingerprint() = delete;
+
+public:
+    // Over the code units: a text fingerprints differently in UTF-8 and in UTF-16.
+    [[nodiscard]] static uint64_t Of(std::string_view text);
+    [[nodiscard]] static uint64_t Of(std::wstring_view text);
+    [[nodiscard]] static uint64_t Combine(uint64_t seed, uint64_t value);
+};
+
+// The interval between polls: doubled after each poll that found nothing, up to Max, and back to Min after a change.
+// An idle host settles at Max; a burst of changes, like plugging in a headset, is followed at Min.
+class PollingSchedule final {
+public:
+    struct Options {
+        std::chrono::milliseconds Min{ 250 };
+        std::chrono::milliseconds Max{ 8000 };
+    };
+
+public:
+    explicit PollingSchedule(const Options & options);
+
+public:
+    [[nodiscard]] std::chrono::milliseconds GetInterval() const { return interval_; }
+    // After a poll: returns the interval to the next one.
+    std::chrono::milliseconds Next(bool changed);
+
+private:
+    Options options_;
+    std::chrono::milliseconds interval_;
+};
+
+// Calls poll on a PollingSchedule; poll returns whether it found a change. The polls run on executor if given,
+// which must outlive the poller; otherwise on the poller's own thread, with COM initialized. With an executor,
+// the poller must not be destroyed on the executor thread: a poll waiting for that thread would never finish.
+class ContentPoller final {
+public:
+    using PollFunctionT = std::function<bool()>;
+
+    struct Statistics {
+        uint64_t Polls = 0;
+        uint64_t Changes = 0;
+        // spent in poll
+        std::chrono::nanoseconds BusyTime{ 0 };
+    };
+
+public:
+    DISALLOW_COPY_MOVE(ContentPoller);
+    // The first poll comes after options.Min.
+    ContentPoller(PollFunctionT poll, const PollingSchedule::Options & options, ComExecutor * executor = nullptr);
+    // Waits for a running poll, then stops the thread.
+    ~ContentPoller();
+
+public:
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    void Run();
+
+private:
+    PollFunctionT poll_;
+    PollingSchedule schedule_;
+    ComExecutor * executor_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    bool stopRequested_ = false;
+    Statistics statistics_;
+
+    std::thread worker_;
+};
+}
@@ -0,0 +1,365 @@
+#include "os-dependencies.h"
+
+#include "DeviceHistory.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace
+{
+    // Bits are packed from the most significant bit of a byte on.
+    class BitWriter {
+    public:
+        BitWriter(uint8_t * bits, size_t bitCount)
+            : bits_(bits)
+            , bitCount_(bitCount)
+        {
+        }
+
+        // width: up to 64
+        void Write(uint64_t value, unsigned width)
+        {
+            while (width > 0)
+            {
+                const unsigned offset = bitCount_ % 8;
+                const unsigned take = std::min(width, 8 - offset);
+                const auto chunk = static_cast<unsigned>(value >> (width - take)) & ((1u << take) - 1);
+                bits_[bitCount_ / 8] |= static_cast<uint8_t>(chunk << (8 - offset - take));
+                bitCount_ += take;
+                width -= take;
+            }
+        }
+
+        [[nodiscard]] size_t GetBitCount() const { return bitCount_; }
+
+    private:
+        uint8_t * bits_;
+        size_t bitCount_;
+    };
+
+    class BitReader {
+    public:
+        explicit BitReader(const uint8_t * bits)
+            : bits_(bits)
+        {
+        }
+
+        uint64_t Read(unsigned width)
+        {
+            uint64_t value = 0;
+            while (width > 0)
+            {
+                const unsigned offset = position_ % 8;
+                const unsigned take = std::min(width, 8 - offset);
+                const unsigned chunk = (bits_[position_ / 8] >> (8 - offset - take)) & ((1u << take) - 1);
+                value = value << take | chunk;
+                position_ += take;
+                width -= take;
+            }
+            return value;
+        }
+
+        // Reads 1 bits up to the first 0 bit, which is consumed, or up to maxOnes of them.
+        unsigned ReadOnes(unsigned maxOnes)
+        {
+            unsigned ones = 0;
+            while (ones < maxOnes && Read(1) == 1)
+            {
+                ++ones;
+            }
+            return ones;
+        }
+
+    private:
+        const uint8_t * bits_;
+        size_t position_ = 0;
+    };
+
+    // A class is marked by one 1 bit more than the class before it and a 0 bit; a 0 bit alone stands for
+    // a repetition. Following the classes, all 1 bits mark a raw field.
+    constexpr uint64_t ClassPrefix(size_t index) { return ((uint64_t{ 1 } << (index + 1)) - 1) << 1; }
+    constexpr unsigned ClassPrefixBits(size_t index) { return static_cast<unsigned>(index) + 2; }
+
+    // Time: the change of the interval to the previous sample, in ms, biased by Min.
+    struct TimeClass {
+        int64_t Min;
+        int64_t Max;
+        unsigned Width;
+    };
+
+    constexpr TimeClass time_classes[] = { { -63, 64, 7 }, { -255, 256, 9 }, { -2047, 2048, 12 } };
+    constexpr unsigned raw_time_prefix_bits = static_cast<unsigned>(std::size(time_classes)) + 1;
+
+    unsigned TimeBits(int64_t deltaOfDelta)
+    {
+        if (deltaOfDelta == 0)
+        {
+            return 1;
+        }
+        for (size_t i = 0; i < std::size(time_classes); ++i)
+        {
+            if (deltaOfDelta >= time_classes[i].Min && deltaOfDelta <= time_classes[i].Max)
+            {
+                return ClassPrefixBits(i) + time_classes[i].Width;
+            }
+        }
+        return raw_time_prefix_bits + 64;
+    }
+
+    void WriteTime(BitWriter & writer, int64_t deltaOfDelta)
+    {
+        if (deltaOfDelta == 0)
+        {
+            writer.Write(0, 1);
+            return;
+        }
+        for (size_t i = 0; i < std::size(time_classes); ++i)
+        {
+            if (deltaOfDelta >= time_classes[i].Min && deltaOfDelta <= time_classes[i].Max)
+            {
+                writer.Write(ClassPrefix(i), ClassPrefixBits(i));
+                writer.Write(static_cast<uint64_t>(deltaOfDelta - time_classes[i].Min), time_classes[i].Width);
+                return;
+            }
+        }
+        writer.Write((uint64_t{ 1 } << raw_time_prefix_bits) - 1, raw_time_prefix_bits);
+        writer.Write(static_cast<uint64_t>(deltaOfDelta), 64);
+    }
+
+    int64_t ReadTime(BitReader & reader)
+    {
+        const auto ones = reader.ReadOnes(raw_time_prefix_bits);
+        if (ones == 0)
+        {
+            return 0;
+        }
+        if (ones == raw_time_prefix_bits)
+        {
+            return static_cast<int64_t>(reader.Read(64));
+        }
+        const auto & timeClass = time_classes[ones - 1];
+        return static_cast<int64_t>(reader.Read(timeClass.Width)) + timeClass.Min;
+    }
+
+    // Value: the step from the previous value, zigzag encoded, or the value itself in the raw field.
+    constexpr unsigned step_widths[] = { 6, 11 };
+    constexpr unsigned raw_value_prefix_bits = static_cast<unsigned>(std::size(step_widths)) + 1;
+
+    uint32_t ZigZag(int32_t step)
+    {
+        return static_cast<uint32_t>(step) << 1 ^ static_cast<uint32_t>(step >> 31);
+    }
+
+    int32_t UnZigZag(uint32_t value)
+    {
+        return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+    }
+
+    unsigned ValueBits(int32_t step, int32_t lastStep)
+    {
+        if (step == lastStep)
+        {
+            return 1;
+        }
+        for (size_t i = 0; i < std::size(step_widths); ++i)
+        {
+            if (ZigZag(step) < 1u << step_widths[i])
+            {
+                return ClassPrefixBits(i) + step_widths[i];
+            }
+        }
+        return raw_value_prefix_bits + 16;
+    }
+
+    void WriteValue(BitWriter & writer, int32_t step, int32_t lastStep, uint16_t value)
+    {
+        if (step == lastStep)
+        {
+            writer.Write(0, 1);
+            return;
+        }
+        for (size_t i = 0; i < std::size(step_widths); ++i)
+        {
+            if (ZigZag(step) < 1u << step_widths[i])
+            {
+                writer.Write(ClassPrefix(i), ClassPrefixBits(i));
+                writer.Write(ZigZag(step), step_widths[i]);
+                return;
+            }
+        }
+        writer.Write((uint64_t{ 1 } << raw_value_prefix_bits) - 1, raw_value_prefix_bits);
+        writer.Write(value, 16);
+    }
+
+    // Returns the value; updates the step.
+    uint16_t ReadValue(BitReader & reader, uint16_t lastValue, int32_t & step)
+    {
+        const auto ones = reader.ReadOnes(raw_value_prefix_bits);
+        if (ones == raw_value_prefix_bits)
+        {
+            const auto value = static_cast<uint16_t>(reader.Read(16));
+            step = static_cast<int32_t>(value) - lastValue;
+            return value;
+        }
+        if (ones > 0)
+        {
+            step = UnZigZag(static_cast<uint32_t>(reader.Read(step_widths[ones - 1])));
+        }
+        return static_cast<uint16_t>(lastValue + step);
+    }
+
+    // Rounded up, so that a sample, kept in ms, is at or after from exactly if its ms are.
+    int64_t ToMilliseconds(std::chrono::system_clock::time_point time)
+    {
+        return std::chrono::ceil<std::chrono::milliseconds>(time.time_since_epoch()).count();
+    }
+}
+
+
+ed::audio::DeviceHistory::DeviceHistory(const Options & options)
+    : options_(options)
+{
+}
+
+void ed::audio::DeviceHistory::Record(const std::string & pnpId, SoundDeviceHistoryKind kind, uint16_t value,
+    std::chrono::system_clock::time_point time)
+{
+    const auto index = static_cast<size_t>(kind);
+    if (index >= kind_count)
+    {
+        throw std::runtime_error("Unknown device history kind");
+    }
+    auto timeMs = ToMilliseconds(time);
+
+    std::lock_guard lock(mutex_);
+    auto found = devices_.find(pnpId);
+    if (found == devices_.end())
+    {
+        found = devices_.emplace(pnpId, SeriesSetT{}).first;
+    }
+    auto & series = found->second[index];
+    if (!series.Blocks.empty())
+    {
+        if (value == series.LastValue)
+        {
+            return;
+        }
+        timeMs = std::max(timeMs, series.Blocks.back().LastTime);
+    }
+    Append(series, timeMs, value);
+    ++statistics_.SamplesRecorded;
+}
+
+std::vector<SoundDeviceHistorySample> ed::audio::DeviceHistory::Query(const std::string & pnpId, SoundDeviceHistoryKind kind,
+    std::chrono::system_clock::time_point from, std::chrono::system_clock::time_point to) const
+{
+    const auto index = static_cast<size_t>(kind);
+    if (index >= kind_count)
+    {
+        throw std::runtime_error("Unknown device history kind");
+    }
+    const auto fromMs = ToMilliseconds(from);
+    const auto toMs = ToMilliseconds(to);
+
+    std::vector<SoundDeviceHistorySample> samples;
+    std::lock_guard lock(mutex_);
+    const auto found = devices_.find(pnpId);
+    if (found == devices_.end())
+    {
+        return samples;
+    }
+    // blocks follow each other in time: the first one of the range is found by bisection
+    const auto & blocks = found->second[index].Blocks;
+    for (
+        auto block = std::ranges::partition_point(blocks, [fromMs](const Block & b) { return b.LastTime < fromMs; });
+        block != blocks.end() && block->FirstTime < toMs;
+        ++block
+    )
+    {
+        Decode(*block, fromMs, toMs, samples);
+    }
+    return samples;
+}
+
+ed::audio::DeviceHistory::Statistics ed::audio::DeviceHistory::GetStatistics() const
+{
+    std::lock_guard lock(mutex_);
+    auto statistics = statistics_;
+    statistics.MemoryBytes = 0;
+    for (const auto & [pnpId, seriesSet] : devices_)
+    {
+        statistics.MemoryBytes += sizeof(pnpId) + pnpId.capacity() + sizeof(SeriesSetT);
+        for (const auto & series : seriesSet)
+        {
+            statistics.MemoryBytes += series.Blocks.size() * sizeof(Block);
+        }
+    }
+    return statistics;
+}
+
+void ed::audio::DeviceHistory::Append(Series & series, int64_t time, uint16_t value)
+{
+    if (!series.Blocks.empty())
+    {
+        auto & block = series.Blocks.back();
+        const auto delta = time - block.LastTime;
+        const auto deltaOfDelta = delta - series.LastDelta;
+        const auto step = static_cast<int32_t>(value) - series.LastValue;
+        if (block.BitCount + TimeBits(deltaOfDelta) + ValueBits(step, series.LastStep) <= block.Bits.size() * 8)
+        {
+            BitWriter writer(block.Bits.data(), block.BitCount);
+            WriteTime(writer, deltaOfDelta);
+            WriteValue(writer, step, series.LastStep, value);
+            block.BitCount = static_cast<uint16_t>(writer.GetBitCount());
+            block.LastTime = time;
+            ++block.Count;
+            series.LastDelta = delta;
+            series.LastStep = step;
+            series.LastValue = value;
+            return;
+        }
+    }
+
+    if (series.Blocks.size() >= std::max<size_t>(options_.MaxBlocksPerSeries, 1))
+    {
+        statistics_.SamplesDropped += series.Blocks.front().Count;
+        --statistics_.Blocks;
+        series.Blocks.pop_front();
+    }
+    auto & block = series.Blocks.emplace_back();
+    block.FirstTime = time;
+    block.LastTime = time;
+    block.FirstValue = value;
+    block.Count = 1;
+    ++statistics_.Blocks;
+    series.LastDelta = 0;
+    series.LastStep = 0;
+    series.LastValue = value;
+}
+
+void ed::audio::DeviceHistory::Decode(const Block & block, int64_t from, int64_t to, std::vector<SoundDeviceHistorySample> & samples)
+{
+    BitReader reader(block.Bits.data());
+    auto time = block.FirstTime;
+    int64_t delta = 0;
+    int32_t step = 0;
+    auto value = block.FirstValue;
+    for (uint16_t i = 0; i < block.Count; ++i)
+    {
+        if (i > 0)
+        {
+            delta += ReadTime(reader);
+            time += delta;
+            value = ReadValue(reader, value, step);
+        }
+        if (time >= to)
+        {
+            break;
+        }
+        if (time >= from)
+        {
+            samples.push_back({ std::chrono::system_clock::time_point(std::chrono::milliseconds(time)), value });
+        }
+    }
+}
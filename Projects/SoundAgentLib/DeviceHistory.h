@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "public/SoundAgentInterface.h"
+
+
+namespace ed::audio {
+// Bounded in-memory history of the volume and default-role transitions of each device, kept compressed.
+// A series, one per device and SoundDeviceHistoryKind, is a list of fixed-size blocks. A block holds its first
+// sample in full and bit packs the following ones: the time, in ms, as the delta of its delta to the previous
+// one, and the value as its step from the previous value, both in prefix classes of growing width, the
+// shortest for a repeated interval and a repeated step. A slider drag takes about 1.5 bytes a sample.
+// A block decodes on its own, so the oldest block of a full series is dropped, and a range query decodes only
+// the blocks overlapping the range. A value equal to the last one of its series is not recorded again.
+// Thread-safe.
+class DeviceHistory final {
+public:
+    struct Options {
+        // A block takes block_bytes.
+        size_t MaxBlocksPerSeries = 256;
+    };
+
+    struct Statistics {
+        uint64_t SamplesRecorded = 0;
+        uint64_t SamplesDropped = 0;
+        uint64_t Blocks = 0;
+        // blocks and bookkeeping
+        size_t MemoryBytes = 0;
+    };
+
+    static constexpr size_t block_bytes = 512;
+
+public:
+    DISALLOW_COPY_MOVE(DeviceHistory);
+    explicit DeviceHistory(const Options & options);
+    ~DeviceHistory() = default;
+
+public:
+    // A time before the last one of the series is taken as the last one: the wall clock may be set back.
+    void Record(const std::string & pnpId, SoundDeviceHistoryKind kind, uint16_t value, std::chrono::system_clock::time_point time);
+    // Samples with from <= time < to, oldest first. Empty for an unknown device.
+    [[nodiscard]] std::vector<SoundDeviceHistorySample> Query(const std::string & pnpId, SoundDeviceHistoryKind kind,
+        std::chrono::system_clock::time_point from, std::chrono::system_clock::time_point to) const;
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    static constexpr size_t header_bytes = 2 * sizeof(int64_t) + 3 * sizeof(uint16_t);
+
+    struct Block {
+        // ms since the epoch
+        int64_t FirstTime = 0;
+        int64_t LastTime = 0;
+        uint16_t FirstValue = 0;
+        uint16_t Count = 0;
+        uint16_t BitCount = 0;
+        std::array<uint8_t, block_bytes - header_bytes> Bits{};
+    };
+    static_assert(sizeof(Block) == block_bytes);
+
+    struct Series {
+        std::deque<Block> Blocks;
+        // encoder state after the last sample
+        int64_t LastDelta = 0;
+        int32_t LastStep = 0;
+        uint16_t LastValue = 0;
+    };
+
+    static constexpr size_t kind_count = 4;
+    using SeriesSetT = std::array<Series, kind_count>;
+
+    // Must be called with mutex_ held.
+    void Append(Series & series, int64_t time, uint16_t value);
+    // Appends the samples of the block with from <= time < to.
+    static void Decode(const Block & block, int64_t from, int64_t to, std::vector<SoundDeviceHistorySample> & samples);
+
+private:
+    const Options options_;
+    mutable std::mutex mutex_;
+    std::map<std::string, SeriesSetT, std::less<>> devices_;
+    Statistics statistics_;
+};
+}
@@ -0,0 +1,233 @@
+#include "os-dependencies.h"
+
+#include "DeviceIndex.h"
+
+#include <algorithm>
+#include <bit>
+#include <ranges>
+#include <utility>
+
+
+namespace
+{
+    constexpr size_t bits_per_word = 64;
+
+    template <size_t... Indexes>
+    std::array<std::pmr::vector<uint64_t>, sizeof...(Indexes)> MakeBitmaps(std::pmr::memory_resource * resource,
+        std::index_sequence<Indexes...>)
+    {
+        return { (static_cast<void>(Indexes), std::pmr::vector<uint64_t>(resource))... };
+    }
+
+    char ToLowerAscii(char c)
+    {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+}
+
+ed::audio::DeviceIndex::DeviceIndex(std::pmr::memory_resource * resource)
+    : present_(resource)
+    , renders_(resource)
+    , captures_(resource)
+    , renderDefault_(resource)
+    , captureDefault_(resource)
+    , formFactors_(MakeBitmaps(resource, std::make_index_sequence<form_factor_count>()))
+    , postingsByTrigram_(resource)
+    , generations_(resource)
+    , trigramScratch_(resource)
+{
+}
+
+void ed::audio::DeviceIndex::Add(Handle handle, const SoundDevice & device)
+{
+    const auto flow = device.GetFlow();
+    SetBit(present_, handle, true);
+    SetBit(renders_, handle, flow == SoundDeviceFlowType::Render || flow == SoundDeviceFlowType::RenderAndCapture);
+    SetBit(captures_, handle, flow == SoundDeviceFlowType::Capture || flow == SoundDeviceFlowType::RenderAndCapture);
+    SetBit(renderDefault_, handle, device.IsRenderCurrentlyDefault());
+    SetBit(captureDefault_, handle, device.IsCaptureCurrentlyDefault());
+    SetBit(formFactors_[static_cast<size_t>(device.GetFormFactor())], handle, true);
+
+    if (handle >= generations_.size())
+    {
+        generations_.resize(static_cast<size_t>(handle) + 1, 0);
+    }
+    CollectTrigrams(device.GetNameView());
+    for (const auto trigram : trigramScratch_)
+    {
+        postingsByTrigram_[trigram].push_back({ handle, generations_[handle] });
+    }
+    postingCount_ += trigramScratch_.size();
+}
+
+void ed::audio::DeviceIndex::Remove(Handle handle, const SoundDevice & device)
+{
+    SetBit(present_, handle, false);
+    SetBit(renders_, handle, false);
+    SetBit(captures_, handle, false);
+    SetBit(renderDefault_, handle, false);
+    SetBit(captureDefault_, handle, false);
+    SetBit(formFactors_[static_cast<size_t>(device.GetFormFactor())], handle, false);
+
+    CollectTrigrams(device.GetNameView());
+    ++generations_[handle];
+    stalePostingCount_ += trigramScratch_.size();
+    if (stalePostingCount_ * 2 > postingCount_)
+    {
+        DropStalePostings();
+    }
+}
+
+void ed::audio::DeviceIndex::SetRenderDefault(Handle handle, bool isDefault)
+{
+    SetBit(renderDefault_, handle, isDefault);
+}
+
+void ed::audio::DeviceIndex::SetCaptureDefault(Handle handle, bool isDefault)
+{
+    SetBit(captureDefault_, handle, isDefault);
+}
+
+void ed::audio::DeviceIndex::Clear()
+{
+    for (auto * bitmap : { &present_, &renders_, &captures_, &renderDefault_, &captureDefault_ })
+    {
+        std::ranges::fill(*bitmap, 0);
+    }
+    for (auto & bitmap : formFactors_)
+    {
+        std::ranges::fill(bitmap, 0);
+    }
+    for (auto & postings : postingsByTrigram_ | std::views::values)
+    {
+        postings.clear();
+    }
+    postingCount_ = 0;
+    stalePostingCount_ = 0;
+}
+
+bool ed::audio::DeviceIndex::FindCandidates(const DeviceQuery & query, std::vector<Handle> & handles) const
+{
+    handles.clear();
+
+    std::array<const Bitmap *, 5> conditions{};
+    size_t conditionCount = 0;
+    if (query.Renders)
+    {
+        conditions[conditionCount++] = &renders_;
+    }
+    if (query.Captures)
+    {
+        conditions[conditionCount++] = &captures_;
+    }
+    if (query.IsRenderDefault)
+    {
+        conditions[conditionCount++] = &renderDefault_;
+    }
+    if (query.IsCaptureDefault)
+    {
+        conditions[conditionCount++] = &captureDefault_;
+    }
+    if (query.FormFactor.has_value())
+    {
+        conditions[conditionCount++] = &formFactors_[static_cast<size_t>(*query.FormFactor)];
+    }
+
+    if (query.NameContains.size() >= trigram_size)
+    {
+        const std::pmr::vector<Posting> * shortest = nullptr;
+        for (size_t offset = 0; offset + trigram_size <= query.NameContains.size(); ++offset)
+        {
+            const auto found = postingsByTrigram_.find(GetTrigram(query.NameContains, offset));
+            if (found == postingsByTrigram_.end() || found->second.empty())
+            {
+                return true;
+            }
+            if (shortest == nullptr || found->second.size() < shortest->size())
+            {
+                shortest = &found->second;
+            }
+        }
+        for (const auto & [handle, generation] : *shortest)
+        {
+            if (generation == generations_[handle]
+                && std::all_of(conditions.begin(), conditions.begin() + static_cast<ptrdiff_t>(conditionCount),
+                    [handle](const Bitmap * bitmap) { return TestBit(*bitmap, handle); }))
+            {
+                handles.push_back(handle);
+            }
+        }
+        std::ranges::sort(handles);
+        return true;
+    }
+
+    for (size_t word = 0; word < present_.size(); ++word)
+    {
+        auto bits = present_[word];
+        for (size_t i = 0; i < conditionCount && bits != 0; ++i)
+        {
+            bits &= word < conditions[i]->size() ? (*conditions[i])[word] : 0;
+        }
+        for (; bits != 0; bits &= bits - 1)
+        {
+            handles.push_back(static_cast<Handle>(word * bits_per_word + std::countr_zero(bits)));
+        }
+    }
+    return !query.NameContains.empty();
+}
+
+bool ed::audio::DeviceIndex::NameContains(std::string_view name, std::string_view part)
+{
+    return part.empty()
+        || !std::ranges::search(name, part, [](char a, char b) { return ToLowerAscii(a) == ToLowerAscii(b); }).empty();
+}
+
+ed::audio::DeviceIndex::Trigram ed::audio::DeviceIndex::GetTrigram(std::string_view text, size_t offset)
+{
+    return static_cast<Trigram>(static_cast<uint8_t>(ToLowerAscii(text[offset]))) << 16
+        | static_cast<Trigram>(static_cast<uint8_t>(ToLowerAscii(text[offset + 1]))) << 8
+        | static_cast<Trigram>(static_cast<uint8_t>(ToLowerAscii(text[offset + 2])));
+}
+
+bool ed::audio::DeviceIndex::TestBit(const Bitmap & bitmap, Handle handle)
+{
+    const auto word = handle / bits_per_word;
+    return word < bitmap.size() && (bitmap[word] >> (handle % bits_per_word) & 1) != 0;
+}
+
+void ed::audio::DeviceIndex::SetBit(Bitmap & bitmap, Handle handle, bool value)
+{
+    const auto word = handle / bits_per_word;
+    if (word >= bitmap.size())
+    {
+        if (!value)
+        {
+            return;
+        }
+        bitmap.resize(word + 1, 0);
+    }
+    const auto mask = uint64_t{ 1 } << (handle % bits_per_word);
+    bitmap[word] = value ? bitmap[word] | mask : bitmap[word] & ~mask;
+}
+
+void ed::audio::DeviceIndex::CollectTrigrams(std::string_view name)
+{
+    trigramScratch_.clear();
+    for (size_t offset = 0; offset + trigram_size <= name.size(); ++offset)
+    {
+        trigramScratch_.push_back(GetTrigram(name, offset));
+    }
+    std::ranges::sort(trigramScratch_);
+    const auto duplicates = std::ranges::unique(trigramScratch_);
+    trigramScratch_.erase(duplicates.begin(), duplicates.end());
+}
+
+void ed::audio::DeviceIndex::DropStalePostings()
+{
+    for (auto & postings : postingsByTrigram_ | std::views::values)
+    {
+        std::erase_if(postings, [this](const Posting & posting) { return posting.Generation != generations_[posting.Device]; });
+    }
+    postingCount_ -= stalePostingCount_;
+    stalePostingCount_ = 0;
+}
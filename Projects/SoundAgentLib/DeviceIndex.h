@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "SoundDevice.h"
+#include "StringInterner.h"
+
+
+namespace ed::audio {
+// What DeviceTable::Find matches: a device must meet every condition set.
+struct DeviceQuery {
+    // only devices that render, resp. capture audio; those of both flows included
+    bool Renders = false;
+    bool Captures = false;
+    // only the default render, resp. capture device
+    bool IsRenderDefault = false;
+    bool IsCaptureDefault = false;
+    std::optional<SoundDeviceFormFactor> FormFactor;
+    // a part of the name, case-insensitive for ASCII letters; empty for any name
+    std::string_view NameContains;
+};
+
+// Secondary indexes of the devices of a DeviceTable, by handle, updated with each change of the table.
+// Flow, form factor and default roles are bitmaps by handle: a query ANDs the bitmaps of its conditions 64 handles
+// at a time. Names are indexed by their trigrams, three bytes with ASCII letters lowercased: a name condition of
+// three bytes or more starts from the shortest posting list of its trigrams, and the table verifies the names of
+// those candidates. A shorter one is verified on the candidates of the bitmaps.
+// Postings carry the generation of their device, bumped on removal: a removal leaves them stale rather than
+// searching the lists, and the stale ones are dropped once they are half of all, for an amortized constant cost.
+// The containers are allocated from the given memory resource; compaction reuses their capacity, so that an index
+// in an arena grows with the distinct trigrams and the largest number of postings only.
+class DeviceIndex final {
+public:
+    using Handle = StringInterner::Id;
+
+public:
+    explicit DeviceIndex(std::pmr::memory_resource * resource = std::pmr::get_default_resource());
+
+public:
+    // The handle must not be in the index.
+    void Add(Handle handle, const SoundDevice & device);
+    // The device must be the one added with the handle.
+    void Remove(Handle handle, const SoundDevice & device);
+    void SetRenderDefault(Handle handle, bool isDefault);
+    void SetCaptureDefault(Handle handle, bool isDefault);
+    void Clear();
+
+    // Into handles, ascending: the devices meeting the conditions of the query. True if their names are still to be
+    // verified against query.NameContains, see NameContains.
+    bool FindCandidates(const DeviceQuery & query, std::vector<Handle> & handles) const;
+
+    [[nodiscard]] static bool NameContains(std::string_view name, std::string_view part);
+
+private:
+    using Bitmap = std::pmr::vector<uint64_t>;
+    using Trigram = uint32_t;
+
+    struct Posting {
+        Handle Device;
+        uint32_t Generation;
+    };
+
+    static constexpr size_t form_factor_count = static_cast<size_t>(SoundDeviceFormFactor::Unknown) + 1;
+    static constexpr size_t trigram_size = 3;
+
+    [[nodiscard]] static Trigram GetTrigram(std::string_view text, size_t offset);
+    [[nodiscard]] static bool TestBit(const Bitmap & bitmap, Handle handle);
+    static void SetBit(Bitmap & bitmap, Handle handle, bool value);
+    // The distinct trigrams of the name, into trigramScratch_.
+    void CollectTrigrams(std::string_view name);
+    void DropStalePostings();
+
+private:
+    Bitmap present_;
+    Bitmap renders_;
+    Bitmap captures_;
+    Bitmap renderDefault_;
+    Bitmap captureDefault_;
+    std::array<Bitmap, form_factor_count> formFactors_;
+    // unordered posting lists
+    std::pmr::unordered_map<Trigram, std::pmr::vector<Posting>> postingsByTrigram_;
+    // indexed by handle: the generation of the device's current postings
+    std::pmr::vector<uint32_t> generations_;
+    size_t postingCount_ = 0;
+    size_t stalePostingCount_ = 0;
+    std::pmr::vector<Trigram> trigramScratch_;
+};
+}
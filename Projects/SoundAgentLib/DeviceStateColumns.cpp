@@ -0,0 +1,205 @@
+#include "os-dependencies.h"
+
+#include "DeviceStateColumns.h"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define DEVICE_STATE_COLUMNS_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace
+{
+    constexpr size_t bitmap_word_rows = 64;
+
+    size_t GetBitmapWordCount(size_t rowCount)
+    {
+        return (rowCount + bitmap_word_rows - 1) / bitmap_word_rows;
+    }
+
+#ifdef DEVICE_STATE_COLUMNS_SSE2
+    // The 16 values of a block, or zeros beyond the column: the rows of an absent block are absent.
+    template <typename T>
+    __m128i LoadBlock(const std::pmr::vector<T> & column, size_t offset)
+    {
+        if (offset >= column.size())
+        {
+            return _mm_setzero_si128();
+        }
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(column.data() + offset));
+    }
+
+    // 0xFF in the bytes of the rows equal in both 16-bit columns.
+    __m128i CompareWords(const std::pmr::vector<uint16_t> & before, const std::pmr::vector<uint16_t> & after, size_t offset)
+    {
+        return _mm_packs_epi16(
+            _mm_cmpeq_epi16(LoadBlock(before, offset), LoadBlock(after, offset)),
+            _mm_cmpeq_epi16(LoadBlock(before, offset + 8), LoadBlock(after, offset + 8)));
+    }
+
+    __m128i CompareBytes(const std::pmr::vector<uint8_t> & before, const std::pmr::vector<uint8_t> & after, size_t offset)
+    {
+        return _mm_cmpeq_epi8(LoadBlock(before, offset), LoadBlock(after, offset));
+    }
+#endif
+}
+
+
+ed::audio::DeviceStateColumns::DeviceStateColumns(std::pmr::memory_resource * resource)
+    : renderVolumes_(resource)
+    , captureVolumes_(resource)
+    , flows_(resource)
+    , flags_(resource)
+{
+}
+
+void ed::audio::DeviceStateColumns::Set(Row row, const SoundDevice & device)
+{
+    Reserve(row);
+    renderVolumes_[row] = device.GetCurrentRenderVolume();
+    captureVolumes_[row] = device.GetCurrentCaptureVolume();
+    flows_[row] = static_cast<uint8_t>(device.GetFlow());
+    flags_[row] = static_cast<uint8_t>(flag_present
+        | (device.IsRenderCurrentlyDefault() ? flag_render_default : 0)
+        | (device.IsCaptureCurrentlyDefault() ? flag_capture_default : 0));
+}
+
+void ed::audio::DeviceStateColumns::Clear(Row row)
+{
+    if (row >= flags_.size())
+    {
+        return;
+    }
+    renderVolumes_[row] = 0;
+    captureVolumes_[row] = 0;
+    flows_[row] = 0;
+    flags_[row] = 0;
+}
+
+void ed::audio::DeviceStateColumns::Reserve(Row row)
+{
+    if (row < flags_.size())
+    {
+        return;
+    }
+    const auto rowCount = (static_cast<size_t>(row) / block_rows + 1) * block_rows;
+    renderVolumes_.resize(rowCount, 0);
+    captureVolumes_.resize(rowCount, 0);
+    flows_.resize(rowCount, 0);
+    flags_.resize(rowCount, 0);
+}
+
+void ed::audio::DeviceStateColumns::SetFlag(Row row, uint8_t flag, bool value)
+{
+    flags_[row] = static_cast<uint8_t>(value ? flags_[row] | flag : flags_[row] & ~flag);
+}
+
+std::vector<uint64_t> ed::audio::DeviceStateColumns::ComputeChangeBitmap(const DeviceStateColumns & before,
+    const DeviceStateColumns & after)
+{
+    const auto rowCount = std::max(before.GetRowCount(), after.GetRowCount());
+    std::vector<uint64_t> bitmap(GetBitmapWordCount(rowCount), 0);
+    for (size_t offset = 0; offset < rowCount; offset += block_rows)
+    {
+        bitmap[offset / bitmap_word_rows] |= uint64_t{ GetBlockChanges(before, after, offset) } << (offset % bitmap_word_rows);
+    }
+    return bitmap;
+}
+
+std::vector<uint64_t> ed::audio::DeviceStateColumns::ComputeChangeBitmapScalar(const DeviceStateColumns & before,
+    const DeviceStateColumns & after)
+{
+    const auto rowCount = std::max(before.GetRowCount(), after.GetRowCount());
+    std::vector<uint64_t> bitmap(GetBitmapWordCount(rowCount), 0);
+    for (size_t row = 0; row < rowCount; ++row)
+    {
+        if (GetRowChanges(before, after, static_cast<Row>(row)) != 0)
+        {
+            bitmap[row / bitmap_word_rows] |= uint64_t{ 1 } << (row % bitmap_word_rows);
+        }
+    }
+    return bitmap;
+}
+
+std::vector<ed::audio::DeviceStateColumns::ChangeRecord> ed::audio::DeviceStateColumns::Diff(const DeviceStateColumns & before,
+    const DeviceStateColumns & after)
+{
+    std::vector<ChangeRecord> changes;
+    Diff(before, after, changes);
+    return changes;
+}
+
+void ed::audio::DeviceStateColumns::Diff(const DeviceStateColumns & before, const DeviceStateColumns & after,
+    std::vector<ChangeRecord> & changes)
+{
+    changes.clear();
+    const auto rowCount = std::max(before.GetRowCount(), after.GetRowCount());
+    // the bitmap a block at a time, so that nothing is allocated besides the records
+    for (size_t offset = 0; offset < rowCount; offset += block_rows)
+    {
+        for (auto bits = GetBlockChanges(before, after, offset); bits != 0; bits &= bits - 1)
+        {
+            const auto row = static_cast<Row>(offset + std::countr_zero(bits));
+            changes.push_back({ row, GetRowChanges(before, after, row) });
+        }
+    }
+}
+
+uint32_t ed::audio::DeviceStateColumns::GetBlockChanges(const DeviceStateColumns & before, const DeviceStateColumns & after,
+    size_t offset)
+{
+#ifdef DEVICE_STATE_COLUMNS_SSE2
+    const auto equal = _mm_and_si128(
+        _mm_and_si128(CompareBytes(before.flags_, after.flags_, offset), CompareBytes(before.flows_, after.flows_, offset)),
+        _mm_and_si128(CompareWords(before.renderVolumes_, after.renderVolumes_, offset),
+            CompareWords(before.captureVolumes_, after.captureVolumes_, offset)));
+    return static_cast<uint32_t>(~_mm_movemask_epi8(equal) & 0xFFFF);
+#else
+    uint32_t changes = 0;
+    for (size_t i = 0; i < block_rows; ++i)
+    {
+        if (GetRowChanges(before, after, static_cast<Row>(offset + i)) != 0)
+        {
+            changes |= 1u << i;
+        }
+    }
+    return changes;
+#endif
+}
+
+ed::audio::DeviceStateColumns::ChangeMask ed::audio::DeviceStateColumns::GetRowChanges(const DeviceStateColumns & before,
+    const DeviceStateColumns & after, Row row)
+{
+    const auto wasPresent = before.IsPresent(row);
+    const auto isPresent = after.IsPresent(row);
+    if (!wasPresent || !isPresent)
+    {
+        return wasPresent == isPresent ? 0 : isPresent ? change_added : change_removed;
+    }
+
+    ChangeMask changes = 0;
+    if (before.flows_[row] != after.flows_[row])
+    {
+        changes |= change_flow;
+    }
+    if (before.renderVolumes_[row] != after.renderVolumes_[row])
+    {
+        changes |= change_render_volume;
+    }
+    if (before.captureVolumes_[row] != after.captureVolumes_[row])
+    {
+        changes |= change_capture_volume;
+    }
+    if ((before.flags_[row] ^ after.flags_[row]) & flag_render_default)
+    {
+        changes |= change_render_default;
+    }
+    if ((before.flags_[row] ^ after.flags_[row]) & flag_capture_default)
+    {
+        changes |= change_capture_default;
+    }
+    return changes;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "SoundDevice.h"
+#include "StringInterner.h"
+
+
+namespace ed::audio {
+// The hot state of devices (presence, flow, volumes, default roles) as columns, one row per device handle.
+// Rows are handles rather than slots, so that two copies line up row by row however the devices moved between
+// them; an absent row is all zeros. Copy the columns to keep a state, and Diff two of them to find what changed:
+// the columns are compared 16 rows at a time with SSE2, into a bitmap of the changed rows.
+// The columns are allocated from the given memory resource; a copy uses the default one.
+class DeviceStateColumns final {
+public:
+    using Row = StringInterner::Id;
+    using ChangeMask = uint8_t;
+
+    static constexpr ChangeMask change_added = 1 << 0;
+    static constexpr ChangeMask change_removed = 1 << 1;
+    // The following are set for rows present in both states only.
+    static constexpr ChangeMask change_flow = 1 << 2;
+    static constexpr ChangeMask change_render_volume = 1 << 3;
+    static constexpr ChangeMask change_capture_volume = 1 << 4;
+    static constexpr ChangeMask change_render_default = 1 << 5;
+    static constexpr ChangeMask change_capture_default = 1 << 6;
+
+    struct ChangeRecord {
+        Row Device = 0;
+        ChangeMask Changes = 0;
+    };
+
+public:
+    DeviceStateColumns() = default;
+    explicit DeviceStateColumns(std::pmr::memory_resource * resource);
+
+public:
+    // A multiple of 16, beyond the last row set.
+    [[nodiscard]] size_t GetRowCount() const { return flags_.size(); }
+    [[nodiscard]] bool IsPresent(Row row) const { return row < flags_.size() && (flags_[row] & flag_present) != 0; }
+
+    void Set(Row row, const SoundDevice & device);
+    // The row must be present.
+    void SetRenderVolume(Row row, uint16_t volume) { renderVolumes_[row] = volume; }
+    void SetCaptureVolume(Row row, uint16_t volume) { captureVolumes_[row] = volume; }
+    void SetRenderDefault(Row row, bool isDefault) { SetFlag(row, flag_render_default, isDefault); }
+    void SetCaptureDefault(Row row, bool isDefault) { SetFlag(row, flag_capture_default, isDefault); }
+    void Clear(Row row);
+
+    // A bit per row, set where the states differ; as many words as the longer state needs.
+    [[nodiscard]] static std::vector<uint64_t> ComputeChangeBitmap(const DeviceStateColumns & before, const DeviceStateColumns & after);
+    // The changed rows in ascending order.
+    [[nodiscard]] static std::vector<ChangeRecord> Diff(const DeviceStateColumns & before, const DeviceStateColumns & after);
+    // Replaces the content of changes, reusing its capacity.
+    static void Diff(const DeviceStateColumns & before, const DeviceStateColumns & after, std::vector<ChangeRecord> & changes);
+
+    [[nodiscard]] static std::vector<uint64_t> ComputeChangeBitmapScalar(const DeviceStateColumns & before, const DeviceStateColumns & after);
+
+private:
+    // the columns grow by blocks of 16 rows, so that the kernel has no tail
+    static constexpr size_t block_rows = 16;
+
+    static constexpr uint8_t flag_present = 1 << 0;
+    static constexpr uint8_t flag_render_default = 1 << 1;
+    static constexpr uint8_t flag_capture_default = 1 << 2;
+
+    void Reserve(Row row);
+    void SetFlag(Row row, uint8_t flag, bool value);
+    // A bit per row of the block of 16 rows at offset, set where the states differ.
+    [[nodiscard]] static uint32_t GetBlockChanges(const DeviceStateColumns & before, const DeviceStateColumns & after, size_t offset);
+    [[nodiscard]] static ChangeMask GetRowChanges(const DeviceStateColumns & before, const DeviceStateColumns & after, Row row);
+
+private:
+    std::pmr::vector<uint16_t> renderVolumes_;
+    std::pmr::vector<uint16_t> captureVolumes_;
+    std::pmr::vector<uint8_t> flows_;
+    std::pmr::vector<uint8_t> flags_;
+};
+}
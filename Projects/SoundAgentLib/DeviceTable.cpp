@@ -0,0 +1,132 @@
+#include "os-dependencies.h"
+
+#include "DeviceTable.h"
+
+
+ed::audio::DeviceTable::DeviceTable(StringInterner & pnpIds, std::pmr::memory_resource * resource)
+    : pnpIds_(&pnpIds)
+    , devices_(resource)
+    , handles_(resource)
+    , slotOfHandle_(resource)
+    , columns_(resource)
+    , index_(resource)
+{
+}
+
+std::optional<ed::audio::DeviceTable::Handle> ed::audio::DeviceTable::FindHandle(std::string_view pnpId) const
+{
+    const auto handle = pnpIds_->Find(pnpId);
+    if (!handle.has_value() || Find(*handle) == nullptr)
+    {
+        return std::nullopt;
+    }
+    return handle;
+}
+
+const ed::audio::SoundDevice * ed::audio::DeviceTable::Find(Handle handle) const
+{
+    if (handle >= slotOfHandle_.size() || slotOfHandle_[handle] == no_slot)
+    {
+        return nullptr;
+    }
+    return &devices_[slotOfHandle_[handle]];
+}
+
+const ed::audio::SoundDevice * ed::audio::DeviceTable::Find(std::string_view pnpId) const
+{
+    const auto handle = pnpIds_->Find(pnpId);
+    return handle.has_value() ? Find(*handle) : nullptr;
+}
+
+void ed::audio::DeviceTable::Find(const DeviceQuery & query, std::vector<Handle> & handles) const
+{
+    if (index_.FindCandidates(query, handles))
+    {
+        std::erase_if(handles, [this, &query](Handle handle)
+            {
+                return !DeviceIndex::NameContains(devices_[slotOfHandle_[handle]].GetNameView(), query.NameContains);
+            });
+    }
+}
+
+ed::audio::DeviceTable::Handle ed::audio::DeviceTable::Put(const SoundDevice & device)
+{
+    const auto handle = pnpIds_->Intern(device.GetPnpId());
+    if (handle >= slotOfHandle_.size())
+    {
+        slotOfHandle_.resize(static_cast<size_t>(handle) + 1, no_slot);
+    }
+    columns_.Set(handle, device);
+    if (slotOfHandle_[handle] != no_slot)
+    {
+        index_.Remove(handle, devices_[slotOfHandle_[handle]]);
+        index_.Add(handle, device);
+        devices_[slotOfHandle_[handle]] = device;
+        return handle;
+    }
+    index_.Add(handle, device);
+    slotOfHandle_[handle] = static_cast<uint32_t>(devices_.size());
+    devices_.push_back(device);
+    handles_.push_back(handle);
+    return handle;
+}
+
+bool ed::audio::DeviceTable::Erase(Handle handle)
+{
+    if (handle >= slotOfHandle_.size() || slotOfHandle_[handle] == no_slot)
+    {
+        return false;
+    }
+    const auto slot = slotOfHandle_[handle];
+    index_.Remove(handle, devices_[slot]);
+    const auto last = static_cast<uint32_t>(devices_.size() - 1);
+    if (slot != last)
+    {
+        devices_[slot] = std::move(devices_[last]);
+        handles_[slot] = handles_[last];
+        slotOfHandle_[handles_[slot]] = slot;
+    }
+    devices_.pop_back();
+    handles_.pop_back();
+    slotOfHandle_[handle] = no_slot;
+    columns_.Clear(handle);
+    return true;
+}
+
+void ed::audio::DeviceTable::Clear()
+{
+    for (const auto handle : handles_)
+    {
+        slotOfHandle_[handle] = no_slot;
+        columns_.Clear(handle);
+    }
+    devices_.clear();
+    handles_.clear();
+    index_.Clear();
+}
+
+void ed::audio::DeviceTable::SetRenderVolume(Handle handle, uint16_t volume)
+{
+    devices_[slotOfHandle_[handle]].SetCurrentRenderVolume(volume);
+    columns_.SetRenderVolume(handle, volume);
+}
+
+void ed::audio::DeviceTable::SetCaptureVolume(Handle handle, uint16_t volume)
+{
+    devices_[slotOfHandle_[handle]].SetCurrentCaptureVolume(volume);
+    columns_.SetCaptureVolume(handle, volume);
+}
+
+void ed::audio::DeviceTable::SetRenderDefault(Handle handle, bool isDefault)
+{
+    devices_[slotOfHandle_[handle]].SetRenderCurrentlyDefault(isDefault);
+    columns_.SetRenderDefault(handle, isDefault);
+    index_.SetRenderDefault(handle, isDefault);
+}
+
+void ed::audio::DeviceTable::SetCaptureDefault(Handle handle, bool isDefault)
+{
+    devices_[slotOfHandle_[handle]].SetCaptureCurrentlyDefault(isDefault);
+    columns_.SetCaptureDefault(handle, isDefault);
+    index_.SetCaptureDefault(handle, isDefault);
+}
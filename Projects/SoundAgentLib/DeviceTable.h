@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "DeviceIndex.h"
+#include "DeviceStateColumns.h"
+#include "SoundDevice.h"
+#include "StringInterner.h"
+
+
+namespace ed::audio {
+// The devices of a collection, in a dense array of slots. A device is found by the handle of its PnP id,
+// interned once, through an array indexed by handle: no string is compared after the PnP id has been interned.
+// Removal moves the last device into the freed slot, so the order of the slots is arbitrary.
+// The hot state of the devices is mirrored in columns by handle, and their flow, form factor, default roles and
+// names in a DeviceIndex, so the devices change through the setters only.
+// Copies share the interner, so the devices of a copy taken before a change have the same handles.
+// The arrays are allocated from the given memory resource, e.g. an arena dropped with the table; a copy uses the
+// default resource. They grow past their largest size only, so an arena under a long-lived table stays bounded.
+class DeviceTable final {
+public:
+    using Handle = StringInterner::Id;
+
+public:
+    // The interner must outlive the table and its copies, the resource the table.
+    explicit DeviceTable(StringInterner & pnpIds, std::pmr::memory_resource * resource = std::pmr::get_default_resource());
+
+public:
+    [[nodiscard]] size_t GetSize() const { return devices_.size(); }
+    [[nodiscard]] const SoundDevice & GetAt(size_t index) const { return devices_[index]; }
+    [[nodiscard]] Handle GetHandleAt(size_t index) const { return handles_[index]; }
+    [[nodiscard]] const std::pmr::vector<SoundDevice> & GetDevices() const { return devices_; }
+
+    [[nodiscard]] const DeviceStateColumns & GetStateColumns() const { return columns_; }
+
+    // Nothing if the table has no device with the PnP id. Does not intern.
+    [[nodiscard]] std::optional<Handle> FindHandle(std::string_view pnpId) const;
+    [[nodiscard]] const SoundDevice * Find(Handle handle) const;
+    [[nodiscard]] const SoundDevice * Find(std::string_view pnpId) const;
+    // Into handles, ascending: the devices matching the query, found through the index. Allocates nothing once
+    // handles has grown to the number of candidates.
+    void Find(const DeviceQuery & query, std::vector<Handle> & handles) const;
+
+    // Adds the device, or replaces the one with its PnP id.
+    Handle Put(const SoundDevice & device);
+    // False if there is no such device.
+    bool Erase(Handle handle);
+    void Clear();
+
+    // The device must be in the table.
+    void SetRenderVolume(Handle handle, uint16_t volume);
+    void SetCaptureVolume(Handle handle, uint16_t volume);
+    void SetRenderDefault(Handle handle, bool isDefault);
+    void SetCaptureDefault(Handle handle, bool isDefault);
+
+private:
+    static constexpr uint32_t no_slot = UINT32_MAX;
+
+    StringInterner * pnpIds_;
+    std::pmr::vector<SoundDevice> devices_;
+    // the handle of the device in the same slot
+    std::pmr::vector<Handle> handles_;
+    // indexed by handle
+    std::pmr::vector<uint32_t> slotOfHandle_;
+    DeviceStateColumns columns_;
+    DeviceIndex index_;
+};
+}
@@ -0,0 +1,894 @@
+#include "os-dependencies.h"
+
+#include "EndpointSimulator.h"
+
+#include "IdentifierText.h"
+
+#include <endpointvolume.h>
+#include <Functiondiscoverykeys_devpkey.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+    // Deterministic container GUID, so the same key always yields the same PnP id.
+    GUID ContainerKeyToGuid(const std::wstring & containerKey)
+    {
+        uint64_t hashes[2] = { 14695981039346656037ULL, 1099511628211ULL * 31 };
+        for (auto & hash : hashes)
+        {
+            for (const wchar_t c : containerKey)
+            {
+                hash ^= static_cast<uint64_t>(c);
+                hash *= 1099511628211ULL;
+            }
+        }
+        GUID guid;
+        static_assert(sizeof(guid) == sizeof(hashes));
+        std::memcpy(&guid, hashes, sizeof(guid));
+        return guid;
+    }
+
+    LPWSTR DuplicateAsCoTaskMem(const std::wstring & value)
+    {
+        const auto size = (value.size() + 1) * sizeof(wchar_t);
+        auto * copy = static_cast<LPWSTR>(CoTaskMemAlloc(size));
+        if (copy != nullptr)
+        {
+            std::memcpy(copy, value.c_str(), size);
+        }
+        return copy;
+    }
+
+    bool IsKey(REFPROPERTYKEY key, const PROPERTYKEY & expected)
+    {
+        return key.fmtid == expected.fmtid && key.pid == expected.pid;
+    }
+
+    size_t FlowIndex(EDataFlow flow)
+    {
+        return flow == eRender ? 0 : 1;
+    }
+}
+
+namespace ed::audio
+{
+    namespace
+    {
+        // One object per endpoint, serving all interfaces the collection asks an endpoint for.
+        class SimulatedEndpoint final : public IMMDevice, public IMMEndpoint, public IPropertyStore, public IAudioEndpointVolume {
+        public:
+            DISALLOW_COPY_MOVE(SimulatedEndpoint);
+            SimulatedEndpoint(std::wstring endpointId, std::wstring name, EDataFlow flow, uint16_t volume, const GUID & containerId,
+                std::shared_ptr<const std::atomic<bool>> notificationsAvailable)
+                : endpointId_(std::move(endpointId))
+                , flow_(flow)
+                , notificationsAvailable_(std::move(notificationsAvailable))
+                , name_(std::move(name))
+                , formFactor_(flow == eCapture ? Microphone : Speakers)
+                , containerId_(containerId)
+                , volume_(volume)
+            {
+            }
+            virtual ~SimulatedEndpoint() = default;
+
+            // IUnknown
+            ULONG STDMETHODCALLTYPE AddRef() override
+            {
+                return ++ref_;
+            }
+
+            ULONG STDMETHODCALLTYPE Release() override
+            {
+                const ULONG ref = --ref_;
+                if (ref == 0)
+                {
+                    delete this;
+                }
+                return ref;
+            }
+
+            HRESULT STDMETHODCALLTYPE QueryInterface(REFIID refIId, VOID ** ppvInterface) override
+            {
+                if (refIId == IID_IUnknown || refIId == __uuidof(IMMDevice))
+                {
+                    *ppvInterface = static_cast<IMMDevice*>(this);
+                }
+                else if (refIId == __uuidof(IMMEndpoint))
+                {
+                    *ppvInterface = static_cast<IMMEndpoint*>(this);
+                }
+                else if (refIId == __uuidof(IPropertyStore))
+                {
+                    *ppvInterface = static_cast<IPropertyStore*>(this);
+                }
+                else if (refIId == __uuidof(IAudioEndpointVolume))
+                {
+                    *ppvInterface = static_cast<IAudioEndpointVolume*>(this);
+                }
+                else
+                {
+                    *ppvInterface = nullptr;
+                    return E_NOINTERFACE;
+                }
+                AddRef();
+                return S_OK;
+            }
+
+            // IMMDevice
+            HRESULT STDMETHODCALLTYPE Activate(REFIID iid, DWORD, PROPVARIANT *, void ** ppInterface) override
+            {
+                if (iid != __uuidof(IAudioEndpointVolume))
+                {
+                    *ppInterface = nullptr;
+                    return E_NOINTERFACE;
+                }
+                return QueryInterface(iid, ppInterface);
+            }
+
+            HRESULT STDMETHODCALLTYPE OpenPropertyStore(DWORD, IPropertyStore ** ppProperties) override
+            {
+                AddRef();
+                *ppProperties = this;
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetId(LPWSTR * ppStrId) override
+            {
+                *ppStrId = DuplicateAsCoTaskMem(endpointId_);
+                return *ppStrId != nullptr ? S_OK : E_OUTOFMEMORY;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetState(DWORD * pdwState) override
+            {
+                *pdwState = IsActive() ? DEVICE_STATE_ACTIVE : DEVICE_STATE_NOTPRESENT;
+                return S_OK;
+            }
+
+            // IMMEndpoint
+            HRESULT STDMETHODCALLTYPE GetDataFlow(EDataFlow * pDataFlow) override
+            {
+                *pDataFlow = flow_;
+                return S_OK;
+            }
+
+            // IPropertyStore, read-only
+            HRESULT STDMETHODCALLTYPE GetCount(DWORD * cProps) override
+            {
+                *cProps = 3;
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetAt(DWORD, PROPERTYKEY *) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetValue(REFPROPERTYKEY key, PROPVARIANT * pv) override
+            {
+                PropVariantInit(pv);
+                if (IsKey(key, PKEY_Device_FriendlyName))
+                {
+                    std::lock_guard lock(mutex_);
+                    pv->vt = VT_LPWSTR;
+                    pv->pwszVal = DuplicateAsCoTaskMem(name_);
+                }
+                else if (IsKey(key, PKEY_AudioEndpoint_FormFactor))
+                {
+                    std::lock_guard lock(mutex_);
+                    pv->vt = VT_UI4;
+                    pv->ulVal = formFactor_;
+                }
+                else if (IsKey(key, PKEY_Device_ContainerId))
+                {
+                    std::lock_guard lock(mutex_);
+                    pv->vt = VT_CLSID;
+                    pv->puuid = static_cast<CLSID*>(CoTaskMemAlloc(sizeof(CLSID)));
+                    if (pv->puuid == nullptr)
+                    {
+                        pv->vt = VT_EMPTY;
+                        return E_OUTOFMEMORY;
+                    }
+                    *pv->puuid = containerId_;
+                }
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE SetValue(REFPROPERTYKEY, REFPROPVARIANT) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE Commit() override
+            {
+                return E_NOTIMPL;
+            }
+
+            // IAudioEndpointVolume: master volume and mute only
+            HRESULT STDMETHODCALLTYPE RegisterControlChangeNotify(IAudioEndpointVolumeCallback * pNotify) override
+            {
+                if (!notificationsAvailable_->load())
+                {
+                    return E_ACCESSDENIED;
+                }
+                std::lock_guard lock(mutex_);
+                if (std::ranges::find(*volumeCallbacks_, pNotify) == volumeCallbacks_->end())
+                {
+                    auto callbacks = std::make_shared<std::vector<IAudioEndpointVolumeCallback*>>(*volumeCallbacks_);
+                    callbacks->push_back(pNotify);
+                    volumeCallbacks_ = std::move(callbacks);
+                }
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE UnregisterControlChangeNotify(IAudioEndpointVolumeCallback * pNotify) override
+            {
+                std::lock_guard lock(mutex_);
+                auto callbacks = std::make_shared<std::vector<IAudioEndpointVolumeCallback*>>(*volumeCallbacks_);
+                std::erase(*callbacks, pNotify);
+                volumeCallbacks_ = std::move(callbacks);
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetChannelCount(UINT * pnChannelCount) override
+            {
+                *pnChannelCount = 1;
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE SetMasterVolumeLevel(float, LPCGUID) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE SetMasterVolumeLevelScalar(float fLevel, LPCGUID pguidEventContext) override
+            {
+                SetVolume(static_cast<uint16_t>(std::clamp(fLevel, 0.0f, 1.0f) * 1000.0f + 0.5f),
+                    pguidEventContext != nullptr ? *pguidEventContext : GUID{});
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetMasterVolumeLevel(float *) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetMasterVolumeLevelScalar(float * pfLevel) override
+            {
+                std::lock_guard lock(mutex_);
+                *pfLevel = static_cast<float>(volume_) / 1000.0f;
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE SetChannelVolumeLevel(UINT, float, LPCGUID) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE SetChannelVolumeLevelScalar(UINT, float, LPCGUID) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetChannelVolumeLevel(UINT, float *) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetChannelVolumeLevelScalar(UINT, float *) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE SetMute(BOOL bMute, LPCGUID pguidEventContext) override
+            {
+                std::unique_lock lock(mutex_);
+                const bool muted = bMute != FALSE;
+                if (muted == muted_)
+                {
+                    // unchanged: the OS returns S_FALSE and notifies nothing
+                    return S_FALSE;
+                }
+                muted_ = muted;
+                const auto volume = volume_;
+                lock.unlock();
+                Notify(volume, muted, pguidEventContext != nullptr ? *pguidEventContext : GUID{});
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetMute(BOOL * pbMute) override
+            {
+                std::lock_guard lock(mutex_);
+                *pbMute = muted_ ? TRUE : FALSE;
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetVolumeStepInfo(UINT *, UINT *) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE VolumeStepUp(LPCGUID) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE VolumeStepDown(LPCGUID) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE QueryHardwareSupport(DWORD *) override
+            {
+                return E_NOTIMPL;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetVolumeRange(float *, float *, float *) override
+            {
+                return E_NOTIMPL;
+            }
+
+        public:
+            [[nodiscard]] const std::wstring & GetEndpointId() const { return endpointId_; }
+            [[nodiscard]] EDataFlow GetFlow() const { return flow_; }
+            [[nodiscard]] bool IsActive() const { return active_; }
+            void SetActive(bool active) { active_ = active; }
+
+            void SetName(std::wstring name)
+            {
+                std::lock_guard lock(mutex_);
+                name_ = std::move(name);
+            }
+
+            void SetFormFactor(EndpointFormFactor formFactor)
+            {
+                std::lock_guard lock(mutex_);
+                formFactor_ = formFactor;
+            }
+
+            void SetContainerId(const GUID & containerId)
+            {
+                std::lock_guard lock(mutex_);
+                containerId_ = containerId;
+            }
+
+            // Notifies the registered volume callbacks, like the OS after a volume change; eventContext is passed
+            // on to them, as the OS does for the context of the caller that changed it.
+            void SetVolume(uint16_t volume, const GUID & eventContext = {})
+            {
+                bool muted;
+                {
+                    std::lock_guard lock(mutex_);
+                    volume_ = volume;
+                    muted = muted_;
+                }
+                Notify(volume, muted, eventContext);
+            }
+
+        private:
+            void Notify(uint16_t volume, bool muted, const GUID & eventContext) const
+            {
+                std::shared_ptr<const std::vector<IAudioEndpointVolumeCallback*>> callbacks;
+                {
+                    std::lock_guard lock(mutex_);
+                    callbacks = volumeCallbacks_;
+                }
+                AUDIO_VOLUME_NOTIFICATION_DATA data{};
+                data.guidEventContext = eventContext;
+                data.bMuted = muted ? TRUE : FALSE;
+                data.fMasterVolume = static_cast<float>(volume) / 1000.0f;
+                data.nChannels = 1;
+                data.afChannelVolumes[0] = data.fMasterVolume;
+                for (auto * callback : *callbacks)
+                {
+                    // ReSharper disable once CppFunctionResultShouldBeUsed
+                    callback->OnNotify(&data);
+                }
+            }
+
+        private:
+            std::atomic<ULONG> ref_ = 1;
+            const std::wstring endpointId_;
+            const EDataFlow flow_;
+            const std::shared_ptr<const std::atomic<bool>> notificationsAvailable_;
+            std::atomic<bool> active_ = true;
+
+            // guards the properties, the volume and the callbacks
+            mutable std::mutex mutex_;
+            std::wstring name_;
+            EndpointFormFactor formFactor_;
+            GUID containerId_;
+            uint16_t volume_;
+            // kept apart from the volume, as on Windows: unmuting restores the level
+            bool muted_ = false;
+            // replaced on each change, so that a volume change takes a reference instead of a copy
+            std::shared_ptr<const std::vector<IAudioEndpointVolumeCallback*>> volumeCallbacks_ =
+                std::make_shared<const std::vector<IAudioEndpointVolumeCallback*>>();
+        };
+
+        // Result of EnumAudioEndpoints: holds a reference on each endpoint.
+        class SimulatedEndpointCollection final : public IMMDeviceCollection {
+        public:
+            DISALLOW_COPY_MOVE(SimulatedEndpointCollection);
+            explicit SimulatedEndpointCollection(std::vector<SimulatedEndpoint*> endpoints)
+                : endpoints_(std::move(endpoints))
+            {
+            }
+            virtual ~SimulatedEndpointCollection()
+            {
+                for (auto * endpoint : endpoints_)
+                {
+                    endpoint->Release();
+                }
+            }
+
+            ULONG STDMETHODCALLTYPE AddRef() override
+            {
+                return ++ref_;
+            }
+
+            ULONG STDMETHODCALLTYPE Release() override
+            {
+                const ULONG ref = --ref_;
+                if (ref == 0)
+                {
+                    delete this;
+                }
+                return ref;
+            }
+
+            HRESULT STDMETHODCALLTYPE QueryInterface(REFIID refIId, VOID ** ppvInterface) override
+            {
+                if (refIId == IID_IUnknown || refIId == __uuidof(IMMDeviceCollection))
+                {
+                    AddRef();
+                    *ppvInterface = static_cast<IMMDeviceCollection*>(this);
+                    return S_OK;
+                }
+                *ppvInterface = nullptr;
+                return E_NOINTERFACE;
+            }
+
+            HRESULT STDMETHODCALLTYPE GetCount(UINT * pcDevices) override
+            {
+                *pcDevices = static_cast<UINT>(endpoints_.size());
+                return S_OK;
+            }
+
+            HRESULT STDMETHODCALLTYPE Item(UINT nDevice, IMMDevice ** ppDevice) override
+            {
+                if (nDevice >= endpoints_.size())
+                {
+                    *ppDevice = nullptr;
+                    return E_INVALIDARG;
+                }
+                endpoints_[nDevice]->AddRef();
+                *ppDevice = endpoints_[nDevice];
+                return S_OK;
+            }
+
+        private:
+            std::atomic<ULONG> ref_ = 1;
+            std::vector<SimulatedEndpoint*> endpoints_;
+        };
+    }
+
+    class SimulatedEnumerator final : public IMMDeviceEnumerator {
+    public:
+        DISALLOW_COPY_MOVE(SimulatedEnumerator);
+        SimulatedEnumerator() = default;
+        virtual ~SimulatedEnumerator()
+        {
+            for (auto * endpoint : endpoints_ | std::views::values)
+            {
+                endpoint->Release();
+            }
+        }
+
+        // IUnknown
+        ULONG STDMETHODCALLTYPE AddRef() override
+        {
+            return ++ref_;
+        }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            const ULONG ref = --ref_;
+            if (ref == 0)
+            {
+                delete this;
+            }
+            return ref;
+        }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID refIId, VOID ** ppvInterface) override
+        {
+            if (refIId == IID_IUnknown || refIId == __uuidof(IMMDeviceEnumerator))
+            {
+                AddRef();
+                *ppvInterface = static_cast<IMMDeviceEnumerator*>(this);
+                return S_OK;
+            }
+            *ppvInterface = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        // IMMDeviceEnumerator
+        HRESULT STDMETHODCALLTYPE EnumAudioEndpoints(EDataFlow dataFlow, DWORD dwStateMask, IMMDeviceCollection ** ppDevices) override
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(enumerationLatencyMs_.load()));
+            std::vector<SimulatedEndpoint*> selected;
+            {
+                std::lock_guard lock(mutex_);
+                for (auto * endpoint : endpoints_ | std::views::values)
+                {
+                    const DWORD state = endpoint->IsActive() ? DEVICE_STATE_ACTIVE : DEVICE_STATE_NOTPRESENT;
+                    if ((dataFlow == eAll || dataFlow == endpoint->GetFlow()) && (state & dwStateMask) != 0)
+                    {
+                        endpoint->AddRef();
+                        selected.push_back(endpoint);
+                    }
+                }
+            }
+            *ppDevices = new SimulatedEndpointCollection(std::move(selected));
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE GetDefaultAudioEndpoint(EDataFlow dataFlow, ERole, IMMDevice ** ppEndpoint) override
+        {
+            std::lock_guard lock(mutex_);
+            *ppEndpoint = nullptr;
+            if (dataFlow != eRender && dataFlow != eCapture)
+            {
+                return E_INVALIDARG;
+            }
+            const auto & defaultId = defaultEndpointIds_[FlowIndex(dataFlow)];
+            if (!defaultId.has_value())
+            {
+                return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+            }
+            auto * endpoint = endpoints_.at(*defaultId);
+            endpoint->AddRef();
+            *ppEndpoint = endpoint;
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE GetDevice(LPCWSTR pwstrId, IMMDevice ** ppDevice) override
+        {
+            std::lock_guard lock(mutex_);
+            *ppDevice = nullptr;
+            const auto foundPair = endpoints_.find(pwstrId);
+            if (foundPair == endpoints_.end())
+            {
+                return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+            }
+            foundPair->second->AddRef();
+            *ppDevice = foundPair->second;
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE RegisterEndpointNotificationCallback(IMMNotificationClient * pClient) override
+        {
+            if (!notificationsAvailable_->load())
+            {
+                return E_ACCESSDENIED;
+            }
+            std::lock_guard lock(mutex_);
+            if (std::ranges::find(clients_, pClient) == clients_.end())
+            {
+                clients_.push_back(pClient);
+            }
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE UnregisterEndpointNotificationCallback(IMMNotificationClient * pClient) override
+        {
+            std::lock_guard lock(mutex_);
+            std::erase(clients_, pClient);
+            return S_OK;
+        }
+
+    public:
+        bool AddEndpoint(const std::wstring & endpointId, const std::wstring & name, EDataFlow flow, uint16_t volume,
+            const std::wstring & containerKey)
+        {
+            if (flow != eRender && flow != eCapture)
+            {
+                return false;
+            }
+            std::lock_guard notificationLock(notificationMutex_);
+            {
+                std::lock_guard lock(mutex_);
+                if (const auto foundPair = endpoints_.find(endpointId)
+                    ; foundPair != endpoints_.end())
+                {
+                    auto * endpoint = foundPair->second;
+                    if (endpoint->IsActive() || endpoint->GetFlow() != flow)
+                    {
+                        return false;
+                    }
+                    endpoint->SetName(name);
+                    endpoint->SetActive(true);
+                }
+                else
+                {
+                    endpoints_.emplace(endpointId, new SimulatedEndpoint(endpointId, name, flow, volume,
+                        ContainerKeyToGuid(containerKey.empty() ? endpointId : containerKey), notificationsAvailable_));
+                }
+            }
+            for (auto * client : GetClients())
+            {
+                // ReSharper disable once CppFunctionResultShouldBeUsed
+                client->OnDeviceStateChanged(endpointId.c_str(), DEVICE_STATE_ACTIVE);
+            }
+            if (volume != GetVolumeOf(endpointId))
+            {
+                SetVolumeNotifying(endpointId, volume);
+            }
+            return true;
+        }
+
+        bool RemoveEndpoint(const std::wstring & endpointId)
+        {
+            std::lock_guard notificationLock(notificationMutex_);
+            std::optional<EDataFlow> defaultFlowLost;
+            {
+                std::lock_guard lock(mutex_);
+                const auto foundPair = endpoints_.find(endpointId);
+                if (foundPair == endpoints_.end() || !foundPair->second->IsActive())
+                {
+                    return false;
+                }
+                foundPair->second->SetActive(false);
+                if (auto & defaultId = defaultEndpointIds_[FlowIndex(foundPair->second->GetFlow())]
+                    ; defaultId == endpointId)
+                {
+                    defaultId.reset();
+                    defaultFlowLost = foundPair->second->GetFlow();
+                }
+            }
+            const auto clients = GetClients();
+            for (auto * client : clients)
+            {
+                // ReSharper disable once CppFunctionResultShouldBeUsed
+                client->OnDeviceStateChanged(endpointId.c_str(), DEVICE_STATE_NOTPRESENT);
+            }
+            if (defaultFlowLost.has_value())
+            {
+                NotifyDefaultChanged(clients, *defaultFlowLost, nullptr);
+            }
+            return true;
+        }
+
+        bool SetDefaultEndpoint(const std::wstring & endpointId)
+        {
+            std::lock_guard notificationLock(notificationMutex_);
+            EDataFlow flow;
+            {
+                std::lock_guard lock(mutex_);
+                const auto foundPair = endpoints_.find(endpointId);
+                if (foundPair == endpoints_.end() || !foundPair->second->IsActive())
+                {
+                    return false;
+                }
+                flow = foundPair->second->GetFlow();
+                defaultEndpointIds_[FlowIndex(flow)] = endpointId;
+            }
+            NotifyDefaultChanged(GetClients(), flow, endpointId.c_str());
+            return true;
+        }
+
+        bool SetVolume(const std::wstring & endpointId, uint16_t volume)
+        {
+            std::lock_guard notificationLock(notificationMutex_);
+            return SetVolumeNotifying(endpointId, volume);
+        }
+
+        // Changes a property of an active endpoint with change, then notifies the key.
+        template <typename ChangeT>
+        bool ChangeProperty(const std::wstring & endpointId, const PROPERTYKEY & key, ChangeT && change)
+        {
+            std::lock_guard notificationLock(notificationMutex_);
+            {
+                std::lock_guard lock(mutex_);
+                const auto foundPair = endpoints_.find(endpointId);
+                if (foundPair == endpoints_.end() || !foundPair->second->IsActive())
+                {
+                    return false;
+                }
+                change(*foundPair->second);
+            }
+            for (auto * client : GetClients())
+            {
+                // ReSharper disable once CppFunctionResultShouldBeUsed
+                client->OnPropertyValueChanged(endpointId.c_str(), key);
+            }
+            return true;
+        }
+
+        void SetEnumerationLatency(std::chrono::milliseconds latency)
+        {
+            enumerationLatencyMs_ = latency.count();
+        }
+
+        void SetNotificationsAvailable(bool available)
+        {
+            *notificationsAvailable_ = available;
+        }
+
+        // The level, kept while muted; 0 if the endpoint is unknown.
+        uint16_t GetVolumeOf(const std::wstring & endpointId)
+        {
+            IMMDevice * device = nullptr;
+            if (FAILED(GetDevice(endpointId.c_str(), &device)))
+            {
+                return 0;
+            }
+            float level = 0.0f;
+            // ReSharper disable once CppFunctionResultShouldBeUsed
+            static_cast<SimulatedEndpoint*>(device)->GetMasterVolumeLevelScalar(&level);
+            device->Release();
+            return static_cast<uint16_t>(level * 1000.0f + 0.5f);
+        }
+
+        bool IsMuted(const std::wstring & endpointId)
+        {
+            IMMDevice * device = nullptr;
+            if (FAILED(GetDevice(endpointId.c_str(), &device)))
+            {
+                return false;
+            }
+            BOOL muted = FALSE;
+            // ReSharper disable once CppFunctionResultShouldBeUsed
+            static_cast<SimulatedEndpoint*>(device)->GetMute(&muted);
+            device->Release();
+            return muted != FALSE;
+        }
+
+    private:
+        // Must be called with notificationMutex_ held.
+        bool SetVolumeNotifying(const std::wstring & endpointId, uint16_t volume)
+        {
+            SimulatedEndpoint * endpoint;
+            {
+                std::lock_guard lock(mutex_);
+                const auto foundPair = endpoints_.find(endpointId);
+                if (foundPair == endpoints_.end() || !foundPair->second->IsActive())
+                {
+                    return false;
+                }
+                endpoint = foundPair->second;
+                endpoint->AddRef();
+            }
+            endpoint->SetVolume(std::min<uint16_t>(volume, 1000));
+            endpoint->Release();
+            return true;
+        }
+
+        std::vector<IMMNotificationClient*> GetClients() const
+        {
+            std::lock_guard lock(mutex_);
+            return clients_;
+        }
+
+        static void NotifyDefaultChanged(const std::vector<IMMNotificationClient*> & clients, EDataFlow flow, LPCWSTR endpointId)
+        {
+            for (auto * client : clients)
+            {
+                for (const auto role : { eConsole, eMultimedia })
+                {
+                    // ReSharper disable once CppFunctionResultShouldBeUsed
+                    client->OnDefaultDeviceChanged(flow, role, endpointId);
+                }
+            }
+        }
+
+    private:
+        std::atomic<ULONG> ref_ = 1;
+        std::atomic<int64_t> enumerationLatencyMs_ = 0;
+        // shared with the endpoints, which the collection may keep beyond the enumerator
+        std::shared_ptr<std::atomic<bool>> notificationsAvailable_ = std::make_shared<std::atomic<bool>>(true);
+
+        // serializes notifications, as the OS raises them on one thread; taken before mutex_
+        std::mutex notificationMutex_;
+        // guards the endpoint map, the defaults and the clients; never held while notifying
+        mutable std::mutex mutex_;
+        std::map<std::wstring, SimulatedEndpoint*> endpoints_;
+        std::optional<std::wstring> defaultEndpointIds_[2];
+        std::vector<IMMNotificationClient*> clients_;
+    };
+}
+
+ed::audio::EndpointSimulator::EndpointSimulator()
+    : enumerator_(new SimulatedEnumerator())
+{
+}
+
+ed::audio::EndpointSimulator::~EndpointSimulator()
+{
+    enumerator_->Release();
+}
+
+IMMDeviceEnumerator * ed::audio::EndpointSimulator::GetEnumerator() const
+{
+    return enumerator_;
+}
+
+bool ed::audio::EndpointSimulator::AddEndpoint(const std::wstring & endpointId, const std::wstring & name, EDataFlow flow,
+    uint16_t volume, const std::wstring & containerKey)
+{
+    return enumerator_->AddEndpoint(endpointId, name, flow, volume, containerKey);
+}
+
+bool ed::audio::EndpointSimulator::RemoveEndpoint(const std::wstring & endpointId)
+{
+    return enumerator_->RemoveEndpoint(endpointId);
+}
+
+bool ed::audio::EndpointSimulator::SetDefaultEndpoint(const std::wstring & endpointId)
+{
+    return enumerator_->SetDefaultEndpoint(endpointId);
+}
+
+bool ed::audio::EndpointSimulator::SetVolume(const std::wstring & endpointId, uint16_t volume)
+{
+    return enumerator_->SetVolume(endpointId, volume);
+}
+
+uint16_t ed::audio::EndpointSimulator::GetVolume(const std::wstring & endpointId) const
+{
+    return enumerator_->GetVolumeOf(endpointId);
+}
+
+bool ed::audio::EndpointSimulator::IsMuted(const std::wstring & endpointId) const
+{
+    return enumerator_->IsMuted(endpointId);
+}
+
+bool ed::audio::EndpointSimulator::SetName(const std::wstring & endpointId, const std::wstring & name)
+{
+    return enumerator_->ChangeProperty(endpointId, PKEY_Device_FriendlyName,
+        [&name](SimulatedEndpoint & endpoint) { endpoint.SetName(name); });
+}
+
+bool ed::audio::EndpointSimulator::SetFormFactor(const std::wstring & endpointId, EndpointFormFactor formFactor)
+{
+    return enumerator_->ChangeProperty(endpointId, PKEY_AudioEndpoint_FormFactor,
+        [formFactor](SimulatedEndpoint & endpoint) { endpoint.SetFormFactor(formFactor); });
+}
+
+bool ed::audio::EndpointSimulator::SetContainer(const std::wstring & endpointId, const std::wstring & containerKey)
+{
+    return enumerator_->ChangeProperty(endpointId, PKEY_Device_ContainerId,
+        [&](SimulatedEndpoint & endpoint) { endpoint.SetContainerId(ContainerKeyToGuid(containerKey.empty() ? endpointId : containerKey)); });
+}
+
+bool ed::audio::EndpointSimulator::NotifyPropertyValueChanged(const std::wstring & endpointId, const PROPERTYKEY & key)
+{
+    return enumerator_->ChangeProperty(endpointId, key, [](SimulatedEndpoint &) {});
+}
+
+void ed::audio::EndpointSimulator::SetEnumerationLatency(std::chrono::milliseconds latency)
+{
+    enumerator_->SetEnumerationLatency(latency);
+}
+
+void ed::audio::EndpointSimulator::SetNotificationsAvailable(bool available)
+{
+    enumerator_->SetNotificationsAvailable(available);
+}
+
+std::string ed::audio::EndpointSimulator::GetPnpIdOfContainer(const std::wstring & containerKey)
+{
+    return IdentifierText::FormatGuid(ContainerKeyToGuid(containerKey));
+}
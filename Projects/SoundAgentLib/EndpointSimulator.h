@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <mmdeviceapi.h>
+#include <string>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+
+namespace ed::audio {
+class SimulatedEnumerator;
+
+// In-process stand-in for the Windows audio endpoint stack: an IMMDeviceEnumerator over simulated endpoints
+// that raises IMMNotificationClient / IAudioEndpointVolumeCallback notifications the way the OS does,
+// synchronously on the thread that changes the simulated state. Notifications are serialized.
+// Lets an unchanged SoundDeviceCollection run without audio hardware, e.g. for load tests.
+// Changes must not overlap with the destruction of a collection using the enumerator.
+class EndpointSimulator final {
+public:
+    DISALLOW_COPY_MOVE(EndpointSimulator);
+    EndpointSimulator();
+    ~EndpointSimulator();
+
+public:
+    // Not AddRef'ed: the caller AddRef's it to keep it beyond the simulator's lifetime.
+    [[nodiscard]] IMMDeviceEnumerator * GetEnumerator() const;
+
+    // Adds an active endpoint or re-activates a removed one. Volume: 0 to 1000.
+    // Endpoints with the same containerKey form one device (PnP id), like render and capture of a headset;
+    // an empty containerKey gives the endpoint its own.
+    bool AddEndpoint(const std::wstring & endpointId, const std::wstring & name, EDataFlow flow, uint16_t volume,
+        const std::wstring & containerKey = {});
+    // The endpoint becomes "not present" and stays retrievable by its id, as on Windows.
+    // If it was a default endpoint, its flow has no default afterward.
+    bool RemoveEndpoint(const std::wstring & endpointId);
+    // Makes an active endpoint the console and multimedia default of its flow.
+    bool SetDefaultEndpoint(const std::wstring & endpointId);
+    bool SetVolume(const std::wstring & endpointId, uint16_t volume);
+    // As the endpoint has it, whether set here or through its IAudioEndpointVolume. The level is kept while muted.
+    // Changes through the interface notify on the calling thread, with the caller's event context.
+    [[nodiscard]] uint16_t GetVolume(const std::wstring & endpointId) const;
+    [[nodiscard]] bool IsMuted(const std::wstring & endpointId) const;
+    // Change a property of an active endpoint and notify the change through OnPropertyValueChanged, as the OS does after
+    // a rename in the sound settings or a driver update. A new containerKey moves the endpoint to that device.
+    bool SetName(const std::wstring & endpointId, const std::wstring & name);
+    bool SetFormFactor(const std::wstring & endpointId, EndpointFormFactor formFactor);
+    bool SetContainer(const std::wstring & endpointId, const std::wstring & containerKey);
+    // Notifies a change of the key without changing anything, like the many the OS raises for properties
+    // the collection does not read.
+    bool NotifyPropertyValueChanged(const std::wstring & endpointId, const PROPERTYKEY & key);
+    // Makes every enumeration of the endpoints take this long, like a slow audio service at system start.
+    void SetEnumerationLatency(std::chrono::milliseconds latency);
+    // Without notifications, the enumerator and the endpoints refuse callbacks with E_ACCESSDENIED, like a locked-down
+    // host; changes go unnotified. Applies to registrations made afterward.
+    void SetNotificationsAvailable(bool available);
+
+    // PnP id the collection derives from an endpoint's container, for the simulator's clients to match devices.
+    [[nodiscard]] static std::string GetPnpIdOfContainer(const std::wstring & containerKey);
+
+private:
+    SimulatedEnumerator * enumerator_;
+};
+}
@@ -0,0 +1,193 @@
+#include "os-dependencies.h"
+
+#include "EventChannel.h"
+
+#include <algorithm>
+#include <bit>
+
+
+ed::audio::EventChannel::EventChannel(size_t capacity)
+    : mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1)
+    , slots_(std::make_unique<Slot[]>(mask_ + 1))
+{
+}
+
+ed::audio::EventChannel::~EventChannel() = default;
+
+void ed::audio::EventChannel::OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion)
+{
+    // resolved here once, so that consumers read it without a lock
+    const auto pnpId = devicePnpId.empty() ? std::string_view() : pnpIds_.Resolve(pnpIds_.Intern(devicePnpId));
+    const auto position = published_.load(std::memory_order_relaxed);
+
+    // a sequence lock: readers of the slot check that the sequence has not changed while they read
+    auto & slot = slots_[position & mask_];
+    slot.Sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.Type.store(event, std::memory_order_relaxed);
+    slot.DevicePnpIdData.store(pnpId.data(), std::memory_order_relaxed);
+    slot.DevicePnpIdSize.store(pnpId.size(), std::memory_order_relaxed);
+    slot.StateVersion.store(stateVersion, std::memory_order_relaxed);
+    slot.Sequence.store(2 * position + 2, std::memory_order_release);
+
+    latestStateVersion_.store(stateVersion, std::memory_order_relaxed);
+    // sequentially consistent, like the waiter of a consumer: either the consumer sees the event, or this sees the waiter
+    published_.store(position + 1, std::memory_order_seq_cst);
+    WakeUpConsumers();
+}
+
+std::unique_ptr<ed::audio::EventChannel::Consumer> ed::audio::EventChannel::Connect(ExecutorT executor)
+{
+    std::lock_guard lock(consumersMutex_);
+    auto consumer = std::make_unique<Consumer>(*this, std::move(executor), published_.load(std::memory_order_acquire));
+    consumers_.push_back(consumer.get());
+    return consumer;
+}
+
+bool ed::audio::EventChannel::TryRead(uint64_t position, SoundDeviceEvent & event) const
+{
+    const auto & slot = slots_[position & mask_];
+    const auto sequence = slot.Sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * position + 2)
+    {
+        return false;
+    }
+    const auto type = slot.Type.load(std::memory_order_relaxed);
+    const auto pnpIdData = slot.DevicePnpIdData.load(std::memory_order_relaxed);
+    const auto pnpIdSize = slot.DevicePnpIdSize.load(std::memory_order_relaxed);
+    const auto stateVersion = slot.StateVersion.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.Sequence.load(std::memory_order_relaxed) != sequence)
+    {
+        return false;
+    }
+
+    event.Type = type;
+    event.DevicePnpId.assign(pnpIdData == nullptr ? "" : pnpIdData, pnpIdSize);
+    event.StateVersion = stateVersion;
+    return true;
+}
+
+void ed::audio::EventChannel::WakeUpConsumers()
+{
+    {
+        std::lock_guard lock(consumersMutex_);
+        for (const auto consumer : consumers_)
+        {
+            if (const auto handle = consumer->TakeWaiter())
+            {
+                wakeUps_.emplace_back(consumer, handle);
+            }
+        }
+    }
+    // Outside the lock: an executor may resume inline, and the coroutine disconnect.
+    // A consumer stays while its coroutine is suspended.
+    for (const auto & [consumer, handle] : wakeUps_)
+    {
+        consumer->executor_(handle);
+    }
+    wakeUps_.clear();
+}
+
+void ed::audio::EventChannel::Disconnect(const Consumer & consumer)
+{
+    std::lock_guard lock(consumersMutex_);
+    std::erase(consumers_, &consumer);
+}
+
+
+ed::audio::EventChannel::Consumer::Consumer(EventChannel & channel, ExecutorT executor, uint64_t position)
+    : channel_(channel)
+    , executor_(std::move(executor))
+    , position_(position)
+{
+}
+
+ed::audio::EventChannel::Consumer::~Consumer()
+{
+    channel_.Disconnect(*this);
+}
+
+ed::audio::AsyncGenerator<std::vector<ed::audio::SoundDeviceEvent>> ed::audio::EventChannel::Consumer::ChangeSets()
+{
+    for (;;)
+    {
+        co_yield co_await NextChangeSet();
+    }
+}
+
+ed::audio::EventChannel::Consumer::Statistics ed::audio::EventChannel::Consumer::GetStatistics() const
+{
+    return { received_.load(std::memory_order_relaxed), overruns_.load(std::memory_order_relaxed) };
+}
+
+bool ed::audio::EventChannel::Consumer::IsEventAvailable() const
+{
+    return position_ < channel_.published_.load(std::memory_order_acquire);
+}
+
+bool ed::audio::EventChannel::Consumer::Suspend(std::coroutine_handle<> handle)
+{
+    waiter_.store(handle.address(), std::memory_order_seq_cst);
+    if (position_ < channel_.published_.load(std::memory_order_seq_cst))
+    {
+        // Published meanwhile: take the resumption back, unless the channel took it already.
+        if (void * expected = handle.address()
+            ; waiter_.compare_exchange_strong(expected, nullptr, std::memory_order_seq_cst))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::coroutine_handle<> ed::audio::EventChannel::Consumer::TakeWaiter()
+{
+    if (waiter_.load(std::memory_order_seq_cst) == nullptr)
+    {
+        return {};
+    }
+    return std::coroutine_handle<>::from_address(waiter_.exchange(nullptr, std::memory_order_seq_cst));
+}
+
+ed::audio::SoundDeviceEvent ed::audio::EventChannel::Consumer::ReadEvent()
+{
+    SoundDeviceEvent event;
+    if (channel_.published_.load(std::memory_order_acquire) - position_ > channel_.GetCapacity()
+        || !channel_.TryRead(position_, event))
+    {
+        return SkipOverwritten();
+    }
+    ++position_;
+    received_.fetch_add(1, std::memory_order_relaxed);
+    return event;
+}
+
+std::vector<ed::audio::SoundDeviceEvent> ed::audio::EventChannel::Consumer::ReadChangeSet()
+{
+    const auto end = channel_.published_.load(std::memory_order_acquire);
+    if (end - position_ > channel_.GetCapacity())
+    {
+        return { SkipOverwritten() };
+    }
+
+    std::vector<SoundDeviceEvent> events(static_cast<size_t>(end - position_));
+    for (auto & event : events)
+    {
+        if (!channel_.TryRead(position_, event))
+        {
+            // The older events are of no use either: the consumer re-reads all.
+            return { SkipOverwritten() };
+        }
+        ++position_;
+    }
+    received_.fetch_add(events.size(), std::memory_order_relaxed);
+    return events;
+}
+
+ed::audio::SoundDeviceEvent ed::audio::EventChannel::Consumer::SkipOverwritten()
+{
+    position_ = channel_.published_.load(std::memory_order_acquire);
+    overruns_.fetch_add(1, std::memory_order_relaxed);
+    return { SoundDeviceEventType::ContentReset, std::string(), channel_.latestStateVersion_.load(std::memory_order_relaxed) };
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "public/SoundAgentInterface.h"
+
+#include "AsyncGenerator.h"
+#include "StringInterner.h"
+
+
+namespace ed::audio {
+struct SoundDeviceEvent {
+    SoundDeviceEventType Type = SoundDeviceEventType::Confirmed;
+    std::string DevicePnpId;
+    uint64_t StateVersion = 0;
+};
+
+// Hands the events of a collection to coroutines: co_await consumer.NextEvent() resumes each consumer on its own
+// executor, with no thread per consumer. Subscribe the channel to a collection, and unsubscribe it, waiting for
+// running notifications, before destroying it.
+// The events go to a bounded ring, written by the notifying thread and read by every consumer at its own position
+// without locks. A consumer falling behind by more than the capacity loses the overwritten events: it gets
+// a ContentReset instead, telling it to re-read the collection.
+class EventChannel final : public SoundDeviceObserverInterface {
+public:
+    // Schedules the resumption of a consumer; called on the notifying thread, so it should only queue it.
+    using ExecutorT = std::function<void(std::coroutine_handle<>)>;
+
+    class Consumer;
+
+public:
+    DISALLOW_COPY_MOVE(EventChannel);
+    // capacity: rounded up to a power of two.
+    explicit EventChannel(size_t capacity);
+    // The consumers must be destroyed before.
+    ~EventChannel() override;
+
+public:
+    // Notifications must not overlap, as with the delivery thread of a collection.
+    void OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion) override;
+
+    // The consumer gets the events published after this call.
+    [[nodiscard]] std::unique_ptr<Consumer> Connect(ExecutorT executor);
+    [[nodiscard]] size_t GetCapacity() const { return mask_ + 1; }
+
+private:
+    struct Slot {
+        // 2 * position + 1 while the event at the position is written, 2 * position + 2 once it is
+        std::atomic<uint64_t> Sequence = 0;
+        std::atomic<SoundDeviceEventType> Type = SoundDeviceEventType::Confirmed;
+        // of a string of the interner, which stays in place
+        std::atomic<const char *> DevicePnpIdData = nullptr;
+        std::atomic<size_t> DevicePnpIdSize = 0;
+        std::atomic<uint64_t> StateVersion = 0;
+    };
+
+    // False if the event at the position has been overwritten.
+    bool TryRead(uint64_t position, SoundDeviceEvent & event) const;
+    void WakeUpConsumers();
+    void Disconnect(const Consumer & consumer);
+
+private:
+    const size_t mask_;
+    const std::unique_ptr<Slot[]> slots_;
+    // the number of events published: the position of the next one
+    std::atomic<uint64_t> published_ = 0;
+    std::atomic<uint64_t> latestStateVersion_ = 0;
+    StringInterner pnpIds_;
+
+    std::mutex consumersMutex_;
+    std::vector<Consumer *> consumers_;
+    // used by the notifying thread only
+    std::vector<std::pair<Consumer *, std::coroutine_handle<>>> wakeUps_;
+};
+
+// One reader of a channel. Await it from one coroutine at a time; do not destroy it while a coroutine awaits it.
+class EventChannel::Consumer final {
+public:
+    struct Statistics {
+        uint64_t Received = 0;
+        uint64_t Overruns = 0;
+    };
+
+    // Resumes at once if there is an event, otherwise on the executor once there is one.
+    template <typename ResultT, ResultT (Consumer::*Read)()>
+    class Awaiter {
+    public:
+        explicit Awaiter(Consumer & consumer) : consumer_(consumer) {}
+
+        bool await_ready() const { return consumer_.IsEventAvailable(); }
+        bool await_suspend(std::coroutine_handle<> handle) { return consumer_.Suspend(handle); }
+        ResultT await_resume() { return (consumer_.*Read)(); }
+
+    private:
+        Consumer & consumer_;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(Consumer);
+    Consumer(EventChannel & channel, ExecutorT executor, uint64_t position);
+    ~Consumer();
+
+public:
+    // The next event.
+    [[nodiscard]] auto NextEvent() { return Awaiter<SoundDeviceEvent, &Consumer::ReadEvent>(*this); }
+    // All events there are, at least one.
+    [[nodiscard]] auto NextChangeSet() { return Awaiter<std::vector<SoundDeviceEvent>, &Consumer::ReadChangeSet>(*this); }
+    // The change sets, one after another, endlessly.
+    [[nodiscard]] AsyncGenerator<std::vector<SoundDeviceEvent>> ChangeSets();
+
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    [[nodiscard]] bool IsEventAvailable() const;
+    // False if an event arrived meanwhile, so the coroutine goes on at once.
+    bool Suspend(std::coroutine_handle<> handle);
+    // Takes the coroutine to resume, if one waits.
+    std::coroutine_handle<> TakeWaiter();
+    SoundDeviceEvent ReadEvent();
+    std::vector<SoundDeviceEvent> ReadChangeSet();
+    SoundDeviceEvent SkipOverwritten();
+
+private:
+    friend class EventChannel;
+
+    EventChannel & channel_;
+    const ExecutorT executor_;
+    uint64_t position_;
+    std::atomic<void *> waiter_ = nullptr;
+    std::atomic<uint64_t> received_ = 0;
+    std::atomic<uint64_t> overruns_ = 0;
+};
+}
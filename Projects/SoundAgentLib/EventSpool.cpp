@@ -0,0 +1,690 @@
+#include "os-dependencies.h"
+
+#include "EventSpool.h"
+
+#include "BlockCompressor.h"
+
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+
+namespace
+{
+    // Segment file header, little endian:
+    //   u32 magic | u8 format version | u8 sealed | u16 reserved | u64 first sequence | i64 base time (ms since epoch)
+    //   | u32 record count | u32 raw bytes
+    // The counts are set in sealed segments only. An open segment is scanned for its records instead,
+    // each of them:
+    //   varint body length (never 0: the zeroes behind the last record end the segment) | body
+    // and a body:
+    //   zigzag varint time delta (ms, to the previous record or the base time) | u8 event
+    //   | varint PnP id reference: 0 for a new one, followed by varint length | bytes; else its 1-based index
+    //   | varint volume
+    // A sealed segment has the BlockCompressor output of the records behind its header.
+    constexpr uint32_t segment_magic = 0x50534153; // "SASP"
+    constexpr uint8_t format_version = 1;
+    constexpr size_t header_size = 32;
+    constexpr size_t max_pnp_id_size = 1024;
+    constexpr size_t min_segment_bytes = 4096;
+    constexpr auto open_extension = ".open";
+    constexpr auto sealed_extension = ".sealed";
+    constexpr auto temporary_extension = ".tmp";
+    constexpr auto acknowledged_file_name = "acknowledged";
+
+    struct SegmentHeader {
+        bool Sealed = false;
+        uint64_t FirstSequence = 0;
+        int64_t BaseTime = 0;
+        uint32_t RecordCount = 0;
+        uint32_t RawBytes = 0;
+    };
+
+    template <typename T>
+    void PutInteger(char * out, T value)
+    {
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            out[i] = static_cast<char>(static_cast<uint64_t>(value) >> (8 * i) & 0xFF);
+        }
+    }
+
+    template <typename T>
+    T GetInteger(const char * data)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+        }
+        return static_cast<T>(value);
+    }
+
+    void PutHeader(char * out, const SegmentHeader & header)
+    {
+        std::memset(out, 0, header_size);
+        PutInteger(out, segment_magic);
+        out[4] = static_cast<char>(format_version);
+        out[5] = header.Sealed ? 1 : 0;
+        PutInteger(out + 8, header.FirstSequence);
+        PutInteger(out + 16, header.BaseTime);
+        PutInteger(out + 24, header.RecordCount);
+        PutInteger(out + 28, header.RawBytes);
+    }
+
+    bool GetHeader(std::string_view data, SegmentHeader & header)
+    {
+        if (data.size() < header_size || GetInteger<uint32_t>(data.data()) != segment_magic
+            || static_cast<uint8_t>(data[4]) != format_version)
+        {
+            return false;
+        }
+        header.Sealed = data[5] != 0;
+        header.FirstSequence = GetInteger<uint64_t>(data.data() + 8);
+        header.BaseTime = GetInteger<int64_t>(data.data() + 16);
+        header.RecordCount = GetInteger<uint32_t>(data.data() + 24);
+        header.RawBytes = GetInteger<uint32_t>(data.data() + 28);
+        return true;
+    }
+
+    void AppendVarint(std::string & out, uint64_t value)
+    {
+        for (; value >= 0x80; value >>= 7)
+        {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    size_t GetVarintSize(uint64_t value)
+    {
+        size_t size = 1;
+        for (; value >= 0x80; value >>= 7)
+        {
+            ++size;
+        }
+        return size;
+    }
+
+    uint64_t ZigZag(int64_t value)
+    {
+        return static_cast<uint64_t>(value) << 1 ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t UnZigZag(uint64_t value)
+    {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    int64_t ToMilliseconds(std::chrono::system_clock::time_point time)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+    }
+
+    class RecordReader {
+    public:
+        explicit RecordReader(std::string_view data)
+            : data_(data)
+        {
+        }
+
+        // False if the data ends within the varint.
+        bool TryReadVarint(uint64_t & value)
+        {
+            value = 0;
+            for (size_t shift = 0; shift < 64 && position_ < data_.size(); shift += 7)
+            {
+                const auto byte = static_cast<uint8_t>(data_[position_++]);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uint64_t ReadVarint()
+        {
+            uint64_t value;
+            if (!TryReadVarint(value))
+            {
+                throw std::runtime_error("Spool record truncated");
+            }
+            return value;
+        }
+
+        std::string_view Take(uint64_t size)
+        {
+            if (data_.size() - position_ < size)
+            {
+                throw std::runtime_error("Spool record truncated");
+            }
+            const auto taken = data_.substr(position_, static_cast<size_t>(size));
+            position_ += static_cast<size_t>(size);
+            return taken;
+        }
+
+        [[nodiscard]] size_t GetPosition() const { return position_; }
+        [[nodiscard]] size_t GetRemaining() const { return data_.size() - position_; }
+
+    private:
+        std::string_view data_;
+        size_t position_ = 0;
+    };
+
+    // Decodes the records of a segment, up to its end or to a record cut short, and returns where they end.
+    // onRecord(time, event, pnpId, volume, isNewPnpId).
+    template <typename OnRecord>
+    size_t DecodeRecords(std::string_view data, int64_t baseTime, OnRecord onRecord)
+    {
+        int64_t time = baseTime;
+        std::vector<std::string_view> pnpIds;
+        size_t end = 0;
+        for (RecordReader reader(data); reader.GetRemaining() > 0;)
+        {
+            uint64_t length;
+            if (!reader.TryReadVarint(length) || length == 0 || length > reader.GetRemaining())
+            {
+                break;
+            }
+            RecordReader body(reader.Take(length));
+            time += UnZigZag(body.ReadVarint());
+            const auto event = static_cast<SoundDeviceEventType>(body.Take(1)[0]);
+            const auto reference = body.ReadVarint();
+            std::string_view pnpId;
+            if (reference == 0)
+            {
+                pnpId = body.Take(body.ReadVarint());
+                pnpIds.push_back(pnpId);
+            }
+            else if (reference <= pnpIds.size())
+            {
+                pnpId = pnpIds[static_cast<size_t>(reference - 1)];
+            }
+            else
+            {
+                throw std::runtime_error("Spool record refers to an unknown PnP id");
+            }
+            onRecord(time, event, pnpId, static_cast<uint16_t>(body.ReadVarint()), reference == 0);
+            end = reader.GetPosition();
+        }
+        return end;
+    }
+
+    std::string ReadWholeFile(const std::filesystem::path & path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error(std::format("Can not read spool file {}.", path.string()));
+        }
+        return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    }
+
+    // Writes to a temporary file first, so that the file is either complete or absent.
+    void WriteWholeFile(const std::filesystem::path & path, std::string_view content)
+    {
+        auto temporary = path;
+        temporary += temporary_extension;
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(content.data(), static_cast<std::streamsize>(content.size()));
+            if (!file.flush())
+            {
+                throw std::runtime_error(std::format("Can not write spool file {}.", temporary.string()));
+            }
+        }
+        std::filesystem::rename(temporary, path);
+    }
+}
+
+// A file of a fixed size, mapped into memory for reading and writing.
+class ed::audio::EventSpool::MappedFile final {
+public:
+    DISALLOW_COPY_MOVE(MappedFile);
+
+    // Opens or creates the file; it is extended to size bytes, with zeroes, if it is smaller.
+    MappedFile(const std::filesystem::path & path, size_t size)
+    {
+        file_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error(std::format("Can not open spool segment {}, error {}.", path.string(), GetLastError()));
+        }
+        LARGE_INTEGER fileSize{};
+        GetFileSizeEx(file_, &fileSize);
+        size_ = std::max(size, static_cast<size_t>(fileSize.QuadPart));
+
+        mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(size_) >> 32),
+            static_cast<DWORD>(size_ & 0xFFFFFFFF), nullptr);
+        data_ = mapping_ != nullptr ? static_cast<char *>(MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, size_)) : nullptr;
+        if (data_ == nullptr)
+        {
+            const auto error = GetLastError();
+            Close();
+            throw std::runtime_error(std::format("Can not map spool segment {}, error {}.", path.string(), error));
+        }
+    }
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    [[nodiscard]] char * GetData() const { return data_; }
+    [[nodiscard]] size_t GetSize() const { return size_; }
+
+    void Flush() const
+    {
+        FlushViewOfFile(data_, 0);
+        FlushFileBuffers(file_);
+    }
+
+private:
+    void Close()
+    {
+        if (data_ != nullptr)
+        {
+            UnmapViewOfFile(data_);
+            data_ = nullptr;
+        }
+        if (mapping_ != nullptr)
+        {
+            CloseHandle(mapping_);
+            mapping_ = nullptr;
+        }
+        if (file_ != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file_);
+            file_ = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+    char * data_ = nullptr;
+    size_t size_ = 0;
+};
+
+ed::audio::EventSpool::EventSpool(std::filesystem::path directory, const Options & options)
+    : directory_(std::move(directory))
+    , options_{ std::max(options.SegmentBytes, min_segment_bytes), std::max<size_t>(options.MaxSealedSegments, 1) }
+{
+    std::lock_guard lock(mutex_);
+    Recover();
+}
+
+ed::audio::EventSpool::~EventSpool() = default;
+
+uint64_t ed::audio::EventSpool::Append(SoundDeviceEventType event, std::string_view pnpId, uint16_t volume,
+    std::chrono::system_clock::time_point time)
+{
+    const auto milliseconds = ToMilliseconds(time);
+    pnpId = pnpId.substr(0, max_pnp_id_size);
+
+    std::lock_guard lock(mutex_);
+    if (open_ == nullptr)
+    {
+        OpenNewSegment(milliseconds);
+    }
+
+    const auto encode = [this, event, pnpId, volume, milliseconds]
+    {
+        scratch_.clear();
+        AppendVarint(scratch_, ZigZag(milliseconds - open_->LastTime));
+        scratch_.push_back(static_cast<char>(event));
+        if (const auto found = open_->PnpIds.find(pnpId)
+            ; found != open_->PnpIds.end())
+        {
+            AppendVarint(scratch_, found->second);
+        }
+        else
+        {
+            AppendVarint(scratch_, 0);
+            AppendVarint(scratch_, pnpId.size());
+            scratch_.append(pnpId);
+        }
+        AppendVarint(scratch_, volume);
+        return GetVarintSize(scratch_.size()) + scratch_.size();
+    };
+    auto size = encode();
+    if (open_->End + size > open_->File->GetSize())
+    {
+        SealOpenSegment();
+        OpenNewSegment(milliseconds);
+        size = encode();
+    }
+
+    // the body first and the first byte of its length last: a crash amid the copy leaves no record
+    char * out = open_->File->GetData() + open_->End;
+    const auto lengthSize = size - scratch_.size();
+    std::memcpy(out + lengthSize, scratch_.data(), scratch_.size());
+    std::string length;
+    AppendVarint(length, scratch_.size());
+    std::memcpy(out + 1, length.data() + 1, lengthSize - 1);
+    out[0] = length[0];
+
+    open_->End += size;
+    open_->LastTime = milliseconds;
+    open_->PnpIds.try_emplace(std::string(pnpId), static_cast<uint32_t>(open_->PnpIds.size() + 1));
+    ++open_->RecordCount;
+    ++statistics_.RecordsAppended;
+    return nextSequence_++;
+}
+
+std::vector<ed::audio::EventSpool::Record> ed::audio::EventSpool::Read(uint64_t after, size_t maxRecords) const
+{
+    std::vector<Record> records;
+    std::lock_guard lock(mutex_);
+
+    auto segment = sealed_.upper_bound(after + 1);
+    if (segment != sealed_.begin())
+    {
+        --segment;
+    }
+    for (; segment != sealed_.end() && records.size() < maxRecords; ++segment)
+    {
+        if (segment->first + segment->second.RecordCount <= after + 1)
+        {
+            continue;
+        }
+        try
+        {
+            for (const auto & record : LoadSealed(segment->first, segment->second))
+            {
+                if (record.Sequence > after && records.size() < maxRecords)
+                {
+                    records.push_back(record);
+                }
+            }
+        }
+        catch (const std::exception & ex)
+        {
+            // the records are lost; a reader must not get stuck on them
+            spdlog::error("Spool segment {} skipped: {}", segment->second.Path.string(), ex.what());
+        }
+    }
+
+    if (open_ != nullptr && records.size() < maxRecords && open_->FirstSequence + open_->RecordCount > after + 1)
+    {
+        auto sequence = open_->FirstSequence;
+        DecodeRecords(std::string_view(open_->File->GetData() + header_size, open_->End - header_size), open_->BaseTime,
+            [&records, &sequence, after, maxRecords](int64_t time, SoundDeviceEventType event, std::string_view pnpId, uint16_t volume, bool)
+            {
+                if (sequence > after && records.size() < maxRecords)
+                {
+                    records.push_back({ sequence, std::chrono::system_clock::time_point(std::chrono::milliseconds(time)), event,
+                        std::string(pnpId), volume });
+                }
+                ++sequence;
+            });
+    }
+    return records;
+}
+
+void ed::audio::EventSpool::Acknowledge(uint64_t sequence)
+{
+    std::lock_guard lock(mutex_);
+    sequence = std::min(sequence, nextSequence_ - 1);
+    if (sequence <= acknowledged_)
+    {
+        return;
+    }
+    acknowledged_ = sequence;
+    WriteAcknowledged();
+    DeleteAcknowledgedSegments();
+}
+
+void ed::audio::EventSpool::Flush()
+{
+    std::lock_guard lock(mutex_);
+    if (open_ != nullptr)
+    {
+        open_->File->Flush();
+    }
+}
+
+uint64_t ed::audio::EventSpool::GetAcknowledged() const
+{
+    std::lock_guard lock(mutex_);
+    return acknowledged_;
+}
+
+uint64_t ed::audio::EventSpool::GetLastSequence() const
+{
+    std::lock_guard lock(mutex_);
+    return nextSequence_ - 1;
+}
+
+ed::audio::EventSpool::Statistics ed::audio::EventSpool::GetStatistics() const
+{
+    std::lock_guard lock(mutex_);
+    return statistics_;
+}
+
+void ed::audio::EventSpool::Recover()
+{
+    std::filesystem::create_directories(directory_);
+    if (const auto acknowledgedPath = directory_ / acknowledged_file_name
+        ; std::filesystem::exists(acknowledgedPath))
+    {
+        const auto content = ReadWholeFile(acknowledgedPath);
+        acknowledged_ = content.size() == sizeof(uint64_t) ? GetInteger<uint64_t>(content.data()) : 0;
+    }
+
+    std::vector<std::pair<uint64_t, std::filesystem::path>> openPaths;
+    for (const auto & entry : std::filesystem::directory_iterator(directory_))
+    {
+        const auto & path = entry.path();
+        const auto extension = path.extension().string();
+        if (extension == temporary_extension)
+        {
+            // a write cut short
+            std::filesystem::remove(path);
+            continue;
+        }
+        const auto stem = path.stem().string();
+        uint64_t firstSequence = 0;
+        if (std::from_chars(stem.data(), stem.data() + stem.size(), firstSequence).ec != std::errc())
+        {
+            continue;
+        }
+        if (extension == open_extension)
+        {
+            openPaths.emplace_back(firstSequence, path);
+        }
+        else if (extension == sealed_extension)
+        {
+            SegmentHeader header;
+            if (const auto content = ReadWholeFile(path)
+                ; !GetHeader(content, header) || !header.Sealed || header.FirstSequence != firstSequence)
+            {
+                spdlog::error("Spool segment {} ignored: no valid header.", path.string());
+                continue;
+            }
+            sealed_[firstSequence] = { path, header.RecordCount };
+        }
+    }
+
+    // more than one open segment is left only if sealing was cut short; the older ones are sealed now
+    std::ranges::sort(openPaths);
+    for (const auto & [firstSequence, path] : openPaths)
+    {
+        if (open_ != nullptr)
+        {
+            SealOpenSegment();
+        }
+        if (sealed_.contains(firstSequence))
+        {
+            // sealed, but not yet deleted
+            std::filesystem::remove(path);
+            continue;
+        }
+
+        auto segment = std::make_unique<OpenSegment>();
+        segment->Path = path;
+        segment->File = std::make_unique<MappedFile>(path, options_.SegmentBytes);
+        SegmentHeader header;
+        if (!GetHeader(std::string_view(segment->File->GetData(), header_size), header) || header.Sealed
+            || header.FirstSequence != firstSequence)
+        {
+            // created, but the header not yet written: holds no records
+            segment.reset();
+            std::filesystem::remove(path);
+            continue;
+        }
+        segment->FirstSequence = firstSequence;
+        segment->BaseTime = header.BaseTime;
+        segment->LastTime = header.BaseTime;
+        auto & recovered = *segment;
+        segment->End = header_size + DecodeRecords(
+            std::string_view(segment->File->GetData() + header_size, segment->File->GetSize() - header_size), header.BaseTime,
+            [&recovered](int64_t time, SoundDeviceEventType, std::string_view pnpId, uint16_t, bool isNewPnpId)
+            {
+                if (isNewPnpId)
+                {
+                    recovered.PnpIds.try_emplace(std::string(pnpId), static_cast<uint32_t>(recovered.PnpIds.size() + 1));
+                }
+                recovered.LastTime = time;
+                ++recovered.RecordCount;
+            });
+        // anything behind the last complete record would be taken for a record later
+        std::memset(segment->File->GetData() + segment->End, 0, segment->File->GetSize() - segment->End);
+        open_ = std::move(segment);
+    }
+
+    if (open_ != nullptr)
+    {
+        nextSequence_ = open_->FirstSequence + open_->RecordCount;
+    }
+    else if (!sealed_.empty())
+    {
+        nextSequence_ = sealed_.rbegin()->first + sealed_.rbegin()->second.RecordCount;
+    }
+    // all acknowledged records may be deleted; the sequence must go on behind them nonetheless
+    nextSequence_ = std::max(nextSequence_, acknowledged_ + 1);
+    DeleteAcknowledgedSegments();
+    DropOverflowSegments();
+
+    spdlog::info("Event spool {}: {} sealed segments, {} records in the open one, sequence {} acknowledged of {}.",
+        directory_.string(), sealed_.size(), open_ != nullptr ? open_->RecordCount : 0, acknowledged_, nextSequence_ - 1);
+}
+
+void ed::audio::EventSpool::OpenNewSegment(int64_t time)
+{
+    auto segment = std::make_unique<OpenSegment>();
+    segment->Path = SegmentPath(nextSequence_, false);
+    segment->File = std::make_unique<MappedFile>(segment->Path, options_.SegmentBytes);
+    segment->FirstSequence = nextSequence_;
+    segment->End = header_size;
+    segment->BaseTime = time;
+    segment->LastTime = time;
+    PutHeader(segment->File->GetData(), { .Sealed = false, .FirstSequence = nextSequence_, .BaseTime = time });
+    open_ = std::move(segment);
+}
+
+void ed::audio::EventSpool::SealOpenSegment()
+{
+    auto segment = std::move(open_);
+    if (segment->RecordCount > 0)
+    {
+        const std::string_view records(segment->File->GetData() + header_size, segment->End - header_size);
+        std::string content(header_size, '\0');
+        PutHeader(content.data(), { .Sealed = true, .FirstSequence = segment->FirstSequence, .BaseTime = segment->BaseTime,
+            .RecordCount = segment->RecordCount, .RawBytes = static_cast<uint32_t>(records.size()) });
+        BlockCompressor::Compress(records, content);
+
+        const auto path = SegmentPath(segment->FirstSequence, true);
+        WriteWholeFile(path, content);
+        sealed_[segment->FirstSequence] = { path, segment->RecordCount };
+        ++statistics_.SegmentsSealed;
+        statistics_.RawBytesSealed += records.size();
+        statistics_.CompressedBytesSealed += content.size();
+    }
+    segment->File.reset();
+    std::filesystem::remove(segment->Path);
+
+    DeleteAcknowledgedSegments();
+    DropOverflowSegments();
+}
+
+void ed::audio::EventSpool::DeleteAcknowledgedSegments()
+{
+    while (!sealed_.empty() && sealed_.begin()->first + sealed_.begin()->second.RecordCount <= acknowledged_ + 1)
+    {
+        std::filesystem::remove(sealed_.begin()->second.Path);
+        sealed_.erase(sealed_.begin());
+    }
+}
+
+void ed::audio::EventSpool::DropOverflowSegments()
+{
+    while (sealed_.size() > options_.MaxSealedSegments)
+    {
+        const auto & [firstSequence, segment] = *sealed_.begin();
+        const auto end = firstSequence + segment.RecordCount;
+        const auto lost = end - std::clamp(acknowledged_ + 1, firstSequence, end);
+        spdlog::warn("Event spool full: segment {} dropped, {} records never delivered.", segment.Path.string(), lost);
+        ++statistics_.SegmentsDropped;
+        statistics_.RecordsDropped += lost;
+        std::filesystem::remove(segment.Path);
+        sealed_.erase(sealed_.begin());
+    }
+}
+
+const std::vector<ed::audio::EventSpool::Record> & ed::audio::EventSpool::LoadSealed(uint64_t firstSequence, const SealedSegment & segment) const
+{
+    if (cachedFirstSequence_ == firstSequence)
+    {
+        return cachedRecords_;
+    }
+    cachedRecords_.clear();
+    cachedFirstSequence_ = 0;
+
+    const auto content = ReadWholeFile(segment.Path);
+    SegmentHeader header;
+    if (!GetHeader(content, header))
+    {
+        throw std::runtime_error("No valid header");
+    }
+    std::string records;
+    records.reserve(header.RawBytes);
+    BlockCompressor::Decompress(std::string_view(content).substr(header_size), records);
+    if (records.size() != header.RawBytes)
+    {
+        throw std::runtime_error("Records have the wrong size");
+    }
+
+    cachedRecords_.reserve(header.RecordCount);
+    auto sequence = firstSequence;
+    DecodeRecords(records, header.BaseTime,
+        [this, &sequence](int64_t time, SoundDeviceEventType event, std::string_view pnpId, uint16_t volume, bool)
+        {
+            cachedRecords_.push_back({ sequence++, std::chrono::system_clock::time_point(std::chrono::milliseconds(time)), event,
+                std::string(pnpId), volume });
+        });
+    if (cachedRecords_.size() != header.RecordCount)
+    {
+        throw std::runtime_error("Record count does not match the header");
+    }
+    cachedFirstSequence_ = firstSequence;
+    return cachedRecords_;
+}
+
+std::filesystem::path ed::audio::EventSpool::SegmentPath(uint64_t firstSequence, bool sealed) const
+{
+    // zero-padded, so that the names sort by sequence
+    return directory_ / std::format("{:020}{}", firstSequence, sealed ? sealed_extension : open_extension);
+}
+
+void ed::audio::EventSpool::WriteAcknowledged() const
+{
+    std::string content(sizeof(uint64_t), '\0');
+    PutInteger(content.data(), acknowledged_);
+    WriteWholeFile(directory_ / acknowledged_file_name, content);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "public/SoundAgentInterface.h"
+
+
+namespace ed::audio {
+// Store-and-forward spool of device events for an uploader that may be offline for a long time.
+// Events get consecutive sequence numbers and are appended to the open segment, a fixed-size file
+// mapped into memory, so an append is a copy and survives a crash of the process. Records are
+// delta encoded: varints, the time relative to the previous record and PnP ids by their index in the
+// segment once seen. A full segment is sealed: block compressed into a file of its own.
+// The last acknowledged sequence is persisted; segments acknowledged in full are deleted, and after a
+// restart reading resumes behind it. The oldest segments are dropped beyond the segment limit.
+// Thread-safe.
+class EventSpool final {
+public:
+    struct Options {
+        size_t SegmentBytes = 1024 * 1024;
+        // sealed segments kept at most; the oldest is dropped, acknowledged or not
+        size_t MaxSealedSegments = 256;
+    };
+
+    struct Record {
+        uint64_t Sequence = 0;
+        std::chrono::system_clock::time_point Time;
+        SoundDeviceEventType Event = SoundDeviceEventType::Confirmed;
+        std::string PnpId;
+        uint16_t Volume = 0;
+    };
+
+    struct Statistics {
+        uint64_t RecordsAppended = 0;
+        uint64_t SegmentsSealed = 0;
+        uint64_t SegmentsDropped = 0;
+        uint64_t RecordsDropped = 0;
+        uint64_t RawBytesSealed = 0;
+        uint64_t CompressedBytesSealed = 0;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(EventSpool);
+    // Creates the directory if needed and recovers the segments and the acknowledged sequence in it.
+    // Throws std::runtime_error if the directory or its files can not be used.
+    EventSpool(std::filesystem::path directory, const Options & options);
+    ~EventSpool();
+
+public:
+    // Returns the sequence of the record. PnP ids longer than 1 KiB are truncated.
+    uint64_t Append(SoundDeviceEventType event, std::string_view pnpId, uint16_t volume, std::chrono::system_clock::time_point time);
+    // Up to maxRecords records following the sequence after, in order.
+    [[nodiscard]] std::vector<Record> Read(uint64_t after, size_t maxRecords) const;
+    // Persists that everything up to the sequence has been delivered.
+    void Acknowledge(uint64_t sequence);
+    // Writes the open segment through to the disk, e.g. before a shutdown of the system.
+    void Flush();
+
+    [[nodiscard]] uint64_t GetAcknowledged() const;
+    // 0 if nothing was ever appended.
+    [[nodiscard]] uint64_t GetLastSequence() const;
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    class MappedFile;
+
+    struct SealedSegment {
+        std::filesystem::path Path;
+        uint32_t RecordCount = 0;
+    };
+
+    // lets the PnP id dictionary be searched by string_view
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view value) const { return std::hash<std::string_view>()(value); }
+    };
+
+    struct OpenSegment {
+        std::filesystem::path Path;
+        std::unique_ptr<MappedFile> File;
+        uint64_t FirstSequence = 0;
+        uint32_t RecordCount = 0;
+        size_t End = 0;
+        int64_t BaseTime = 0;
+        int64_t LastTime = 0;
+        // 1-based index of each PnP id seen in the segment
+        std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>> PnpIds;
+    };
+
+    // Must be called with mutex_ held.
+    void Recover();
+    void OpenNewSegment(int64_t time);
+    void SealOpenSegment();
+    void DeleteAcknowledgedSegments();
+    void DropOverflowSegments();
+    // Decodes the records of a sealed segment; the last one is cached, as the uploader reads it in batches.
+    const std::vector<Record> & LoadSealed(uint64_t firstSequence, const SealedSegment & segment) const;
+
+    [[nodiscard]] std::filesystem::path SegmentPath(uint64_t firstSequence, bool sealed) const;
+    void WriteAcknowledged() const;
+
+private:
+    const std::filesystem::path directory_;
+    const Options options_;
+    mutable std::mutex mutex_;
+    std::map<uint64_t, SealedSegment> sealed_;
+    std::unique_ptr<OpenSegment> open_;
+    uint64_t nextSequence_ = 1;
+    uint64_t acknowledged_ = 0;
+    Statistics statistics_;
+    // the record being appended, reused
+    std::string scratch_;
+    mutable uint64_t cachedFirstSequence_ = 0;
+    mutable std::vector<Record> cachedRecords_;
+};
+}
@@ -0,0 +1,287 @@
+#include "os-dependencies.h"
+
+#include "EventStreamPublisher.h"
+
+#include "BinaryEventCodec.h"
+
+#include <algorithm>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+
+class ed::audio::EventStreamPublisher::Client final {
+public:
+    DISALLOW_COPY_MOVE(Client);
+    Client(EventStreamPublisher & publisher, uint64_t id, SendFunctionT send, AbortFunctionT abort)
+        : publisher_(publisher)
+        , id_(id)
+        , send_(std::move(send))
+        , abort_(std::move(abort))
+        , sender_(&Client::RunSender, this)
+    {
+    }
+
+    ~Client()
+    {
+        Abort();
+        sender_.join();
+    }
+
+public:
+    // Returns false if the frame made the client lag.
+    bool Enqueue(const std::shared_ptr<const std::string> & frame, uint64_t stateVersion)
+    {
+        std::lock_guard lock(mutex_);
+        if (closed_)
+        {
+            return true;
+        }
+        if (queuedBytes_ + frame->size() > publisher_.clientQueueLimitBytes_)
+        {
+            return false;
+        }
+        queue_.push_back({ frame, stateVersion });
+        queuedBytes_ += frame->size();
+        wakeUp_.notify_one();
+        return true;
+    }
+
+    // Drops the queue; the sender continues with a fresh snapshot.
+    void Resync()
+    {
+        std::lock_guard lock(mutex_);
+        queue_.clear();
+        queuedBytes_ = 0;
+        resyncRequested_ = true;
+        wakeUp_.notify_one();
+    }
+
+    void Abort()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            if (closed_)
+            {
+                return;
+            }
+            closed_ = true;
+            wakeUp_.notify_one();
+        }
+        abort_();
+    }
+
+    [[nodiscard]] bool IsFinished() const
+    {
+        std::lock_guard lock(mutex_);
+        return finished_;
+    }
+
+    [[nodiscard]] uint64_t GetId() const { return id_; }
+
+private:
+    struct QueuedFrame {
+        std::shared_ptr<const std::string> Bytes;
+        uint64_t StateVersion;
+    };
+
+    void RunSender()
+    {
+        constexpr size_t maxBatchBytes = 64 * 1024;
+        std::string batch;
+        // frames up to this version are reflected in the last snapshot sent
+        uint64_t snapshotVersion = 0;
+        for (;;)
+        {
+            bool snapshotRequested;
+            {
+                std::unique_lock lock(mutex_);
+                wakeUp_.wait(lock, [this] { return closed_ || resyncRequested_ || !queue_.empty(); });
+                if (closed_)
+                {
+                    break;
+                }
+                snapshotRequested = std::exchange(resyncRequested_, false);
+            }
+
+            batch.clear();
+            if (snapshotRequested)
+            {
+                const auto snapshot = publisher_.collection_.CreateSnapshot();
+                snapshotVersion = snapshot.StateVersion;
+                BinaryEventCodec::AppendSnapshotFrame(batch, snapshot);
+            }
+            {
+                std::lock_guard lock(mutex_);
+                while (!queue_.empty() && batch.size() < maxBatchBytes)
+                {
+                    const auto & frame = queue_.front();
+                    if (frame.StateVersion > snapshotVersion)
+                    {
+                        batch.append(*frame.Bytes);
+                    }
+                    queuedBytes_ -= frame.Bytes->size();
+                    queue_.pop_front();
+                }
+            }
+
+            if (!batch.empty())
+            {
+                if (!send_(batch))
+                {
+                    break;
+                }
+                publisher_.AddBytesSent(batch.size());
+            }
+        }
+
+        std::lock_guard lock(mutex_);
+        closed_ = true;
+        finished_ = true;
+        queue_.clear();
+    }
+
+private:
+    EventStreamPublisher & publisher_;
+    const uint64_t id_;
+    SendFunctionT send_;
+    AbortFunctionT abort_;
+
+    // guards the queue and the flags
+    mutable std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    std::deque<QueuedFrame> queue_;
+    size_t queuedBytes_ = 0;
+    // a new client starts with a snapshot
+    bool resyncRequested_ = true;
+    bool closed_ = false;
+    bool finished_ = false;
+
+    std::thread sender_;
+};
+
+ed::audio::EventStreamPublisher::EventStreamPublisher(const SoundDeviceCollectionInterface & collection,
+    size_t clientQueueLimitBytes, LagPolicy lagPolicy)
+    : collection_(collection)
+    , clientQueueLimitBytes_(clientQueueLimitBytes)
+    , lagPolicy_(lagPolicy)
+{
+    frame_.reserve(512);
+}
+
+ed::audio::EventStreamPublisher::~EventStreamPublisher()
+{
+    std::map<uint64_t, std::unique_ptr<Client>> clients;
+    {
+        std::lock_guard lock(mutex_);
+        clients.swap(clients_);
+    }
+    for (const auto & client : clients | std::views::values)
+    {
+        client->Abort();
+    }
+    // destroying joins the senders
+}
+
+void ed::audio::EventStreamPublisher::AddClient(SendFunctionT send, AbortFunctionT abort)
+{
+    CloseFinishedClients();
+
+    std::lock_guard lock(mutex_);
+    const auto id = nextClientId_++;
+    clients_.emplace(id, std::make_unique<Client>(*this, id, std::move(send), std::move(abort)));
+    ++statistics_.ClientsAccepted;
+    spdlog::info("Stream client {} connected, {} clients.", id, clients_.size());
+}
+
+size_t ed::audio::EventStreamPublisher::GetClientCount() const
+{
+    std::lock_guard lock(mutex_);
+    return static_cast<size_t>(std::ranges::count_if(clients_ | std::views::values,
+        [](const std::unique_ptr<Client> & client) { return !client->IsFinished(); }));
+}
+
+ed::audio::EventStreamPublisher::Statistics ed::audio::EventStreamPublisher::GetStatistics() const
+{
+    std::lock_guard lock(mutex_);
+    return statistics_;
+}
+
+void ed::audio::EventStreamPublisher::OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion)
+{
+    std::lock_guard lock(mutex_);
+    if (event == SoundDeviceEventType::ContentReset)
+    {
+        for (const auto & client : clients_ | std::views::values)
+        {
+            client->Resync();
+        }
+        return;
+    }
+
+    frame_.clear();
+    std::unique_ptr<SoundDeviceInterface> device;
+    if (event == SoundDeviceEventType::Discovered
+        || event == SoundDeviceEventType::PropertyChanged
+        || event == SoundDeviceEventType::VolumeRenderChanged
+        || event == SoundDeviceEventType::VolumeCaptureChanged)
+    {
+        device = collection_.CreateItem(devicePnpId);
+    }
+    BinaryEventCodec::AppendEventFrame(frame_, event, devicePnpId, stateVersion, device.get());
+    const auto frame = std::make_shared<const std::string>(frame_);
+    ++statistics_.FramesPublished;
+
+    for (const auto & client : clients_ | std::views::values)
+    {
+        if (client->Enqueue(frame, stateVersion))
+        {
+            continue;
+        }
+        if (lagPolicy_ == LagPolicy::CoalesceToSnapshot)
+        {
+            client->Resync();
+            ++statistics_.SnapshotsForLaggingClients;
+        }
+        else
+        {
+            spdlog::warn("Stream client {} disconnected: it lags more than {} bytes behind.", client->GetId(), clientQueueLimitBytes_);
+            client->Abort();
+            ++statistics_.ClientsDisconnectedAsLagging;
+        }
+    }
+}
+
+void ed::audio::EventStreamPublisher::CloseFinishedClients()
+{
+    std::vector<std::unique_ptr<Client>> finished;
+    {
+        std::lock_guard lock(mutex_);
+        for (auto it = clients_.begin(); it != clients_.end();)
+        {
+            if (it->second->IsFinished())
+            {
+                finished.push_back(std::move(it->second));
+                it = clients_.erase(it);
+                ++statistics_.ClientsClosed;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    for (const auto & client : finished)
+    {
+        spdlog::info("Stream client {} closed.", client->GetId());
+    }
+    // destroying joins the finished senders
+}
+
+void ed::audio::EventStreamPublisher::AddBytesSent(size_t bytes)
+{
+    std::lock_guard lock(mutex_);
+    statistics_.BytesSent += bytes;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "public/SoundAgentInterface.h"
+
+
+namespace ed::audio {
+// Publishes the collection to any number of stream clients in BinaryEventCodec frames:
+// a snapshot first, then one frame per change. Each frame is encoded once and queued to every client.
+// Every client has its own bounded queue, drained by its own sender thread, so a slow client blocks
+// neither the delivery thread nor the other clients. A client whose queue would exceed the limit lags;
+// the lag policy decides what happens to it.
+class EventStreamPublisher final : public SoundDeviceObserverInterface {
+public:
+    enum class LagPolicy : uint8_t {
+        // drop the queue and send a fresh snapshot once the client catches up
+        CoalesceToSnapshot,
+        // close the client
+        Disconnect
+    };
+
+    // Blocking write of a batch of frames; returns false once the client is gone.
+    using SendFunctionT = std::function<bool(std::string_view)>;
+    // Makes a running and any later send fail soon, e.g. by cancelling the pending write. Must not block.
+    using AbortFunctionT = std::function<void()>;
+
+    struct Statistics {
+        uint64_t ClientsAccepted = 0;
+        uint64_t ClientsClosed = 0;
+        uint64_t ClientsDisconnectedAsLagging = 0;
+        uint64_t SnapshotsForLaggingClients = 0;
+        uint64_t FramesPublished = 0;
+        uint64_t BytesSent = 0;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(EventStreamPublisher);
+    EventStreamPublisher(const SoundDeviceCollectionInterface & collection, size_t clientQueueLimitBytes, LagPolicy lagPolicy);
+    // Aborts and closes all clients. Unsubscribe from the collection first.
+    ~EventStreamPublisher() override;
+
+public:
+    // The client gets a snapshot first. The functions are released when the client is closed.
+    void AddClient(SendFunctionT send, AbortFunctionT abort);
+    [[nodiscard]] size_t GetClientCount() const;
+    [[nodiscard]] Statistics GetStatistics() const;
+
+    void OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion) override;
+
+private:
+    class Client;
+
+    void CloseFinishedClients();
+    void AddBytesSent(size_t bytes);
+
+private:
+    const SoundDeviceCollectionInterface & collection_;
+    const size_t clientQueueLimitBytes_;
+    const LagPolicy lagPolicy_;
+
+    // guards clients_ and statistics_; never held while sending
+    mutable std::mutex mutex_;
+    std::map<uint64_t, std::unique_ptr<Client>> clients_;
+    uint64_t nextClientId_ = 1;
+    Statistics statistics_;
+    // reused by the delivery thread, which is the only one calling OnCollectionChanged
+    std::string frame_;
+};
+}
@@ -0,0 +1,330 @@
+#include "os-dependencies.h"
+
+#include "FleetIndex.h"
+
+#include <algorithm>
+#include <mutex>
+
+
+namespace
+{
+    void AddToIndex(std::unordered_map<uint32_t, std::unordered_set<uint32_t>> & index, uint32_t key, uint32_t host)
+    {
+        if (key != ed::audio::StringInterner::no_id)
+        {
+            index[key].insert(host);
+        }
+    }
+
+    void RemoveFromIndex(std::unordered_map<uint32_t, std::unordered_set<uint32_t>> & index, uint32_t key, uint32_t host)
+    {
+        if (const auto found = index.find(key)
+            ; found != index.end())
+        {
+            found->second.erase(host);
+            if (found->second.empty())
+            {
+                index.erase(found);
+            }
+        }
+    }
+}
+
+ed::audio::FleetIndex::FleetIndex(size_t shardCount)
+    : shards_(std::make_unique<Shard[]>(shardCount))
+    , shardCount_(shardCount)
+{
+}
+
+ed::audio::FleetIndex::HostId ed::audio::FleetIndex::AddHost(std::string_view hostName)
+{
+    const auto hostId = strings_.Intern(hostName);
+    auto & shard = GetShard(hostId);
+    std::unique_lock lock(shard.Mutex);
+    shard.Hosts.try_emplace(hostId);
+    return hostId;
+}
+
+size_t ed::audio::FleetIndex::Ingest(HostId host, std::string_view bytes, BinaryEventCodec::Frame & frame)
+{
+    size_t consumed = 0;
+    for (size_t size; (size = BinaryEventCodec::DecodeFrame(bytes.substr(consumed), frame)) != 0; consumed += size)
+    {
+        Apply(host, frame);
+    }
+    return consumed;
+}
+
+void ed::audio::FleetIndex::Apply(HostId hostId, const BinaryEventCodec::Frame & frame)
+{
+    // the interner has its own locks; no need to hold the shard's for it
+    const auto pnpId = frame.DevicePnpId.empty() ? StringInterner::no_id : strings_.Intern(frame.DevicePnpId);
+
+    auto & shard = GetShard(hostId);
+    std::unique_lock lock(shard.Mutex);
+    auto & host = shard.Hosts[hostId];
+
+    if (frame.Type == BinaryEventCodec::FrameType::Snapshot)
+    {
+        if (frame.StateVersion < host.StateVersion)
+        {
+            ++shard.StaleFramesDropped;
+            return;
+        }
+        Host replacement{
+            .StateVersion = frame.StateVersion,
+            .StructureVersion = frame.StateVersion,
+            .Devices = {},
+            .DefaultRender = StringInterner::no_id,
+            .DefaultCapture = StringInterner::no_id
+        };
+        for (const auto & device : frame.Devices)
+        {
+            UpsertDevice(replacement, device, frame.StateVersion);
+        }
+        if (!frame.DefaultRenderDevicePnpId.empty())
+        {
+            replacement.DefaultRender = strings_.Intern(frame.DefaultRenderDevicePnpId);
+        }
+        if (!frame.DefaultCaptureDevicePnpId.empty())
+        {
+            replacement.DefaultCapture = strings_.Intern(frame.DefaultCaptureDevicePnpId);
+        }
+
+        UpdateIndexes(shard, hostId, host, false);
+        shard.DeviceCount -= host.Devices.size();
+        host = std::move(replacement);
+        shard.DeviceCount += host.Devices.size();
+        UpdateIndexes(shard, hostId, host, true);
+        ++shard.FramesApplied;
+        return;
+    }
+
+    const auto found = std::ranges::find(host.Devices, pnpId, &Device::PnpId);
+    const auto isKnown = found != host.Devices.end() && !frame.Devices.empty()
+        && strings_.Find(frame.Devices[0].Name) == found->Name;
+
+    // the common case: a volume change of a known device leaves the indexes alone, and is versioned by the device's
+    // volumes rather than by the host, since it may arrive after newer events of the other lane
+    if (isKnown && (frame.Event == SoundDeviceEventType::VolumeRenderChanged || frame.Event == SoundDeviceEventType::VolumeCaptureChanged))
+    {
+        if (!UpdateVolumes(*found, frame.Devices[0], frame.StateVersion))
+        {
+            ++shard.StaleFramesDropped;
+            return;
+        }
+        if (frame.StateVersion > host.StructureVersion)
+        {
+            found->Flow = frame.Devices[0].Flow;
+        }
+        host.StateVersion = std::max(host.StateVersion, frame.StateVersion);
+        ++shard.FramesApplied;
+        return;
+    }
+
+    if (frame.StateVersion <= host.StructureVersion)
+    {
+        ++shard.StaleFramesDropped;
+        return;
+    }
+    host.StructureVersion = frame.StateVersion;
+    host.StateVersion = std::max(host.StateVersion, frame.StateVersion);
+    ++shard.FramesApplied;
+
+    switch (frame.Event)
+    {
+    case SoundDeviceEventType::Discovered:
+    case SoundDeviceEventType::PropertyChanged:
+    case SoundDeviceEventType::VolumeRenderChanged:
+    case SoundDeviceEventType::VolumeCaptureChanged:
+        if (frame.Devices.empty())
+        {
+            return;
+        }
+        if (isKnown)
+        {
+            UpdateVolumes(*found, frame.Devices[0], frame.StateVersion);
+            found->Flow = frame.Devices[0].Flow;
+            return;
+        }
+        UpdateIndexes(shard, hostId, host, false);
+        shard.DeviceCount -= host.Devices.size();
+        UpsertDevice(host, frame.Devices[0], frame.StateVersion);
+        shard.DeviceCount += host.Devices.size();
+        UpdateIndexes(shard, hostId, host, true);
+        return;
+    case SoundDeviceEventType::Detached:
+        UpdateIndexes(shard, hostId, host, false);
+        shard.DeviceCount -= std::erase_if(host.Devices, [pnpId](const Device & device) { return device.PnpId == pnpId; });
+        UpdateIndexes(shard, hostId, host, true);
+        return;
+    case SoundDeviceEventType::DefaultRenderChanged:
+    case SoundDeviceEventType::DefaultCaptureChanged:
+        UpdateIndexes(shard, hostId, host, false);
+        (frame.Event == SoundDeviceEventType::DefaultRenderChanged ? host.DefaultRender : host.DefaultCapture) = pnpId;
+        UpdateIndexes(shard, hostId, host, true);
+        return;
+    case SoundDeviceEventType::Confirmed:
+    case SoundDeviceEventType::ContentReset:
+        return;
+    }
+}
+
+std::vector<std::string_view> ed::audio::FleetIndex::FindHostsWithDefault(DeviceKey key, std::string_view value, SoundDeviceFlowType flow) const
+{
+    std::vector<std::string_view> hosts;
+    const auto id = strings_.Find(value);
+    if (!id.has_value() || (flow != SoundDeviceFlowType::Render && flow != SoundDeviceFlowType::Capture))
+    {
+        return hosts;
+    }
+
+    const auto indexOf = [key, flow](const Shard & shard) -> const HostsById &
+    {
+        if (flow == SoundDeviceFlowType::Render)
+        {
+            return key == DeviceKey::PnpId ? shard.DefaultRenderByPnpId : shard.DefaultRenderByName;
+        }
+        return key == DeviceKey::PnpId ? shard.DefaultCaptureByPnpId : shard.DefaultCaptureByName;
+    };
+    for (size_t i = 0; i < shardCount_; ++i)
+    {
+        std::shared_lock lock(shards_[i].Mutex);
+        const auto & index = indexOf(shards_[i]);
+        if (const auto found = index.find(*id)
+            ; found != index.end())
+        {
+            for (const auto host : found->second)
+            {
+                hosts.push_back(strings_.Resolve(host));
+            }
+        }
+    }
+    return hosts;
+}
+
+std::vector<std::string_view> ed::audio::FleetIndex::FindHostsWithDevice(DeviceKey key, std::string_view value) const
+{
+    std::vector<std::string_view> hosts;
+    const auto id = strings_.Find(value);
+    if (!id.has_value())
+    {
+        return hosts;
+    }
+
+    for (size_t i = 0; i < shardCount_; ++i)
+    {
+        std::shared_lock lock(shards_[i].Mutex);
+        const auto & index = key == DeviceKey::PnpId ? shards_[i].DevicesByPnpId : shards_[i].DevicesByName;
+        if (const auto found = index.find(*id)
+            ; found != index.end())
+        {
+            for (const auto host : found->second)
+            {
+                hosts.push_back(strings_.Resolve(host));
+            }
+        }
+    }
+    return hosts;
+}
+
+std::optional<uint16_t> ed::audio::FleetIndex::GetVolume(HostId hostId, std::string_view devicePnpId, SoundDeviceFlowType flow) const
+{
+    const auto pnpId = strings_.Find(devicePnpId);
+    if (!pnpId.has_value() || (flow != SoundDeviceFlowType::Render && flow != SoundDeviceFlowType::Capture))
+    {
+        return std::nullopt;
+    }
+
+    const auto & shard = GetShard(hostId);
+    std::shared_lock lock(shard.Mutex);
+    const auto host = shard.Hosts.find(hostId);
+    if (host == shard.Hosts.end())
+    {
+        return std::nullopt;
+    }
+    const auto found = std::ranges::find(host->second.Devices, *pnpId, &Device::PnpId);
+    if (found == host->second.Devices.end())
+    {
+        return std::nullopt;
+    }
+    return flow == SoundDeviceFlowType::Render ? found->RenderVolume : found->CaptureVolume;
+}
+
+ed::audio::FleetIndex::Statistics ed::audio::FleetIndex::GetStatistics() const
+{
+    Statistics statistics;
+    for (size_t i = 0; i < shardCount_; ++i)
+    {
+        std::shared_lock lock(shards_[i].Mutex);
+        statistics.Hosts += shards_[i].Hosts.size();
+        statistics.Devices += shards_[i].DeviceCount;
+        statistics.FramesApplied += shards_[i].FramesApplied;
+        statistics.StaleFramesDropped += shards_[i].StaleFramesDropped;
+    }
+    statistics.InternedStrings = strings_.GetSize();
+    return statistics;
+}
+
+void ed::audio::FleetIndex::UpdateIndexes(Shard & shard, HostId hostId, const Host & host, bool add)
+{
+    const auto update = add ? AddToIndex : RemoveFromIndex;
+    const auto nameOf = [&host](Id pnpId)
+    {
+        const auto found = std::ranges::find(host.Devices, pnpId, &Device::PnpId);
+        return found == host.Devices.end() ? StringInterner::no_id : found->Name;
+    };
+
+    for (const auto & device : host.Devices)
+    {
+        update(shard.DevicesByPnpId, device.PnpId, hostId);
+        update(shard.DevicesByName, device.Name, hostId);
+    }
+    update(shard.DefaultRenderByPnpId, host.DefaultRender, hostId);
+    update(shard.DefaultRenderByName, nameOf(host.DefaultRender), hostId);
+    update(shard.DefaultCaptureByPnpId, host.DefaultCapture, hostId);
+    update(shard.DefaultCaptureByName, nameOf(host.DefaultCapture), hostId);
+}
+
+bool ed::audio::FleetIndex::UpdateVolumes(Device & device, const BinaryEventCodec::Device & source, uint64_t stateVersion)
+{
+    auto updated = false;
+    if (stateVersion > device.RenderVolumeVersion)
+    {
+        device.RenderVolume = source.RenderVolume;
+        device.RenderVolumeVersion = stateVersion;
+        updated = true;
+    }
+    if (stateVersion > device.CaptureVolumeVersion)
+    {
+        device.CaptureVolume = source.CaptureVolume;
+        device.CaptureVolumeVersion = stateVersion;
+        updated = true;
+    }
+    return updated;
+}
+
+void ed::audio::FleetIndex::UpsertDevice(Host & host, const BinaryEventCodec::Device & device, uint64_t stateVersion)
+{
+    const Device record{
+        .PnpId = strings_.Intern(device.PnpId),
+        .Name = strings_.Intern(device.Name),
+        .Flow = device.Flow,
+        .RenderVolume = device.RenderVolume,
+        .CaptureVolume = device.CaptureVolume,
+        .RenderVolumeVersion = stateVersion,
+        .CaptureVolumeVersion = stateVersion
+    };
+    if (const auto found = std::ranges::find(host.Devices, record.PnpId, &Device::PnpId)
+        ; found != host.Devices.end())
+    {
+        *found = record;
+        return;
+    }
+    host.Devices.push_back(record);
+}
+
+ed::audio::FleetIndex::Shard & ed::audio::FleetIndex::GetShard(HostId host) const
+{
+    return shards_[host % shardCount_];
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "public/SoundAgentInterface.h"
+
+#include "BinaryEventCodec.h"
+#include "StringInterner.h"
+
+
+namespace ed::audio {
+// Device state of many agents, fed by their BinaryEventCodec streams and keyed by host.
+// Hosts are spread over shards; a frame updates a single shard, so ingest scales with the threads as long
+// as they feed different hosts. Each shard indexes its hosts by the PnP id and by the name of their
+// devices and of their current defaults. Queries visit every shard. All strings are interned.
+class FleetIndex final {
+public:
+    using HostId = StringInterner::Id;
+
+    enum class DeviceKey : uint8_t { PnpId, Name };
+
+    struct Statistics {
+        uint64_t Hosts = 0;
+        uint64_t Devices = 0;
+        uint64_t FramesApplied = 0;
+        uint64_t StaleFramesDropped = 0;
+        size_t InternedStrings = 0;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(FleetIndex);
+    explicit FleetIndex(size_t shardCount = 64);
+    ~FleetIndex() = default;
+
+public:
+    HostId AddHost(std::string_view hostName);
+
+    // Applies the complete frames at the start of bytes and returns the number of bytes they take.
+    // frame is scratch space, reused to avoid allocations. Throws std::runtime_error on a malformed frame.
+    size_t Ingest(HostId host, std::string_view bytes, BinaryEventCodec::Frame & frame);
+    // A snapshot replaces the state of the host; an event not newer than the host's state is dropped.
+    // Agents deliver volume events in a lane of their own, late: a volume event is dropped only if not newer than
+    // the volumes of its device, so that it is not lost behind later device and default events.
+    void Apply(HostId host, const BinaryEventCodec::Frame & frame);
+
+    // flow: Render or Capture.
+    [[nodiscard]] std::vector<std::string_view> FindHostsWithDefault(DeviceKey key, std::string_view value, SoundDeviceFlowType flow) const;
+    [[nodiscard]] std::vector<std::string_view> FindHostsWithDevice(DeviceKey key, std::string_view value) const;
+    // flow: Render or Capture; none for an unknown host or device.
+    [[nodiscard]] std::optional<uint16_t> GetVolume(HostId host, std::string_view devicePnpId, SoundDeviceFlowType flow) const;
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    using Id = StringInterner::Id;
+    using HostsById = std::unordered_map<Id, std::unordered_set<HostId>>;
+
+    struct Device {
+        Id PnpId;
+        Id Name;
+        SoundDeviceFlowType Flow;
+        uint16_t RenderVolume;
+        uint16_t CaptureVolume;
+        // of the frames the volumes were taken from
+        uint64_t RenderVolumeVersion;
+        uint64_t CaptureVolumeVersion;
+    };
+
+    struct Host {
+        // of the newest frame applied, and of the newest one that was not a volume change of a known device
+        uint64_t StateVersion = 0;
+        uint64_t StructureVersion = 0;
+        std::vector<Device> Devices;
+        Id DefaultRender = StringInterner::no_id;
+        Id DefaultCapture = StringInterner::no_id;
+    };
+
+    struct Shard {
+        mutable std::shared_mutex Mutex;
+        std::unordered_map<HostId, Host> Hosts;
+        HostsById DevicesByPnpId;
+        HostsById DevicesByName;
+        HostsById DefaultRenderByPnpId;
+        HostsById DefaultRenderByName;
+        HostsById DefaultCaptureByPnpId;
+        HostsById DefaultCaptureByName;
+        uint64_t DeviceCount = 0;
+        uint64_t FramesApplied = 0;
+        uint64_t StaleFramesDropped = 0;
+    };
+
+    // Must be called with the shard's mutex held. add: add the host's index entries, or remove them.
+    static void UpdateIndexes(Shard & shard, HostId hostId, const Host & host, bool add);
+    // Takes the volumes older than stateVersion; returns whether there were any.
+    static bool UpdateVolumes(Device & device, const BinaryEventCodec::Device & source, uint64_t stateVersion);
+    void UpsertDevice(Host & host, const BinaryEventCodec::Device & device, uint64_t stateVersion);
+    Shard & GetShard(HostId host) const;
+
+private:
+    StringInterner strings_;
+    const std::unique_ptr<Shard[]> shards_;
+    const size_t shardCount_;
+};
+}
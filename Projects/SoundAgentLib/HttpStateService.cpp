@@ -0,0 +1,230 @@
+#include "os-dependencies.h"
+
+#include "HttpStateService.h"
+
+#include "NdjsonEventWriter.h"
+
+#include <charconv>
+#include <format>
+#include <iterator>
+
+#include <magic_enum/magic_enum.hpp>
+
+
+namespace
+{
+    constexpr std::string_view json_content_type = "application/json";
+    constexpr std::string_view metrics_content_type = "text/plain; version=0.0.4";
+}
+
+ed::audio::HttpStateService::HttpStateService(const SoundDeviceCollectionInterface & collection)
+    : collection_(collection)
+{
+}
+
+ed::audio::HttpStateService::Result ed::audio::HttpStateService::Handle(const Request & request, const ConnectionGauges & gauges)
+{
+    ++requests_;
+    if (request.Method != "GET")
+    {
+        return { .Reply = CreateErrorResponse(405, "Method Not Allowed") };
+    }
+
+    if (request.Path == "/metrics")
+    {
+        return { .Reply = Response{ .ContentType = metrics_content_type, .Body = FormatMetrics(gauges) } };
+    }
+    if (request.Path != "/devices" && request.Path != "/defaults")
+    {
+        return { .Reply = CreateErrorResponse(404, "Not Found") };
+    }
+
+    const auto waitVersion = ParseWaitVersion(request.Query);
+    if (!waitVersion.has_value())
+    {
+        return { .Reply = CreateErrorResponse(400, "Bad Request") };
+    }
+    if (waitVersion->has_value() && collection_.GetStateVersion() <= **waitVersion)
+    {
+        ++longPolls_;
+        return { .WaitAboveVersion = **waitVersion };
+    }
+
+    const auto documents = GetDocuments();
+    if (!waitVersion->has_value() && request.IfNoneMatch == std::format(R"("{}")", documents.StateVersion))
+    {
+        ++notModified_;
+        return { .Reply = Response{ .Status = 304, .Reason = "Not Modified", .ETagVersion = documents.StateVersion } };
+    }
+    return { .Reply = Response{
+        .ContentType = json_content_type,
+        .ETagVersion = documents.StateVersion,
+        .Body = request.Path == "/devices" ? documents.Devices : documents.Defaults } };
+}
+
+ed::audio::HttpStateService::Response ed::audio::HttpStateService::HandleExpiredWait(const Request &)
+{
+    ++longPollsExpired_;
+    ++notModified_;
+    return Response{ .Status = 304, .Reason = "Not Modified", .ETagVersion = collection_.GetStateVersion() };
+}
+
+uint64_t ed::audio::HttpStateService::GetStateVersion() const
+{
+    return collection_.GetStateVersion();
+}
+
+ed::audio::HttpStateService::Statistics ed::audio::HttpStateService::GetStatistics() const
+{
+    return Statistics{
+        .Requests = requests_,
+        .NotModified = notModified_,
+        .DocumentRenders = documentRenders_,
+        .LongPolls = longPolls_,
+        .LongPollsExpired = longPollsExpired_
+    };
+}
+
+void ed::audio::HttpStateService::SetStateChangedFunction(StateChangedFunctionT stateChanged)
+{
+    std::lock_guard lock(stateChangedMutex_);
+    stateChanged_ = std::move(stateChanged);
+}
+
+void ed::audio::HttpStateService::OnCollectionChanged(SoundDeviceEventType event, const std::string &, uint64_t)
+{
+    ++eventCounts_[static_cast<size_t>(event)];
+
+    std::lock_guard lock(stateChangedMutex_);
+    if (stateChanged_)
+    {
+        stateChanged_();
+    }
+}
+
+ed::audio::HttpStateService::Documents ed::audio::HttpStateService::GetDocuments()
+{
+    std::lock_guard lock(documentsMutex_);
+    if (documents_.Devices != nullptr && documents_.StateVersion >= collection_.GetStateVersion())
+    {
+        return documents_;
+    }
+
+    const auto snapshot = collection_.CreateSnapshot();
+    ++documentRenders_;
+
+    auto devices = std::make_shared<std::string>();
+    devices->reserve(64 + snapshot.Devices.size() * 192);
+    std::format_to(std::back_inserter(*devices), R"({{"version":{},"devices":[)", snapshot.StateVersion);
+    for (size_t i = 0; i < snapshot.Devices.size(); ++i)
+    {
+        if (i != 0)
+        {
+            devices->push_back(',');
+        }
+        NdjsonEventWriter::AppendDevice(*devices, *snapshot.Devices[i]);
+    }
+    devices->append("]}");
+
+    auto defaults = std::make_shared<std::string>();
+    const auto appendDefault = [&defaults, &snapshot](const std::optional<std::string> & pnpId)
+    {
+        for (const auto & device : snapshot.Devices)
+        {
+            if (pnpId.has_value() && device->GetPnpId() == *pnpId)
+            {
+                NdjsonEventWriter::AppendDevice(*defaults, *device);
+                return;
+            }
+        }
+        defaults->append("null");
+    };
+    std::format_to(std::back_inserter(*defaults), R"({{"version":{},"defaultRender":)", snapshot.StateVersion);
+    appendDefault(snapshot.DefaultRenderDevicePnpId);
+    defaults->append(R"(,"defaultCapture":)");
+    appendDefault(snapshot.DefaultCaptureDevicePnpId);
+    defaults->push_back('}');
+
+    documents_ = Documents{ .StateVersion = snapshot.StateVersion, .Devices = std::move(devices), .Defaults = std::move(defaults) };
+    return documents_;
+}
+
+std::shared_ptr<const std::string> ed::audio::HttpStateService::FormatMetrics(const ConnectionGauges & gauges) const
+{
+    auto text = std::make_shared<std::string>();
+    auto out = std::back_inserter(*text);
+
+    text->append("# HELP sound_agent_events_total Collection change events by type.\n"
+        "# TYPE sound_agent_events_total counter\n");
+    for (const auto event : magic_enum::enum_values<SoundDeviceEventType>())
+    {
+        std::format_to(out, "sound_agent_events_total{{event=\"{}\"}} {}\n",
+            magic_enum::enum_name(event), eventCounts_[static_cast<size_t>(event)].load());
+    }
+
+    const auto statistics = GetStatistics();
+    std::format_to(out,
+        "# HELP sound_agent_state_version Version of the collection state.\n"
+        "# TYPE sound_agent_state_version gauge\n"
+        "sound_agent_state_version {}\n"
+        "# HELP sound_agent_http_requests_total HTTP requests handled.\n"
+        "# TYPE sound_agent_http_requests_total counter\n"
+        "sound_agent_http_requests_total {}\n"
+        "# HELP sound_agent_http_not_modified_total Requests answered with 304 Not Modified.\n"
+        "# TYPE sound_agent_http_not_modified_total counter\n"
+        "sound_agent_http_not_modified_total {}\n"
+        "# HELP sound_agent_http_document_renders_total JSON document renderings, at most one per state version.\n"
+        "# TYPE sound_agent_http_document_renders_total counter\n"
+        "sound_agent_http_document_renders_total {}\n"
+        "# HELP sound_agent_http_long_polls_total Requests that waited for a state change.\n"
+        "# TYPE sound_agent_http_long_polls_total counter\n"
+        "sound_agent_http_long_polls_total {}\n"
+        "# HELP sound_agent_http_long_polls_expired_total Waiting requests answered at their timeout.\n"
+        "# TYPE sound_agent_http_long_polls_expired_total counter\n"
+        "sound_agent_http_long_polls_expired_total {}\n"
+        "# HELP sound_agent_http_connections Open HTTP connections.\n"
+        "# TYPE sound_agent_http_connections gauge\n"
+        "sound_agent_http_connections {}\n"
+        "# HELP sound_agent_http_long_polls_waiting Requests waiting for a state change.\n"
+        "# TYPE sound_agent_http_long_polls_waiting gauge\n"
+        "sound_agent_http_long_polls_waiting {}\n",
+        collection_.GetStateVersion(), statistics.Requests, statistics.NotModified, statistics.DocumentRenders,
+        statistics.LongPolls, statistics.LongPollsExpired, gauges.Open, gauges.Waiting);
+
+    return text;
+}
+
+// Returns nullopt if the query is malformed; an empty inner optional if there is no wait parameter.
+std::optional<std::optional<uint64_t>> ed::audio::HttpStateService::ParseWaitVersion(std::string_view query)
+{
+    constexpr std::string_view waitParameter = "wait=";
+    while (!query.empty())
+    {
+        const auto end = query.find('&');
+        const auto parameter = query.substr(0, end);
+        query = end == std::string_view::npos ? std::string_view() : query.substr(end + 1);
+
+        if (parameter.starts_with(waitParameter))
+        {
+            const auto value = parameter.substr(waitParameter.size());
+            uint64_t version = 0;
+            if (const auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(), version)
+                ; error != std::errc() || ptr != value.data() + value.size())
+            {
+                return std::nullopt;
+            }
+            return std::optional(version);
+        }
+    }
+    return std::optional<uint64_t>();
+}
+
+ed::audio::HttpStateService::Response ed::audio::HttpStateService::CreateErrorResponse(uint16_t status, std::string_view reason)
+{
+    return Response{
+        .Status = status,
+        .Reason = reason,
+        .ContentType = "text/plain",
+        .Body = std::make_shared<const std::string>(std::format("{} {}\n", status, reason))
+    };
+}
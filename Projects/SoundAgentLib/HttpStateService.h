@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "public/SoundAgentInterface.h"
+
+
+namespace ed::audio {
+// The HTTP resources of the collection, independent of the transport:
+//   GET /devices   {"version":N,"devices":[<device>...]}
+//   GET /defaults  {"version":N,"defaultRender":<device>|null,"defaultCapture":<device>|null}
+//   GET /metrics   Prometheus text format
+// <device> is the NdjsonEventWriter device object. The JSON documents are rendered once per state version
+// and served from a cache; their ETag is the state version. "?wait=<version>" makes the request wait
+// until the state version exceeds <version>; the transport parks it and asks again.
+class HttpStateService final : public SoundDeviceObserverInterface {
+public:
+    struct Request {
+        std::string_view Method;
+        std::string_view Path;
+        std::string_view Query;
+        std::string_view IfNoneMatch;
+    };
+
+    struct Response {
+        uint16_t Status = 200;
+        std::string_view Reason = "OK";
+        std::string_view ContentType;
+        // the state version the body reflects, sent as ETag
+        std::optional<uint64_t> ETagVersion;
+        std::shared_ptr<const std::string> Body;
+    };
+
+    // Either the response, or the state version the request waits to be exceeded.
+    struct Result {
+        std::optional<Response> Reply;
+        uint64_t WaitAboveVersion = 0;
+    };
+
+    // Connection figures of the transport, exported with the metrics.
+    struct ConnectionGauges {
+        size_t Open = 0;
+        size_t Waiting = 0;
+    };
+
+    struct Statistics {
+        uint64_t Requests = 0;
+        uint64_t NotModified = 0;
+        uint64_t DocumentRenders = 0;
+        uint64_t LongPolls = 0;
+        uint64_t LongPollsExpired = 0;
+    };
+
+    // Called on the delivery thread after each change; must not block.
+    using StateChangedFunctionT = std::function<void()>;
+
+public:
+    DISALLOW_COPY_MOVE(HttpStateService);
+    explicit HttpStateService(const SoundDeviceCollectionInterface & collection);
+    ~HttpStateService() override = default;
+
+public:
+    Result Handle(const Request & request, const ConnectionGauges & gauges);
+    // Answers a waiting request whose wait timed out: 304 with the current ETag.
+    Response HandleExpiredWait(const Request & request);
+    // A plain text response for errors detected by the transport as well.
+    static Response CreateErrorResponse(uint16_t status, std::string_view reason);
+
+    [[nodiscard]] uint64_t GetStateVersion() const;
+    [[nodiscard]] Statistics GetStatistics() const;
+    void SetStateChangedFunction(StateChangedFunctionT stateChanged);
+
+    void OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion) override;
+
+private:
+    struct Documents {
+        uint64_t StateVersion = 0;
+        std::shared_ptr<const std::string> Devices;
+        std::shared_ptr<const std::string> Defaults;
+    };
+
+    // Renders both documents from one snapshot, unless the cached ones are current.
+    Documents GetDocuments();
+    std::shared_ptr<const std::string> FormatMetrics(const ConnectionGauges & gauges) const;
+    static std::optional<std::optional<uint64_t>> ParseWaitVersion(std::string_view query);
+
+private:
+    const SoundDeviceCollectionInterface & collection_;
+
+    // guards documents_; held while rendering them
+    std::mutex documentsMutex_;
+    Documents documents_;
+    std::mutex stateChangedMutex_;
+    StateChangedFunctionT stateChanged_;
+
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(SoundDeviceEventType::PropertyChanged) + 1> eventCounts_{};
+    std::atomic<uint64_t> requests_ = 0;
+    std::atomic<uint64_t> notModified_ = 0;
+    std::atomic<uint64_t> documentRenders_ = 0;
+    std::atomic<uint64_t> longPolls_ = 0;
+    std::atomic<uint64_t> longPollsExpired_ = 0;
+};
+}
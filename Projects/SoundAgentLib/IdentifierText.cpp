@@ -0,0 +1,484 @@
+#include "os-dependencies.h"
+
+#include "IdentifierText.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define IDENTIFIER_TEXT_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace
+{
+    constexpr size_t guid_text_length = 36;
+    constexpr size_t guid_digit_count = 32;
+
+    // The bytes of a GUID in the order of its text: the first three fields are big-endian there.
+    using GuidBytes = std::array<uint8_t, 16>;
+
+    GuidBytes GuidToBytes(const GUID & guid)
+    {
+        return {
+            static_cast<uint8_t>(guid.Data1 >> 24), static_cast<uint8_t>(guid.Data1 >> 16),
+            static_cast<uint8_t>(guid.Data1 >> 8), static_cast<uint8_t>(guid.Data1),
+            static_cast<uint8_t>(guid.Data2 >> 8), static_cast<uint8_t>(guid.Data2),
+            static_cast<uint8_t>(guid.Data3 >> 8), static_cast<uint8_t>(guid.Data3),
+            guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+            guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]
+        };
+    }
+
+    GUID BytesToGuid(const GuidBytes & bytes)
+    {
+        GUID guid{};
+        guid.Data1 = static_cast<uint32_t>(bytes[0]) << 24 | static_cast<uint32_t>(bytes[1]) << 16
+            | static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+        guid.Data2 = static_cast<uint16_t>(bytes[4] << 8 | bytes[5]);
+        guid.Data3 = static_cast<uint16_t>(bytes[6] << 8 | bytes[7]);
+        std::memcpy(guid.Data4, bytes.data() + 8, sizeof guid.Data4);
+        return guid;
+    }
+
+    // The groups of hex digits of the text of a GUID: offset in the text and length.
+    constexpr std::array<std::pair<size_t, size_t>, 5> guid_groups = { {
+        { 0, 8 }, { 9, 4 }, { 14, 4 }, { 19, 4 }, { 24, 12 }
+    } };
+
+    // The 36 characters between the braces, if any; empty if the dashes are not in place.
+    std::string_view UnwrapGuidText(std::string_view text)
+    {
+        if (text.size() == guid_text_length + 2 && text.front() == '{' && text.back() == '}')
+        {
+            text = text.substr(1, guid_text_length);
+        }
+        if (text.size() != guid_text_length)
+        {
+            return {};
+        }
+        for (size_t i = 1; i < guid_groups.size(); ++i)
+        {
+            if (text[guid_groups[i].first - 1] != '-')
+            {
+                return {};
+            }
+        }
+        return text;
+    }
+
+    void GatherGuidDigits(std::string_view guidText, char * digits)
+    {
+        for (const auto & [offset, length] : guid_groups)
+        {
+            std::memcpy(digits, guidText.data() + offset, length);
+            digits += length;
+        }
+    }
+
+    std::string ScatterGuidDigits(const char * digits)
+    {
+        std::string text(guid_text_length, '-');
+        for (const auto & [offset, length] : guid_groups)
+        {
+            std::memcpy(text.data() + offset, digits, length);
+            digits += length;
+        }
+        return text;
+    }
+
+    int HexDigitValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if (c >= 'A' && c <= 'F')
+        {
+            return c - 'A' + 10;
+        }
+        if (c >= 'a' && c <= 'f')
+        {
+            return c - 'a' + 10;
+        }
+        return -1;
+    }
+
+    bool IsBrace(char c)
+    {
+        return c == '{' || c == '}';
+    }
+
+    // Appends the code point starting at "in" and moves past it.
+    char * AppendUtf8(const char16_t * & in, const char16_t * end, char * out)
+    {
+        uint32_t codePoint = *in++;
+        if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+        {
+            if (codePoint <= 0xDBFF && in != end && *in >= 0xDC00 && *in <= 0xDFFF)
+            {
+                codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (*in++ - 0xDC00);
+            }
+            else
+            {
+                codePoint = 0xFFFD;
+            }
+        }
+
+        if (codePoint < 0x80)
+        {
+            *out++ = static_cast<char>(codePoint);
+        }
+        else if (codePoint < 0x800)
+        {
+            *out++ = static_cast<char>(0xC0 | codePoint >> 6);
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000)
+        {
+            *out++ = static_cast<char>(0xE0 | codePoint >> 12);
+            *out++ = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            *out++ = static_cast<char>(0xF0 | codePoint >> 18);
+            *out++ = static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+            *out++ = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        return out;
+    }
+
+    // A UTF-16 code unit takes at most three bytes in UTF-8; a surrogate pair takes four.
+    constexpr size_t max_utf8_per_unit = 3;
+
+#ifdef IDENTIFIER_TEXT_SSE2
+    __m128i Load(const void * data)
+    {
+        return _mm_loadu_si128(static_cast<const __m128i *>(data));
+    }
+
+    void Store(void * data, __m128i value)
+    {
+        _mm_storeu_si128(static_cast<__m128i *>(data), value);
+    }
+
+    // 0xFF in the bytes within [low, high]; the bytes are compared signed, so both must be below 0x80.
+    __m128i BytesInRange(__m128i bytes, char low, char high)
+    {
+        return _mm_and_si128(
+            _mm_cmpgt_epi8(bytes, _mm_set1_epi8(static_cast<char>(low - 1))),
+            _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(high + 1))));
+    }
+
+    // Two bits per code unit, set for the ones below 0x80.
+    int AsciiUnitsMask(__m128i units)
+    {
+        return _mm_movemask_epi8(_mm_cmpeq_epi16(
+            _mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xFF80))), _mm_setzero_si128()));
+    }
+
+    std::string Utf16ToAsciiSse2(std::u16string_view text)
+    {
+        std::string result(text.size(), '\0');
+        const auto lowBytes = _mm_set1_epi16(0x00FF);
+        size_t i = 0;
+        for (; i + 16 <= text.size(); i += 16)
+        {
+            const auto first = _mm_and_si128(Load(text.data() + i), lowBytes);
+            const auto second = _mm_and_si128(Load(text.data() + i + 8), lowBytes);
+            Store(result.data() + i, _mm_packus_epi16(first, second));
+        }
+        for (; i < text.size(); ++i)
+        {
+            result[i] = static_cast<char>(text[i]);
+        }
+        return result;
+    }
+
+    std::string Utf16ToUtf8Sse2(std::u16string_view text)
+    {
+        std::string result(text.size() * max_utf8_per_unit, '\0');
+        auto in = text.data();
+        const auto end = in + text.size();
+        auto out = result.data();
+        while (end - in >= 8)
+        {
+            const auto units = Load(in);
+            // Packed and stored in any case: there is room for 8 bytes, and the ASCII ones are right.
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(units, units));
+            const auto asciiMask = AsciiUnitsMask(units);
+            if (asciiMask == 0xFFFF)
+            {
+                in += 8;
+                out += 8;
+                continue;
+            }
+            const auto asciiCount = std::countr_one(static_cast<unsigned>(asciiMask)) / 2;
+            in += asciiCount;
+            out += asciiCount;
+            out = AppendUtf8(in, end, out);
+        }
+        while (in != end)
+        {
+            out = AppendUtf8(in, end, out);
+        }
+        result.resize(static_cast<size_t>(out - result.data()));
+        return result;
+    }
+
+    void StripBracesSse2(std::string & text)
+    {
+        const auto data = text.data();
+        const auto open = _mm_set1_epi8('{');
+        const auto close = _mm_set1_epi8('}');
+        size_t read = 0;
+        size_t written = 0;
+        for (; read + 16 <= text.size(); read += 16)
+        {
+            const auto bytes = Load(data + read);
+            // Writing behind the read position in place: the bytes overwritten are read already.
+            if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, open), _mm_cmpeq_epi8(bytes, close))) == 0)
+            {
+                Store(data + written, bytes);
+                written += 16;
+                continue;
+            }
+            for (size_t i = read; i < read + 16; ++i)
+            {
+                if (!IsBrace(data[i]))
+                {
+                    data[written++] = data[i];
+                }
+            }
+        }
+        for (; read < text.size(); ++read)
+        {
+            if (!IsBrace(data[read]))
+            {
+                data[written++] = data[read];
+            }
+        }
+        text.resize(written);
+    }
+
+    void ToUpperAsciiSse2(std::string & text)
+    {
+        const auto data = text.data();
+        const auto caseBit = _mm_set1_epi8(0x20);
+        size_t i = 0;
+        for (; i + 16 <= text.size(); i += 16)
+        {
+            const auto bytes = Load(data + i);
+            Store(data + i, _mm_xor_si128(bytes, _mm_and_si128(BytesInRange(bytes, 'a', 'z'), caseBit)));
+        }
+        for (; i < text.size(); ++i)
+        {
+            if (data[i] >= 'a' && data[i] <= 'z')
+            {
+                data[i] = static_cast<char>(data[i] - ('a' - 'A'));
+            }
+        }
+    }
+
+    // Nibbles to '0'-'9' and 'A'-'F'.
+    __m128i NibblesToHexDigits(__m128i nibbles)
+    {
+        const auto letterOffset = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+        return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letterOffset);
+    }
+
+    std::string FormatGuidSse2(const GUID & guid)
+    {
+        const auto guidBytes = GuidToBytes(guid);
+        const auto bytes = Load(guidBytes.data());
+        const auto nibbleMask = _mm_set1_epi8(0x0F);
+        const auto high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibbleMask);
+        const auto low = _mm_and_si128(bytes, nibbleMask);
+
+        char digits[guid_digit_count];
+        Store(digits, NibblesToHexDigits(_mm_unpacklo_epi8(high, low)));
+        Store(digits + 16, NibblesToHexDigits(_mm_unpackhi_epi8(high, low)));
+        return ScatterGuidDigits(digits);
+    }
+
+    std::optional<GUID> ParseGuidSse2(std::string_view text)
+    {
+        const auto guidText = UnwrapGuidText(text);
+        if (guidText.empty())
+        {
+            return std::nullopt;
+        }
+        char digits[guid_digit_count];
+        GatherGuidDigits(guidText, digits);
+
+        __m128i halves[2];
+        for (size_t half = 0; half < 2; ++half)
+        {
+            const auto chars = Load(digits + 16 * half);
+            const auto lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+            const auto isDecimal = BytesInRange(chars, '0', '9');
+            const auto isLetter = BytesInRange(lower, 'a', 'f');
+            if (_mm_movemask_epi8(_mm_or_si128(isDecimal, isLetter)) != 0xFFFF)
+            {
+                return std::nullopt;
+            }
+            const auto values = _mm_or_si128(
+                _mm_and_si128(isDecimal, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+                _mm_and_si128(isLetter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+            // The two digits of a byte share a 16-bit lane, the high digit in its low byte.
+            halves[half] = _mm_or_si128(
+                _mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 4),
+                _mm_srli_epi16(values, 8));
+        }
+        GuidBytes bytes;
+        Store(bytes.data(), _mm_packus_epi16(halves[0], halves[1]));
+        return BytesToGuid(bytes);
+    }
+#endif
+}
+
+
+std::string ed::audio::IdentifierText::Utf16ToAscii(std::u16string_view text)
+{
+#ifdef IDENTIFIER_TEXT_SSE2
+    return Utf16ToAsciiSse2(text);
+#else
+    return Utf16ToAsciiScalar(text);
+#endif
+}
+
+std::string ed::audio::IdentifierText::Utf16ToUtf8(std::u16string_view text)
+{
+#ifdef IDENTIFIER_TEXT_SSE2
+    return Utf16ToUtf8Sse2(text);
+#else
+    return Utf16ToUtf8Scalar(text);
+#endif
+}
+
+void ed::audio::IdentifierText::StripBraces(std::string & text)
+{
+#ifdef IDENTIFIER_TEXT_SSE2
+    StripBracesSse2(text);
+#else
+    StripBracesScalar(text);
+#endif
+}
+
+void ed::audio::IdentifierText::ToUpperAscii(std::string & text)
+{
+#ifdef IDENTIFIER_TEXT_SSE2
+    ToUpperAsciiSse2(text);
+#else
+    ToUpperAsciiScalar(text);
+#endif
+}
+
+std::string ed::audio::IdentifierText::FormatGuid(const GUID & guid)
+{
+#ifdef IDENTIFIER_TEXT_SSE2
+    return FormatGuidSse2(guid);
+#else
+    return FormatGuidScalar(guid);
+#endif
+}
+
+std::optional<GUID> ed::audio::IdentifierText::ParseGuid(std::string_view text)
+{
+#ifdef IDENTIFIER_TEXT_SSE2
+    return ParseGuidSse2(text);
+#else
+    return ParseGuidScalar(text);
+#endif
+}
+
+bool ed::audio::IdentifierText::IsVectorized()
+{
+#ifdef IDENTIFIER_TEXT_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string ed::audio::IdentifierText::Utf16ToAsciiScalar(std::u16string_view text)
+{
+    std::string result(text.size(), '\0');
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        result[i] = static_cast<char>(text[i]);
+    }
+    return result;
+}
+
+std::string ed::audio::IdentifierText::Utf16ToUtf8Scalar(std::u16string_view text)
+{
+    std::string result(text.size() * max_utf8_per_unit, '\0');
+    auto in = text.data();
+    const auto end = in + text.size();
+    auto out = result.data();
+    while (in != end)
+    {
+        out = AppendUtf8(in, end, out);
+    }
+    result.resize(static_cast<size_t>(out - result.data()));
+    return result;
+}
+
+void ed::audio::IdentifierText::StripBracesScalar(std::string & text)
+{
+    std::erase_if(text, IsBrace);
+}
+
+void ed::audio::IdentifierText::ToUpperAsciiScalar(std::string & text)
+{
+    for (auto & c : text)
+    {
+        if (c >= 'a' && c <= 'z')
+        {
+            c = static_cast<char>(c - ('a' - 'A'));
+        }
+    }
+}
+
+std::string ed::audio::IdentifierText::FormatGuidScalar(const GUID & guid)
+{
+    constexpr auto hexDigits = "0123456789ABCDEF";
+    char digits[guid_digit_count];
+    const auto bytes = GuidToBytes(guid);
+    for (size_t i = 0; i < bytes.size(); ++i)
+    {
+        digits[2 * i] = hexDigits[bytes[i] >> 4];
+        digits[2 * i + 1] = hexDigits[bytes[i] & 0x0F];
+    }
+    return ScatterGuidDigits(digits);
+}
+
+std::optional<GUID> ed::audio::IdentifierText::ParseGuidScalar(std::string_view text)
+{
+    const auto guidText = UnwrapGuidText(text);
+    if (guidText.empty())
+    {
+        return std::nullopt;
+    }
+    char digits[guid_digit_count];
+    GatherGuidDigits(guidText, digits);
+
+    GuidBytes bytes;
+    for (size_t i = 0; i < bytes.size(); ++i)
+    {
+        const auto high = HexDigitValue(digits[2 * i]);
+        const auto low = HexDigitValue(digits[2 * i + 1]);
+        if (high < 0 || low < 0)
+        {
+            return std::nullopt;
+        }
+        bytes[i] = static_cast<uint8_t>(high << 4 | low);
+    }
+    return BytesToGuid(bytes);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <guiddef.h>
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+
+namespace ed::audio {
+// Conversions on the hot path of every endpoint callback: wide endpoint ids and names to narrow strings,
+// the PnP id form of endpoint ids, and container GUIDs to and from text.
+// The kernels work on 16 bytes at a time with SSE2, which every x64 processor has; elsewhere, and for the tails,
+// the scalar versions run. The scalar versions are public, so that tests can check the two give the same results.
+class IdentifierText final {
+public:
+    DISALLOW_COPY_MOVE(IdentifierText);
+    IdentifierText() = delete;
+    ~IdentifierText() = delete;
+
+public:
+    // Keeps the low byte of each code unit, as WString2StringTruncate: meant for ASCII text like endpoint ids.
+    [[nodiscard]] static std::string Utf16ToAscii(std::u16string_view text);
+    // Lone surrogates become U+FFFD, as with WideCharToMultiByte.
+    [[nodiscard]] static std::string Utf16ToUtf8(std::u16string_view text);
+    // Removes '{' and '}'.
+    static void StripBraces(std::string & text);
+    // Only 'a' to 'z' change, as with std::toupper in the "C" locale.
+    static void ToUpperAscii(std::string & text);
+    // "XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX" in upper case: StringFromGUID2 without the braces.
+    [[nodiscard]] static std::string FormatGuid(const GUID & guid);
+    // Takes the form of FormatGuid, in either case, with or without braces.
+    [[nodiscard]] static std::optional<GUID> ParseGuid(std::string_view text);
+
+    // wchar_t is UTF-16 on Windows.
+    [[nodiscard]] static std::string Utf16ToAscii(std::wstring_view text) { return Utf16ToAscii(ToUtf16(text)); }
+    [[nodiscard]] static std::string Utf16ToUtf8(std::wstring_view text) { return Utf16ToUtf8(ToUtf16(text)); }
+
+    [[nodiscard]] static bool IsVectorized();
+
+    [[nodiscard]] static std::string Utf16ToAsciiScalar(std::u16string_view text);
+    [[nodiscard]] static std::string Utf16ToUtf8Scalar(std::u16string_view text);
+    static void StripBracesScalar(std::string & text);
+    static void ToUpperAsciiScalar(std::string & text);
+    [[nodiscard]] static std::string FormatGuidScalar(const GUID & guid);
+    [[nodiscard]] static std::optional<GUID> ParseGuidScalar(std::string_view text);
+
+private:
+    static std::u16string_view ToUtf16(std::wstring_view text)
+    {
+        static_assert(sizeof(wchar_t) == sizeof(char16_t));
+        return { reinterpret_cast<const char16_t *>(text.data()), text.size() };
+    }
+};
+}
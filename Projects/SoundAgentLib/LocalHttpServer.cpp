@@ -0,0 +1,502 @@
+#include "os-dependencies.h"
+
+#include "LocalHttpServer.h"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+
+namespace
+{
+    constexpr size_t max_request_header_bytes = 8 * 1024;
+    constexpr size_t max_connections = 4096;
+    constexpr size_t receive_chunk_bytes = 4096;
+
+    bool SetNonBlocking(SOCKET socket)
+    {
+        u_long nonBlocking = 1;
+        return ioctlsocket(socket, FIONBIO, &nonBlocking) == 0;
+    }
+
+    bool EqualsIgnoreCase(std::string_view left, std::string_view right)
+    {
+        return std::ranges::equal(left, right, [](char l, char r)
+        {
+            return std::tolower(static_cast<unsigned char>(l)) == std::tolower(static_cast<unsigned char>(r));
+        });
+    }
+
+    std::string_view Trim(std::string_view value)
+    {
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+        {
+            value.remove_prefix(1);
+        }
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+        {
+            value.remove_suffix(1);
+        }
+        return value;
+    }
+}
+
+struct ed::audio::LocalHttpServer::PendingRequest {
+    std::string Method;
+    std::string Path;
+    std::string Query;
+    std::string IfNoneMatch;
+    bool CloseAfterResponse = false;
+    std::chrono::steady_clock::time_point WaitDeadline;
+
+    [[nodiscard]] HttpStateService::Request AsServiceRequest() const
+    {
+        return { .Method = Method, .Path = Path, .Query = Query, .IfNoneMatch = IfNoneMatch };
+    }
+
+    // Parses the request line and header fields, without the blank line.
+    static std::optional<PendingRequest> Parse(std::string_view header)
+    {
+        const auto lineEnd = header.find("\r\n");
+        const auto requestLine = header.substr(0, lineEnd);
+        header = lineEnd == std::string_view::npos ? std::string_view() : header.substr(lineEnd + 2);
+
+        const auto methodEnd = requestLine.find(' ');
+        const auto targetEnd = requestLine.rfind(' ');
+        if (methodEnd == std::string_view::npos || targetEnd == methodEnd)
+        {
+            return std::nullopt;
+        }
+        const auto target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        const auto version = requestLine.substr(targetEnd + 1);
+        if (!target.starts_with('/') || (version != "HTTP/1.1" && version != "HTTP/1.0"))
+        {
+            return std::nullopt;
+        }
+
+        PendingRequest request;
+        request.Method = requestLine.substr(0, methodEnd);
+        const auto queryStart = target.find('?');
+        request.Path = target.substr(0, queryStart);
+        if (queryStart != std::string_view::npos)
+        {
+            request.Query = target.substr(queryStart + 1);
+        }
+        request.CloseAfterResponse = version == "HTTP/1.0";
+
+        while (!header.empty())
+        {
+            const auto end = header.find("\r\n");
+            const auto field = header.substr(0, end);
+            header = end == std::string_view::npos ? std::string_view() : header.substr(end + 2);
+
+            const auto colon = field.find(':');
+            if (colon == std::string_view::npos)
+            {
+                return std::nullopt;
+            }
+            const auto name = field.substr(0, colon);
+            const auto value = Trim(field.substr(colon + 1));
+            if (EqualsIgnoreCase(name, "Connection"))
+            {
+                if (EqualsIgnoreCase(value, "close"))
+                {
+                    request.CloseAfterResponse = true;
+                }
+                else if (EqualsIgnoreCase(value, "keep-alive"))
+                {
+                    request.CloseAfterResponse = false;
+                }
+            }
+            else if (EqualsIgnoreCase(name, "If-None-Match"))
+            {
+                request.IfNoneMatch = value;
+            }
+            else if ((EqualsIgnoreCase(name, "Content-Length") && value != "0") || EqualsIgnoreCase(name, "Transfer-Encoding"))
+            {
+                // request bodies are not supported
+                return std::nullopt;
+            }
+        }
+        return request;
+    }
+};
+
+struct ed::audio::LocalHttpServer::Connection {
+    SOCKET Socket = INVALID_SOCKET;
+    std::string Input;
+    std::string Output;
+    size_t OutputSent = 0;
+    bool CloseWhenSent = false;
+    bool Closed = false;
+    // the request waiting for a state change
+    std::optional<PendingRequest> Waiting;
+    uint64_t WaitAboveVersion = 0;
+
+    void AppendResponse(const HttpStateService::Response & response, bool close)
+    {
+        auto out = std::back_inserter(Output);
+        std::format_to(out, "HTTP/1.1 {} {}\r\n", response.Status, response.Reason);
+        if (response.Body != nullptr)
+        {
+            std::format_to(out, "Content-Type: {}\r\nContent-Length: {}\r\n", response.ContentType, response.Body->size());
+        }
+        if (response.ETagVersion.has_value())
+        {
+            std::format_to(out, "ETag: \"{}\"\r\n", *response.ETagVersion);
+        }
+        Output.append("Cache-Control: no-cache\r\n");
+        if (close)
+        {
+            Output.append("Connection: close\r\n");
+            CloseWhenSent = true;
+        }
+        Output.append("\r\n");
+        if (response.Body != nullptr)
+        {
+            Output.append(*response.Body);
+        }
+    }
+};
+
+ed::audio::LocalHttpServer::LocalHttpServer(HttpStateService & service, uint16_t port, std::chrono::milliseconds longPollTimeout)
+    : service_(service)
+    , longPollTimeout_(longPollTimeout)
+    , listener_(INVALID_SOCKET)
+    , wakeUpSocket_(INVALID_SOCKET)
+{
+    WSADATA wsaData;
+    if (const auto error = WSAStartup(MAKEWORD(2, 2), &wsaData)
+        ; error != 0)
+    {
+        throw std::runtime_error(std::format("WSAStartup failed, error {}.", error));
+    }
+
+    const auto fail = [this](std::string_view what)
+    {
+        const auto error = WSAGetLastError();
+        CloseSockets();
+        WSACleanup();
+        throw std::runtime_error(std::format("HTTP listener: {} failed, error {}.", what, error));
+    };
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    int addressLength = sizeof(address);
+
+    const auto listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    listener_ = static_cast<SocketT>(listener);
+    constexpr BOOL exclusive = TRUE;
+    if (listener == INVALID_SOCKET
+        || setsockopt(listener, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<const char *>(&exclusive), sizeof(exclusive)) != 0
+        || bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0
+        || listen(listener, SOMAXCONN) != 0
+        || getsockname(listener, reinterpret_cast<sockaddr *>(&address), &addressLength) != 0
+        || !SetNonBlocking(listener))
+    {
+        fail("listen");
+    }
+    port_ = ntohs(address.sin_port);
+
+    address.sin_port = 0;
+    addressLength = sizeof(address);
+    const auto wakeUpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    wakeUpSocket_ = static_cast<SocketT>(wakeUpSocket);
+    if (wakeUpSocket == INVALID_SOCKET
+        || bind(wakeUpSocket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0
+        || getsockname(wakeUpSocket, reinterpret_cast<sockaddr *>(&address), &addressLength) != 0
+        || connect(wakeUpSocket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0
+        || !SetNonBlocking(wakeUpSocket))
+    {
+        fail("wake-up socket set-up");
+    }
+
+    service_.SetStateChangedFunction([this] { WakeUp(); });
+    loop_ = std::thread(&LocalHttpServer::Run, this);
+    spdlog::info("HTTP listener on 127.0.0.1:{}.", port_);
+}
+
+ed::audio::LocalHttpServer::~LocalHttpServer()
+{
+    service_.SetStateChangedFunction(nullptr);
+    stopRequested_ = true;
+    WakeUp();
+    loop_.join();
+
+    CloseSockets();
+    WSACleanup();
+}
+
+uint16_t ed::audio::LocalHttpServer::GetPort() const
+{
+    return port_;
+}
+
+void ed::audio::LocalHttpServer::WakeUp()
+{
+    if (!wakeUpPending_.exchange(true))
+    {
+        constexpr char signal = 0;
+        send(static_cast<SOCKET>(wakeUpSocket_), &signal, 1, 0);
+    }
+}
+
+void ed::audio::LocalHttpServer::CloseSockets() const
+{
+    if (static_cast<SOCKET>(wakeUpSocket_) != INVALID_SOCKET)
+    {
+        closesocket(static_cast<SOCKET>(wakeUpSocket_));
+    }
+    if (static_cast<SOCKET>(listener_) != INVALID_SOCKET)
+    {
+        closesocket(static_cast<SOCKET>(listener_));
+    }
+}
+
+void ed::audio::LocalHttpServer::Run()
+{
+    std::vector<WSAPOLLFD> pollFds;
+    while (!stopRequested_)
+    {
+        pollFds.clear();
+        pollFds.push_back({ .fd = static_cast<SOCKET>(listener_), .events = POLLRDNORM, .revents = 0 });
+        pollFds.push_back({ .fd = static_cast<SOCKET>(wakeUpSocket_), .events = POLLRDNORM, .revents = 0 });
+        auto nearestDeadline = std::chrono::steady_clock::time_point::max();
+        for (const auto & connection : connections_)
+        {
+            SHORT events = 0;
+            if (connection->Input.size() <= max_request_header_bytes)
+            {
+                events |= POLLRDNORM;
+            }
+            if (connection->OutputSent < connection->Output.size())
+            {
+                events |= POLLWRNORM;
+            }
+            if (connection->Waiting.has_value())
+            {
+                nearestDeadline = (std::min)(nearestDeadline, connection->Waiting->WaitDeadline);
+            }
+            pollFds.push_back({ .fd = connection->Socket, .events = events, .revents = 0 });
+        }
+
+        int timeoutMs = -1;
+        if (nearestDeadline != std::chrono::steady_clock::time_point::max())
+        {
+            const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(nearestDeadline - std::chrono::steady_clock::now());
+            timeoutMs = static_cast<int>(std::clamp<int64_t>(remaining.count(), 0, INT_MAX));
+        }
+        if (WSAPoll(pollFds.data(), static_cast<ULONG>(pollFds.size()), timeoutMs) == SOCKET_ERROR)
+        {
+            spdlog::error("HTTP listener: WSAPoll failed, error {}.", WSAGetLastError());
+            break;
+        }
+
+        if (pollFds[1].revents != 0)
+        {
+            wakeUpPending_ = false;
+            char signals[64];
+            while (recv(static_cast<SOCKET>(wakeUpSocket_), signals, sizeof(signals), 0) > 0)
+            {
+            }
+            const auto stateVersion = service_.GetStateVersion();
+            for (const auto & connection : connections_)
+            {
+                if (connection->Waiting.has_value() && connection->WaitAboveVersion < stateVersion)
+                {
+                    Resume(*connection, false);
+                }
+            }
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < connections_.size(); ++i)
+        {
+            auto & connection = *connections_[i];
+            if ((pollFds[i + 2].revents & (POLLRDNORM | POLLHUP | POLLERR)) != 0)
+            {
+                Receive(connection);
+            }
+            if (connection.Waiting.has_value() && connection.Waiting->WaitDeadline <= now)
+            {
+                Resume(connection, true);
+            }
+            ProcessInput(connection);
+            Send(connection);
+        }
+
+        std::erase_if(connections_, [this](const std::unique_ptr<Connection> & connection)
+        {
+            if (!connection->Closed)
+            {
+                return false;
+            }
+            if (connection->Waiting.has_value())
+            {
+                --waitingCount_;
+            }
+            closesocket(connection->Socket);
+            return true;
+        });
+
+        if (pollFds[0].revents != 0)
+        {
+            Accept();
+        }
+    }
+
+    for (const auto & connection : connections_)
+    {
+        closesocket(connection->Socket);
+    }
+    connections_.clear();
+    waitingCount_ = 0;
+}
+
+void ed::audio::LocalHttpServer::Accept()
+{
+    for (;;)
+    {
+        const auto socket = accept(static_cast<SOCKET>(listener_), nullptr, nullptr);
+        if (socket == INVALID_SOCKET)
+        {
+            return;
+        }
+        if (connections_.size() >= max_connections || !SetNonBlocking(socket))
+        {
+            spdlog::warn("HTTP listener: connection rejected, {} connections open.", connections_.size());
+            closesocket(socket);
+            continue;
+        }
+        constexpr BOOL noDelay = TRUE;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&noDelay), sizeof(noDelay));
+
+        auto connection = std::make_unique<Connection>();
+        connection->Socket = socket;
+        connections_.push_back(std::move(connection));
+    }
+}
+
+void ed::audio::LocalHttpServer::Receive(Connection & connection) const
+{
+    char buffer[receive_chunk_bytes];
+    while (connection.Input.size() <= max_request_header_bytes)
+    {
+        const auto received = recv(connection.Socket, buffer, sizeof(buffer), 0);
+        if (received > 0)
+        {
+            connection.Input.append(buffer, static_cast<size_t>(received));
+            continue;
+        }
+        // 0: the client closed its side; an answer could not be delivered anymore
+        if (received == 0 || WSAGetLastError() != WSAEWOULDBLOCK)
+        {
+            connection.Closed = true;
+        }
+        return;
+    }
+}
+
+void ed::audio::LocalHttpServer::ProcessInput(Connection & connection)
+{
+    while (!connection.Closed && !connection.CloseWhenSent && !connection.Waiting.has_value())
+    {
+        const auto headerEnd = connection.Input.find("\r\n\r\n");
+        if (headerEnd == std::string::npos)
+        {
+            if (connection.Input.size() > max_request_header_bytes)
+            {
+                connection.AppendResponse(HttpStateService::CreateErrorResponse(431, "Request Header Fields Too Large"), true);
+            }
+            return;
+        }
+
+        auto request = PendingRequest::Parse(std::string_view(connection.Input).substr(0, headerEnd));
+        connection.Input.erase(0, headerEnd + 4);
+        if (!request.has_value())
+        {
+            connection.AppendResponse(HttpStateService::CreateErrorResponse(400, "Bad Request"), true);
+            return;
+        }
+        Answer(connection, std::move(*request));
+    }
+}
+
+void ed::audio::LocalHttpServer::Answer(Connection & connection, PendingRequest request)
+{
+    const auto result = service_.Handle(request.AsServiceRequest(),
+        { .Open = connections_.size(), .Waiting = waitingCount_ });
+    if (result.Reply.has_value())
+    {
+        connection.AppendResponse(*result.Reply, request.CloseAfterResponse);
+        return;
+    }
+
+    request.WaitDeadline = std::chrono::steady_clock::now() + longPollTimeout_;
+    connection.WaitAboveVersion = result.WaitAboveVersion;
+    connection.Waiting = std::move(request);
+    ++waitingCount_;
+}
+
+void ed::audio::LocalHttpServer::Resume(Connection & connection, bool expired)
+{
+    auto request = std::move(*connection.Waiting);
+    connection.Waiting.reset();
+    --waitingCount_;
+
+    if (expired)
+    {
+        connection.AppendResponse(service_.HandleExpiredWait(request.AsServiceRequest()), request.CloseAfterResponse);
+    }
+    else
+    {
+        Answer(connection, std::move(request));
+    }
+}
+
+void ed::audio::LocalHttpServer::Send(Connection & connection)
+{
+    while (!connection.Closed && connection.OutputSent < connection.Output.size())
+    {
+        const auto remaining = (std::min)(connection.Output.size() - connection.OutputSent, static_cast<size_t>(INT_MAX));
+        const auto sent = send(connection.Socket, connection.Output.data() + connection.OutputSent, static_cast<int>(remaining), 0);
+        if (sent > 0)
+        {
+            connection.OutputSent += static_cast<size_t>(sent);
+        }
+        else if (WSAGetLastError() == WSAEWOULDBLOCK)
+        {
+            return;
+        }
+        else
+        {
+            connection.Closed = true;
+        }
+    }
+
+    if (connection.OutputSent != 0 && connection.OutputSent == connection.Output.size())
+    {
+        connection.Output.clear();
+        connection.OutputSent = 0;
+        if (connection.CloseWhenSent)
+        {
+            shutdown(connection.Socket, SD_SEND);
+            connection.Closed = true;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "HttpStateService.h"
+
+
+namespace ed::audio {
+// Minimal HTTP/1.1 server for HttpStateService on the loopback interface.
+// A single thread multiplexes all connections with WSAPoll, so a waiting long-poll costs a connection entry
+// and no thread. Only GET requests without a body are accepted; keep-alive and pipelined requests are
+// answered in order. A waiting request is resumed when the state changes, or answered with 304 at its timeout.
+class LocalHttpServer final {
+public:
+    DISALLOW_COPY_MOVE(LocalHttpServer);
+    // port 0 picks a free one. Throws std::runtime_error if the listener can not be set up.
+    LocalHttpServer(HttpStateService & service, uint16_t port, std::chrono::milliseconds longPollTimeout);
+    // Closes all connections, waiting requests included.
+    ~LocalHttpServer();
+
+public:
+    [[nodiscard]] uint16_t GetPort() const;
+
+private:
+    // SOCKET, kept out of this header
+    using SocketT = uintptr_t;
+    struct Connection;
+    struct PendingRequest;
+
+    void Run();
+    void WakeUp();
+    void CloseSockets() const;
+
+    void Accept();
+    void Receive(Connection & connection) const;
+    void ProcessInput(Connection & connection);
+    void Answer(Connection & connection, PendingRequest request);
+    void Resume(Connection & connection, bool expired);
+    static void Send(Connection & connection);
+
+private:
+    HttpStateService & service_;
+    const std::chrono::milliseconds longPollTimeout_;
+    SocketT listener_;
+    // a UDP socket connected to itself; a datagram wakes the loop up
+    SocketT wakeUpSocket_;
+    uint16_t port_ = 0;
+
+    std::atomic<bool> wakeUpPending_ = false;
+    std::atomic<bool> stopRequested_ = false;
+
+    // used by the loop thread only
+    std::vector<std::unique_ptr<Connection>> connections_;
+    size_t waitingCount_ = 0;
+
+    std::thread loop_;
+};
+}
@@ -1,7 +1,7 @@
 ﻿// ReSharper disable CppClangTidyClangDiagnosticLanguageExtensionToken
 #pragma once
 
-#include <cassert>
+#include <atomic>
 #include <endpointvolume.h>
 #include <mmdeviceapi.h>
 
@@ -17,14 +17,28 @@ public:
 
 private:
     LONG ref_ = 1;
-    IMMDeviceEnumerator * enumerator_ = nullptr;
+    // written once the system enumerator is created late, while the collection may read it
+    std::atomic<IMMDeviceEnumerator *> enumerator_ = nullptr;
+    bool usesSystemEnumerator_ = false;
+    std::atomic<bool> notificationsRegistered_ = false;
 
 public:
+    // Without the system enumerator, e.g. on hosts where the audio service is locked down, the client is
+    // left without one; see TryCreateSystemEnumerator.
     MultipleNotificationClient()
+        : usesSystemEnumerator_(true)
     {
-        const auto hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&enumerator_));
-        assert(SUCCEEDED(hr));
+        TryCreateSystemEnumerator();
+    }
 
+    // Uses the given enumerator instead of the system one, e.g. a simulated endpoint stack.
+    explicit MultipleNotificationClient(IMMDeviceEnumerator * enumerator)
+        : enumerator_(enumerator)
+    {
+        if (enumerator != nullptr)
+        {
+            enumerator->AddRef();
+        }
         RegisterEnumerator();
     }
 
@@ -108,26 +122,60 @@ public:
 protected:
     [[nodiscard]] IMMDeviceEnumerator* GetEnumeratorOrNull() const noexcept
     {
-        return enumerator_; // nullptr if unavailable
+        return enumerator_.load(); // nullptr if unavailable
+    }
+
+    // False if there is no enumerator or it refused the endpoint notification callback: then nothing tells
+    // about changes, and the content must be polled.
+    [[nodiscard]] bool AreNotificationsRegistered() const noexcept
+    {
+        return notificationsRegistered_.load();
+    }
+
+    // Creates and registers the system enumerator if there is none yet, e.g. when the audio service was not up
+    // at construction. False if there still is none; a given enumerator is never replaced.
+    bool TryCreateSystemEnumerator()
+    {
+        if (enumerator_.load() != nullptr)
+        {
+            return true;
+        }
+        if (!usesSystemEnumerator_)
+        {
+            return false;
+        }
+        IMMDeviceEnumerator * enumerator = nullptr;
+        if (FAILED(CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&enumerator))))
+        {
+            return false;
+        }
+        if (IMMDeviceEnumerator * expected = nullptr; !enumerator_.compare_exchange_strong(expected, enumerator))
+        {
+            enumerator->Release();
+            return true;
+        }
+        RegisterEnumerator();
+        return true;
     }
 
 private:
     void RegisterEnumerator()
     {
-        if (enumerator_ != nullptr)
+        if (auto * enumerator = enumerator_.load(); enumerator != nullptr)
         {
-            // ReSharper disable once CppFunctionResultShouldBeUsed
-            enumerator_->RegisterEndpointNotificationCallback(this);
+            notificationsRegistered_ = SUCCEEDED(enumerator->RegisterEndpointNotificationCallback(this));
         }
     }
     void UnregisterEnumerator()
     {
-        if (enumerator_ != nullptr)
+        if (auto * enumerator = enumerator_.exchange(nullptr); enumerator != nullptr)
         {
-            // ReSharper disable once CppFunctionResultShouldBeUsed
-            enumerator_->UnregisterEndpointNotificationCallback(this);
-            enumerator_->Release();
-            enumerator_ = nullptr;
+            if (notificationsRegistered_.exchange(false))
+            {
+                // ReSharper disable once CppFunctionResultShouldBeUsed
+                enumerator->UnregisterEndpointNotificationCallback(this);
+            }
+            enumerator->Release();
         }
     }
 
@@ -0,0 +1,142 @@
+#include "os-dependencies.h"
+
+#include "NdjsonEventWriter.h"
+
+#include <format>
+#include <iterator>
+
+#include <magic_enum/magic_enum.hpp>
+
+
+ed::audio::NdjsonEventWriter::NdjsonEventWriter(const SoundDeviceCollectionInterface & collection, BufferedLineWriter & output)
+    : collection_(collection)
+    , output_(output)
+{
+    line_.reserve(512);
+}
+
+void ed::audio::NdjsonEventWriter::WriteSnapshot()
+{
+    const auto snapshot = collection_.CreateSnapshot();
+    snapshotVersion_ = snapshot.StateVersion;
+    output_.WriteLine(FormatSnapshot(snapshot));
+}
+
+void ed::audio::NdjsonEventWriter::OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion)
+{
+    if (event == SoundDeviceEventType::ContentReset)
+    {
+        WriteSnapshot();
+        return;
+    }
+    if (stateVersion <= snapshotVersion_)
+    {
+        return;
+    }
+
+    line_.clear();
+    line_.append(R"({"type":"event","event":)");
+    AppendJsonString(line_, magic_enum::enum_name(event));
+    std::format_to(std::back_inserter(line_), R"(,"version":{},"pnpId":)", stateVersion);
+    AppendJsonString(line_, devicePnpId);
+
+    if (event == SoundDeviceEventType::Discovered
+        || event == SoundDeviceEventType::PropertyChanged
+        || event == SoundDeviceEventType::VolumeRenderChanged
+        || event == SoundDeviceEventType::VolumeCaptureChanged)
+    {
+        if (const auto device = collection_.CreateItem(devicePnpId)
+            ; device != nullptr)
+        {
+            line_.append(R"(,"device":)");
+            AppendDevice(line_, *device);
+        }
+    }
+    line_.push_back('}');
+
+    output_.WriteLine(line_);
+}
+
+std::string ed::audio::NdjsonEventWriter::FormatSnapshot(const SoundDeviceCollectionSnapshot & snapshot)
+{
+    std::string line;
+    line.reserve(128 + snapshot.Devices.size() * 192);
+
+    const auto appendOptional = [&line](const std::optional<std::string> & value)
+    {
+        if (value.has_value())
+        {
+            AppendJsonString(line, *value);
+        }
+        else
+        {
+            line.append("null");
+        }
+    };
+
+    std::format_to(std::back_inserter(line), R"({{"type":"snapshot","version":{},"defaultRender":)", snapshot.StateVersion);
+    appendOptional(snapshot.DefaultRenderDevicePnpId);
+    line.append(R"(,"defaultCapture":)");
+    appendOptional(snapshot.DefaultCaptureDevicePnpId);
+    line.append(R"(,"devices":[)");
+    for (size_t i = 0; i < snapshot.Devices.size(); ++i)
+    {
+        if (i != 0)
+        {
+            line.push_back(',');
+        }
+        AppendDevice(line, *snapshot.Devices[i]);
+    }
+    line.append("]}");
+
+    return line;
+}
+
+void ed::audio::NdjsonEventWriter::AppendDevice(std::string & out, const SoundDeviceInterface & device)
+{
+    out.append(R"({"pnpId":)");
+    AppendJsonString(out, device.GetPnpId());
+    out.append(R"(,"name":)");
+    AppendJsonString(out, device.GetName());
+    out.append(R"(,"flow":)");
+    AppendJsonString(out, magic_enum::enum_name(device.GetFlow()));
+    std::format_to(std::back_inserter(out), R"(,"renderVolume":{},"captureVolume":{}}})",
+        device.GetCurrentRenderVolume(), device.GetCurrentCaptureVolume());
+}
+
+void ed::audio::NdjsonEventWriter::AppendJsonString(std::string & out, std::string_view value)
+{
+    out.push_back('"');
+    for (const char c : value)
+    {
+        switch (c)
+        {
+        case '"':
+            out.append(R"(\")");
+            break;
+        case '\\':
+            out.append(R"(\\)");
+            break;
+        case '\n':
+            out.append(R"(\n)");
+            break;
+        case '\r':
+            out.append(R"(\r)");
+            break;
+        case '\t':
+            out.append(R"(\t)");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                std::format_to(std::back_inserter(out), R"(\u{:04x})", static_cast<unsigned>(c));
+            }
+            else
+            {
+                // UTF-8 multibyte sequences pass unchanged
+                out.push_back(c);
+            }
+        }
+    }
+    out.push_back('"');
+}
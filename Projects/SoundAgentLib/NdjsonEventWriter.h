@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "public/SoundAgentInterface.h"
+
+#include "BufferedLineWriter.h"
+
+
+namespace ed::audio {
+// Streams the collection as newline-delimited JSON: one snapshot line, then one line per change
+// carrying only the device concerned. A ContentReset is written as a new snapshot.
+// Lines:
+//   {"type":"snapshot","version":N,"defaultRender":"<id>"|null,"defaultCapture":"<id>"|null,"devices":[<device>...]}
+//   {"type":"event","event":"<SoundDeviceEventType>","version":N,"pnpId":"<id>"[,"device":<device>]}
+//   <device> = {"pnpId":"..","name":"..","flow":"Render","renderVolume":N,"captureVolume":N}
+class NdjsonEventWriter final : public SoundDeviceObserverInterface {
+public:
+    DISALLOW_COPY_MOVE(NdjsonEventWriter);
+    NdjsonEventWriter(const SoundDeviceCollectionInterface & collection, BufferedLineWriter & output);
+    ~NdjsonEventWriter() override = default;
+
+public:
+    // Subscribe before writing the snapshot: events already reflected in it are skipped by their version.
+    void WriteSnapshot();
+
+    void OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion) override;
+
+    static void AppendJsonString(std::string & out, std::string_view value);
+    static void AppendDevice(std::string & out, const SoundDeviceInterface & device);
+    static std::string FormatSnapshot(const SoundDeviceCollectionSnapshot & snapshot);
+
+private:
+    const SoundDeviceCollectionInterface & collection_;
+    BufferedLineWriter & output_;
+    std::atomic<uint64_t> snapshotVersion_ = 0;
+    // reused by the delivery thread, which is the only one calling OnCollectionChanged
+    std::string line_;
+};
+}
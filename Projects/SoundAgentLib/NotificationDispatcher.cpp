@@ -0,0 +1,189 @@
+#include "os-dependencies.h"
+
+#include "NotificationDispatcher.h"
+
+#include <spdlog/spdlog.h>
+
+
+ed::audio::NotificationDispatcher::NotificationDispatcher(DeliverFunctionT deliverFunc)
+    : deliverFunc_(std::move(deliverFunc))
+    , worker_(&NotificationDispatcher::Run, this)
+{
+}
+
+ed::audio::NotificationDispatcher::~NotificationDispatcher()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopRequested_ = true;
+    }
+    wakeUp_.notify_all();
+    worker_.join();
+}
+
+bool ed::audio::NotificationDispatcher::IsHighPriority(SoundDeviceEventType event)
+{
+    return event != SoundDeviceEventType::VolumeRenderChanged && event != SoundDeviceEventType::VolumeCaptureChanged;
+}
+
+void ed::audio::NotificationDispatcher::Post(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion)
+{
+    {
+        std::lock_guard lock(mutex_);
+        ++statistics_.Posted;
+
+        if (IsHighPriority(event))
+        {
+            if (event == SoundDeviceEventType::Detached)
+            {
+                DiscardPendingVolumeEvents(devicePnpId);
+            }
+            else if (event == SoundDeviceEventType::ContentReset)
+            {
+                DiscardAllPendingVolumeEvents();
+            }
+            highPriorityLane_.push_back({ event, devicePnpId, stateVersion });
+        }
+        else
+        {
+            // Volume events carry no value, observers re-read it; one pending event per device and flow suffices.
+            auto foundPair = pendingVolumeVersions_.find(devicePnpId);
+            if (foundPair == pendingVolumeVersions_.end())
+            {
+                foundPair = pendingVolumeVersions_.emplace(devicePnpId, PendingVolumeVersions{}).first;
+            }
+            auto & version = GetVersion(foundPair->second, event);
+            const auto wasPending = version.has_value();
+            version = stateVersion;
+            if (wasPending)
+            {
+                ++statistics_.Coalesced;
+                return;
+            }
+            lowPriorityLane_.push_back({ event, foundPair });
+        }
+    }
+    wakeUp_.notify_one();
+}
+
+// Must be called with mutex_ held.
+void ed::audio::NotificationDispatcher::DiscardPendingVolumeEvents(const std::string & devicePnpId)
+{
+    const auto foundPair = pendingVolumeVersions_.find(devicePnpId);
+    if (foundPair == pendingVolumeVersions_.end())
+    {
+        return;
+    }
+    lowPriorityLane_.erase(lowPriorityLane_.begin(), lowPriorityLane_.begin() + static_cast<ptrdiff_t>(lowPriorityHead_));
+    lowPriorityHead_ = 0;
+    statistics_.DiscardedAsStale += std::erase_if(lowPriorityLane_,
+        [&foundPair](const VolumeNotification & notification)
+        {
+            return notification.Device == foundPair;
+        });
+    pendingVolumeVersions_.erase(foundPair);
+}
+
+// Must be called with mutex_ held.
+void ed::audio::NotificationDispatcher::DiscardAllPendingVolumeEvents()
+{
+    statistics_.DiscardedAsStale += lowPriorityLane_.size() - lowPriorityHead_;
+    lowPriorityLane_.clear();
+    lowPriorityHead_ = 0;
+    pendingVolumeVersions_.clear();
+}
+
+ed::audio::NotificationDispatcher::VolumeNotification ed::audio::NotificationDispatcher::PopVolumeNotification()
+{
+    const auto notification = lowPriorityLane_[lowPriorityHead_++];
+    // the lane keeps its capacity: once drained it starts over, else its delivered half is dropped
+    if (lowPriorityHead_ == lowPriorityLane_.size())
+    {
+        lowPriorityLane_.clear();
+        lowPriorityHead_ = 0;
+    }
+    else if (lowPriorityHead_ * 2 >= lowPriorityLane_.size())
+    {
+        lowPriorityLane_.erase(lowPriorityLane_.begin(), lowPriorityLane_.begin() + static_cast<ptrdiff_t>(lowPriorityHead_));
+        lowPriorityHead_ = 0;
+    }
+    return notification;
+}
+
+std::optional<uint64_t> & ed::audio::NotificationDispatcher::GetVersion(PendingVolumeVersions & versions, SoundDeviceEventType event)
+{
+    return event == SoundDeviceEventType::VolumeRenderChanged ? versions.Render : versions.Capture;
+}
+
+void ed::audio::NotificationDispatcher::WaitUntilIdle()
+{
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this]
+        {
+            return stopRequested_ || (!delivering_ && highPriorityLane_.empty() && lowPriorityHead_ == lowPriorityLane_.size());
+        });
+}
+
+ed::audio::NotificationDispatcher::Statistics ed::audio::NotificationDispatcher::GetStatistics() const
+{
+    std::lock_guard lock(mutex_);
+    return statistics_;
+}
+
+void ed::audio::NotificationDispatcher::Run()
+{
+    // outside the loop, so that the PnP ids of volume events are copied into the same buffer
+    Notification notification{};
+    std::unique_lock lock(mutex_);
+    for (;;)
+    {
+        wakeUp_.wait(lock, [this]
+            {
+                return stopRequested_ || !highPriorityLane_.empty() || lowPriorityHead_ != lowPriorityLane_.size();
+            });
+        if (stopRequested_)
+        {
+            break;
+        }
+
+        if (!highPriorityLane_.empty())
+        {
+            notification = std::move(highPriorityLane_.front());
+            highPriorityLane_.pop_front();
+        }
+        else
+        {
+            const auto [event, device] = PopVolumeNotification();
+            auto & version = GetVersion(device->second, event);
+            notification.Event = event;
+            notification.DevicePnpId.assign(device->first);
+            notification.StateVersion = *version;
+            version.reset();
+        }
+
+        delivering_ = true;
+        lock.unlock();
+        try
+        {
+            deliverFunc_(notification.Event, notification.DevicePnpId, notification.StateVersion);
+        }
+        catch (const std::exception & ex)
+        {
+            spdlog::error("Delivering an audio device event failed: {}", ex.what());
+        }
+        catch (...)
+        {
+            // not a std::exception, e.g. thrown through a callback of another language
+            spdlog::error("Delivering an audio device event failed with an unknown exception.");
+        }
+        lock.lock();
+        delivering_ = false;
+        ++statistics_.Delivered;
+
+        if (highPriorityLane_.empty() && lowPriorityHead_ == lowPriorityLane_.size())
+        {
+            idle_.notify_all();
+        }
+    }
+    idle_.notify_all();
+}
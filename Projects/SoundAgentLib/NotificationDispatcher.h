@@ -0,0 +1,98 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "public/SoundAgentInterface.h"
+
+
+namespace ed::audio {
+// Delivers collection events on an own worker thread, in two priority lanes:
+// topology and default-device events always go before pending volume events.
+// Volume events are coalesced per device and flow (keeping the newest state version),
+// and dropped if their device is detached or the whole content is reset meanwhile.
+// Posting a volume event for a device seen before allocates nothing: its pending state is kept until the device
+// is detached, and the volume lane reuses its capacity.
+// The lanes reorder state versions: a volume event may be delivered after high-priority events posted later, so
+// carrying an older version than they did. Observers must not drop an event for its version being below the last one
+// seen, at least not across the lanes.
+// An exception thrown by the delivery function is logged and does not stop the worker.
+class NotificationDispatcher final {
+public:
+    using DeliverFunctionT = std::function<void(SoundDeviceEventType, const std::string&, uint64_t)>;
+
+    struct Statistics {
+        uint64_t Posted = 0;
+        uint64_t Delivered = 0;
+        uint64_t Coalesced = 0;
+        uint64_t DiscardedAsStale = 0;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(NotificationDispatcher);
+    explicit NotificationDispatcher(DeliverFunctionT deliverFunc);
+    // Stops the worker; events not yet delivered are discarded.
+    ~NotificationDispatcher();
+
+public:
+    void Post(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion);
+    // Blocks until every event posted so far is delivered or discarded. Do not call from a delivery.
+    void WaitUntilIdle();
+
+    [[nodiscard]] Statistics GetStatistics() const;
+    [[nodiscard]] static bool IsHighPriority(SoundDeviceEventType event);
+
+private:
+    struct Notification {
+        SoundDeviceEventType Event;
+        std::string DevicePnpId;
+        uint64_t StateVersion;
+    };
+
+    // newest state version of the pending volume events of a device
+    struct PendingVolumeVersions {
+        std::optional<uint64_t> Render;
+        std::optional<uint64_t> Capture;
+    };
+
+    using PendingVolumeVersionsT = std::map<std::string, PendingVolumeVersions, std::less<>>;
+
+    struct VolumeNotification {
+        SoundDeviceEventType Event;
+        PendingVolumeVersionsT::iterator Device;
+    };
+
+    void Run();
+    void DiscardPendingVolumeEvents(const std::string & devicePnpId);
+    void DiscardAllPendingVolumeEvents();
+    // Must be called with mutex_ held, the volume lane not empty.
+    VolumeNotification PopVolumeNotification();
+    [[nodiscard]] static std::optional<uint64_t> & GetVersion(PendingVolumeVersions & versions, SoundDeviceEventType event);
+
+private:
+    DeliverFunctionT deliverFunc_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    std::condition_variable idle_;
+    std::deque<Notification> highPriorityLane_;
+    // the pending volume events from lowPriorityHead_ on
+    std::vector<VolumeNotification> lowPriorityLane_;
+    size_t lowPriorityHead_ = 0;
+    PendingVolumeVersionsT pendingVolumeVersions_;
+    bool delivering_ = false;
+    bool stopRequested_ = false;
+    Statistics statistics_;
+
+    std::thread worker_;
+};
+}
@@ -0,0 +1,187 @@
+#include "os-dependencies.h"
+
+#include "ObserverRegistry.h"
+
+#include <algorithm>
+
+
+namespace {
+    // Nesting depth of Notify on the current thread, used to avoid a self-wait in Remove.
+    thread_local uint32_t notify_depth_on_this_thread = 0;
+}
+
+ed::audio::ObserverRegistry::ObserverRegistry()
+    : current_(new HandlerLists())
+{
+}
+
+ed::audio::ObserverRegistry::~ObserverRegistry()
+{
+    WaitForRunningNotifications();
+    delete current_.load();
+    for (const auto * lists : retired_)
+    {
+        delete lists;
+    }
+}
+
+void ed::audio::ObserverRegistry::Add(SoundDeviceObserverInterface & observer)
+{
+    const Handler handler{ &InvokeObserver, &observer };
+    AddTarget(&observer, {
+        { SoundDeviceEventType::Confirmed, handler },
+        { SoundDeviceEventType::Discovered, handler },
+        { SoundDeviceEventType::Detached, handler },
+        { SoundDeviceEventType::VolumeRenderChanged, handler },
+        { SoundDeviceEventType::VolumeCaptureChanged, handler },
+        { SoundDeviceEventType::DefaultRenderChanged, handler },
+        { SoundDeviceEventType::DefaultCaptureChanged, handler },
+        { SoundDeviceEventType::ContentReset, handler },
+        { SoundDeviceEventType::PropertyChanged, handler }
+    });
+}
+
+void ed::audio::ObserverRegistry::Remove(SoundDeviceObserverInterface & observer, bool waitForRunningNotifications)
+{
+    RemoveTarget(&observer, waitForRunningNotifications);
+}
+
+void ed::audio::ObserverRegistry::InvokeObserver(void * target, SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion)
+{
+    static_cast<SoundDeviceObserverInterface *>(target)->OnCollectionChanged(event, devicePnpId, stateVersion);
+}
+
+void ed::audio::ObserverRegistry::AddTarget(void * target, std::initializer_list<TypedHandler> handlers)
+{
+    std::lock_guard lock(writeMutex_);
+
+    const auto * oldLists = current_.load();
+    if (std::ranges::find(oldLists->Targets, target) != oldLists->Targets.end())
+    {
+        return;
+    }
+    auto * newLists = new HandlerLists(*oldLists);
+    newLists->Targets.push_back(target);
+    for (const auto & [event, handler] : handlers)
+    {
+        newLists->ByEvent[static_cast<size_t>(event)].push_back(handler);
+    }
+    PublishAndRetire(newLists);
+}
+
+void ed::audio::ObserverRegistry::RemoveTarget(const void * target, bool waitForRunningNotifications)
+{
+    {
+        std::lock_guard lock(writeMutex_);
+
+        const auto * oldLists = current_.load();
+        if (std::ranges::find(oldLists->Targets, target) != oldLists->Targets.end())
+        {
+            auto * newLists = new HandlerLists(*oldLists);
+            std::erase(newLists->Targets, target);
+            for (auto & handlers : newLists->ByEvent)
+            {
+                std::erase_if(handlers, [target](const Handler & handler) { return handler.Target == target; });
+            }
+            PublishAndRetire(newLists);
+        }
+    }
+    if (!waitForRunningNotifications || notify_depth_on_this_thread != 0)
+    {
+        return;
+    }
+    uint64_t retiredBefore;
+    {
+        std::lock_guard lock(writeMutex_);
+        retiredBefore = retiredCount_;
+    }
+    WaitForRunningNotifications();
+
+    // The lists retired before the wait are no longer read by anyone, even if notifications kept running. Others
+    // may have been freed or retired meanwhile, so they are found by count rather than by position.
+    std::lock_guard lock(writeMutex_);
+    const auto firstKept = retiredCount_ - retired_.size();
+    const auto freeable = static_cast<std::ptrdiff_t>(retiredBefore > firstKept ? retiredBefore - firstKept : 0);
+    std::for_each(retired_.begin(), retired_.begin() + freeable, [](const HandlerLists * lists) { delete lists; });
+    retired_.erase(retired_.begin(), retired_.begin() + freeable);
+}
+
+void ed::audio::ObserverRegistry::Notify(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion) const
+{
+    // The scope must precede the load: a writer that observes zero in-flight notifications
+    // after publishing a new list may then free the lists it retired.
+    const NotificationScope scope(*this);
+
+    const auto * lists = current_.load();
+    if (const auto index = static_cast<size_t>(event); index < event_type_count)
+    {
+        for (const auto & handler : lists->ByEvent[index])
+        {
+            handler.Function(handler.Target, event, devicePnpId, stateVersion);
+        }
+    }
+}
+
+size_t ed::audio::ObserverRegistry::GetSize() const
+{
+    const NotificationScope scope(*this);
+    return current_.load()->Targets.size();
+}
+
+ed::audio::ObserverRegistry::NotificationScope::NotificationScope(const ObserverRegistry & registry)
+    : registry_(registry)
+    , inFlight_(registry.inFlight_[registry.epoch_.load() & 1])
+{
+    inFlight_.fetch_add(1);
+    ++notify_depth_on_this_thread;
+}
+
+ed::audio::ObserverRegistry::NotificationScope::~NotificationScope()
+{
+    --notify_depth_on_this_thread;
+    if (inFlight_.fetch_sub(1) == 1 && registry_.waiters_.load() != 0)
+    {
+        inFlight_.notify_all();
+    }
+}
+
+// Must be called with writeMutex_ held.
+void ed::audio::ObserverRegistry::PublishAndRetire(const HandlerLists * newLists)
+{
+    retired_.push_back(current_.exchange(newLists));
+    ++retiredCount_;
+
+    // No notification is running: none of them can still be holding retired lists.
+    if (inFlight_[0].load() == 0 && inFlight_[1].load() == 0)
+    {
+        for (const auto * lists : retired_)
+        {
+            delete lists;
+        }
+        retired_.clear();
+    }
+}
+
+// The notifications running at the call are counted in either slot: the other one may still hold some that read
+// the epoch before the last flip. That slot is drained first, while new notifications count in the current one;
+// then the epoch is flipped, so that new notifications count in the other slot again, and the current one drained.
+// A notification that read the epoch just before a flip counts in the drained slot, but it reads the lists published
+// before the wait, so waiting for it is harmless.
+void ed::audio::ObserverRegistry::WaitForRunningNotifications() const
+{
+    std::lock_guard lock(waitMutex_);
+    const auto epoch = epoch_.load();
+    WaitUntilNoneInFlight(inFlight_[(epoch + 1) & 1]);
+    epoch_.store(epoch + 1);
+    WaitUntilNoneInFlight(inFlight_[epoch & 1]);
+}
+
+void ed::audio::ObserverRegistry::WaitUntilNoneInFlight(std::atomic<uint32_t> & inFlight) const
+{
+    waiters_.fetch_add(1);
+    for (auto count = inFlight.load(); count != 0; count = inFlight.load())
+    {
+        inFlight.wait(count);
+    }
+    waiters_.fetch_sub(1);
+}
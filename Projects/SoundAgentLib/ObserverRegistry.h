@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "public/SoundAgentInterface.h"
+
+
+namespace ed::audio {
+// Copy-on-write handler lists, one per event type. Subscribe / Unsubscribe publish a new immutable set of lists,
+// Notify iterates the list of its event type in the currently published one without taking a lock.
+// Changes become visible with the next notification; a notification already running keeps its lists.
+//
+// A target registered with AddHandlers gets OnEvent<Event>(devicePnpId, stateVersion) called for the events it was
+// registered for only: the call is a plain function pointer specialized per event type at compile time, with no
+// virtual call and no branching on the event. A SoundDeviceObserverInterface is registered through an adapter
+// handler for every event type that calls OnCollectionChanged.
+class ObserverRegistry final {
+public:
+    static constexpr size_t event_type_count = static_cast<size_t>(SoundDeviceEventType::PropertyChanged) + 1;
+
+    struct Handler {
+        using FunctionT = void (*)(void * target, SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion);
+
+        FunctionT Function;
+        void * Target;
+    };
+
+    struct HandlerLists {
+        std::array<std::vector<Handler>, event_type_count> ByEvent;
+        // the registered observers and handler targets, one entry each
+        std::vector<const void *> Targets;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(ObserverRegistry);
+    ObserverRegistry();
+    ~ObserverRegistry();
+
+public:
+    void Add(SoundDeviceObserverInterface & observer);
+    // If waitForRunningNotifications is set, returns only after all notifications started before the call finished.
+    // Notifications started later are waited for only in the corner case WaitForRunningNotifications describes.
+    // Called from inside a notification on the same thread it does not wait (it would wait for itself).
+    void Remove(SoundDeviceObserverInterface & observer, bool waitForRunningNotifications);
+
+    // Ignored if the target is registered already.
+    template <SoundDeviceEventType... Events, typename TargetT>
+    void AddHandlers(TargetT & target)
+    {
+        static_assert(sizeof...(Events) > 0, "A target handles at least one event type");
+        AddTarget(std::addressof(target), { TypedHandler{ Events, Handler{ &InvokeHandler<Events, TargetT>, std::addressof(target) } }... });
+    }
+
+    // Like Remove.
+    template <typename TargetT>
+    void RemoveHandlers(TargetT & target, bool waitForRunningNotifications)
+    {
+        RemoveTarget(std::addressof(target), waitForRunningNotifications);
+    }
+
+    void Notify(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion) const;
+
+    [[nodiscard]] size_t GetSize() const;
+
+private:
+    struct TypedHandler {
+        SoundDeviceEventType Event;
+        Handler Entry;
+    };
+
+    template <SoundDeviceEventType Event, typename TargetT>
+    static void InvokeHandler(void * target, SoundDeviceEventType /*event*/, const std::string & devicePnpId, uint64_t stateVersion)
+    {
+        static_cast<TargetT *>(target)->template OnEvent<Event>(devicePnpId, stateVersion);
+    }
+
+    static void InvokeObserver(void * target, SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion);
+
+    // Counts a running notification in the slot of the current epoch, until destroyed, also when a handler throws.
+    class NotificationScope final {
+    public:
+        DISALLOW_COPY_MOVE(NotificationScope);
+        explicit NotificationScope(const ObserverRegistry & registry);
+        ~NotificationScope();
+
+    private:
+        const ObserverRegistry & registry_;
+        std::atomic<uint32_t> & inFlight_;
+    };
+
+    void AddTarget(void * target, std::initializer_list<TypedHandler> handlers);
+    void RemoveTarget(const void * target, bool waitForRunningNotifications);
+    void PublishAndRetire(const HandlerLists * newLists);
+    // Blocks, without spinning, until the notifications that started before the call finished.
+    void WaitForRunningNotifications() const;
+    void WaitUntilNoneInFlight(std::atomic<uint32_t> & inFlight) const;
+
+private:
+    std::atomic<const HandlerLists *> current_;
+    // A notification counts itself in the slot of the epoch's parity. Waiting drains the other slot, flips the epoch
+    // and drains the slot the notifications counted in before, see WaitForRunningNotifications.
+    mutable std::atomic<uint64_t> epoch_{ 0 };
+    mutable std::array<std::atomic<uint32_t>, 2> inFlight_{};
+    // threads blocked in WaitUntilNoneInFlight: the last notification of a slot wakes them only if there are any
+    mutable std::atomic<uint32_t> waiters_{ 0 };
+    // serializes the epoch flips of concurrent waits
+    mutable std::mutex waitMutex_;
+
+    // guards writers and the retired lists
+    std::mutex writeMutex_;
+    std::vector<const HandlerLists *> retired_;
+    // of all time: retired_ holds the last retired_.size() of them, being freed only from the front
+    uint64_t retiredCount_ = 0;
+};
+}
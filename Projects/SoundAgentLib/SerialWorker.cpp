@@ -0,0 +1,108 @@
+#include "os-dependencies.h"
+
+#include "SerialWorker.h"
+
+#include <spdlog/spdlog.h>
+
+
+ed::audio::SerialWorker::SerialWorker()
+    : worker_(&SerialWorker::Run, this)
+{
+}
+
+ed::audio::SerialWorker::~SerialWorker()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopRequested_ = true;
+    }
+    wakeUp_.notify_all();
+    worker_.join();
+}
+
+void ed::audio::SerialWorker::Post(TaskT task)
+{
+    {
+        std::lock_guard lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    wakeUp_.notify_one();
+}
+
+void ed::audio::SerialWorker::WaitUntilIdle()
+{
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this]
+        {
+            return !running_ && tasks_.empty();
+        });
+}
+
+void ed::audio::SerialWorker::SetReadiness(Readiness readiness)
+{
+    {
+        std::lock_guard lock(mutex_);
+        auto expected = Readiness::Pending;
+        if (!readiness_.compare_exchange_strong(expected, readiness, std::memory_order_release))
+        {
+            return;
+        }
+    }
+    readinessChanged_.notify_all();
+}
+
+ed::audio::SerialWorker::Readiness ed::audio::SerialWorker::GetReadiness() const
+{
+    return readiness_.load(std::memory_order_acquire);
+}
+
+ed::audio::SerialWorker::Readiness ed::audio::SerialWorker::WaitForReadiness(std::chrono::milliseconds timeout) const
+{
+    std::unique_lock lock(mutex_);
+    readinessChanged_.wait_for(lock, timeout, [this]
+        {
+            return readiness_.load(std::memory_order_acquire) != Readiness::Pending;
+        });
+    return readiness_.load(std::memory_order_acquire);
+}
+
+bool ed::audio::SerialWorker::IsWorkerThread() const
+{
+    return std::this_thread::get_id() == worker_.get_id();
+}
+
+void ed::audio::SerialWorker::Run()
+{
+    std::unique_lock lock(mutex_);
+    for (;;)
+    {
+        wakeUp_.wait(lock, [this]
+            {
+                return stopRequested_ || !tasks_.empty();
+            });
+        if (tasks_.empty())
+        {
+            break;
+        }
+
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+        running_ = true;
+        lock.unlock();
+        try
+        {
+            task();
+        }
+        catch (const std::exception & ex)
+        {
+            spdlog::error("Background task failed: {}", ex.what());
+        }
+        lock.lock();
+        running_ = false;
+
+        if (tasks_.empty())
+        {
+            idle_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+
+namespace ed::audio {
+// Runs tasks one after another, in the order they are posted, on an own thread.
+// Lets API calls return at once while the COM set-up and the enumeration run behind them: the start-up
+// task tells by its readiness when there is content to answer from. The tasks do their COM work on a ComExecutor.
+class SerialWorker final {
+public:
+    using TaskT = std::function<void()>;
+
+    enum class Readiness : uint8_t {
+        Pending = 0,
+        Ready,
+        Failed
+    };
+
+public:
+    DISALLOW_COPY_MOVE(SerialWorker);
+    SerialWorker();
+    // Runs the tasks posted so far, then stops the thread.
+    ~SerialWorker();
+
+public:
+    // Exceptions of the task are logged.
+    void Post(TaskT task);
+    // Blocks until every task posted so far has run. Do not call from a task.
+    void WaitUntilIdle();
+
+    // Only the first change from Pending counts; it wakes the waiters.
+    void SetReadiness(Readiness readiness);
+    [[nodiscard]] Readiness GetReadiness() const;
+    // Pending if it times out.
+    Readiness WaitForReadiness(std::chrono::milliseconds timeout) const;
+
+    // Whether the caller is a task; it must neither wait for the worker nor destroy it.
+    [[nodiscard]] bool IsWorkerThread() const;
+
+private:
+    void Run();
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    std::condition_variable idle_;
+    mutable std::condition_variable readinessChanged_;
+    std::deque<TaskT> tasks_;
+    bool running_ = false;
+    bool stopRequested_ = false;
+    // read without the lock by every getter of the API
+    std::atomic<Readiness> readiness_ = Readiness::Pending;
+
+    std::thread worker_;
+};
+}
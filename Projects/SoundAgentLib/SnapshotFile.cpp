@@ -0,0 +1,303 @@
+#include "os-dependencies.h"
+
+#include "SnapshotFile.h"
+
+#include <array>
+#include <format>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+
+namespace
+{
+    // File layout, little endian:
+    //   header: u32 magic | u16 format version | u16 header size | u32 file size | u32 device count
+    //     | i64 saved at (ms since epoch) | i32 default render index | i32 default capture index (-1: none)
+    //     | u32 CRC-32 of the file, taken with this field zero | u32 reserved
+    //   an entry per device: u32 PnP id offset | u32 name offset | u16 PnP id size | u16 name size | u8 flow
+    //     | u8 form factor | u16 render volume | u16 capture volume | u16 reserved
+    //   the strings, UTF-8, not terminated; offsets are from the start of the file.
+    constexpr uint32_t snapshot_magic = 0x54444153; // "SADT"
+    constexpr size_t header_size = 40;
+    constexpr size_t entry_size = 20;
+    constexpr size_t checksum_offset = 32;
+    constexpr auto temporary_extension = ".tmp";
+
+    template <typename T>
+    void PutInteger(std::string & out, size_t offset, T value)
+    {
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            out[offset + i] = static_cast<char>(static_cast<uint64_t>(value) >> (8 * i) & 0xFF);
+        }
+    }
+
+    template <typename T>
+    T GetInteger(std::string_view bytes, size_t offset)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[offset + i])) << (8 * i);
+        }
+        return static_cast<T>(value);
+    }
+
+    constexpr std::array<uint32_t, 256> crc_table = []
+    {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                value = (value & 1) != 0 ? 0xEDB88320 ^ value >> 1 : value >> 1;
+            }
+            table[i] = value;
+        }
+        return table;
+    }();
+
+    // CRC-32 of the bytes, the checksum field counted as zero.
+    uint32_t Checksum(std::string_view bytes)
+    {
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < bytes.size(); ++i)
+        {
+            const auto byte = i >= checksum_offset && i < checksum_offset + sizeof(uint32_t) ? uint8_t{ 0 } : static_cast<uint8_t>(bytes[i]);
+            crc = crc_table[(crc ^ byte) & 0xFF] ^ crc >> 8;
+        }
+        return ~crc;
+    }
+
+    // A whole file, mapped read-only.
+    class MappedView final {
+    public:
+        DISALLOW_COPY_MOVE(MappedView);
+
+        explicit MappedView(const std::filesystem::path & path)
+        {
+            file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE)
+            {
+                throw std::runtime_error(std::format("Can not open it, error {}.", GetLastError()));
+            }
+            LARGE_INTEGER fileSize{};
+            GetFileSizeEx(file_, &fileSize);
+            size_ = static_cast<size_t>(fileSize.QuadPart);
+            if (size_ == 0)
+            {
+                return;
+            }
+            mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data_ = mapping_ != nullptr ? static_cast<const char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            if (data_ == nullptr)
+            {
+                const auto error = GetLastError();
+                Close();
+                throw std::runtime_error(std::format("Can not map it, error {}.", error));
+            }
+        }
+
+        ~MappedView()
+        {
+            Close();
+        }
+
+        [[nodiscard]] std::string_view GetBytes() const { return { data_, data_ != nullptr ? size_ : 0 }; }
+
+    private:
+        void Close()
+        {
+            if (data_ != nullptr)
+            {
+                UnmapViewOfFile(data_);
+                data_ = nullptr;
+            }
+            if (mapping_ != nullptr)
+            {
+                CloseHandle(mapping_);
+                mapping_ = nullptr;
+            }
+            if (file_ != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(file_);
+                file_ = INVALID_HANDLE_VALUE;
+            }
+        }
+
+        HANDLE file_ = INVALID_HANDLE_VALUE;
+        HANDLE mapping_ = nullptr;
+        const char * data_ = nullptr;
+        size_t size_ = 0;
+    };
+}
+
+
+void ed::audio::SnapshotFile::Save(const std::filesystem::path & path, const SoundDeviceCollectionSnapshot & snapshot,
+    std::chrono::system_clock::time_point savedAt)
+{
+    const auto content = Encode(snapshot, savedAt);
+    auto temporary = path;
+    temporary += temporary_extension;
+    std::error_code ignored;
+    std::filesystem::create_directories(path.parent_path(), ignored);
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+        if (!file.flush())
+        {
+            throw std::runtime_error(std::format("Can not write device snapshot {}.", temporary.string()));
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+        throw std::runtime_error(std::format("Can not replace device snapshot {}: {}", path.string(), error.message()));
+    }
+}
+
+std::optional<ed::audio::SnapshotFile::Content> ed::audio::SnapshotFile::Load(const std::filesystem::path & path)
+{
+    std::error_code error;
+    if (!std::filesystem::exists(path, error))
+    {
+        spdlog::info("No device snapshot {} to start from.", path.string());
+        return std::nullopt;
+    }
+    try
+    {
+        const MappedView view(path);
+        auto content = Decode(view.GetBytes());
+        spdlog::info("Device snapshot {} of {} devices loaded.", path.string(), content.Devices.size());
+        return content;
+    }
+    catch (const std::exception & ex)
+    {
+        spdlog::warn("Device snapshot {} not used: {}", path.string(), ex.what());
+        return std::nullopt;
+    }
+}
+
+std::string ed::audio::SnapshotFile::Encode(const SoundDeviceCollectionSnapshot & snapshot, std::chrono::system_clock::time_point savedAt)
+{
+    int32_t defaultRenderIndex = -1;
+    int32_t defaultCaptureIndex = -1;
+    size_t stringsSize = 0;
+    for (size_t i = 0; i < snapshot.Devices.size(); ++i)
+    {
+        const auto pnpId = snapshot.Devices[i]->GetPnpId();
+        stringsSize += std::min<size_t>(pnpId.size(), UINT16_MAX) + std::min<size_t>(snapshot.Devices[i]->GetName().size(), UINT16_MAX);
+        defaultRenderIndex = snapshot.DefaultRenderDevicePnpId == pnpId ? static_cast<int32_t>(i) : defaultRenderIndex;
+        defaultCaptureIndex = snapshot.DefaultCaptureDevicePnpId == pnpId ? static_cast<int32_t>(i) : defaultCaptureIndex;
+    }
+
+    std::string out(header_size + snapshot.Devices.size() * entry_size, '\0');
+    out.reserve(out.size() + stringsSize);
+    PutInteger(out, 0, snapshot_magic);
+    PutInteger(out, 4, format_version);
+    PutInteger(out, 6, static_cast<uint16_t>(header_size));
+    PutInteger(out, 8, static_cast<uint32_t>(out.size() + stringsSize));
+    PutInteger(out, 12, static_cast<uint32_t>(snapshot.Devices.size()));
+    PutInteger(out, 16, std::chrono::duration_cast<std::chrono::milliseconds>(savedAt.time_since_epoch()).count());
+    PutInteger(out, 24, defaultRenderIndex);
+    PutInteger(out, 28, defaultCaptureIndex);
+
+    for (size_t i = 0; i < snapshot.Devices.size(); ++i)
+    {
+        const auto & device = *snapshot.Devices[i];
+        const auto entry = header_size + i * entry_size;
+        const auto pnpId = device.GetPnpId().substr(0, UINT16_MAX);
+        const auto name = device.GetName().substr(0, UINT16_MAX);
+        PutInteger(out, entry, static_cast<uint32_t>(out.size()));
+        out += pnpId;
+        PutInteger(out, entry + 4, static_cast<uint32_t>(out.size()));
+        out += name;
+        PutInteger(out, entry + 8, static_cast<uint16_t>(pnpId.size()));
+        PutInteger(out, entry + 10, static_cast<uint16_t>(name.size()));
+        PutInteger(out, entry + 12, static_cast<uint8_t>(device.GetFlow()));
+        PutInteger(out, entry + 13, static_cast<uint8_t>(device.GetFormFactor()));
+        PutInteger(out, entry + 14, device.GetCurrentRenderVolume());
+        PutInteger(out, entry + 16, device.GetCurrentCaptureVolume());
+    }
+    PutInteger(out, checksum_offset, Checksum(out));
+    return out;
+}
+
+ed::audio::SnapshotFile::Content ed::audio::SnapshotFile::Decode(std::string_view bytes)
+{
+    if (bytes.size() < header_size)
+    {
+        throw std::runtime_error("The file is truncated.");
+    }
+    if (GetInteger<uint32_t>(bytes, 0) != snapshot_magic)
+    {
+        throw std::runtime_error("Not a device snapshot.");
+    }
+    if (const auto version = GetInteger<uint16_t>(bytes, 4); version != format_version)
+    {
+        throw std::runtime_error(std::format("Format version {}, {} expected.", version, format_version));
+    }
+    if (GetInteger<uint16_t>(bytes, 6) != header_size || GetInteger<uint32_t>(bytes, 8) != bytes.size())
+    {
+        throw std::runtime_error("The file is truncated.");
+    }
+    if (GetInteger<uint32_t>(bytes, checksum_offset) != Checksum(bytes))
+    {
+        throw std::runtime_error("The checksum does not match.");
+    }
+
+    const auto deviceCount = GetInteger<uint32_t>(bytes, 12);
+    const auto defaultRenderIndex = GetInteger<int32_t>(bytes, 24);
+    const auto defaultCaptureIndex = GetInteger<int32_t>(bytes, 28);
+    const auto stringsOffset = header_size + static_cast<size_t>(deviceCount) * entry_size;
+    if (stringsOffset > bytes.size()
+        || defaultRenderIndex < -1 || defaultRenderIndex >= static_cast<int64_t>(deviceCount)
+        || defaultCaptureIndex < -1 || defaultCaptureIndex >= static_cast<int64_t>(deviceCount))
+    {
+        throw std::runtime_error("The header is inconsistent.");
+    }
+    const auto getString = [bytes, stringsOffset](size_t offset, size_t size)
+    {
+        if (offset < stringsOffset || offset + size > bytes.size())
+        {
+            throw std::runtime_error("A string is out of the file.");
+        }
+        return std::string(bytes.substr(offset, size));
+    };
+
+    Content content;
+    content.SavedAt = std::chrono::system_clock::time_point(std::chrono::milliseconds(GetInteger<int64_t>(bytes, 16)));
+    content.Devices.reserve(deviceCount);
+    for (uint32_t i = 0; i < deviceCount; ++i)
+    {
+        const auto entry = header_size + static_cast<size_t>(i) * entry_size;
+        const auto flow = GetInteger<uint8_t>(bytes, entry + 12);
+        const auto formFactor = GetInteger<uint8_t>(bytes, entry + 13);
+        const auto renderVolume = GetInteger<uint16_t>(bytes, entry + 14);
+        const auto captureVolume = GetInteger<uint16_t>(bytes, entry + 16);
+        if (flow > static_cast<uint8_t>(SoundDeviceFlowType::RenderAndCapture) || formFactor > static_cast<uint8_t>(SoundDeviceFormFactor::Unknown)
+            || renderVolume > 1000 || captureVolume > 1000)
+        {
+            throw std::runtime_error("A device entry is inconsistent.");
+        }
+        const auto isDefaultRender = static_cast<int64_t>(i) == defaultRenderIndex;
+        const auto isDefaultCapture = static_cast<int64_t>(i) == defaultCaptureIndex;
+        content.Devices.emplace_back(
+            getString(GetInteger<uint32_t>(bytes, entry), GetInteger<uint16_t>(bytes, entry + 8)),
+            getString(GetInteger<uint32_t>(bytes, entry + 4), GetInteger<uint16_t>(bytes, entry + 10)),
+            static_cast<SoundDeviceFlowType>(flow), renderVolume, captureVolume, isDefaultRender, isDefaultCapture,
+            static_cast<SoundDeviceFormFactor>(formFactor));
+        if (isDefaultRender)
+        {
+            content.DefaultRenderDevicePnpId = content.Devices.back().GetPnpId();
+        }
+        if (isDefaultCapture)
+        {
+            content.DefaultCaptureDevicePnpId = content.Devices.back().GetPnpId();
+        }
+    }
+    return content;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "public/SoundAgentInterface.h"
+
+#include "SoundDevice.h"
+
+
+namespace ed::audio {
+// The device table and the defaults of a collection, persisted for a warm start of the next run.
+// The file has a fixed little-endian layout that is read in place from a mapping: a header, an entry of a
+// fixed size per device and the strings the entries point to. A checksum covers the whole file.
+// A damaged file, or one of another format version, is not used.
+class SnapshotFile final {
+public:
+    // 2: the entries keep the form factor
+    static constexpr uint16_t format_version = 2;
+
+    struct Content {
+        std::vector<SoundDevice> Devices;
+        std::optional<std::string> DefaultRenderDevicePnpId;
+        std::optional<std::string> DefaultCaptureDevicePnpId;
+        std::chrono::system_clock::time_point SavedAt;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(SnapshotFile);
+    SnapshotFile() = delete;
+    ~SnapshotFile() = delete;
+
+public:
+    // Replaces the file through a temporary one and a rename. Throws std::runtime_error if it can not be written.
+    static void Save(const std::filesystem::path & path, const SoundDeviceCollectionSnapshot & snapshot,
+        std::chrono::system_clock::time_point savedAt);
+    // Nothing if the file is missing or can not be used; the reason is logged.
+    [[nodiscard]] static std::optional<Content> Load(const std::filesystem::path & path);
+
+    [[nodiscard]] static std::string Encode(const SoundDeviceCollectionSnapshot & snapshot, std::chrono::system_clock::time_point savedAt);
+    // Throws std::runtime_error if the bytes are damaged or of another format version.
+    [[nodiscard]] static Content Decode(std::string_view bytes);
+};
+}
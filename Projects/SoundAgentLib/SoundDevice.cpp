@@ -12,10 +12,11 @@ ed::audio::SoundDevice::SoundDevice()
 
 // ReSharper disable once CppParameterMayBeConst
 ed::audio::SoundDevice::SoundDevice(std::string pnpId, std::string name, SoundDeviceFlowType flow, uint16_t renderVolume,
-                          uint16_t captureVolume, bool renderIsDefault, bool captureIsDefault)
+                          uint16_t captureVolume, bool renderIsDefault, bool captureIsDefault, SoundDeviceFormFactor formFactor)
     : pnpId_(std::move(pnpId))
       , name_(std::move(name))
       , flow_(flow)
+      , formFactor_(formFactor)
       , renderVolume_(renderVolume)
       , captureVolume_(captureVolume)
     , renderIsDefault_(renderIsDefault)
@@ -27,6 +28,7 @@ ed::audio::SoundDevice::SoundDevice(const SoundDevice & toCopy)
     : pnpId_(toCopy.pnpId_)
       , name_(toCopy.name_)
       , flow_(toCopy.flow_)
+      , formFactor_(toCopy.formFactor_)
       , renderVolume_(toCopy.renderVolume_)
       , captureVolume_(toCopy.captureVolume_)
     , renderIsDefault_(toCopy.renderIsDefault_)
@@ -38,6 +40,7 @@ ed::audio::SoundDevice::SoundDevice(SoundDevice && toMove) noexcept
     : pnpId_(std::move(toMove.pnpId_))
       , name_(std::move(toMove.name_))
       , flow_(toMove.flow_)
+      , formFactor_(toMove.formFactor_)
       , renderVolume_(toMove.renderVolume_)
       , captureVolume_(toMove.captureVolume_)
     , renderIsDefault_(toMove.renderIsDefault_)
@@ -52,6 +55,7 @@ ed::audio::SoundDevice & ed::audio::SoundDevice::operator=(const SoundDevice & t
         pnpId_ = toCopy.pnpId_;
         name_ = toCopy.name_;
         flow_ = toCopy.flow_;
+        formFactor_ = toCopy.formFactor_;
         renderVolume_ = toCopy.renderVolume_;
         captureVolume_ = toCopy.captureVolume_;
         renderIsDefault_ = toCopy.renderIsDefault_;
@@ -67,6 +71,7 @@ ed::audio::SoundDevice & ed::audio::SoundDevice::operator=(SoundDevice && toMove
         pnpId_ = std::move(toMove.pnpId_);
         name_ = std::move(toMove.name_);
         flow_ = toMove.flow_;
+        formFactor_ = toMove.formFactor_;
         renderVolume_ = toMove.renderVolume_;
         captureVolume_ = toMove.captureVolume_;
         captureIsDefault_ = toMove.captureIsDefault_;
@@ -90,6 +95,11 @@ SoundDeviceFlowType ed::audio::SoundDevice::GetFlow() const
     return flow_;
 }
 
+SoundDeviceFormFactor ed::audio::SoundDevice::GetFormFactor() const
+{
+    return formFactor_;
+}
+
 uint16_t ed::audio::SoundDevice::GetCurrentRenderVolume() const
 {
     return renderVolume_;
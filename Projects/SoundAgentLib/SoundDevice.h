@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include <string>
+#include <string_view>
 
 #include "public/SoundAgentInterface.h"
 
@@ -11,7 +12,8 @@ public:
 
 public:
     SoundDevice();
-    SoundDevice(std::string pnpId, std::string name, SoundDeviceFlowType flow, uint16_t renderVolume, uint16_t captureVolume, bool renderIsDefault, bool captureIsDefault);
+    SoundDevice(std::string pnpId, std::string name, SoundDeviceFlowType flow, uint16_t renderVolume, uint16_t captureVolume, bool renderIsDefault, bool captureIsDefault,
+        SoundDeviceFormFactor formFactor = SoundDeviceFormFactor::Unknown);
     SoundDevice(const SoundDevice & toCopy);
     SoundDevice(SoundDevice && toMove) noexcept;
     SoundDevice & operator=(const SoundDevice & toCopy);
@@ -19,8 +21,13 @@ public:
 
 public:
     [[nodiscard]] std::string GetName() const override;
+    // Without a copy; valid while the device is neither changed nor destroyed.
+    [[nodiscard]] std::string_view GetNameView() const { return name_; }
     [[nodiscard]] std::string GetPnpId() const override;
+    // Like GetNameView, as the string itself for the callers that need one.
+    [[nodiscard]] const std::string & GetPnpIdRef() const { return pnpId_; }
     [[nodiscard]] SoundDeviceFlowType GetFlow() const override;
+    [[nodiscard]] SoundDeviceFormFactor GetFormFactor() const override;
     [[nodiscard]] uint16_t GetCurrentRenderVolume() const override; // 0 to 1000
     [[nodiscard]] uint16_t GetCurrentCaptureVolume() const override; // 0 to 1000
     void SetCurrentRenderVolume(uint16_t volume); // 0 to 1000
@@ -34,6 +41,7 @@ private:
     std::string pnpId_;
     std::string name_;
     SoundDeviceFlowType flow_;
+    SoundDeviceFormFactor formFactor_;
     uint16_t renderVolume_; // 0 to 1000
     uint16_t captureVolume_; // 0 to 1000
     bool renderIsDefault_ = false;
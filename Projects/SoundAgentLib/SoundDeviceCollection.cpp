@@ -8,17 +8,22 @@ extern "C" const CLSID CLSID_StdGlobalInterfaceTable;
 
 #include "SoundDeviceCollection.h"
 
+#include "IdentifierText.h"
 #include "SoundDevice.h"
 #include "Utilities.h"
 
 #include "ApiClient/common/StringUtils.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <mmdeviceapi.h>
 #include <endpointvolume.h>
 #include <Functiondiscoverykeys_devpkey.h>
 #include <ranges>
+#include <set>
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <valarray>
 
 #include <magic_enum/magic_enum_iostream.hpp>
@@ -28,6 +33,9 @@ extern "C" const CLSID CLSID_StdGlobalInterfaceTable;
 using namespace std::literals::string_literals;
 
 namespace {
+    // the PnP id of the events of no device
+    const std::string no_device_pnp_id;
+
     SoundDeviceFlowType ConvertFromLowLevelFlow(const EDataFlow flow)
     {
         switch (flow)
@@ -43,77 +51,618 @@ namespace {
             return SoundDeviceFlowType::None;
         }
     }
+
+    SoundDeviceFormFactor ConvertFromLowLevelFormFactor(const EndpointFormFactor formFactor)
+    {
+        // the same values in the same order
+        return formFactor >= RemoteNetworkDevice && formFactor < UnknownFormFactor
+            ? static_cast<SoundDeviceFormFactor>(formFactor)
+            : SoundDeviceFormFactor::Unknown;
+    }
+
+    // The endpoint properties a device is made of, see TryCreateDeviceAndGetVolumeEndpoint.
+    bool IsDeviceProperty(const PROPERTYKEY & key)
+    {
+        return std::ranges::any_of(std::initializer_list<PROPERTYKEY>{
+                PKEY_Device_FriendlyName, PKEY_AudioEndpoint_FormFactor, PKEY_Device_ContainerId },
+            [&key](const PROPERTYKEY & deviceKey) { return key.fmtid == deviceKey.fmtid && key.pid == deviceKey.pid; });
+    }
+}
+
+
+ed::audio::SoundDeviceCollection::SoundDeviceCollection()
+    : SoundDeviceCollection(std::pmr::get_default_resource())
+{
+}
+
+ed::audio::SoundDeviceCollection::SoundDeviceCollection(std::pmr::memory_resource * upstream)
+    : upstream_(upstream)
+    , generation_(std::make_unique<DeviceGeneration>(pnpIds_, upstream))
+    , dispatcher_([this](SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion)
+        {
+            observers_.Notify(event, devicePnpId, stateVersion);
+        })
+    , eventScratch_(upstream)
+    , volumeStatesBefore_(upstream)
+{
+}
+
+ed::audio::SoundDeviceCollection::SoundDeviceCollection(IMMDeviceEnumerator * enumerator)
+    : SoundDeviceCollection(enumerator, std::pmr::get_default_resource())
+{
+}
+
+ed::audio::SoundDeviceCollection::SoundDeviceCollection(IMMDeviceEnumerator * enumerator, std::pmr::memory_resource * upstream)
+    : MultipleNotificationClient(enumerator)
+    , upstream_(upstream)
+    , generation_(std::make_unique<DeviceGeneration>(pnpIds_, upstream))
+    , dispatcher_([this](SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion)
+        {
+            observers_.Notify(event, devicePnpId, stateVersion);
+        })
+    , eventScratch_(upstream)
+    , volumeStatesBefore_(upstream)
+{
 }
 
+ed::audio::SoundDeviceCollection::DeviceGeneration::DeviceGeneration(StringInterner & pnpIds, std::pmr::memory_resource * upstream)
+    : Arena(generation_arena_bytes, upstream)
+    , Devices(pnpIds, &Arena)
+{
+}
 
 ed::audio::SoundDeviceCollection::~SoundDeviceCollection()
 {
+    StopPolling();
+    {
+        // waits for a running write, which uses the endpoints
+        std::lock_guard lock(writerMutex_);
+        writer_.reset();
+    }
     UnregisterAllEndpointsVolumes();
 }
 
 void ed::audio::SoundDeviceCollection::ResetContent()
 {
-    RecreateActiveDeviceList();
+    RecreateActiveDeviceList(false);
+}
+
+void ed::audio::SoundDeviceCollection::ReconcileContent()
+{
+    RecreateActiveDeviceList(true);
+}
+
+void ed::audio::SoundDeviceCollection::NotifyCurrentDefaults()
+{
+    std::lock_guard lock(stateMutex_);
+    NotifyObservers(SoundDeviceEventType::DefaultRenderChanged, defaultRenderDevicePnpId_.value_or(""));
+    NotifyObservers(SoundDeviceEventType::DefaultCaptureChanged, defaultCaptureDevicePnpId_.value_or(""));
 }
 
+void ed::audio::SoundDeviceCollection::LoadStaleContent(const SnapshotFile::Content & content)
+{
+    std::lock_guard lock(stateMutex_);
+    // the previous content is retired wholesale
+    generation_ = std::make_unique<DeviceGeneration>(pnpIds_, upstream_);
+    for (const auto & device : content.Devices)
+    {
+        generation_->Devices.Put(device);
+    }
+    defaultRenderDevicePnpId_ = content.DefaultRenderDevicePnpId;
+    defaultCaptureDevicePnpId_ = content.DefaultCaptureDevicePnpId;
+    stale_ = true;
+    spdlog::info("Serving {} devices of a snapshot saved {} s ago until they are enumerated.", generation_->Devices.GetSize(),
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - content.SavedAt).count());
+
+    MarkStateChanged();
+    NotifyObservers(SoundDeviceEventType::ContentReset, "");
+}
+
+uint64_t ed::audio::SoundDeviceCollection::GetStateVersion() const
+{
+    return stateVersion_.load();
+}
+
+SoundDeviceCollectionSnapshot ed::audio::SoundDeviceCollection::CreateSnapshot() const
+{
+    std::lock_guard lock(stateMutex_);
+
+    SoundDeviceCollectionSnapshot snapshot;
+    snapshot.StateVersion = stateVersion_.load();
+    snapshot.Devices.reserve(generation_->Devices.GetSize());
+    for (const auto & device : generation_->Devices.GetDevices())
+    {
+        snapshot.Devices.push_back(std::make_unique<SoundDevice>(device));
+    }
+    snapshot.DefaultRenderDevicePnpId = defaultRenderDevicePnpId_;
+    snapshot.DefaultCaptureDevicePnpId = defaultCaptureDevicePnpId_;
+    snapshot.IsStale = stale_;
+    return snapshot;
+}
+
+std::vector<SoundDeviceHistorySample> ed::audio::SoundDeviceCollection::GetHistory(const std::string & devicePnpId,
+    SoundDeviceHistoryKind kind, std::chrono::system_clock::time_point from, std::chrono::system_clock::time_point to) const
+{
+    return history_.Query(devicePnpId, kind, from, to);
+}
+
+// Must be called with stateMutex_ held, before the observers are notified about the change.
+void ed::audio::SoundDeviceCollection::MarkStateChanged()
+{
+    ++stateVersion_;
+}
+
+// Polls only where the notifications are unavailable.
 void ed::audio::SoundDeviceCollection::ActivateAndStartLoop()
 {
+    if (AreNotificationsRegistered())
+    {
+        return;
+    }
+    spdlog::warn("Audio endpoint notifications are unavailable: polling the audio devices instead.");
+    StartPolling(PollingSchedule::Options{});
 }
 
 void ed::audio::SoundDeviceCollection::DeactivateAndStopLoop()
 {
+    StopPolling();
+    StopVolumeWrites();
 }
 
-size_t ed::audio::SoundDeviceCollection::GetSize() const
+void ed::audio::SoundDeviceCollection::StartPolling(const PollingSchedule::Options & options)
 {
-    return pnpToDeviceMap_.size();
+    std::lock_guard lock(pollerMutex_);
+    poller_.reset();
+    polledFingerprint_ = 0;
+    poller_ = std::make_unique<ContentPoller>([this] { return PollContent(); }, options, executor_);
 }
 
-std::unique_ptr<SoundDeviceInterface> ed::audio::SoundDeviceCollection::CreateItem(size_t deviceNumber) const
+void ed::audio::SoundDeviceCollection::UseComExecutor(ComExecutor * executor)
 {
-    if (deviceNumber >= pnpToDeviceMap_.size())
+    std::scoped_lock lock(pollerMutex_, writerMutex_);
+    executor_ = executor;
+}
+
+// Must be called without stateMutex_ held: waits for a running poll.
+void ed::audio::SoundDeviceCollection::StopPolling()
+{
+    std::lock_guard lock(pollerMutex_);
+    poller_.reset();
+}
+
+std::optional<ed::audio::ContentPoller::Statistics> ed::audio::SoundDeviceCollection::GetPollingStatistics() const
+{
+    std::lock_guard lock(pollerMutex_);
+    if (poller_ == nullptr)
     {
-        throw std::runtime_error("Device number is too big");
+        return std::nullopt;
     }
-    size_t i = 0;
-    for (const auto & recordVal : pnpToDeviceMap_ | std::views::values)
+    return poller_->GetStatistics();
+}
+
+bool ed::audio::SoundDeviceCollection::SetVolume(const std::string & devicePnpId, SoundDeviceFlowType flow, uint16_t volume)
+{
+    std::optional<StringInterner::Id> endpointHandle;
+    {
+        std::lock_guard lock(stateMutex_);
+        endpointHandle = FindEndpointOfDevice(devicePnpId, flow);
+    }
+    if (!endpointHandle.has_value())
+    {
+        return false;
+    }
+    auto * writer = GetVolumeWriter();
+    if (writer == nullptr)
+    {
+        return false;
+    }
+    writer->SetVolume(*endpointHandle, volume);
+    return true;
+}
+
+bool ed::audio::SoundDeviceCollection::SetMute(const std::string & devicePnpId, SoundDeviceFlowType flow, bool mute)
+{
+    std::optional<StringInterner::Id> endpointHandle;
+    {
+        std::lock_guard lock(stateMutex_);
+        endpointHandle = FindEndpointOfDevice(devicePnpId, flow);
+    }
+    if (!endpointHandle.has_value())
+    {
+        return false;
+    }
+    auto * writer = GetVolumeWriter();
+    if (writer == nullptr)
+    {
+        return false;
+    }
+    writer->SetMute(*endpointHandle, mute);
+    return true;
+}
+
+bool ed::audio::SoundDeviceCollection::RampVolume(const std::string & devicePnpId, SoundDeviceFlowType flow, uint16_t volume,
+    std::chrono::milliseconds duration)
+{
+    std::optional<StringInterner::Id> endpointHandle;
+    EndPointVolumeSmartPtr endpointVolume;
+    uint16_t from = 0;
     {
-        if (i++ == deviceNumber)
+        std::lock_guard lock(stateMutex_);
+        endpointHandle = FindEndpointOfDevice(devicePnpId, flow);
+        if (!endpointHandle.has_value())
         {
-            return std::make_unique<SoundDevice>(recordVal);
+            return false;
         }
+        endpointVolume = endpoints_.find(*endpointHandle)->second.Volume;
+        const auto * device = generation_->Devices.Find(devicePnpId);
+        from = flow == SoundDeviceFlowType::Render ? device->GetCurrentRenderVolume() : device->GetCurrentCaptureVolume();
+    }
+    // from the level rather than the volume as last read: a muted endpoint reads as 0, and its ramp would jump
+    ComExecutor * executor;
+    {
+        std::lock_guard lock(writerMutex_);
+        executor = executor_;
+    }
+    const auto readLevel = [&endpointVolume] { return TryGetLevel(endpointVolume); };
+    from = (executor != nullptr ? executor->Invoke(readLevel) : readLevel()).value_or(from);
+
+    auto * writer = GetVolumeWriter();
+    if (writer == nullptr)
+    {
+        return false;
+    }
+    writer->RampVolume(*endpointHandle, from, volume, duration);
+    return true;
+}
+
+bool ed::audio::SoundDeviceCollection::WaitForVolumeWrites(std::chrono::milliseconds timeout)
+{
+    VolumeWriter * writer;
+    {
+        std::lock_guard lock(writerMutex_);
+        writer = writer_.get();
+    }
+    // the writer lives as long as the collection, once created
+    return writer == nullptr || writer->WaitUntilIdle(timeout);
+}
+
+std::optional<ed::audio::VolumeWriter::Statistics> ed::audio::SoundDeviceCollection::GetVolumeWriteStatistics() const
+{
+    std::lock_guard lock(writerMutex_);
+    if (writer_ == nullptr)
+    {
+        return std::nullopt;
+    }
+    return writer_->GetStatistics();
+}
+
+ed::audio::VolumeWriter * ed::audio::SoundDeviceCollection::GetVolumeWriter()
+{
+    std::lock_guard lock(writerMutex_);
+    if (writesStopped_)
+    {
+        return nullptr;
+    }
+    if (writer_ == nullptr)
+    {
+        writer_ = std::make_unique<VolumeWriter>(
+            [this](VolumeWriter::Key endpointHandle, uint16_t volume) { return WriteEndpointVolume(endpointHandle, volume); },
+            [this](VolumeWriter::Key endpointHandle, bool mute) { return WriteEndpointMute(endpointHandle, mute); },
+            VolumeWriter::Options{}, executor_);
+    }
+    return writer_.get();
+}
+
+// Not on the executor thread of UseComExecutor: waits for a running write, which may be waiting for it.
+// The writer is kept, stopped, for WaitForVolumeWrites.
+void ed::audio::SoundDeviceCollection::StopVolumeWrites()
+{
+    std::lock_guard lock(writerMutex_);
+    writesStopped_ = true;
+    if (writer_ != nullptr)
+    {
+        writer_->Stop();
     }
-    throw std::runtime_error("Device number not found");
+}
+
+// Must be called with stateMutex_ held. Render or Capture only: the endpoint of one flow is written.
+std::optional<ed::audio::StringInterner::Id> ed::audio::SoundDeviceCollection::FindEndpointOfDevice(const std::string & devicePnpId,
+    SoundDeviceFlowType flow) const
+{
+    if (flow != SoundDeviceFlowType::Render && flow != SoundDeviceFlowType::Capture)
+    {
+        return std::nullopt;
+    }
+    const auto deviceHandle = generation_->Devices.FindHandle(devicePnpId);
+    if (!deviceHandle.has_value())
+    {
+        return std::nullopt;
+    }
+    for (const auto & [endpointHandle, endpoint] : endpoints_)
+    {
+        if (endpoint.DeviceHandle == *deviceHandle && endpoint.Device.GetFlow() == flow && endpoint.Volume != nullptr)
+        {
+            return endpointHandle;
+        }
+    }
+    return std::nullopt;
+}
+
+// Must be called without stateMutex_ held, from the writer's thread: the endpoint may notify the change on it.
+bool ed::audio::SoundDeviceCollection::WriteEndpointVolume(StringInterner::Id endpointHandle, uint16_t volume)
+{
+    EndPointVolumeSmartPtr endpointVolume;
+    {
+        std::lock_guard lock(stateMutex_);
+        const auto found = endpoints_.find(endpointHandle);
+        if (found == endpoints_.end() || found->second.Volume == nullptr)
+        {
+            return false;
+        }
+        endpointVolume = found->second.Volume;
+    }
+    if (FAILED(endpointVolume->SetMasterVolumeLevelScalar(static_cast<float>(volume) / 1000.0f, &volumeWriteContext_)))
+    {
+        return false;
+    }
+    TakeWrittenVolume(endpointHandle, endpointVolume);
+    return true;
+}
+
+// Must be called without stateMutex_ held, like WriteEndpointVolume.
+bool ed::audio::SoundDeviceCollection::WriteEndpointMute(StringInterner::Id endpointHandle, bool mute)
+{
+    EndPointVolumeSmartPtr endpointVolume;
+    {
+        std::lock_guard lock(stateMutex_);
+        const auto found = endpoints_.find(endpointHandle);
+        if (found == endpoints_.end() || found->second.Volume == nullptr)
+        {
+            return false;
+        }
+        endpointVolume = found->second.Volume;
+    }
+    // S_FALSE if unchanged
+    if (FAILED(endpointVolume->SetMute(mute ? TRUE : FALSE, &volumeWriteContext_)))
+    {
+        return false;
+    }
+    TakeWrittenVolume(endpointHandle, endpointVolume);
+    return true;
+}
+
+// Must be called without stateMutex_ held. Reads back what the endpoint made of a write and takes it into the device,
+// its fingerprint and the history, in place of the echo OnNotify skips; a new state version, but no event.
+void ed::audio::SoundDeviceCollection::TakeWrittenVolume(StringInterner::Id endpointHandle, const EndPointVolumeSmartPtr & endpointVolume)
+{
+    const auto volume = TryGetVolume(endpointVolume);
+    if (!volume.has_value())
+    {
+        return;
+    }
+    std::lock_guard lock(stateMutex_);
+    const auto found = endpoints_.find(endpointHandle);
+    // unregistered meanwhile, or registered anew by a reset that read the volume itself
+    if (found == endpoints_.end() || found->second.Volume != endpointVolume)
+    {
+        return;
+    }
+    auto & endpoint = found->second;
+    const auto * device = generation_->Devices.Find(endpoint.DeviceHandle);
+    if (device == nullptr)
+    {
+        return;
+    }
+    endpoint.Fingerprint = GetEndpointFingerprint(endpointHandle, *volume);
+    const bool isRender = endpoint.Device.GetFlow() == SoundDeviceFlowType::Render;
+    if ((isRender ? device->GetCurrentRenderVolume() : device->GetCurrentCaptureVolume()) == *volume)
+    {
+        return;
+    }
+    if (isRender)
+    {
+        generation_->Devices.SetRenderVolume(endpoint.DeviceHandle, *volume);
+    }
+    else
+    {
+        generation_->Devices.SetCaptureVolume(endpoint.DeviceHandle, *volume);
+    }
+    MarkStateChanged();
+    if (!stale_)
+    {
+        RecordDeviceVolumes(*generation_->Devices.Find(endpoint.DeviceHandle), std::chrono::system_clock::now());
+    }
+}
+
+GUID ed::audio::SoundDeviceCollection::CreateVolumeWriteContext()
+{
+    GUID context{};
+    if (FAILED(CoCreateGuid(&context)))
+    {
+        spdlog::warn("No event context for volume writes: the echoes of the own writes are notified as changes.");
+    }
+    return context;
+}
+
+// Must be called without stateMutex_ held.
+bool ed::audio::SoundDeviceCollection::PollContent()
+{
+    if (!TryCreateSystemEnumerator())
+    {
+        return false;
+    }
+    const auto fingerprint = FingerprintActiveEndpointsAndDefaults();
+    if (!fingerprint.has_value())
+    {
+        return false;
+    }
+    if (*fingerprint != polledFingerprint_)
+    {
+        spdlog::info("Polling found the audio endpoints or the defaults changed.");
+        const auto stateVersion = stateVersion_.load();
+        ReconcileContent();
+        polledFingerprint_ = *fingerprint;
+        return stateVersion_.load() != stateVersion;
+    }
+
+    std::lock_guard lock(stateMutex_);
+    return HaveVolumesChanged() && RefreshVolumesAndNotifyObservers();
+}
+
+// Must be called without stateMutex_ held: enumerates. The sum of the fingerprints of the active endpoint ids,
+// combined with those of the default ids; nullopt if the endpoints cannot be enumerated.
+std::optional<uint64_t> ed::audio::SoundDeviceCollection::FingerprintActiveEndpointsAndDefaults() const
+{
+    const auto enumerator = GetEnumeratorOrNull();
+    if (enumerator == nullptr)
+    {
+        return std::nullopt;
+    }
+    CComPtr<IMMDeviceCollection> endpoints;
+    UINT count = 0;
+    if (FAILED(enumerator->EnumAudioEndpoints(eAll, DEVICE_STATE_ACTIVE, &endpoints)) || FAILED(endpoints->GetCount(&count)))
+    {
+        return std::nullopt;
+    }
+    uint64_t fingerprint = 0;
+    for (UINT i = 0; i < count; ++i)
+    {
+        CComPtr<IMMDevice> endpoint;
+        if (SUCCEEDED(endpoints->Item(i, &endpoint)))
+        {
+            if (const auto endpointId = GetDeviceId(endpoint); endpointId.has_value())
+            {
+                fingerprint += Fingerprint::Of(*endpointId);
+            }
+        }
+    }
+    fingerprint = Fingerprint::Combine(fingerprint, count);
+    // unlike TryGetRenderAndCaptureDefaultDeviceIds, silent about a flow without a default: that is no news when polling
+    for (const auto flow : { eRender, eCapture })
+    {
+        CComPtr<IMMDevice> defaultEndpoint;
+        std::optional<std::wstring> defaultId;
+        if (SUCCEEDED(enumerator->GetDefaultAudioEndpoint(flow, eConsole, &defaultEndpoint)))
+        {
+            defaultId = GetDeviceId(defaultEndpoint);
+        }
+        fingerprint = Fingerprint::Combine(fingerprint, defaultId.has_value() ? Fingerprint::Of(*defaultId) : 0);
+    }
+    return fingerprint;
+}
+
+uint64_t ed::audio::SoundDeviceCollection::GetEndpointFingerprint(StringInterner::Id endpointHandle, uint16_t volume) const
+{
+    return Fingerprint::Combine(Fingerprint::Of(endpointIds_.Resolve(endpointHandle)), volume);
+}
+
+size_t ed::audio::SoundDeviceCollection::GetSize() const
+{
+    std::lock_guard lock(stateMutex_);
+    return generation_->Devices.GetSize();
+}
+
+std::unique_ptr<SoundDeviceInterface> ed::audio::SoundDeviceCollection::CreateItem(size_t deviceNumber) const
+{
+    std::lock_guard lock(stateMutex_);
+    if (deviceNumber >= generation_->Devices.GetSize())
+    {
+        throw std::runtime_error("Device number is too big");
+    }
+    return std::make_unique<SoundDevice>(generation_->Devices.GetAt(deviceNumber));
 }
 
 std::unique_ptr<SoundDeviceInterface> ed::audio::SoundDeviceCollection::CreateItem(
     const std::string & devicePnpId) const
 {
-    if (!pnpToDeviceMap_.contains(devicePnpId))
+    std::lock_guard lock(stateMutex_);
+    const auto device = generation_->Devices.Find(devicePnpId);
+    if (device == nullptr)
     {
         return nullptr;
     }
-    return std::make_unique<SoundDevice>(pnpToDeviceMap_.at(devicePnpId));
+    return std::make_unique<SoundDevice>(*device);
 }
 
 std::optional<std::string> ed::audio::SoundDeviceCollection::GetDefaultRenderDevicePnpId() const
 {
+    std::lock_guard lock(stateMutex_);
     return defaultRenderDevicePnpId_;
 }
 
 std::optional<std::string> ed::audio::SoundDeviceCollection::GetDefaultCaptureDevicePnpId() const
 {
+    std::lock_guard lock(stateMutex_);
     return defaultCaptureDevicePnpId_;
 }
 
+bool ed::audio::SoundDeviceCollection::ReadDefaultRenderDevicePnpId(std::string & pnpId) const
+{
+    std::lock_guard lock(stateMutex_);
+    pnpId.assign(defaultRenderDevicePnpId_.has_value() ? *defaultRenderDevicePnpId_ : std::string_view());
+    return defaultRenderDevicePnpId_.has_value();
+}
+
+bool ed::audio::SoundDeviceCollection::ReadDefaultCaptureDevicePnpId(std::string & pnpId) const
+{
+    std::lock_guard lock(stateMutex_);
+    pnpId.assign(defaultCaptureDevicePnpId_.has_value() ? *defaultCaptureDevicePnpId_ : std::string_view());
+    return defaultCaptureDevicePnpId_.has_value();
+}
+
 void ed::audio::SoundDeviceCollection::Subscribe(SoundDeviceObserverInterface & observer)
 {
-    observers_.insert(&observer);
+    observers_.Add(observer);
+}
+
+void ed::audio::SoundDeviceCollection::Unsubscribe(SoundDeviceObserverInterface & observer, bool waitForRunningNotifications)
+{
+    observers_.Remove(observer, waitForRunningNotifications);
 }
 
-void ed::audio::SoundDeviceCollection::Unsubscribe(SoundDeviceObserverInterface & observer)
+ed::audio::NotificationDispatcher::Statistics ed::audio::SoundDeviceCollection::GetDeliveryStatistics() const
 {
-    observers_.erase(&observer);
+    return dispatcher_.GetStatistics();
+}
+
+ed::audio::DeviceStateColumns ed::audio::SoundDeviceCollection::GetStateColumns() const
+{
+    std::lock_guard lock(stateMutex_);
+    return generation_->Devices.GetStateColumns();
+}
+
+std::string ed::audio::SoundDeviceCollection::GetPnpIdOfRow(DeviceStateColumns::Row row) const
+{
+    return std::string(pnpIds_.Resolve(row));
+}
+
+ed::audio::SoundDeviceCollection::ContentAudit ed::audio::SoundDeviceCollection::Audit() const
+{
+    const auto historyBytes = history_.GetStatistics().MemoryBytes;
+    std::lock_guard lock(stateMutex_);
+    const auto & devices = generation_->Devices;
+    ContentAudit audit;
+    audit.Devices = devices.GetSize();
+    audit.Endpoints = endpoints_.size();
+    audit.InternedPnpIds = pnpIds_.GetSize();
+    audit.InternedEndpointIds = endpointIds_.GetSize();
+    audit.HistoryBytes = historyBytes;
+
+    std::unordered_set<DeviceTable::Handle> devicesWithEndpoints;
+    for (const auto & endpoint : endpoints_ | std::views::values)
+    {
+        const auto * device = devices.Find(endpoint.DeviceHandle);
+        const auto flow = endpoint.Device.GetFlow();
+        if (device == nullptr
+            || (device->GetFlow() != flow && device->GetFlow() != SoundDeviceFlowType::RenderAndCapture))
+        {
+            ++audit.OrphanEndpoints;
+            continue;
+        }
+        devicesWithEndpoints.insert(endpoint.DeviceHandle);
+    }
+    audit.DevicesWithoutEndpoints = devices.GetSize() - devicesWithEndpoints.size();
+    return audit;
 }
 
 // ReSharper disable once CppPassValueParameterByConstReference
@@ -134,18 +683,35 @@ std::optional<std::wstring> ed::audio::SoundDeviceCollection::GetDeviceId(CComPt
     return deviceId;
 }
 
-std::string ed::audio::SoundDeviceCollection::DeviceIdToPnpIdForm(const std::string& deviceIdAscii)
+std::optional<uint16_t> ed::audio::SoundDeviceCollection::TryGetVolume(const EndPointVolumeSmartPtr & endpointVolume)
 {
-    auto pnpId = deviceIdAscii;
-    if (pnpId.length() > 79)
+    BOOL mute;
+    if (FAILED(endpointVolume->GetMute(&mute)))
     {
-        pnpId = pnpId.substr(0, 79);
+        return std::nullopt;
     }
-    std::erase_if(pnpId,
-                  [](wchar_t c) { return c == L'{' || c == L'}'; });
+    if (mute != FALSE)
+    {
+        return 0;
+    }
+    return TryGetLevel(endpointVolume);
+}
+
+std::optional<uint16_t> ed::audio::SoundDeviceCollection::TryGetLevel(const EndPointVolumeSmartPtr & endpointVolume)
+{
+    float volume = 0.0f;
+    if (FAILED(endpointVolume->GetMasterVolumeLevelScalar(&volume)))
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint16_t>(lround(volume * 1000.0f));
+}
 
-    std::ranges::transform(pnpId, pnpId.begin(),
-                           [](wchar_t c) { return std::toupper(c); });
+std::string ed::audio::SoundDeviceCollection::DeviceIdToPnpIdForm(const std::string& deviceIdAscii)
+{
+    auto pnpId = deviceIdAscii.substr(0, 79);
+    IdentifierText::StripBraces(pnpId);
+    IdentifierText::ToUpperAscii(pnpId);
 
     return pnpId;
 }
@@ -163,7 +729,7 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
         return false;
     }
     deviceId = deviceIdOpt.value();
-    auto deviceIdAscii = WString2StringTruncate(deviceId);
+    auto deviceIdAscii = IdentifierText::Utf16ToAscii(deviceId);
 
 
     HRESULT hr;
@@ -189,7 +755,7 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
     // Read device PnP Class id property
     std::string pnpId;
     std::string name;
-    EndpointFormFactor formFactorEnum;
+    EndpointFormFactor formFactorEnum = UnknownFormFactor;
     {
         IPropertyStore* pProps = nullptr;
         hr = deviceEndpointSmartPtr->OpenPropertyStore(STGM_READ, &pProps);
@@ -206,7 +772,7 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
             assert(SUCCEEDED(hr));
             if (propVarForName.vt == VT_LPWSTR)
             {
-                name = Utf16ToUtf8(propVarForName.pwszVal);
+                name = IdentifierText::Utf16ToUtf8(propVarForName.pwszVal);
                 spdlog::info(R"(The end point device "{}" got a name "{}".)",
                              deviceIdAscii, name);
             }
@@ -248,23 +814,13 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
             assert(SUCCEEDED(hr));
             assert(propVarForGuid.vt == VT_CLSID);
             {
-                WCHAR buff[80];
-                // ReSharper disable once CppTooWideScopeInitStatement
-                const auto len = StringFromGUID2(
-                    *propVarForGuid.puuid,
-                    buff,
-                    std::size(buff)
-                );
-                if (len >= 2)
+                constexpr auto noPlugAndPlayGuid = "00000000-0000-0000-FFFF-FFFFFFFFFFFF";
+                static const auto noPlugAndPlayContainerId = IdentifierText::ParseGuid(noPlugAndPlayGuid).value();
+                if (*propVarForGuid.puuid != noPlugAndPlayContainerId)
                 {
-                    pnpId = WString2StringTruncate(buff);
-                    if (pnpId[0] == '{')
-                    {
-                        pnpId = pnpId.substr(1, pnpId.length() - 2);
-                    }
+                    pnpId = IdentifierText::FormatGuid(*propVarForGuid.puuid);
                 }
-                if (constexpr auto noPlugAndPlayGuid = "00000000-0000-0000-FFFF-FFFFFFFFFFFF"
-                    ; pnpId == noPlugAndPlayGuid)
+                else
                 {
                     pnpId = DeviceIdToPnpIdForm(deviceIdAscii);
 
@@ -310,20 +866,16 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
         spdlog::warn(R"(The end point device "{}" has no volume property.)", deviceIdAscii);
         return false;
     }
-    BOOL mute;
-    hr = outVolumeEndpoint->GetMute(&mute);
-    if (FAILED(hr)) {
-        return false;
-    }
-    if (mute == FALSE) {
-        float currVolume = 0.0f;
-        hr = outVolumeEndpoint->GetMasterVolumeLevelScalar(&currVolume);
-        if (FAILED(hr)) {
-            return false;
-        }
-        volume = static_cast<uint16_t>(lround(currVolume * 1000.0f));
+    if (const auto volumeOpt = TryGetVolume(outVolumeEndpoint)
+        ; volumeOpt.has_value())
+    {
+        volume = *volumeOpt;
         spdlog::info(R"(The end point device "{}" has a volume "{}".)", deviceIdAscii, volume);
     }
+    else
+    {
+        return false;
+    }
     uint16_t renderVolume = 0;
     uint16_t captureVolume = 0;
 
@@ -339,7 +891,7 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
     case SoundDeviceFlowType::RenderAndCapture:
         break;
     }
-    device = SoundDevice(pnpId, name, flow, renderVolume, captureVolume, false, false);
+    device = SoundDevice(pnpId, name, flow, renderVolume, captureVolume, false, false, ConvertFromLowLevelFormFactor(formFactorEnum));
     return true;
 }
 
@@ -390,14 +942,24 @@ ed::audio::SoundDeviceCollection::TryGetRenderAndCaptureDefaultDeviceIds() const
     return {GetDeviceId(renderDeviceSmartPtr), GetDeviceId(captureDeviceSmartPtr)};
 }
 
+// Must be called without stateMutex_ held.
 void ed::audio::SoundDeviceCollection::UnregisterAllEndpointsVolumes()
 {
-    for (const auto& [deviceId, endpointVolume] : devIdToEndpointVolumes_)
+    std::unordered_map<StringInterner::Id, Endpoint> endpointsToUnregister;
     {
+        std::lock_guard lock(stateMutex_);
+        endpointsToUnregister.swap(endpoints_);
+    }
+    for (const auto& [endpointHandle, endpoint] : endpointsToUnregister)
+    {
+        if (endpoint.Volume == nullptr)
+        {
+            continue;
+        }
         // ReSharper disable once CppFunctionResultShouldBeUsed
-        endpointVolume->UnregisterControlChangeNotify(this);
+        endpoint.Volume->UnregisterControlChangeNotify(this);
         spdlog::info(R"(The next end point device "{}" unregistered for notifications.)",
-            WString2StringTruncate(deviceId));
+            endpointIds_.Resolve(endpointHandle));
     }
 }
 
@@ -413,24 +975,47 @@ void ed::audio::SoundDeviceCollection::UnregisterAllEndpointsVolumes()
 //     return 0;
 // }
 
-void ed::audio::SoundDeviceCollection::UnregisterAndRemoveEndpointsVolumes(const std::wstring & deviceId)
+// Must be called with stateMutex_ held.
+const ed::audio::SoundDeviceCollection::Endpoint * ed::audio::SoundDeviceCollection::FindEndpoint(std::wstring_view deviceId) const
 {
-    if
-    (
-        const auto foundPair = devIdToEndpointVolumes_.find(deviceId)
-        ; foundPair != devIdToEndpointVolumes_.end()
-    )
+    const auto endpointHandle = endpointIds_.Find(IdentifierText::Utf16ToUtf8(deviceId));
+    if (!endpointHandle.has_value())
     {
-        auto audioEndpointVolume = foundPair->second;
-        // ReSharper disable once CppFunctionResultShouldBeUsed
-        audioEndpointVolume->UnregisterControlChangeNotify(this);
-        spdlog::info(R"(The end point device "{}" unregistered for notifications before removal.)",
-            WString2StringTruncate(deviceId));
+        return nullptr;
+    }
+    const auto found = endpoints_.find(*endpointHandle);
+    return found != endpoints_.end() ? &found->second : nullptr;
+}
+
+// Must be called with stateMutex_ held.
+std::optional<ed::audio::SoundDeviceCollection::Endpoint> ed::audio::SoundDeviceCollection::TakeEndpoint(std::wstring_view deviceId)
+{
+    const auto endpointHandle = endpointIds_.Find(IdentifierText::Utf16ToUtf8(deviceId));
+    if (!endpointHandle.has_value())
+    {
+        return std::nullopt;
+    }
+    auto node = endpoints_.extract(*endpointHandle);
+    if (node.empty())
+    {
+        return std::nullopt;
+    }
+    return std::move(node.mapped());
+}
 
-        //        const auto ii = CountRef(static_cast<IAudioEndpointVolume*>(audioEndpointVolume));
-        audioEndpointVolume.Detach();
-        devIdToEndpointVolumes_.erase(foundPair);
+// Must be called without stateMutex_ held.
+// ReSharper disable once CppPassValueParameterByConstReference
+void ed::audio::SoundDeviceCollection::UnregisterEndpointVolume(const std::wstring & deviceId, EndPointVolumeSmartPtr endpointVolume)  // NOLINT(performance-unnecessary-value-param)
+{
+    if (endpointVolume == nullptr)
+    {
+        return;
     }
+    // ReSharper disable once CppFunctionResultShouldBeUsed
+    endpointVolume->UnregisterControlChangeNotify(this);
+    spdlog::info(R"(The end point device "{}" unregistered for notifications before removal.)",
+        IdentifierText::Utf16ToAscii(deviceId));
+    // the reference taken from the endpoint is released here, with the last notification gone
 }
 
 ed::audio::SoundDevice ed::audio::SoundDeviceCollection::MergeDeviceWithExistingOneBasedOnPnpIdAndFlow(
@@ -438,8 +1023,8 @@ ed::audio::SoundDevice ed::audio::SoundDeviceCollection::MergeDeviceWithExisting
 {
     if
     (
-        const auto foundPair = pnpToDeviceMap_.find(device.GetPnpId())
-        ; foundPair != pnpToDeviceMap_.end()
+        const auto foundDevPtr = generation_->Devices.Find(device.GetPnpId())
+        ; foundDevPtr != nullptr
     )
     {
         auto flow = device.GetFlow();
@@ -447,9 +1032,10 @@ ed::audio::SoundDevice ed::audio::SoundDeviceCollection::MergeDeviceWithExisting
         uint16_t captureVolume = device.GetCurrentCaptureVolume();
         bool captureIsDefault = device.IsCaptureCurrentlyDefault();
         bool renderIsDefault = device.IsRenderCurrentlyDefault();
+        auto formFactor = device.GetFormFactor();
 
 
-        const auto & foundDev = foundPair->second;
+        const auto & foundDev = *foundDevPtr;
         if (foundDev.GetFlow() != device.GetFlow())
         {
 
@@ -469,6 +1055,11 @@ ed::audio::SoundDevice ed::audio::SoundDeviceCollection::MergeDeviceWithExisting
             }
 
             flow = SoundDeviceFlowType::RenderAndCapture;
+            // a device of both flows is described by its render endpoint, e.g. Headphones rather than Microphone
+            if (device.GetFlow() == SoundDeviceFlowType::Capture)
+            {
+                formFactor = foundDev.GetFormFactor();
+            }
         }
         auto foundDevNameAsSet = Split(foundDev.GetName(), '/');
 
@@ -476,18 +1067,64 @@ ed::audio::SoundDevice ed::audio::SoundDeviceCollection::MergeDeviceWithExisting
         return {
             device.GetPnpId(), Merge(foundDevNameAsSet, '/'),
             flow, renderVolume, captureVolume,
-            renderIsDefault, captureIsDefault
+            renderIsDefault, captureIsDefault, formFactor
         };
     }
     return device;
 }
 
+// Must be called with stateMutex_ held. A device of both flows is described by its render endpoint, as when merged
+// on registration.
+std::optional<ed::audio::SoundDevice> ed::audio::SoundDeviceCollection::MergeEndpointsOfDevice(
+    DeviceTable::Handle handle, const SoundDevice & base) const
+{
+    std::set<std::string> names;
+    bool hasRender = false;
+    bool hasCapture = false;
+    auto renderFormFactor = SoundDeviceFormFactor::Unknown;
+    auto captureFormFactor = SoundDeviceFormFactor::Unknown;
+    for (const auto & endpoint : endpoints_ | std::views::values)
+    {
+        if (endpoint.DeviceHandle != handle)
+        {
+            continue;
+        }
+        names.insert(endpoint.Device.GetName());
+        if (endpoint.Device.GetFlow() == SoundDeviceFlowType::Render)
+        {
+            hasRender = true;
+            renderFormFactor = endpoint.Device.GetFormFactor();
+        }
+        else
+        {
+            hasCapture = true;
+            captureFormFactor = endpoint.Device.GetFormFactor();
+        }
+    }
+    if (names.empty())
+    {
+        return std::nullopt;
+    }
+    const auto flow = hasRender && hasCapture
+        ? SoundDeviceFlowType::RenderAndCapture
+        : hasRender ? SoundDeviceFlowType::Render : SoundDeviceFlowType::Capture;
+    return SoundDevice(
+        base.GetPnpId(), Merge(names, '/'), flow,
+        hasRender ? base.GetCurrentRenderVolume() : uint16_t{ 0 }, hasCapture ? base.GetCurrentCaptureVolume() : uint16_t{ 0 },
+        hasRender && base.IsRenderCurrentlyDefault(), hasCapture && base.IsCaptureCurrentlyDefault(),
+        hasRender ? renderFormFactor : captureFormFactor);
+}
+
 // ReSharper disable once CppPassValueParameterByConstReference
 void ed::audio::SoundDeviceCollection::ProcessActiveDeviceList(const ProcessDeviceFunctionT& processDeviceFunc)
 {
     HRESULT hr;
     CComPtr<IMMDeviceCollection> deviceCollectionSmartPtr;
-    if (GetEnumeratorOrNull() != nullptr)
+    if (GetEnumeratorOrNull() == nullptr)
+    {
+        spdlog::warn("No audio device enumerator: no devices to enumerate.");
+        return;
+    }
     {
         IMMDeviceCollection* deviceCollection = nullptr;
         hr = GetEnumeratorOrNull()->EnumAudioEndpoints(
@@ -534,13 +1171,16 @@ void ed::audio::SoundDeviceCollection::ProcessActiveDeviceList(const ProcessDevi
 }
 
 
-void ed::audio::SoundDeviceCollection::RecreateActiveDeviceList()
+void ed::audio::SoundDeviceCollection::RecreateActiveDeviceList(bool notifyDifferences)
 {
     spdlog::info("Recreating audio device info list..");
-    pnpToDeviceMap_.clear();
-
     UnregisterAllEndpointsVolumes();
-    devIdToEndpointVolumes_.clear();
+
+    std::lock_guard lock(stateMutex_);
+    // dropped, arena and all, when the differences to it are notified
+    const auto previousGeneration = std::exchange(generation_, std::make_unique<DeviceGeneration>(pnpIds_, upstream_));
+    const auto previousDefaultRender = std::exchange(defaultRenderDevicePnpId_, std::nullopt);
+    const auto previousDefaultCapture = std::exchange(defaultCaptureDevicePnpId_, std::nullopt);
 
     auto [renderDefaultDeviceId, captureDefaultDeviceId] = TryGetRenderAndCaptureDefaultDeviceIds();
 
@@ -550,11 +1190,11 @@ void ed::audio::SoundDeviceCollection::RecreateActiveDeviceList()
             RegisterDevice(self, deviceId, device, endpointVolume);  // NOLINT(performance-unnecessary-value-param)
 
             const auto pnpId = device.GetPnpId();
-            const auto foundPair = self->pnpToDeviceMap_.find(pnpId);
 
-            if (SoundDevice* foundDevicePtr = foundPair != self->pnpToDeviceMap_.end() ? &(foundPair->second) : nullptr
-                ; foundDevicePtr != nullptr)
+            if (const auto handle = self->generation_->Devices.FindHandle(pnpId)
+                ; handle.has_value())
             {
+                const auto & foundDevice = *self->generation_->Devices.Find(*handle);
                 if
                 (
                     (device.GetFlow() == SoundDeviceFlowType::Render || device.GetFlow() ==
@@ -562,13 +1202,13 @@ void ed::audio::SoundDeviceCollection::RecreateActiveDeviceList()
                     && renderDefaultDeviceId.has_value() && *renderDefaultDeviceId == deviceId
                 )
                 {
-                    foundDevicePtr->SetRenderCurrentlyDefault(true);
+                    self->generation_->Devices.SetRenderDefault(*handle, true);
                     defaultRenderDevicePnpId_ = pnpId;
                     spdlog::info(
                         R"(Device "{}", PnPId "{}", name "{}" detected as Render-Default and set respectively.)"
-                        , WString2StringTruncate(deviceId)
+                        , IdentifierText::Utf16ToAscii(deviceId)
                         , pnpId
-                        , foundDevicePtr->GetName()
+                        , foundDevice.GetName()
                     );
                 }
                 if
@@ -578,24 +1218,178 @@ void ed::audio::SoundDeviceCollection::RecreateActiveDeviceList()
                     && captureDefaultDeviceId.has_value() && *captureDefaultDeviceId == deviceId
                 )
                 {
-                    foundDevicePtr->SetCaptureCurrentlyDefault(true);
+                    self->generation_->Devices.SetCaptureDefault(*handle, true);
                     defaultCaptureDevicePnpId_ = pnpId;
                     spdlog::info(
                         R"(Device "{}", PnPId "{}", name "{}" detected as Capture-Default and set respectively.)"
-                        , WString2StringTruncate(deviceId)
+                        , IdentifierText::Utf16ToAscii(deviceId)
                         , pnpId
-                        , foundDevicePtr->GetName()
+                        , foundDevice.GetName()
                     );
                 }
             }
         };
     ProcessActiveDeviceList(setActiveAndRegisterDeviceClosure);
+    stale_ = false;
+
+    if (notifyDifferences)
+    {
+        NotifyDifferences(previousGeneration->Devices, previousDefaultRender, previousDefaultCapture);
+        // the history gets the devices that did not change, too
+        RecordHistory(SoundDeviceEventType::ContentReset, "");
+        return;
+    }
+    MarkStateChanged();
+    NotifyObservers(SoundDeviceEventType::ContentReset, "");
+}
+
+// Must be called with stateMutex_ held. A device whose name or flow changed is discovered anew.
+void ed::audio::SoundDeviceCollection::NotifyDifferences(const DeviceTable & previousDevices,
+    const std::optional<std::string> & previousDefaultRender, const std::optional<std::string> & previousDefaultCapture)
+{
+    const auto & devices = generation_->Devices;
+    // the PnP ids stay in both tables and in the defaults until the events are posted
+    std::pmr::vector<std::pair<SoundDeviceEventType, const std::string *>> events(&eventScratch_);
+    // both tables share the interner: the devices compare by handle
+    for (size_t i = 0; i < previousDevices.GetSize(); ++i)
+    {
+        if (devices.Find(previousDevices.GetHandleAt(i)) == nullptr)
+        {
+            events.emplace_back(SoundDeviceEventType::Detached, &previousDevices.GetAt(i).GetPnpIdRef());
+        }
+    }
+    for (size_t i = 0; i < devices.GetSize(); ++i)
+    {
+        const auto & device = devices.GetAt(i);
+        if (
+            const auto previousDevice = previousDevices.Find(devices.GetHandleAt(i))
+            ; previousDevice == nullptr || previousDevice->GetName() != device.GetName()
+            || previousDevice->GetFlow() != device.GetFlow()
+        )
+        {
+            events.emplace_back(SoundDeviceEventType::Discovered, &device.GetPnpIdRef());
+        }
+    }
+    // volume changes of the devices present in both
+    DeviceStateColumns::Diff(previousDevices.GetStateColumns(), devices.GetStateColumns(), stateChanges_);
+    for (const auto & [handle, changes] : stateChanges_)
+    {
+        if ((changes & DeviceStateColumns::change_render_volume) != 0)
+        {
+            events.emplace_back(SoundDeviceEventType::VolumeRenderChanged, &devices.Find(handle)->GetPnpIdRef());
+        }
+    }
+    for (const auto & [handle, changes] : stateChanges_)
+    {
+        if ((changes & DeviceStateColumns::change_capture_volume) != 0)
+        {
+            events.emplace_back(SoundDeviceEventType::VolumeCaptureChanged, &devices.Find(handle)->GetPnpIdRef());
+        }
+    }
+    if (defaultRenderDevicePnpId_ != previousDefaultRender)
+    {
+        events.emplace_back(SoundDeviceEventType::DefaultRenderChanged,
+            defaultRenderDevicePnpId_.has_value() ? &*defaultRenderDevicePnpId_ : &no_device_pnp_id);
+    }
+    if (defaultCaptureDevicePnpId_ != previousDefaultCapture)
+    {
+        events.emplace_back(SoundDeviceEventType::DefaultCaptureChanged,
+            defaultCaptureDevicePnpId_.has_value() ? &*defaultCaptureDevicePnpId_ : &no_device_pnp_id);
+    }
+
+    spdlog::info("Device list reconciled: {} differences.", events.size());
+    if (events.empty())
+    {
+        return;
+    }
+    MarkStateChanged();
+    for (const auto & [event, pnpId] : events)
+    {
+        NotifyObservers(event, *pnpId);
+    }
+}
+
+// Must be called with stateMutex_ held. Reads the volumes through the registered endpoints instead of enumerating them:
+// a volume notification does not say which endpoint changed, and enumerating allocates for each endpoint.
+bool ed::audio::SoundDeviceCollection::RefreshVolumes()
+{
+    spdlog::debug("Refreshing volumes of audio devices..");
+    bool changed = false;
+    for (auto & [endpointHandle, endpoint] : endpoints_)
+    {
+        if (endpoint.Volume == nullptr || generation_->Devices.Find(endpoint.DeviceHandle) == nullptr)
+        {
+            continue;
+        }
+        const auto volume = TryGetVolume(endpoint.Volume);
+        if (!volume.has_value())
+        {
+            continue;
+        }
+        const auto fingerprint = GetEndpointFingerprint(endpointHandle, *volume);
+        changed = changed || fingerprint != endpoint.Fingerprint;
+        endpoint.Fingerprint = fingerprint;
+        if (endpoint.Device.GetFlow() == SoundDeviceFlowType::Render)
+        {
+            generation_->Devices.SetRenderVolume(endpoint.DeviceHandle, *volume);
+        }
+        else
+        {
+            generation_->Devices.SetCaptureVolume(endpoint.DeviceHandle, *volume);
+        }
+    }
+    return changed;
+}
+
+// Must be called with stateMutex_ held. Reads the volumes without changing anything: the way of polling to tell that
+// there is nothing to do, without the copy of the state columns that RefreshVolumesAndNotifyObservers diffs.
+bool ed::audio::SoundDeviceCollection::HaveVolumesChanged() const
+{
+    return std::ranges::any_of(endpoints_, [this](const auto & handleAndEndpoint)
+        {
+            const auto & [endpointHandle, endpoint] = handleAndEndpoint;
+            if (endpoint.Volume == nullptr || generation_->Devices.Find(endpoint.DeviceHandle) == nullptr)
+            {
+                return false;
+            }
+            const auto volume = TryGetVolume(endpoint.Volume);
+            return volume.has_value() && GetEndpointFingerprint(endpointHandle, *volume) != endpoint.Fingerprint;
+        });
 }
 
-void ed::audio::SoundDeviceCollection::RefreshVolumes()
+// Must be called with stateMutex_ held. Returns whether a volume changed.
+bool ed::audio::SoundDeviceCollection::RefreshVolumesAndNotifyObservers()
 {
-    spdlog::info("Refreshing volumes of audio devices..");
-    ProcessActiveDeviceList(&SoundDeviceCollection::UpdateDeviceVolume);
+    // assigned, not constructed, so that the columns keep their capacity
+    volumeStatesBefore_ = generation_->Devices.GetStateColumns();
+
+    if (!RefreshVolumes())
+    {
+        return false;
+    }
+
+    DeviceStateColumns::Diff(volumeStatesBefore_, generation_->Devices.GetStateColumns(), stateChanges_);
+    if (stateChanges_.empty())
+    {
+        return false;
+    }
+    MarkStateChanged();
+
+    for (const auto & [handle, changes] : stateChanges_)
+    {
+        if ((changes & DeviceStateColumns::change_render_volume) != 0)
+        {
+            NotifyObservers(SoundDeviceEventType::VolumeRenderChanged, generation_->Devices.Find(handle)->GetPnpId());
+        }
+    }
+    for (const auto & [handle, changes] : stateChanges_)
+    {
+        if ((changes & DeviceStateColumns::change_capture_volume) != 0)
+        {
+            NotifyObservers(SoundDeviceEventType::VolumeCaptureChanged, generation_->Devices.Find(handle)->GetPnpId());
+        }
+    }
+    return true;
 }
 
 
@@ -603,58 +1397,117 @@ void ed::audio::SoundDeviceCollection::RefreshVolumes()
 /*static*/
 void ed::audio::SoundDeviceCollection::RegisterDevice(ed::audio::SoundDeviceCollection* self, const std::wstring& deviceId, const SoundDevice& device, EndPointVolumeSmartPtr endpointVolume)  // NOLINT(performance-unnecessary-value-param)
 {
+    const auto endpointHandle = self->endpointIds_.Intern(IdentifierText::Utf16ToUtf8(deviceId));
+    auto & endpoint = self->endpoints_[endpointHandle];
     if (endpointVolume != nullptr)
     {
-        // ReSharper disable once CppFunctionResultShouldBeUsed
-        endpointVolume->RegisterControlChangeNotify(self);
-        self->devIdToEndpointVolumes_[deviceId] = endpointVolume;
-        spdlog::info(R"(The end point device "{}" registered for notifications.)",
-            WString2StringTruncate(deviceId));
+        // kept either way: without notifications, polling reads the volume through it
+        endpoint.Volume = endpointVolume;
+        if (SUCCEEDED(endpointVolume->RegisterControlChangeNotify(self)))
+        {
+            spdlog::info(R"(The end point device "{}" registered for notifications.)",
+                IdentifierText::Utf16ToAscii(deviceId));
+        }
+        else
+        {
+            spdlog::warn(R"(The end point device "{}" refused volume notifications.)",
+                IdentifierText::Utf16ToAscii(deviceId));
+        }
     }
 
     const auto possiblyMergedDevice = self->MergeDeviceWithExistingOneBasedOnPnpIdAndFlow(device);
 
-    self->pnpToDeviceMap_[device.GetPnpId()] = possiblyMergedDevice;
+    endpoint.Device = device;
+    endpoint.DeviceHandle = self->generation_->Devices.Put(possiblyMergedDevice);
+    endpoint.Fingerprint = self->GetEndpointFingerprint(endpointHandle, device.GetFlow() == SoundDeviceFlowType::Capture
+        ? device.GetCurrentCaptureVolume() : device.GetCurrentRenderVolume());
 
     spdlog::info(R"(Device "{}", PnPId "{}", name "{}", flow {} merged and added to the list.)"
-        , WString2StringTruncate(deviceId)
+        , IdentifierText::Utf16ToAscii(deviceId)
         , possiblyMergedDevice.GetPnpId()
         , possiblyMergedDevice.GetName()
         , magic_enum::enum_name(possiblyMergedDevice.GetFlow())
     );
 }
+// ReSharper restore CppPassValueParameterByConstReference
 
-void ed::audio::SoundDeviceCollection::UpdateDeviceVolume(SoundDeviceCollection* self,
-                                                          [[maybe_unused]] const std::wstring& deviceId,
-                                                          const SoundDevice& device, EndPointVolumeSmartPtr)
+// Must be called with stateMutex_ held: the event is stamped with the current state version.
+void ed::audio::SoundDeviceCollection::NotifyObservers(SoundDeviceEventType action, const std::string & devicePNpId)
 {
-    // ReSharper restore CppPassValueParameterByConstReference
-    const auto pnpGuid = device.GetPnpId();
-    if
-    (
-        const auto foundPair = self->pnpToDeviceMap_.find(pnpGuid)
-        ; foundPair != self->pnpToDeviceMap_.end()
-    )
+    RecordHistory(action, devicePNpId);
+    dispatcher_.Post(action, devicePNpId, stateVersion_.load());
+}
+
+// Must be called with stateMutex_ held. The history drops values equal to the last ones, so recording
+// the state the event may have changed is enough.
+void ed::audio::SoundDeviceCollection::RecordHistory(SoundDeviceEventType action, const std::string & devicePnpId)
+{
+    // stale content is not history; it is recorded once it has been enumerated
+    if (stale_)
+    {
+        return;
+    }
+    const auto now = std::chrono::system_clock::now();
+    switch (action)
     {
-        auto& foundDev = foundPair->second;
-        if (device.GetFlow() == SoundDeviceFlowType::Render)
+    case SoundDeviceEventType::Discovered:
+    case SoundDeviceEventType::VolumeRenderChanged:
+    case SoundDeviceEventType::VolumeCaptureChanged:
+        if (const auto found = generation_->Devices.Find(devicePnpId); found != nullptr)
         {
-            foundDev.SetCurrentRenderVolume(device.GetCurrentRenderVolume());
+            RecordDeviceVolumes(*found, now);
         }
-        else
+        break;
+    case SoundDeviceEventType::DefaultRenderChanged:
+        RecordDefault(SoundDeviceHistoryKind::RenderDefault, historyRenderDefaultPnpId_, defaultRenderDevicePnpId_, now);
+        break;
+    case SoundDeviceEventType::DefaultCaptureChanged:
+        RecordDefault(SoundDeviceHistoryKind::CaptureDefault, historyCaptureDefaultPnpId_, defaultCaptureDevicePnpId_, now);
+        break;
+    case SoundDeviceEventType::ContentReset:
+        for (const auto & device : generation_->Devices.GetDevices())
         {
-            foundDev.SetCurrentCaptureVolume(device.GetCurrentCaptureVolume());
+            RecordDeviceVolumes(device, now);
         }
+        RecordDefault(SoundDeviceHistoryKind::RenderDefault, historyRenderDefaultPnpId_, defaultRenderDevicePnpId_, now);
+        RecordDefault(SoundDeviceHistoryKind::CaptureDefault, historyCaptureDefaultPnpId_, defaultCaptureDevicePnpId_, now);
+        break;
+    case SoundDeviceEventType::Confirmed:
+    case SoundDeviceEventType::Detached:
+    case SoundDeviceEventType::PropertyChanged:
+        break;
     }
 }
 
+// A muted endpoint reads as volume 0, so muting is recorded as a drop to 0.
+void ed::audio::SoundDeviceCollection::RecordDeviceVolumes(const SoundDevice & device, std::chrono::system_clock::time_point time)
+{
+    if (device.GetFlow() == SoundDeviceFlowType::Render || device.GetFlow() == SoundDeviceFlowType::RenderAndCapture)
+    {
+        history_.Record(device.GetPnpId(), SoundDeviceHistoryKind::RenderVolume, device.GetCurrentRenderVolume(), time);
+    }
+    if (device.GetFlow() == SoundDeviceFlowType::Capture || device.GetFlow() == SoundDeviceFlowType::RenderAndCapture)
+    {
+        history_.Record(device.GetPnpId(), SoundDeviceHistoryKind::CaptureVolume, device.GetCurrentCaptureVolume(), time);
+    }
+}
 
-void ed::audio::SoundDeviceCollection::NotifyObservers(SoundDeviceEventType action, const std::string & devicePNpId) const
+void ed::audio::SoundDeviceCollection::RecordDefault(SoundDeviceHistoryKind kind,
+    std::optional<std::string> & recordedPnpId, const std::optional<std::string> & pnpId, std::chrono::system_clock::time_point time)
 {
-    for (auto * observer : observers_)
+    if (recordedPnpId == pnpId)
+    {
+        return;
+    }
+    if (recordedPnpId.has_value())
+    {
+        history_.Record(*recordedPnpId, kind, 0, time);
+    }
+    if (pnpId.has_value())
     {
-        observer->OnCollectionChanged(action, devicePNpId);
+        history_.Record(*pnpId, kind, 1, time);
     }
+    recordedPnpId = pnpId;
 }
 
 HRESULT ed::audio::SoundDeviceCollection::OnDeviceAdded(LPCWSTR deviceId)
@@ -662,8 +1515,9 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceAdded(LPCWSTR deviceId)
     const HRESULT onDeviceAdded = MultipleNotificationClient::OnDeviceAdded(deviceId);
     if (onDeviceAdded == S_OK)
     {
-        spdlog::info(R"(Device added: id "{}".)", WString2StringTruncate(deviceId));
+        spdlog::info(R"(Device added: id "{}".)", IdentifierText::Utf16ToAscii(deviceId));
 
+        std::lock_guard lock(stateMutex_);
         SoundDevice device;
         if
         (
@@ -672,6 +1526,7 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceAdded(LPCWSTR deviceId)
         )
         {
             RegisterDevice(this, deviceId, device, endPointVolumeSmartPtr);
+            MarkStateChanged();
 
             const auto pnpId = device.GetPnpId();
             NotifyObservers(SoundDeviceEventType::Discovered, pnpId);
@@ -679,7 +1534,7 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceAdded(LPCWSTR deviceId)
             {
                 NotifyObservers(SoundDeviceEventType::DefaultRenderChanged, pnpId);
                 spdlog::info(R"(Device "{}", PnPId "{}", name "{}" was already Render-Default. Observers notified.)"
-                    , WString2StringTruncate(deviceId)
+                    , IdentifierText::Utf16ToAscii(deviceId)
                     , pnpId
                     , device.GetName()
                 );
@@ -689,14 +1544,14 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceAdded(LPCWSTR deviceId)
             {
                 NotifyObservers(SoundDeviceEventType::DefaultCaptureChanged, pnpId);
                 spdlog::info(R"(Device "{}", PnPId "{}", name "{}" was already Capture-Default. Observers notified.)"
-                    , WString2StringTruncate(deviceId)
+                    , IdentifierText::Utf16ToAscii(deviceId)
                     , pnpId
                     , device.GetName()
                 );
             }
 
         }
-        spdlog::info(R"(Device adding finished: id "{}".)", WString2StringTruncate(deviceId));
+        spdlog::info(R"(Device adding finished: id "{}".)", IdentifierText::Utf16ToAscii(deviceId));
     }
     return onDeviceAdded;
 }
@@ -712,14 +1567,14 @@ bool ed::audio::SoundDeviceCollection::CheckRemovalAndUnmergeDeviceFromExistingO
 
     if
     (
-        const auto foundPair = pnpToDeviceMap_.find(device.GetPnpId())
-        ; foundPair != pnpToDeviceMap_.end()
+        const auto foundDevPtr = generation_->Devices.Find(device.GetPnpId())
+        ; foundDevPtr != nullptr
     )
     {
         auto flow = device.GetFlow();
         auto name = device.GetName();
 
-        const auto & foundDev = foundPair->second;
+        const auto & foundDev = *foundDevPtr;
         if
         (
             foundDev.GetFlow() == flow
@@ -782,13 +1637,25 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceRemoved(LPCWSTR deviceId)
     const HRESULT hr = MultipleNotificationClient::OnDeviceRemoved(deviceId);
     if (hr == S_OK)
     {
-        spdlog::info(R"(Device to remove: id "{}".)", WString2StringTruncate(deviceId));
+        spdlog::info(R"(Device to remove: id "{}".)", IdentifierText::Utf16ToAscii(deviceId));
 
+        std::unique_lock lock(stateMutex_);
+        EndPointVolumeSmartPtr endpointVolumeToUnregister;
         SoundDevice removedDeviceToUnmerge;
-        if
-        (   EndPointVolumeSmartPtr volumeEndpointSmartPtr;
-            TryCreateDeviceOnId(deviceId, removedDeviceToUnmerge, volumeEndpointSmartPtr)
-        )
+        bool isRemovedDeviceKnown;
+        // A registered endpoint is known without probing it, which may fail once it is gone.
+        if (auto endpoint = TakeEndpoint(deviceId); endpoint.has_value())
+        {
+            removedDeviceToUnmerge = endpoint->Device;
+            endpointVolumeToUnregister = endpoint->Volume;
+            isRemovedDeviceKnown = true;
+        }
+        else
+        {
+            EndPointVolumeSmartPtr volumeEndpointSmartPtr;
+            isRemovedDeviceKnown = TryCreateDeviceOnId(deviceId, removedDeviceToUnmerge, volumeEndpointSmartPtr);
+        }
+        if (isRemovedDeviceKnown)
         {
             spdlog::info(R"(Device to remove, more info: name "{}", flow: {}, plug-and-play id: {}.)",
                          removedDeviceToUnmerge.GetName(), magic_enum::enum_name(removedDeviceToUnmerge.GetFlow()),
@@ -799,19 +1666,22 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceRemoved(LPCWSTR deviceId)
             {
                 if (possiblyUnmergedDevice.GetFlow() == SoundDeviceFlowType::None)
                 {
-                    pnpToDeviceMap_.erase(possiblyUnmergedDevice.GetPnpId());
+                    // found by CheckRemovalAndUnmergeDeviceFromExistingOneBasedOnPnpIdAndFlow
+                    generation_->Devices.Erase(*generation_->Devices.FindHandle(possiblyUnmergedDevice.GetPnpId()));
                 }
                 else
                 {
                     spdlog::info(R"(Removed device unmerged: name "{}", flow: {}.)", possiblyUnmergedDevice.GetName(), magic_enum::enum_name(possiblyUnmergedDevice.GetFlow()));
 
-                    pnpToDeviceMap_[possiblyUnmergedDevice.GetPnpId()] = possiblyUnmergedDevice;
+                    generation_->Devices.Put(possiblyUnmergedDevice);
                 }
-                UnregisterAndRemoveEndpointsVolumes(deviceId);
+                MarkStateChanged();
                 NotifyObservers(SoundDeviceEventType::Detached, removedDeviceToUnmerge.GetPnpId());
             }
         }
-        spdlog::info(R"(Device removal finished: id "{}".)", WString2StringTruncate(deviceId));
+        lock.unlock();
+        UnregisterEndpointVolume(deviceId, endpointVolumeToUnregister);
+        spdlog::info(R"(Device removal finished: id "{}".)", IdentifierText::Utf16ToAscii(deviceId));
     }
     return hr;
 }
@@ -839,31 +1709,6 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceOnId(
     return TryCreateDeviceAndGetVolumeEndpoint(deviceSmartPtr, device, devId, outVolumeEndpoint);
 }
 
-std::pair<std::vector<std::string>, std::vector<std::string>>
-ed::audio::SoundDeviceCollection::GetDevicePnPIdsWithChangedVolume(
-    const TPnPIdToDeviceMap & devicesBeforeUpdate, const TPnPIdToDeviceMap & devicesAfterUpdate)
-{
-    std::vector<std::string> diffRender;
-    std::vector<std::string> diffCapture;
-    for (const auto & [pnpIdInBeforeList, deviceInBeforeList] : devicesBeforeUpdate)
-    {
-        if (auto foundInAfterList = devicesAfterUpdate.find(pnpIdInBeforeList);
-            foundInAfterList != devicesAfterUpdate.end())
-        {
-            const auto & deviceInAfterList = foundInAfterList->second;
-            if (deviceInBeforeList.GetCurrentRenderVolume() != deviceInAfterList.GetCurrentRenderVolume())
-            {
-                diffRender.push_back(pnpIdInBeforeList);
-            }
-            if (deviceInBeforeList.GetCurrentCaptureVolume() != deviceInAfterList.GetCurrentCaptureVolume())
-            {
-                diffCapture.push_back(pnpIdInBeforeList);
-            }
-        }
-    }
-    return { diffRender, diffCapture };
-}
-
 HRESULT ed::audio::SoundDeviceCollection::OnDeviceStateChanged(LPCWSTR deviceId, DWORD dwNewState)
 {
     HRESULT hr = MultipleNotificationClient::OnDeviceStateChanged(deviceId, dwNewState);
@@ -888,23 +1733,14 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceStateChanged(LPCWSTR deviceId,
 HRESULT ed::audio::SoundDeviceCollection::OnNotify(PAUDIO_VOLUME_NOTIFICATION_DATA pNotify)
 {
     const HRESULT hResult = MultipleNotificationClient::OnNotify(pNotify);
-    const auto copy = pnpToDeviceMap_;
-
-    RefreshVolumes();
-
-    const auto [diffRender, diffCapture] = GetDevicePnPIdsWithChangedVolume(copy, pnpToDeviceMap_);
-
-    for (
-        const auto& currPnPId : diffRender)
+    // the echo of an own write, taken by TakeWrittenVolume
+    if (pNotify != nullptr && volumeWriteContext_ != GUID{} && IsEqualGUID(pNotify->guidEventContext, volumeWriteContext_))
     {
-        NotifyObservers(SoundDeviceEventType::VolumeRenderChanged, currPnPId);
+        return hResult;
     }
 
-    for (
-        const auto& currPnPId : diffCapture)
-    {
-        NotifyObservers(SoundDeviceEventType::VolumeCaptureChanged, currPnPId);
-    }
+    std::lock_guard lock(stateMutex_);
+    RefreshVolumesAndNotifyObservers();
 
     return hResult;
 }
@@ -919,25 +1755,24 @@ HRESULT ed::audio::SoundDeviceCollection::OnDefaultDeviceChanged(EDataFlow flow,
         return hr;
     }
 
+    std::lock_guard lock(stateMutex_);
+    MarkStateChanged();
+
     // clear previous default device
     if (flow == eRender && defaultRenderDevicePnpId_.has_value())
     {
-        const auto pnpGuid = *defaultRenderDevicePnpId_;
-        const auto foundPair = pnpToDeviceMap_.find(pnpGuid);
-        if (SoundDevice* foundDevicePtr = foundPair != pnpToDeviceMap_.end() ? &(foundPair->second) : nullptr
-            ; foundDevicePtr != nullptr)
+        if (const auto handle = generation_->Devices.FindHandle(*defaultRenderDevicePnpId_)
+            ; handle.has_value())
         {
-            foundDevicePtr->SetRenderCurrentlyDefault(false);
+            generation_->Devices.SetRenderDefault(*handle, false);
         }
     }
     else if (flow == eCapture && defaultCaptureDevicePnpId_.has_value())
     {
-        const auto pnpGuid = *defaultCaptureDevicePnpId_;
-        const auto foundPair = pnpToDeviceMap_.find(pnpGuid);
-        if (SoundDevice* foundDevicePtr = foundPair != pnpToDeviceMap_.end() ? &(foundPair->second) : nullptr
-            ; foundDevicePtr != nullptr)
+        if (const auto handle = generation_->Devices.FindHandle(*defaultCaptureDevicePnpId_)
+            ; handle.has_value())
         {
-            foundDevicePtr->SetCaptureCurrentlyDefault(false);
+            generation_->Devices.SetCaptureDefault(*handle, false);
         }
     }
 
@@ -959,37 +1794,53 @@ HRESULT ed::audio::SoundDeviceCollection::OnDefaultDeviceChanged(EDataFlow flow,
         return hr;
     }
 
-    // got new default device 
-    SoundDevice device;
-    if (
-        EndPointVolumeSmartPtr endPointVolumeSmartPtr;
-        TryCreateDeviceOnId(defaultDeviceId, device, endPointVolumeSmartPtr)
-    )
+    // got new default device: a registered endpoint is not probed again
+    std::optional<DeviceTable::Handle> newDefaultHandle;
+    bool isNewDefaultKnown = false;
+    if (const auto endpoint = FindEndpoint(defaultDeviceId); endpoint != nullptr)
     {
-        const auto pnpId = device.GetPnpId();
-        const auto foundPair = pnpToDeviceMap_.find(pnpId);
-
-        if (SoundDevice* foundDevicePtr = foundPair != pnpToDeviceMap_.end() ? &(foundPair->second) : nullptr
-            ; foundDevicePtr != nullptr)
+        if (generation_->Devices.Find(endpoint->DeviceHandle) != nullptr)
+        {
+            newDefaultHandle = endpoint->DeviceHandle;
+        }
+        isNewDefaultKnown = true;
+    }
+    else
+    {
+        SoundDevice device;
+        if (
+            EndPointVolumeSmartPtr endPointVolumeSmartPtr;
+            TryCreateDeviceOnId(defaultDeviceId, device, endPointVolumeSmartPtr)
+        )
+        {
+            newDefaultHandle = generation_->Devices.FindHandle(device.GetPnpId());
+            isNewDefaultKnown = true;
+        }
+    }
+    if (isNewDefaultKnown)
+    {
+        if (newDefaultHandle.has_value())
         {
+            const auto & foundDevice = *generation_->Devices.Find(*newDefaultHandle);
+            const auto pnpId = foundDevice.GetPnpId();
             if (flow == eRender)
             {
-                foundDevicePtr->SetRenderCurrentlyDefault(true);
+                generation_->Devices.SetRenderDefault(*newDefaultHandle, true);
                 SetDefaultRenderDeviceAndNotifyObservers(pnpId);
                 spdlog::info(R"(Device "{}", PnPId "{}", name "{}" set as Render-Default according to Default-Change-Event. Observers notified.)"
-                    , WString2StringTruncate(defaultDeviceId)
+                    , IdentifierText::Utf16ToAscii(defaultDeviceId)
                     , pnpId
-                    , foundDevicePtr->GetName()
+                    , foundDevice.GetName()
                 );
             }
             else if (flow == eCapture)
             {
-                foundDevicePtr->SetCaptureCurrentlyDefault(true);
+                generation_->Devices.SetCaptureDefault(*newDefaultHandle, true);
                 SetDefaultCaptureDeviceAndNotifyObservers(pnpId);
                 spdlog::info(R"(Device "{}", PnPId "{}", name "{}" set as Capture-Default according to Default-Change-Event. Observers notified.)"
-                    , WString2StringTruncate(defaultDeviceId)
+                    , IdentifierText::Utf16ToAscii(defaultDeviceId)
                     , pnpId
-                    , foundDevicePtr->GetName()
+                    , foundDevice.GetName()
                 );
             }
         }
@@ -1012,6 +1863,113 @@ HRESULT ed::audio::SoundDeviceCollection::OnDefaultDeviceChanged(EDataFlow flow,
     return hr;
 }
 
+HRESULT ed::audio::SoundDeviceCollection::OnPropertyValueChanged(LPCWSTR deviceId, const PROPERTYKEY key)
+{
+    const HRESULT hr = MultipleNotificationClient::OnPropertyValueChanged(deviceId, key);
+    // most notifications are about properties like the audio format; they are dropped before locking
+    if (deviceId == nullptr || !IsDeviceProperty(key))
+    {
+        return hr;
+    }
+
+    std::lock_guard lock(stateMutex_);
+    UpdateEndpointProperties(deviceId);
+    return hr;
+}
+
+// Must be called with stateMutex_ held. An endpoint not registered gets its properties probed once it is added; one
+// that cannot be probed any more keeps its device until it is removed.
+// A device has one endpoint per flow, as the merge on registration assumes: the volume and the default role of
+// the endpoint's flow are the endpoint's, and go with it to the device of a new container.
+void ed::audio::SoundDeviceCollection::UpdateEndpointProperties(LPCWSTR deviceId)
+{
+    const auto endpointHandle = endpointIds_.Find(IdentifierText::Utf16ToUtf8(deviceId));
+    if (!endpointHandle.has_value())
+    {
+        return;
+    }
+    const auto foundPair = endpoints_.find(*endpointHandle);
+    if (foundPair == endpoints_.end() || generation_->Devices.Find(foundPair->second.DeviceHandle) == nullptr)
+    {
+        return;
+    }
+    SoundDevice probed;
+    if (EndPointVolumeSmartPtr endpointVolume; !TryCreateDeviceOnId(deviceId, probed, endpointVolume))
+    {
+        spdlog::warn(R"(The end point device "{}" changed a property, but could not be probed again.)",
+            IdentifierText::Utf16ToAscii(deviceId));
+        return;
+    }
+
+    auto & endpoint = foundPair->second;
+    const auto previousHandle = endpoint.DeviceHandle;
+    // a copy: the table changes below
+    const auto previous = *generation_->Devices.Find(previousHandle);
+    endpoint.Device = probed;
+
+    if (probed.GetPnpIdRef() == previous.GetPnpIdRef())
+    {
+        const auto merged = MergeEndpointsOfDevice(previousHandle, previous);
+        if (merged->GetName() == previous.GetName() && merged->GetFormFactor() == previous.GetFormFactor()
+            && merged->GetFlow() == previous.GetFlow())
+        {
+            return;
+        }
+        generation_->Devices.Put(*merged);
+        MarkStateChanged();
+        NotifyObservers(SoundDeviceEventType::PropertyChanged, previous.GetPnpIdRef());
+        spdlog::info(R"(Device "{}", PnPId "{}" changed its properties: name "{}", form factor {}.)",
+            IdentifierText::Utf16ToAscii(deviceId), previous.GetPnpIdRef(), merged->GetName(),
+            magic_enum::enum_name(merged->GetFormFactor()));
+        return;
+    }
+
+    // the container changed
+    const bool isRender = probed.GetFlow() == SoundDeviceFlowType::Render;
+    const bool wasDefault = isRender ? previous.IsRenderCurrentlyDefault() : previous.IsCaptureCurrentlyDefault();
+    const auto volume = isRender ? previous.GetCurrentRenderVolume() : previous.GetCurrentCaptureVolume();
+    endpoint.DeviceHandle = pnpIds_.Intern(probed.GetPnpIdRef());
+
+    const auto left = MergeEndpointsOfDevice(previousHandle, previous);
+    const auto * existing = generation_->Devices.Find(endpoint.DeviceHandle);
+    const bool joinsKnownDevice = existing != nullptr;
+    auto joined = joinsKnownDevice ? *existing : probed;
+    if (isRender)
+    {
+        joined.SetCurrentRenderVolume(volume);
+        joined.SetRenderCurrentlyDefault(wasDefault);
+    }
+    else
+    {
+        joined.SetCurrentCaptureVolume(volume);
+        joined.SetCaptureCurrentlyDefault(wasDefault);
+    }
+    const auto merged = MergeEndpointsOfDevice(endpoint.DeviceHandle, joined);
+
+    MarkStateChanged();
+    if (left.has_value())
+    {
+        generation_->Devices.Put(*left);
+        NotifyObservers(SoundDeviceEventType::PropertyChanged, previous.GetPnpIdRef());
+    }
+    else
+    {
+        generation_->Devices.Erase(previousHandle);
+        NotifyObservers(SoundDeviceEventType::Detached, previous.GetPnpIdRef());
+    }
+    generation_->Devices.Put(*merged);
+    NotifyObservers(joinsKnownDevice ? SoundDeviceEventType::PropertyChanged : SoundDeviceEventType::Discovered,
+        merged->GetPnpIdRef());
+    if (wasDefault)
+    {
+        (isRender ? defaultRenderDevicePnpId_ : defaultCaptureDevicePnpId_) = merged->GetPnpId();
+        NotifyObservers(isRender ? SoundDeviceEventType::DefaultRenderChanged : SoundDeviceEventType::DefaultCaptureChanged,
+            merged->GetPnpIdRef());
+    }
+    spdlog::info(R"(The end point device "{}" moved from the device with PnPId "{}" to the one with PnPId "{}".)",
+        IdentifierText::Utf16ToAscii(deviceId), previous.GetPnpIdRef(), merged->GetPnpIdRef());
+}
+
 void ed::audio::SoundDeviceCollection::SetDefaultRenderDeviceAndNotifyObservers(const std::string& pnpId)
 {
     defaultRenderDevicePnpId_ = pnpId;
@@ -2,15 +2,27 @@
 
 #include <endpointvolume.h>
 #include <set>
-#include <map>
 #include <atlbase.h>
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <unordered_map>
 
 #include "public/SoundAgentInterface.h"
 
 #include "SoundDevice.h"
 
+#include "ContentPoller.h"
+#include "DeviceHistory.h"
+#include "DeviceTable.h"
 #include "MultipleNotificationClient.h"
+#include "NotificationDispatcher.h"
+#include "ObserverRegistry.h"
+#include "SnapshotFile.h"
+#include "StringInterner.h"
+#include "VolumeWriter.h"
 
 
 namespace ed::audio {
@@ -19,16 +31,54 @@ using EndPointVolumeSmartPtr = CComPtr<IAudioEndpointVolume>;
 
 class SoundDeviceCollection final : public SoundDeviceCollectionInterface, protected MultipleNotificationClient {
 protected:
-    using TPnPIdToDeviceMap = std::map<std::string, SoundDevice>;
     using ProcessDeviceFunctionT =
         std::function<void(ed::audio::SoundDeviceCollection*, const std::wstring&, const SoundDevice&, EndPointVolumeSmartPtr)>;
 
+    // A registered endpoint, under the handle of its id.
+    struct Endpoint {
+        // as probed on registration: its removal takes it out of its device without probing it again
+        SoundDevice Device;
+        DeviceTable::Handle DeviceHandle = StringInterner::no_id;
+        EndPointVolumeSmartPtr Volume;
+        // of the id and the volume last read, see GetEndpointFingerprint
+        uint64_t Fingerprint = 0;
+    };
+
+    // The devices of one enumeration, in an arena of their own. A reset enumerates into a new generation and
+    // drops the previous one wholesale, once the differences to it are notified.
+    struct DeviceGeneration {
+        DeviceGeneration(StringInterner & pnpIds, std::pmr::memory_resource * upstream);
+
+        // declared first: outlives the table
+        std::pmr::monotonic_buffer_resource Arena;
+        DeviceTable Devices;
+    };
+
+public:
+    // The bookkeeping behind the devices, for soak tests to check its invariants and bounds.
+    struct ContentAudit {
+        size_t Devices = 0;
+        size_t Endpoints = 0;
+        // registered endpoints whose device is not in the table, or is there without the endpoint's flow
+        size_t OrphanEndpoints = 0;
+        // devices no registered endpoint belongs to, like the stale ones of a snapshot file
+        size_t DevicesWithoutEndpoints = 0;
+        size_t InternedPnpIds = 0;
+        size_t InternedEndpointIds = 0;
+        size_t HistoryBytes = 0;
+    };
+
 public:
     DISALLOW_COPY_MOVE(SoundDeviceCollection);
     ~SoundDeviceCollection() override;
 
 public:
-    SoundDeviceCollection() = default;
+    SoundDeviceCollection();
+    // Allocates the device tables and the temporaries of events from upstream, which must outlive the collection.
+    explicit SoundDeviceCollection(std::pmr::memory_resource * upstream);
+    // Works on the given enumerator's endpoints instead of the system ones.
+    explicit SoundDeviceCollection(IMMDeviceEnumerator * enumerator);
+    SoundDeviceCollection(IMMDeviceEnumerator * enumerator, std::pmr::memory_resource * upstream);
 
     [[nodiscard]] size_t GetSize() const override;
     [[nodiscard]] std::unique_ptr<SoundDeviceInterface> CreateItem(size_t deviceNumber) const override;
@@ -36,9 +86,89 @@ public:
 
     [[nodiscard]] std::optional<std::string> GetDefaultRenderDevicePnpId() const override;
     [[nodiscard]] std::optional<std::string> GetDefaultCaptureDevicePnpId() const override;
+    // Like the getters above, into the caller's string: a caller reusing it allocates nothing. False if there is no default.
+    bool ReadDefaultRenderDevicePnpId(std::string & pnpId) const;
+    bool ReadDefaultCaptureDevicePnpId(std::string & pnpId) const;
+
+    [[nodiscard]] uint64_t GetStateVersion() const override;
+    [[nodiscard]] SoundDeviceCollectionSnapshot CreateSnapshot() const override;
+    [[nodiscard]] std::vector<SoundDeviceHistorySample> GetHistory(const std::string & devicePnpId, SoundDeviceHistoryKind kind,
+        std::chrono::system_clock::time_point from, std::chrono::system_clock::time_point to) const override;
 
     void Subscribe(SoundDeviceObserverInterface & observer) override;
-    void Unsubscribe(SoundDeviceObserverInterface & observer) override;
+    void Unsubscribe(SoundDeviceObserverInterface & observer, bool waitForRunningNotifications) override;
+    // Calls target.OnEvent<Event>(devicePnpId, stateVersion) for each of the Events, without a virtual call per
+    // observer and event; see ObserverRegistry::AddHandlers.
+    template <SoundDeviceEventType... Events, typename TargetT>
+    void SubscribeHandlers(TargetT & target)
+    {
+        observers_.AddHandlers<Events...>(target);
+    }
+    template <typename TargetT>
+    void UnsubscribeHandlers(TargetT & target, bool waitForRunningNotifications)
+    {
+        observers_.RemoveHandlers(target, waitForRunningNotifications);
+    }
+
+    [[nodiscard]] NotificationDispatcher::Statistics GetDeliveryStatistics() const;
+
+    // The hot state of the devices, to keep and diff with DeviceStateColumns::Diff against a later one.
+    [[nodiscard]] DeviceStateColumns GetStateColumns() const;
+    // The PnP id of a row that is or was present, like the rows of the change records of Diff.
+    [[nodiscard]] std::string GetPnpIdOfRow(DeviceStateColumns::Row row) const;
+    [[nodiscard]] ContentAudit Audit() const;
+
+    // Calls visit(const SoundDevice &) for each device matching the query, through the indexes of the device table,
+    // and returns their number. Allocates nothing once the matches of a query fit in the buffer of an earlier one.
+    // visit runs under the collection's lock: it must neither keep the device nor call the collection.
+    template <typename VisitorT>
+    size_t FindDevices(const DeviceQuery & query, VisitorT && visit) const
+    {
+        std::lock_guard lock(stateMutex_);
+        generation_->Devices.Find(query, queryMatches_);
+        for (const auto handle : queryMatches_)
+        {
+            visit(*generation_->Devices.Find(handle));
+        }
+        return queryMatches_.size();
+    }
+
+    // Serves the content persisted by an earlier run, marked stale, until ReconcileContent replaces it.
+    void LoadStaleContent(const SnapshotFile::Content & content);
+    // Like ResetContent, but notifies the differences to the content before, instead of ContentReset.
+    void ReconcileContent();
+    // Notifies the current default devices again, unchanged, e.g. as the initial state for a new observer.
+    void NotifyCurrentDefaults();
+
+    // For hosts without endpoint notifications: compares a fingerprint of the active endpoints and the defaults to
+    // the one of the last poll, and reconciles the content if they differ; otherwise compares the volumes to the
+    // fingerprints of the registered endpoints, and reads them again only if one differs. Notifies the differences
+    // either way, and returns whether there were any. Creates the system enumerator if it was unavailable so far.
+    bool PollContent();
+    // Calls PollContent on an adaptive schedule, until StopPolling; on the executor of UseComExecutor if set.
+    void StartPolling(const PollingSchedule::Options & options);
+    // Not on the executor thread of UseComExecutor: waits for a running poll, which may be waiting for it.
+    void StopPolling();
+    // nullopt if not polling
+    [[nodiscard]] std::optional<ContentPoller::Statistics> GetPollingStatistics() const;
+    // The COM work of the polls and of the volume writes then runs on executor, which must outlive the collection,
+    // instead of on threads of their own. Call before ActivateAndStartLoop; the collection then must be stopped by
+    // DeactivateAndStopLoop before it is destroyed on the executor thread.
+    void UseComExecutor(ComExecutor * executor);
+
+    // Write the volume (0 to 1000) or the mute of the device's endpoint of the flow, Render or Capture, from the
+    // thread of a VolumeWriter: a command replaces the one of the endpoint not yet written. Return false if the device
+    // has no registered endpoint of the flow, or after DeactivateAndStopLoop. The collection takes what it wrote
+    // without notifying it: the endpoint's echo of an own write is not a change event, while other collections on the
+    // endpoint see it as one.
+    bool SetVolume(const std::string & devicePnpId, SoundDeviceFlowType flow, uint16_t volume);
+    bool SetMute(const std::string & devicePnpId, SoundDeviceFlowType flow, bool mute);
+    // From the endpoint's level, also while it is muted, to volume, over duration, at the ticks of the writer.
+    bool RampVolume(const std::string & devicePnpId, SoundDeviceFlowType flow, uint16_t volume, std::chrono::milliseconds duration);
+    // Whether the commands given so far were written before the timeout. Not on the executor thread of UseComExecutor.
+    bool WaitForVolumeWrites(std::chrono::milliseconds timeout);
+    // nullopt if nothing was written yet
+    [[nodiscard]] std::optional<VolumeWriter::Statistics> GetVolumeWriteStatistics() const;
 
 public:
     HRESULT OnDeviceAdded(LPCWSTR deviceId) override;
@@ -46,6 +176,9 @@ public:
     HRESULT OnDeviceStateChanged(LPCWSTR deviceId, DWORD dwNewState) override;
     HRESULT OnNotify(PAUDIO_VOLUME_NOTIFICATION_DATA pNotify) override;
     HRESULT OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR defaultDeviceId) override;
+    // Of the properties a device is made of, the friendly name, the form factor and the container: probes the
+    // registered endpoint again and updates its device alone, instead of a reset. Others are ignored.
+    HRESULT OnPropertyValueChanged(LPCWSTR deviceId, PROPERTYKEY key) override;
 
 private:
     void SetDefaultRenderDeviceAndNotifyObservers(const std::string& pnpId);
@@ -54,13 +187,23 @@ private:
     void ProcessActiveDeviceList(const ProcessDeviceFunctionT& processDeviceFunc);
     [[nodiscard]] std::pair<std::optional<std::wstring>, std::optional<std::wstring>> TryGetRenderAndCaptureDefaultDeviceIds() const;
 
-    void RecreateActiveDeviceList();
-    void RefreshVolumes();
+    void RecreateActiveDeviceList(bool notifyDifferences);
+    void NotifyDifferences(const DeviceTable & previousDevices, const std::optional<std::string> & previousDefaultRender,
+        const std::optional<std::string> & previousDefaultCapture);
+    // Returns whether the volume of an endpoint differed from its fingerprint.
+    bool RefreshVolumes();
+    [[nodiscard]] bool HaveVolumesChanged() const;
+    bool RefreshVolumesAndNotifyObservers();
+    [[nodiscard]] uint64_t GetEndpointFingerprint(StringInterner::Id endpointHandle, uint16_t volume) const;
+    [[nodiscard]] std::optional<uint64_t> FingerprintActiveEndpointsAndDefaults() const;
     static void RegisterDevice(SoundDeviceCollection* self, const std::wstring& deviceId, const SoundDevice& device, EndPointVolumeSmartPtr endpointVolume);
-    static void UpdateDeviceVolume(SoundDeviceCollection* self, const std::wstring& deviceId, const SoundDevice& device, EndPointVolumeSmartPtr);
 
 
-    void NotifyObservers(SoundDeviceEventType action, const std::string & devicePNpId) const;
+    void NotifyObservers(SoundDeviceEventType action, const std::string & devicePNpId);
+    void RecordHistory(SoundDeviceEventType action, const std::string & devicePnpId);
+    void RecordDeviceVolumes(const SoundDevice & device, std::chrono::system_clock::time_point time);
+    void RecordDefault(SoundDeviceHistoryKind kind, std::optional<std::string> & recordedPnpId,
+        const std::optional<std::string> & pnpId, std::chrono::system_clock::time_point time);
     static bool TryCreateDeviceAndGetVolumeEndpoint(
         CComPtr<IMMDevice> deviceEndpointSmartPtr,
         SoundDevice& device,
@@ -69,12 +212,32 @@ private:
     );
 
     static std::optional<std::wstring> GetDeviceId(CComPtr<IMMDevice> deviceEndpointSmartPtr);
+    // 0 to 1000, 0 if muted.
+    static std::optional<uint16_t> TryGetVolume(const EndPointVolumeSmartPtr & endpointVolume);
+    // 0 to 1000, muted or not.
+    static std::optional<uint16_t> TryGetLevel(const EndPointVolumeSmartPtr & endpointVolume);
     static std::string DeviceIdToPnpIdForm(const std::string& deviceIdAscii);
 
+    [[nodiscard]] std::optional<StringInterner::Id> FindEndpointOfDevice(const std::string & devicePnpId, SoundDeviceFlowType flow) const;
+    // nullptr once the writes are stopped
+    VolumeWriter * GetVolumeWriter();
+    void StopVolumeWrites();
+    bool WriteEndpointVolume(StringInterner::Id endpointHandle, uint16_t volume);
+    bool WriteEndpointMute(StringInterner::Id endpointHandle, bool mute);
+    void TakeWrittenVolume(StringInterner::Id endpointHandle, const EndPointVolumeSmartPtr & endpointVolume);
+    [[nodiscard]] static GUID CreateVolumeWriteContext();
+
     void UnregisterAllEndpointsVolumes();
-    void UnregisterAndRemoveEndpointsVolumes(const std::wstring& deviceId);
+    [[nodiscard]] const Endpoint * FindEndpoint(std::wstring_view deviceId) const;
+    [[nodiscard]] std::optional<Endpoint> TakeEndpoint(std::wstring_view deviceId);
+    void UnregisterEndpointVolume(const std::wstring& deviceId, EndPointVolumeSmartPtr endpointVolume);
+    void MarkStateChanged();
 
     [[nodiscard]] SoundDevice MergeDeviceWithExistingOneBasedOnPnpIdAndFlow(const SoundDevice& device) const;
+    // The device as merged from the registered endpoints of the handle, with the volumes and defaults of base for
+    // the flows they have; nullopt if none of them is left.
+    [[nodiscard]] std::optional<SoundDevice> MergeEndpointsOfDevice(DeviceTable::Handle handle, const SoundDevice & base) const;
+    void UpdateEndpointProperties(LPCWSTR deviceId);
     [[nodiscard]] bool CheckRemovalAndUnmergeDeviceFromExistingOneBasedOnPnpIdAndFlow(
         const SoundDevice& device, SoundDevice& unmergedDev) const;
 
@@ -83,21 +246,61 @@ private:
                              EndPointVolumeSmartPtr& outVolumeEndpoint
     ) const;
 
-    static std::pair<std::vector<std::string>, std::vector<std::string>>
-        GetDevicePnPIdsWithChangedVolume(const TPnPIdToDeviceMap & devicesBeforeUpdate, const TPnPIdToDeviceMap & devicesAfterUpdate);
-
 public:
     void ResetContent() override;
     void ActivateAndStartLoop() override;
     void DeactivateAndStopLoop() override;
 
 private:
-    std::map<std::string, SoundDevice> pnpToDeviceMap_;
-    std::set<SoundDeviceObserverInterface*> observers_;
+    // the first block of a generation's arena, enough for the arrays of a few dozen devices
+    static constexpr size_t generation_arena_bytes = 8 * 1024;
+
+    // Guards the device maps and the defaults. IMMNotificationClient / IAudioEndpointVolumeCallback methods
+    // and public getters lock it; the private helpers expect it locked.
+    // It is never held while unregistering endpoint volume callbacks: that waits for running callbacks.
+    mutable std::mutex stateMutex_;
+    std::atomic<uint64_t> stateVersion_ = 0;
 
-    std::map<std::wstring, CComPtr<IAudioEndpointVolume>> devIdToEndpointVolumes_;
+    std::pmr::memory_resource * upstream_;
+    // The tables are keyed by the handles of these; endpoint ids are interned in UTF-8.
+    StringInterner pnpIds_;
+    StringInterner endpointIds_;
+    std::unique_ptr<DeviceGeneration> generation_;
+    ObserverRegistry observers_;
+    // declared after observers_: stops delivering before the observer list goes away
+    NotificationDispatcher dispatcher_;
+
+    std::unordered_map<StringInterner::Id, Endpoint> endpoints_;
+    // the temporaries of events, like the list of differences after a reset
+    std::pmr::unsynchronized_pool_resource eventScratch_;
+    // reused by every diff of the device states, so that a volume notification allocates nothing in the steady state
+    DeviceStateColumns volumeStatesBefore_;
+    std::vector<DeviceStateColumns::ChangeRecord> stateChanges_;
+    // the handles matching the last query
+    mutable std::vector<DeviceTable::Handle> queryMatches_;
 
     std::optional<std::string> defaultRenderDevicePnpId_;
     std::optional<std::string> defaultCaptureDevicePnpId_;
+    // the content came from a snapshot file and was not enumerated yet
+    bool stale_ = false;
+
+    DeviceHistory history_{ DeviceHistory::Options{} };
+    // the defaults as last recorded in the history, to record the end of their role
+    std::optional<std::string> historyRenderDefaultPnpId_;
+    std::optional<std::string> historyCaptureDefaultPnpId_;
+
+    // of the active endpoints and the defaults as of the last poll; used by the polling thread only
+    uint64_t polledFingerprint_ = 0;
+    // set under both pollerMutex_ and writerMutex_, read under either
+    ComExecutor * executor_ = nullptr;
+    mutable std::mutex pollerMutex_;
+    std::unique_ptr<ContentPoller> poller_;
+
+    // passed with the own writes, to tell their volume notifications from the ones of other writers
+    const GUID volumeWriteContext_ = CreateVolumeWriteContext();
+    // created with the first write, stopped by DeactivateAndStopLoop
+    mutable std::mutex writerMutex_;
+    std::unique_ptr<VolumeWriter> writer_;
+    bool writesStopped_ = false;
 };
 }
@@ -0,0 +1,94 @@
+#include "os-dependencies.h"
+
+#include "SpoolUploader.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+
+ed::audio::SpoolUploader::SpoolUploader(EventSpool & spool, UploadFunctionT upload, const Options & options)
+    : spool_(spool)
+    , upload_(std::move(upload))
+    , options_(options)
+    , thread_(&SpoolUploader::Run, this)
+{
+}
+
+ed::audio::SpoolUploader::~SpoolUploader()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wakeUp_.notify_all();
+    thread_.join();
+}
+
+void ed::audio::SpoolUploader::Notify()
+{
+    {
+        std::lock_guard lock(mutex_);
+        notified_ = true;
+    }
+    wakeUp_.notify_all();
+}
+
+ed::audio::SpoolUploader::Statistics ed::audio::SpoolUploader::GetStatistics() const
+{
+    std::lock_guard lock(mutex_);
+    return statistics_;
+}
+
+void ed::audio::SpoolUploader::Run()
+{
+    auto retryDelay = options_.InitialRetryDelay;
+    std::unique_lock lock(mutex_);
+    while (!stopping_)
+    {
+        notified_ = false;
+        lock.unlock();
+        const auto acknowledged = spool_.GetAcknowledged();
+        std::vector<EventSpool::Record> batch;
+        std::optional<uint64_t> confirmed;
+        try
+        {
+            batch = spool_.Read(acknowledged, options_.BatchRecords);
+            if (!batch.empty())
+            {
+                confirmed = upload_(batch);
+                if (confirmed.has_value() && *confirmed > acknowledged)
+                {
+                    spool_.Acknowledge(*confirmed);
+                }
+            }
+        }
+        catch (const std::exception & ex)
+        {
+            spdlog::error("Event upload failed: {}", ex.what());
+            confirmed.reset();
+        }
+        lock.lock();
+
+        if (batch.empty())
+        {
+            wakeUp_.wait_for(lock, options_.PollInterval, [this] { return stopping_ || notified_; });
+            continue;
+        }
+        // no progress counts as a failure, so a collector stuck on a record is not asked in a busy loop
+        if (!confirmed.has_value() || *confirmed <= acknowledged)
+        {
+            ++statistics_.FailedUploads;
+            if (statistics_.FailedUploads % 10 == 1)
+            {
+                spdlog::warn("Event upload failed, {} failures so far; retrying in {} ms.", statistics_.FailedUploads, retryDelay.count());
+            }
+            wakeUp_.wait_for(lock, retryDelay, [this] { return stopping_; });
+            retryDelay = std::min(retryDelay * 2, options_.MaxRetryDelay);
+            continue;
+        }
+        retryDelay = options_.InitialRetryDelay;
+        ++statistics_.BatchesUploaded;
+        statistics_.RecordsAcknowledged += std::ranges::count_if(batch,
+            [&confirmed](const EventSpool::Record & record) { return record.Sequence <= *confirmed; });
+    }
+}
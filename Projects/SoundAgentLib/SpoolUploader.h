@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "EventSpool.h"
+
+
+namespace ed::audio {
+// Forwards the records of an EventSpool to a collector in batches, on a thread of its own, starting
+// behind the spool's acknowledged sequence, so an upload resumes where it stopped, also after a restart.
+// While the collector is unreachable, the uploader retries with a delay doubling up to a maximum.
+class SpoolUploader final {
+public:
+    // Sends the records, in order, and returns the highest sequence the collector confirmed,
+    // or nothing if it could not be reached. May block; it is not called concurrently.
+    using UploadFunctionT = std::function<std::optional<uint64_t>(const std::vector<EventSpool::Record> &)>;
+
+    struct Options {
+        size_t BatchRecords = 500;
+        // how often to look for new records if not notified
+        std::chrono::milliseconds PollInterval{ 1000 };
+        std::chrono::milliseconds InitialRetryDelay{ 500 };
+        std::chrono::milliseconds MaxRetryDelay{ 30'000 };
+    };
+
+    struct Statistics {
+        uint64_t BatchesUploaded = 0;
+        uint64_t RecordsAcknowledged = 0;
+        uint64_t FailedUploads = 0;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(SpoolUploader);
+    SpoolUploader(EventSpool & spool, UploadFunctionT upload, const Options & options);
+    // Waits for a running upload to return.
+    ~SpoolUploader();
+
+public:
+    // Records were appended: upload them without waiting for the poll interval. Does not cut a retry delay short.
+    void Notify();
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    void Run();
+
+private:
+    EventSpool & spool_;
+    const UploadFunctionT upload_;
+    const Options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    bool notified_ = false;
+    bool stopping_ = false;
+    Statistics statistics_;
+    std::thread thread_;
+};
+}
@@ -0,0 +1,63 @@
+#include "os-dependencies.h"
+
+#include "StringInterner.h"
+
+#include <functional>
+#include <mutex>
+
+
+ed::audio::StringInterner::Id ed::audio::StringInterner::Intern(std::string_view value)
+{
+    const auto hash = std::hash<std::string_view>()(value);
+    auto & shard = shards_[hash % shard_count];
+    {
+        std::shared_lock lock(shard.Mutex);
+        if (const auto found = shard.Ids.find(value)
+            ; found != shard.Ids.end())
+        {
+            return found->second;
+        }
+    }
+
+    std::unique_lock lock(shard.Mutex);
+    // another thread may have added it meanwhile
+    if (const auto found = shard.Ids.find(value)
+        ; found != shard.Ids.end())
+    {
+        return found->second;
+    }
+    const auto id = static_cast<Id>(shard.Strings.size() * shard_count + hash % shard_count);
+    const auto & stored = shard.Strings.emplace_back(value);
+    shard.Ids.emplace(stored, id);
+    return id;
+}
+
+std::optional<ed::audio::StringInterner::Id> ed::audio::StringInterner::Find(std::string_view value) const
+{
+    const auto & shard = shards_[std::hash<std::string_view>()(value) % shard_count];
+    std::shared_lock lock(shard.Mutex);
+    if (const auto found = shard.Ids.find(value)
+        ; found != shard.Ids.end())
+    {
+        return found->second;
+    }
+    return std::nullopt;
+}
+
+std::string_view ed::audio::StringInterner::Resolve(Id id) const
+{
+    const auto & shard = shards_[id % shard_count];
+    std::shared_lock lock(shard.Mutex);
+    return shard.Strings[id / shard_count];
+}
+
+size_t ed::audio::StringInterner::GetSize() const
+{
+    size_t size = 0;
+    for (const auto & shard : shards_)
+    {
+        std::shared_lock lock(shard.Mutex);
+        size += shard.Strings.size();
+    }
+    return size;
+}
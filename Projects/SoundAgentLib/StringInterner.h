@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+
+namespace ed::audio {
+// Thread-safe string pool: equal strings get the same id and share one copy. Strings are never released,
+// which suits the bounded vocabulary of host names, PnP ids and device names.
+// The pool is split into shards by hash, so that threads interning different strings rarely contend.
+class StringInterner final {
+public:
+    using Id = uint32_t;
+    static constexpr Id no_id = UINT32_MAX;
+
+public:
+    DISALLOW_COPY_MOVE(StringInterner);
+    StringInterner() = default;
+    ~StringInterner() = default;
+
+public:
+    Id Intern(std::string_view value);
+    [[nodiscard]] std::optional<Id> Find(std::string_view value) const;
+    // The id must come from this interner. The view stays valid as long as the interner.
+    [[nodiscard]] std::string_view Resolve(Id id) const;
+    [[nodiscard]] size_t GetSize() const;
+
+private:
+    static constexpr size_t shard_count = 16;
+
+    struct Shard {
+        mutable std::shared_mutex Mutex;
+        // a deque keeps the strings in place, so the views of Ids stay valid
+        std::deque<std::string> Strings;
+        std::unordered_map<std::string_view, Id> Ids;
+    };
+
+    std::array<Shard, shard_count> shards_;
+};
+}
@@ -0,0 +1,239 @@
+#include "os-dependencies.h"
+
+#include "VolumeWriter.h"
+
+#include "public/CoInitRaiiHelper.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+
+namespace
+{
+    constexpr uint16_t max_volume = 1000;
+}
+
+ed::audio::VolumeWriter::VolumeWriter(WriteVolumeFunctionT writeVolume, WriteMuteFunctionT writeMute, const Options & options,
+    ComExecutor * executor)
+    : writeVolume_(std::move(writeVolume))
+    , writeMute_(std::move(writeMute))
+    , options_(options)
+    , executor_(executor)
+    , worker_(&VolumeWriter::Run, this)
+{
+}
+
+ed::audio::VolumeWriter::~VolumeWriter()
+{
+    Stop();
+}
+
+void ed::audio::VolumeWriter::Stop()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopRequested_ = true;
+        slots_.clear();
+    }
+    wakeUp_.notify_all();
+    idle_.notify_all();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+}
+
+void ed::audio::VolumeWriter::SetVolume(Key key, uint16_t volume)
+{
+    VolumeCommand command;
+    command.From = command.To = std::min(volume, max_volume);
+    command.Start = command.NextTick = std::chrono::steady_clock::now();
+    Enqueue(key, command);
+}
+
+void ed::audio::VolumeWriter::RampVolume(Key key, uint16_t from, uint16_t to, std::chrono::milliseconds duration)
+{
+    VolumeCommand command;
+    command.From = std::min(from, max_volume);
+    command.To = std::min(to, max_volume);
+    // the first tick writes from at once
+    command.Start = command.NextTick = std::chrono::steady_clock::now();
+    command.Duration = std::max(duration, std::chrono::milliseconds::zero());
+    Enqueue(key, command);
+}
+
+void ed::audio::VolumeWriter::Enqueue(Key key, const VolumeCommand & command)
+{
+    {
+        std::lock_guard lock(mutex_);
+        ++statistics_.Commands;
+        if (stopRequested_)
+        {
+            return;
+        }
+        auto & slot = slots_[key];
+        statistics_.Coalesced += slot.Volume.has_value() ? 1 : 0;
+        slot.Volume = command;
+    }
+    wakeUp_.notify_all();
+}
+
+void ed::audio::VolumeWriter::SetMute(Key key, bool mute)
+{
+    {
+        std::lock_guard lock(mutex_);
+        ++statistics_.Commands;
+        if (stopRequested_)
+        {
+            return;
+        }
+        auto & slot = slots_[key];
+        statistics_.Coalesced += slot.Mute.has_value() ? 1 : 0;
+        slot.Mute = mute;
+    }
+    wakeUp_.notify_all();
+}
+
+bool ed::audio::VolumeWriter::WaitUntilIdle(std::chrono::milliseconds timeout)
+{
+    std::unique_lock lock(mutex_);
+    return idle_.wait_for(lock, timeout, [this] { return stopRequested_ || (slots_.empty() && !writing_); }) && !stopRequested_;
+}
+
+ed::audio::VolumeWriter::Statistics ed::audio::VolumeWriter::GetStatistics() const
+{
+    std::lock_guard lock(mutex_);
+    return statistics_;
+}
+
+std::optional<std::chrono::steady_clock::time_point> ed::audio::VolumeWriter::TakeDueWrites(std::chrono::steady_clock::time_point now)
+{
+    writes_.clear();
+    std::optional<std::chrono::steady_clock::time_point> nextDue;
+    for (auto slotPair = slots_.begin(); slotPair != slots_.end();)
+    {
+        auto & [key, slot] = *slotPair;
+        Write write;
+        write.Target = key;
+        write.Mute = std::exchange(slot.Mute, std::nullopt);
+
+        if (slot.Volume.has_value() && slot.Volume->NextTick <= now)
+        {
+            auto & command = *slot.Volume;
+            if (command.Duration == std::chrono::steady_clock::duration::zero())
+            {
+                write.Volume = command.To;
+                slot.Volume.reset();
+            }
+            else
+            {
+                const auto lateness = std::chrono::duration_cast<std::chrono::nanoseconds>(now - command.NextTick);
+                ++statistics_.RampTicks;
+                statistics_.MaxTickLateness = std::max(statistics_.MaxTickLateness, lateness);
+                statistics_.TotalTickLateness += lateness;
+
+                // the value of the scheduled time, not of now: a late tick does not skew the ramp
+                const auto elapsed = command.NextTick - command.Start;
+                if (elapsed >= command.Duration)
+                {
+                    write.Volume = command.To;
+                    slot.Volume.reset();
+                }
+                else
+                {
+                    const auto progress = std::chrono::duration<double>(elapsed) / std::chrono::duration<double>(command.Duration);
+                    write.Volume = static_cast<uint16_t>(std::lround(command.From + (command.To - command.From) * progress));
+                    // the next tick of the schedule after now, skipping the missed ones; the last one at the end
+                    const std::chrono::steady_clock::duration tick = options_.Tick;
+                    command.NextTick += ((now - command.NextTick) / tick + 1) * tick;
+                    command.NextTick = std::min(command.NextTick, command.Start + command.Duration);
+                }
+            }
+        }
+
+        if (slot.Volume.has_value())
+        {
+            nextDue = nextDue.has_value() ? std::min(*nextDue, slot.Volume->NextTick) : slot.Volume->NextTick;
+        }
+        if (write.Volume.has_value() || write.Mute.has_value())
+        {
+            writes_.push_back(write);
+        }
+        slotPair = slot.Volume.has_value() ? std::next(slotPair) : slots_.erase(slotPair);
+    }
+    return nextDue;
+}
+
+void ed::audio::VolumeWriter::Run()
+{
+    // only needed if the writes run here
+    std::optional<CoInitRaiiHelper> coInitHelper;
+    if (executor_ == nullptr)
+    {
+        coInitHelper.emplace();
+    }
+    std::unique_lock lock(mutex_);
+    while (!stopRequested_)
+    {
+        if (const auto nextDue = TakeDueWrites(std::chrono::steady_clock::now()); writes_.empty())
+        {
+            if (slots_.empty())
+            {
+                idle_.notify_all();
+            }
+            // a command or the stop request wakes it up earlier; the loop takes whatever is due then
+            if (nextDue.has_value())
+            {
+                wakeUp_.wait_until(lock, *nextDue);
+            }
+            else
+            {
+                wakeUp_.wait(lock);
+            }
+            continue;
+        }
+
+        writing_ = true;
+        lock.unlock();
+        const auto [writes, failedWrites] = executor_ != nullptr ? executor_->Invoke([this] { return WriteAll(); }) : WriteAll();
+        lock.lock();
+        writing_ = false;
+        statistics_.Writes += writes;
+        statistics_.FailedWrites += failedWrites;
+    }
+}
+
+std::pair<uint64_t, uint64_t> ed::audio::VolumeWriter::WriteAll()
+{
+    uint64_t writes = 0;
+    uint64_t failedWrites = 0;
+    const auto count = [&writes, &failedWrites](bool written) { ++(written ? writes : failedWrites); };
+    for (const auto & write : writes_)
+    {
+        try
+        {
+            // muting before a volume change and unmuting after it, so that the old volume is not heard in between
+            if (write.Mute == true)
+            {
+                count(writeMute_(write.Target, true));
+            }
+            if (write.Volume.has_value())
+            {
+                count(writeVolume_(write.Target, *write.Volume));
+            }
+            if (write.Mute == false)
+            {
+                count(writeMute_(write.Target, false));
+            }
+        }
+        catch (const std::exception & ex)
+        {
+            spdlog::error("Writing the volume of an audio endpoint failed: {}", ex.what());
+            ++failedWrites;
+        }
+    }
+    return { writes, failedWrites };
+}
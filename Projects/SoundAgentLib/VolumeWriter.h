@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "ComExecutor.h"
+
+
+namespace ed::audio {
+// Writes volumes and mutes of endpoints, one pending command per endpoint and kind: a command replaces the one not yet
+// written, so that a caller dragging a slider costs as many writes as the thread keeps up with, not as many as it was
+// sent. A ramp writes its interpolated volume at every tick, on the tick schedule rather than after the previous write;
+// a late tick is not caught up with bursts.
+// The writes, ramp ticks included, run on executor if given, which must outlive the writer; otherwise on the writer's
+// own thread, with COM initialized. With an executor, the writer must not be stopped or destroyed on the executor
+// thread: a write waiting for that thread would never finish.
+class VolumeWriter final {
+public:
+    using Key = uint32_t;
+    // Return whether the endpoint took the value; called outside the writer's lock.
+    using WriteVolumeFunctionT = std::function<bool(Key key, uint16_t volume)>;
+    using WriteMuteFunctionT = std::function<bool(Key key, bool mute)>;
+
+    struct Options {
+        // of ramps; must be positive
+        std::chrono::milliseconds Tick{ 10 };
+    };
+
+    struct Statistics {
+        uint64_t Commands = 0;
+        // replaced before they were written, or before their ramp ended
+        uint64_t Coalesced = 0;
+        // taken by the endpoints, and refused or failed
+        uint64_t Writes = 0;
+        uint64_t FailedWrites = 0;
+        uint64_t RampTicks = 0;
+        // of the ramp ticks after their scheduled time
+        std::chrono::nanoseconds MaxTickLateness{ 0 };
+        std::chrono::nanoseconds TotalTickLateness{ 0 };
+    };
+
+public:
+    DISALLOW_COPY_MOVE(VolumeWriter);
+    VolumeWriter(WriteVolumeFunctionT writeVolume, WriteMuteFunctionT writeMute, const Options & options,
+        ComExecutor * executor = nullptr);
+    // Stops the writer, if not stopped yet.
+    ~VolumeWriter();
+
+public:
+    // Volume: 0 to 1000.
+    void SetVolume(Key key, uint16_t volume);
+    void SetMute(Key key, bool mute);
+    // From from to to, linearly over duration; to is written last, at the end of the duration.
+    void RampVolume(Key key, uint16_t from, uint16_t to, std::chrono::milliseconds duration);
+    // Whether all commands were written before the timeout; false once stopped.
+    bool WaitUntilIdle(std::chrono::milliseconds timeout);
+    // Waits for a running write, then stops the thread; pending commands and the ones given later are dropped.
+    void Stop();
+
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    struct VolumeCommand {
+        uint16_t From = 0;
+        uint16_t To = 0;
+        std::chrono::steady_clock::time_point Start;
+        // 0 for a plain set
+        std::chrono::steady_clock::duration Duration{ 0 };
+        std::chrono::steady_clock::time_point NextTick;
+    };
+
+    struct Slot {
+        std::optional<VolumeCommand> Volume;
+        std::optional<bool> Mute;
+    };
+
+    // a write taken out of the slots, done outside the lock
+    struct Write {
+        Key Target = 0;
+        std::optional<uint16_t> Volume;
+        std::optional<bool> Mute;
+    };
+
+private:
+    void Run();
+    // Must be called with mutex_ held. Takes the commands due at now into writes_ and returns when the next one is due.
+    std::optional<std::chrono::steady_clock::time_point> TakeDueWrites(std::chrono::steady_clock::time_point now);
+    void Enqueue(Key key, const VolumeCommand & command);
+    // Writes writes_; called outside the lock. Returns the number of writes taken and of those refused or failed.
+    std::pair<uint64_t, uint64_t> WriteAll();
+
+private:
+    WriteVolumeFunctionT writeVolume_;
+    WriteMuteFunctionT writeMute_;
+    Options options_;
+    ComExecutor * const executor_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    std::condition_variable idle_;
+    bool stopRequested_ = false;
+    bool writing_ = false;
+    std::unordered_map<Key, Slot> slots_;
+    Statistics statistics_;
+    // used by the thread only, reused by every round
+    std::vector<Write> writes_;
+
+    std::thread worker_;
+};
+}
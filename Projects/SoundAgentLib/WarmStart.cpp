@@ -0,0 +1,73 @@
+#include "os-dependencies.h"
+
+#include "WarmStart.h"
+
+#include "public/CoInitRaiiHelper.h"
+
+#include <spdlog/spdlog.h>
+
+
+ed::audio::WarmStart::WarmStart(SoundDeviceCollection & collection, std::filesystem::path snapshotPath,
+    ComExecutor * executor)
+    : collection_(collection)
+    , snapshotPath_(std::move(snapshotPath))
+    , executor_(executor)
+{
+    if (const auto content = SnapshotFile::Load(snapshotPath_); content.has_value())
+    {
+        collection_.LoadStaleContent(*content);
+        snapshotLoaded_ = true;
+    }
+    thread_ = std::thread(&WarmStart::Reconcile, this);
+}
+
+ed::audio::WarmStart::~WarmStart()
+{
+    JoinReconciliation();
+    Save();
+}
+
+bool ed::audio::WarmStart::JoinReconciliation()
+{
+    std::lock_guard lock(joinMutex_);
+    if (!thread_.joinable())
+    {
+        return false;
+    }
+    thread_.join();
+    return true;
+}
+
+void ed::audio::WarmStart::Save() const
+{
+    const auto snapshot = collection_.CreateSnapshot();
+    if (snapshot.IsStale)
+    {
+        return;
+    }
+    try
+    {
+        SnapshotFile::Save(snapshotPath_, snapshot, std::chrono::system_clock::now());
+    }
+    catch (const std::exception & ex)
+    {
+        spdlog::warn("Device snapshot not saved: {}", ex.what());
+    }
+}
+
+void ed::audio::WarmStart::Reconcile() const
+{
+    const auto start = std::chrono::steady_clock::now();
+    if (executor_ != nullptr)
+    {
+        executor_->Invoke([this] { collection_.ReconcileContent(); });
+    }
+    else
+    {
+        const CoInitRaiiHelper coInitHelper;
+        collection_.ReconcileContent();
+    }
+    spdlog::info("Devices enumerated in {} ms after the warm start.",
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    Save();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+#include "ComExecutor.h"
+#include "SoundDeviceCollection.h"
+
+
+namespace ed::audio {
+// Lets a collection answer at once from the snapshot file of the previous run, marked stale, while it is
+// enumerated on a thread of its own. The enumeration notifies only the differences to the snapshot.
+// The file is saved again after the enumeration and on destruction.
+class WarmStart final {
+public:
+    DISALLOW_COPY_MOVE(WarmStart);
+    // Loads the snapshot file into the collection, if there is a usable one, and starts the enumeration.
+    // The enumeration runs on executor if given, which must outlive the warm start; otherwise in an apartment
+    // of the enumerating thread.
+    WarmStart(SoundDeviceCollection & collection, std::filesystem::path snapshotPath, ComExecutor * executor = nullptr);
+    // Waits for the enumeration and saves the content of the collection.
+    ~WarmStart();
+
+public:
+    [[nodiscard]] bool IsSnapshotLoaded() const { return snapshotLoaded_; }
+    // Waits for the enumeration to finish. Returns false if it had been joined before.
+    bool JoinReconciliation();
+    // Saves the content of the collection, unless it is stale. Errors are logged.
+    void Save() const;
+
+private:
+    void Reconcile() const;
+
+private:
+    SoundDeviceCollection & collection_;
+    const std::filesystem::path snapshotPath_;
+    ComExecutor * executor_;
+    bool snapshotLoaded_ = false;
+    std::mutex joinMutex_;
+    std::thread thread_;
+};
+}
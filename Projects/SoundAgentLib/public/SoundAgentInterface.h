@@ -3,15 +3,18 @@
 
 #include <ApiClient/common/ClassDefHelper.h>
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <optional>
+#include <vector>
 
 
 class SoundDeviceCollectionInterface;
 class DeviceCollectionObserver;
 class SoundDeviceInterface;
 class SoundDeviceObserverInterface;
+struct SoundDeviceCollectionSnapshot;
 
 enum class SoundDeviceEventType : uint8_t
 {
@@ -21,7 +24,9 @@ enum class SoundDeviceEventType : uint8_t
     VolumeRenderChanged = 3,
     VolumeCaptureChanged = 4,
     DefaultRenderChanged = 5,
-    DefaultCaptureChanged = 6
+    DefaultCaptureChanged = 6,
+    ContentReset = 7, // whole content re-enumerated; re-read everything
+    PropertyChanged = 8 // name, form factor or flow of a known device changed; re-read the device
 };
 
 enum class SoundDeviceFlowType : uint8_t
@@ -32,6 +37,37 @@ enum class SoundDeviceFlowType : uint8_t
     RenderAndCapture
 };
 
+// As Windows reports it for an endpoint (EndpointFormFactor); Unknown if it did not.
+enum class SoundDeviceFormFactor : uint8_t
+{
+    RemoteNetworkDevice = 0,
+    Speakers,
+    LineLevel,
+    Headphones,
+    Microphone,
+    Headset,
+    Handset,
+    UnknownDigitalPassthrough,
+    Spdif,
+    DigitalAudioDisplayDevice,
+    Unknown
+};
+
+enum class SoundDeviceHistoryKind : uint8_t
+{
+    RenderVolume = 0, // 0 to 1000; 0 while muted
+    CaptureVolume = 1,
+    RenderDefault = 2, // 1 while the device is the default, 0 otherwise
+    CaptureDefault = 3
+};
+
+// A transition of a device's volume or default role.
+struct SoundDeviceHistorySample
+{
+    std::chrono::system_clock::time_point Time;
+    uint16_t Value = 0;
+};
+
 class SoundAgent final
 {
 public:
@@ -52,11 +88,21 @@ public:
     virtual std::optional<std::string> GetDefaultRenderDevicePnpId() const = 0;
     virtual std::optional<std::string> GetDefaultCaptureDevicePnpId() const = 0;
 
+    // Incremented with every change of the content; events carry the version that produced them.
+    virtual uint64_t GetStateVersion() const = 0;
+    virtual SoundDeviceCollectionSnapshot CreateSnapshot() const = 0;
+
+    // Transitions with from <= time < to, oldest first. The history is bounded: the oldest transitions are dropped.
+    virtual std::vector<SoundDeviceHistorySample> GetHistory(const std::string& devicePnpId, SoundDeviceHistoryKind kind,
+        std::chrono::system_clock::time_point from, std::chrono::system_clock::time_point to) const = 0;
+
     virtual void ActivateAndStartLoop() = 0;
     virtual void DeactivateAndStopLoop() = 0;
 
     virtual void Subscribe(SoundDeviceObserverInterface& observer) = 0;
-    virtual void Unsubscribe(SoundDeviceObserverInterface& observer) = 0;
+    // waitForRunningNotifications: return only after notifications already being delivered are finished,
+    // so the observer may be destroyed right afterwards. No default: an override would not inherit it.
+    virtual void Unsubscribe(SoundDeviceObserverInterface& observer, bool waitForRunningNotifications) = 0;
 
     virtual void ResetContent() = 0;
 
@@ -67,7 +113,7 @@ public:
 class SoundDeviceObserverInterface
 {
 public:
-    virtual void OnCollectionChanged(SoundDeviceEventType event, const std::string& devicePnpId) = 0;
+    virtual void OnCollectionChanged(SoundDeviceEventType event, const std::string& devicePnpId, uint64_t stateVersion) = 0;
 
     AS_INTERFACE(SoundDeviceObserverInterface);
     DISALLOW_COPY_MOVE(SoundDeviceObserverInterface);
@@ -80,6 +126,7 @@ public:
     virtual std::string GetName() const = 0;
     virtual std::string GetPnpId() const = 0;
     virtual SoundDeviceFlowType GetFlow() const = 0;
+    virtual SoundDeviceFormFactor GetFormFactor() const = 0;
     virtual uint16_t GetCurrentRenderVolume() const = 0; // 0 to 1000
     virtual uint16_t GetCurrentCaptureVolume() const = 0;
     virtual bool IsCaptureCurrentlyDefault() const = 0;
@@ -88,3 +135,14 @@ public:
     AS_INTERFACE(SoundDeviceInterface);
     DISALLOW_COPY_MOVE(SoundDeviceInterface);
 };
+
+// Consistent copy of the collection, tagged with the state version it reflects.
+struct SoundDeviceCollectionSnapshot
+{
+    uint64_t StateVersion = 0;
+    // The content was persisted by an earlier run and the enumeration confirming it has not finished yet.
+    bool IsStale = false;
+    std::vector<std::unique_ptr<SoundDeviceInterface>> Devices;
+    std::optional<std::string> DefaultRenderDevicePnpId;
+    std::optional<std::string> DefaultCaptureDevicePnpId;
+};
@@ -0,0 +1,159 @@
+#include "stdafx.h"
+
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "AllocationCounter.h"
+#include "DeviceStateColumns.h"
+#include "EndpointSimulator.h"
+#include "NotificationDispatcher.h"
+#include "SoundDeviceCollection.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        // A PnP id as long as the real ones, beyond any small string buffer.
+        const std::string long_pnp_id = "{0.0.0.00000000}.{8C1D9A3E-6F24-4B5A-9E1F-0D2C3B4A5E6F}";
+
+        class CountingObserver final : public SoundDeviceObserverInterface {
+        public:
+            CountingObserver() = default;
+            DISALLOW_COPY_MOVE(CountingObserver);
+            ~CountingObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType, const std::string &, uint64_t) override
+            {
+                ++events_;
+            }
+
+        private:
+            std::atomic<uint64_t> events_ = 0;
+        };
+    }
+
+    // Per-operation allocation budgets of the steady-state paths: a regression to any of them fails here.
+    TEST_CLASS(AllocationBudgetTests)
+    {
+        TEST_METHOD(CountsCallingThreadOnlyTest)
+        {
+            const AllocationCounter counter;
+            auto value = std::make_unique<int>(1);
+            std::thread([]
+                {
+                    auto others = std::make_unique<std::vector<int>>(100);
+                }).join();
+            Assert::IsTrue(counter.GetAllocations() >= 1);
+            // the thread object may allocate its state, never the vector of the other thread
+            Assert::IsTrue(counter.GetCounts().Bytes < 100 * sizeof(int));
+            value.reset();
+            Assert::IsTrue(counter.GetCounts().Deallocations >= 1);
+
+            std::unique_ptr<int> kept;
+            Assert::AreEqual(static_cast<uint64_t>(1), AllocationCounter::MeasurePerOperation(10, [&kept]
+                {
+                    kept = std::make_unique<int>(2);
+                }));
+        }
+
+        TEST_METHOD(CountingMemoryResourceTest)
+        {
+            CountingMemoryResource resource;
+            {
+                std::pmr::vector<int> values(&resource);
+                values.reserve(10);
+                values.push_back(1);
+                Assert::AreEqual(static_cast<uint64_t>(1), resource.GetAllocations());
+                Assert::AreEqual(static_cast<uint64_t>(10 * sizeof(int)), resource.GetBytesInUse());
+            }
+            Assert::AreEqual(static_cast<uint64_t>(1), resource.GetDeallocations());
+            Assert::AreEqual(static_cast<uint64_t>(0), resource.GetBytesInUse());
+        }
+
+        TEST_METHOD(StateDiffBudgetTest)
+        {
+            DeviceStateColumns before;
+            for (DeviceStateColumns::Row row = 0; row < 100; ++row)
+            {
+                before.Set(row, SoundDevice("", "", SoundDeviceFlowType::Render, 500, 0, false, false));
+            }
+            auto after = before;
+            std::vector<DeviceStateColumns::ChangeRecord> changes;
+            uint16_t volume = 500;
+            Assert::AreEqual(static_cast<uint64_t>(0), AllocationCounter::MeasurePerOperation(100, [&]
+                {
+                    volume = volume == 500 ? 501 : 500;
+                    after.SetRenderVolume(7, volume);
+                    DeviceStateColumns::Diff(before, after, changes);
+                }));
+        }
+
+        TEST_METHOD(DispatcherVolumePostBudgetTest)
+        {
+            std::atomic<uint64_t> delivered = 0;
+            NotificationDispatcher dispatcher([&delivered](SoundDeviceEventType, const std::string &, uint64_t)
+                {
+                    ++delivered;
+                });
+            uint64_t stateVersion = 0;
+            Assert::AreEqual(static_cast<uint64_t>(0), AllocationCounter::MeasurePerOperation(1'000, [&]
+                {
+                    dispatcher.Post(SoundDeviceEventType::VolumeRenderChanged, long_pnp_id, ++stateVersion);
+                    dispatcher.Post(SoundDeviceEventType::VolumeCaptureChanged, long_pnp_id, ++stateVersion);
+                }));
+            dispatcher.WaitUntilIdle();
+            Assert::IsTrue(delivered.load() > 0);
+        }
+
+        TEST_METHOD(DefaultDeviceReadBudgetTest)
+        {
+            EndpointSimulator simulator;
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400);
+            simulator.SetDefaultEndpoint(L"speakers");
+
+            std::string pnpId;
+            Assert::AreEqual(static_cast<uint64_t>(0), AllocationCounter::MeasurePerOperation(100, [&]
+                {
+                    Assert::IsTrue(collection.ReadDefaultRenderDevicePnpId(pnpId));
+                    Assert::IsFalse(collection.ReadDefaultCaptureDevicePnpId(pnpId));
+                }));
+            collection.ReadDefaultRenderDevicePnpId(pnpId);
+            Assert::AreEqual(EndpointSimulator::GetPnpIdOfContainer(L"speakers"), pnpId);
+        }
+
+        // From the simulated endpoint changing its volume through the event posted to the observers.
+        TEST_METHOD(VolumeNotificationBudgetTest)
+        {
+            EndpointSimulator simulator;
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            CountingObserver observer;
+            collection.Subscribe(observer);
+            const std::wstring speakers = L"speakers-with-a-long-endpoint-id";
+            const std::wstring microphone = L"microphone-with-a-long-endpoint-id";
+            simulator.AddEndpoint(speakers, L"Speakers", eRender, 500);
+            simulator.AddEndpoint(microphone, L"Microphone", eCapture, 500);
+
+            uint16_t volume = 500;
+            // steps of one, so that the history blocks allocated on discovery keep room for every sample
+            Assert::AreEqual(static_cast<uint64_t>(0), AllocationCounter::MeasurePerOperation(64, [&]
+                {
+                    volume = volume == 500 ? 501 : 500;
+                    simulator.SetVolume(speakers, volume);
+                    simulator.SetVolume(microphone, volume);
+                }));
+            Assert::AreEqual(static_cast<uint16_t>(volume),
+                collection.CreateItem(EndpointSimulator::GetPnpIdOfContainer(speakers))->GetCurrentRenderVolume());
+            collection.Unsubscribe(observer, true);
+        }
+    };
+}
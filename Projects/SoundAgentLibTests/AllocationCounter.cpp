@@ -0,0 +1,164 @@
+#include "stdafx.h"
+
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+namespace
+{
+    // constant-initialized, so that counting needs no allocation of its own
+    thread_local ed::audio::AllocationCounter::Counts threadCounts;
+    std::atomic<uint64_t> processAllocations = 0;
+    std::atomic<uint64_t> processDeallocations = 0;
+    std::atomic<uint64_t> processBytes = 0;
+
+    void CountAllocation(size_t bytes)
+    {
+        ++threadCounts.Allocations;
+        threadCounts.Bytes += bytes;
+        processAllocations.fetch_add(1, std::memory_order_relaxed);
+        processBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void CountDeallocation()
+    {
+        ++threadCounts.Deallocations;
+        processDeallocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // malloc and free unqualified: the debug CRT maps them as macros
+    void * Allocate(size_t bytes)
+    {
+        CountAllocation(bytes);
+        return malloc(bytes == 0 ? 1 : bytes);
+    }
+
+    void * AllocateAligned(size_t bytes, std::align_val_t alignment)
+    {
+        CountAllocation(bytes);
+        const auto align = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+        return _aligned_malloc(bytes == 0 ? 1 : bytes, align);
+#else
+        return std::aligned_alloc(align, (bytes + align - 1) / align * align);
+#endif
+    }
+
+    void Deallocate(void * p)
+    {
+        if (p != nullptr)
+        {
+            CountDeallocation();
+            free(p);
+        }
+    }
+
+    void DeallocateAligned(void * p)
+    {
+        if (p != nullptr)
+        {
+            CountDeallocation();
+#ifdef _MSC_VER
+            _aligned_free(p);
+#else
+            free(p);
+#endif
+        }
+    }
+
+    void * AllocateOrThrow(size_t bytes)
+    {
+        if (auto * p = Allocate(bytes); p != nullptr)
+        {
+            return p;
+        }
+        throw std::bad_alloc();
+    }
+
+    void * AllocateAlignedOrThrow(size_t bytes, std::align_val_t alignment)
+    {
+        if (auto * p = AllocateAligned(bytes, alignment); p != nullptr)
+        {
+            return p;
+        }
+        throw std::bad_alloc();
+    }
+}
+
+// The replacements of the global operators, for the whole test module.
+void * operator new(size_t bytes) { return AllocateOrThrow(bytes); }
+void * operator new[](size_t bytes) { return AllocateOrThrow(bytes); }
+void * operator new(size_t bytes, const std::nothrow_t &) noexcept { return Allocate(bytes); }
+void * operator new[](size_t bytes, const std::nothrow_t &) noexcept { return Allocate(bytes); }
+void * operator new(size_t bytes, std::align_val_t alignment) { return AllocateAlignedOrThrow(bytes, alignment); }
+void * operator new[](size_t bytes, std::align_val_t alignment) { return AllocateAlignedOrThrow(bytes, alignment); }
+void * operator new(size_t bytes, std::align_val_t alignment, const std::nothrow_t &) noexcept { return AllocateAligned(bytes, alignment); }
+void * operator new[](size_t bytes, std::align_val_t alignment, const std::nothrow_t &) noexcept { return AllocateAligned(bytes, alignment); }
+
+void operator delete(void * p) noexcept { Deallocate(p); }
+void operator delete[](void * p) noexcept { Deallocate(p); }
+void operator delete(void * p, size_t) noexcept { Deallocate(p); }
+void operator delete[](void * p, size_t) noexcept { Deallocate(p); }
+void operator delete(void * p, const std::nothrow_t &) noexcept { Deallocate(p); }
+void operator delete[](void * p, const std::nothrow_t &) noexcept { Deallocate(p); }
+void operator delete(void * p, std::align_val_t) noexcept { DeallocateAligned(p); }
+void operator delete[](void * p, std::align_val_t) noexcept { DeallocateAligned(p); }
+void operator delete(void * p, size_t, std::align_val_t) noexcept { DeallocateAligned(p); }
+void operator delete[](void * p, size_t, std::align_val_t) noexcept { DeallocateAligned(p); }
+void operator delete(void * p, std::align_val_t, const std::nothrow_t &) noexcept { DeallocateAligned(p); }
+void operator delete[](void * p, std::align_val_t, const std::nothrow_t &) noexcept { DeallocateAligned(p); }
+
+
+ed::audio::AllocationCounter::AllocationCounter()
+    : start_(GetThreadCounts())
+{
+}
+
+ed::audio::AllocationCounter::Counts ed::audio::AllocationCounter::GetCounts() const
+{
+    const auto now = GetThreadCounts();
+    return { now.Allocations - start_.Allocations, now.Deallocations - start_.Deallocations, now.Bytes - start_.Bytes };
+}
+
+void ed::audio::AllocationCounter::Restart()
+{
+    start_ = GetThreadCounts();
+}
+
+ed::audio::AllocationCounter::Counts ed::audio::AllocationCounter::GetThreadCounts()
+{
+    return threadCounts;
+}
+
+ed::audio::AllocationCounter::Counts ed::audio::AllocationCounter::GetProcessCounts()
+{
+    return { processAllocations.load(), processDeallocations.load(), processBytes.load() };
+}
+
+ed::audio::CountingMemoryResource::CountingMemoryResource(std::pmr::memory_resource * upstream)
+    : upstream_(upstream)
+{
+}
+
+void * ed::audio::CountingMemoryResource::do_allocate(size_t bytes, size_t alignment)
+{
+    auto * p = upstream_->allocate(bytes, alignment);
+    ++allocations_;
+    bytesInUse_ += bytes;
+    return p;
+}
+
+void ed::audio::CountingMemoryResource::do_deallocate(void * p, size_t bytes, size_t alignment)
+{
+    upstream_->deallocate(p, bytes, alignment);
+    ++deallocations_;
+    bytesInUse_ -= bytes;
+}
+
+bool ed::audio::CountingMemoryResource::do_is_equal(const std::pmr::memory_resource & other) const noexcept
+{
+    return this == &other;
+}
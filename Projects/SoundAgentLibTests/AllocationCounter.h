@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory_resource>
+
+#include <ApiClient/common/ClassDefHelper.h>
+
+
+namespace ed::audio {
+// Counts the heap allocations of the calling thread, through the global operator new and delete that
+// AllocationCounter.cpp replaces in the test module, from construction on. Allocations of other threads,
+// like the delivery of the notification dispatcher, are not counted.
+class AllocationCounter final {
+public:
+    struct Counts {
+        uint64_t Allocations = 0;
+        uint64_t Deallocations = 0;
+        uint64_t Bytes = 0;
+    };
+
+public:
+    DISALLOW_COPY_MOVE(AllocationCounter);
+    AllocationCounter();
+    ~AllocationCounter() = default;
+
+public:
+    [[nodiscard]] Counts GetCounts() const;
+    [[nodiscard]] uint64_t GetAllocations() const { return GetCounts().Allocations; }
+    void Restart();
+
+    // Of the calling thread since it started.
+    [[nodiscard]] static Counts GetThreadCounts();
+    // Of all threads since the module started; allocations less deallocations are the blocks alive.
+    [[nodiscard]] static Counts GetProcessCounts();
+
+    // The most allocations a single run of the operation made, of repetitions runs after a first, warm-up one.
+    template <typename OperationT>
+    [[nodiscard]] static uint64_t MeasurePerOperation(size_t repetitions, OperationT && operation)
+    {
+        operation();
+        uint64_t most = 0;
+        for (size_t i = 0; i < repetitions; ++i)
+        {
+            const AllocationCounter counter;
+            operation();
+            most = std::max(most, counter.GetAllocations());
+        }
+        return most;
+    }
+
+private:
+    Counts start_;
+};
+
+// Counts what goes through it to the upstream resource, on any thread: plugged into the std::pmr containers
+// under test, it counts their allocations alone.
+class CountingMemoryResource final : public std::pmr::memory_resource {
+public:
+    DISALLOW_COPY_MOVE(CountingMemoryResource);
+    explicit CountingMemoryResource(std::pmr::memory_resource * upstream = std::pmr::new_delete_resource());
+    ~CountingMemoryResource() override = default;
+
+public:
+    [[nodiscard]] uint64_t GetAllocations() const { return allocations_.load(); }
+    [[nodiscard]] uint64_t GetDeallocations() const { return deallocations_.load(); }
+    [[nodiscard]] uint64_t GetBytesInUse() const { return bytesInUse_.load(); }
+
+private:
+    void * do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void * p, size_t bytes, size_t alignment) override;
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override;
+
+private:
+    std::pmr::memory_resource * upstream_;
+    std::atomic<uint64_t> allocations_ = 0;
+    std::atomic<uint64_t> deallocations_ = 0;
+    std::atomic<uint64_t> bytesInUse_ = 0;
+};
+}
@@ -0,0 +1,167 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "AllocationCounter.h"
+#include "ChurnScenario.h"
+#include "EndpointSimulator.h"
+#include "SoundDeviceCollection.h"
+
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        class IgnoringObserver final : public SoundDeviceObserverInterface {
+        public:
+            IgnoringObserver() = default;
+            DISALLOW_COPY_MOVE(IgnoringObserver);
+            ~IgnoringObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType, const std::string &, uint64_t) override {}
+        };
+
+        DWORD GetHandleCount()
+        {
+            DWORD count = 0;
+            GetProcessHandleCount(GetCurrentProcess(), &count);
+            return count;
+        }
+
+        // The collection must follow the scenario exactly, with nothing left over from the endpoints gone.
+        void AssertFollows(const SoundDeviceCollection::ContentAudit & audit, const ChurnScenario & scenario, size_t hour)
+        {
+            const auto where = L" after hour " + std::to_wstring(hour);
+            Assert::AreEqual(static_cast<size_t>(0), audit.OrphanEndpoints, (L"Orphan endpoints" + where).c_str());
+            Assert::AreEqual(static_cast<size_t>(0), audit.DevicesWithoutEndpoints, (L"Stale devices" + where).c_str());
+            Assert::AreEqual(scenario.GetActiveEndpointCount(), audit.Endpoints, (L"Endpoints" + where).c_str());
+            Assert::AreEqual(scenario.GetActiveDeviceCount(), audit.Devices, (L"Devices" + where).c_str());
+            Assert::IsTrue(audit.InternedEndpointIds <= scenario.GetEndpointCount(), (L"Endpoint ids" + where).c_str());
+            Assert::IsTrue(audit.InternedPnpIds <= scenario.GetDeviceCount(), (L"PnP ids" + where).c_str());
+        }
+    }
+
+    TEST_CLASS(ChurnSoakTests)
+    {
+        TEST_METHOD(ScenarioReplaysExactlyTest)
+        {
+            const auto run = [](uint32_t seed)
+            {
+                EndpointSimulator simulator;
+                ChurnScenario::Options options;
+                options.Seed = seed;
+                ChurnScenario scenario(simulator, options);
+                scenario.Advance(12h);
+                return scenario.GetStatistics();
+            };
+            const auto first = run(7);
+            const auto second = run(7);
+            const auto other = run(8);
+
+            Assert::AreEqual(first.Connects, second.Connects);
+            Assert::AreEqual(first.DefaultChanges, second.DefaultChanges);
+            Assert::AreEqual(first.VolumeSteps, second.VolumeSteps);
+            Assert::IsTrue(first.Connects != other.Connects || first.VolumeSteps != other.VolumeSteps, L"The seed counts");
+            Assert::IsTrue(first.Connects > 0 && first.Disconnects > 0 && first.DockBursts > 0);
+            Assert::IsTrue(first.DefaultChanges > 0 && first.VolumeSteps > 0);
+        }
+
+        // A headset's render and capture endpoints make one device, which stays while either of them is there.
+        TEST_METHOD(HeadsetPairsShareTheirDeviceTest)
+        {
+            EndpointSimulator simulator;
+            ChurnScenario::Options options;
+            options.Headsets = 1;
+            options.DockPairs = 0;
+            ChurnScenario scenario(simulator, options);
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+
+            for (size_t hour = 1; hour <= 24; ++hour)
+            {
+                scenario.Advance(1h);
+                AssertFollows(collection.Audit(), scenario, hour);
+            }
+        }
+
+        // A week of the default scenario, checked every simulated minute and sampled every hour: the collection must
+        // follow it, its memory must not grow past the first days', and the process must not keep heap blocks or
+        // handles per hour. The device history, which is bounded but fills over the week, is reported apart.
+        TEST_METHOD(WeekOfChurnSoakTest)
+        {
+            constexpr size_t hours = 7 * 24;
+            CountingMemoryResource upstream;
+            EndpointSimulator simulator;
+            ChurnScenario scenario(simulator, ChurnScenario::Options{});
+            SoundDeviceCollection collection(simulator.GetEnumerator(), &upstream);
+            IgnoringObserver observer;
+            collection.Subscribe(observer);
+            collection.ResetContent();
+
+            struct HourSample {
+                uint64_t CollectionBytes;
+                int64_t LiveBlocks;
+                size_t HistoryBytes;
+                DWORD Handles;
+            };
+            std::vector<HourSample> samples;
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t hour = 1; hour <= hours; ++hour)
+            {
+                for (int minute = 0; minute < 60; ++minute)
+                {
+                    scenario.Advance(1min);
+                    AssertFollows(collection.Audit(), scenario, hour);
+                }
+                const auto audit = collection.Audit();
+                if (hour % 24 == 0)
+                {
+                    // the states of the day, rather than the notifications of its last events
+                    collection.ReconcileContent();
+                }
+                const auto counts = AllocationCounter::GetProcessCounts();
+                samples.push_back({ upstream.GetBytesInUse(), static_cast<int64_t>(counts.Allocations - counts.Deallocations),
+                    audit.HistoryBytes, GetHandleCount() });
+            }
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            collection.Unsubscribe(observer, true);
+
+            const auto & statistics = scenario.GetStatistics();
+            Logger::WriteMessage(std::format("A week of churn in {:.1f} s: {} connections, {} disconnections, {} dock bursts, "
+                "{} default changes, {} volume steps\n",
+                std::chrono::duration<double>(elapsed).count(), statistics.Connects, statistics.Disconnects,
+                statistics.DockBursts, statistics.DefaultChanges, statistics.VolumeSteps).c_str());
+            for (size_t day = 0; day < hours / 24; ++day)
+            {
+                const auto & last = samples[day * 24 + 23];
+                Logger::WriteMessage(std::format("Day {}: collection {} bytes, {} heap blocks alive, history {} bytes, {} handles\n",
+                    day + 1, last.CollectionBytes, last.LiveBlocks, last.HistoryBytes, last.Handles).c_str());
+            }
+
+            const auto mostBytes = [&samples](size_t from, size_t to)
+            {
+                return std::max_element(samples.begin() + static_cast<ptrdiff_t>(from), samples.begin() + static_cast<ptrdiff_t>(to),
+                    [](const HourSample & a, const HourSample & b) { return a.CollectionBytes < b.CollectionBytes; })->CollectionBytes;
+            };
+            Assert::IsTrue(mostBytes(72, hours) <= mostBytes(0, 72), L"The collection's memory grows");
+
+            // after the first day, the blocks alive grow by the history's blocks at most
+            const auto & firstDay = samples[23];
+            const auto & lastDay = samples.back();
+            const auto historyBlocks = static_cast<int64_t>((lastDay.HistoryBytes - firstDay.HistoryBytes) / DeviceHistory::block_bytes);
+            const auto growth = lastDay.LiveBlocks - firstDay.LiveBlocks;
+            Logger::WriteMessage(std::format("Growth over days 2 to 7: {} heap blocks, {} of them the history's; {:+} handles\n",
+                growth, historyBlocks, static_cast<int64_t>(lastDay.Handles) - static_cast<int64_t>(firstDay.Handles)).c_str());
+            Assert::IsTrue(growth <= historyBlocks + 64, L"Heap blocks leak");
+            Assert::IsTrue(lastDay.Handles <= firstDay.Handles + 16, L"Handles leak");
+        }
+    };
+}
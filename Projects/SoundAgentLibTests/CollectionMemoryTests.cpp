@@ -0,0 +1,155 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <format>
+#include <psapi.h>
+#include <string>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "AllocationCounter.h"
+#include "EndpointSimulator.h"
+#include "SoundDeviceCollection.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        class IgnoringObserver final : public SoundDeviceObserverInterface {
+        public:
+            IgnoringObserver() = default;
+            DISALLOW_COPY_MOVE(IgnoringObserver);
+            ~IgnoringObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType, const std::string &, uint64_t) override {}
+        };
+
+        size_t GetWorkingSetBytes()
+        {
+            PROCESS_MEMORY_COUNTERS counters{};
+            if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            {
+                return 0;
+            }
+            return counters.WorkingSetSize;
+        }
+
+        std::wstring MakeEndpointId(const wchar_t * kind, size_t index)
+        {
+            return std::wstring(kind) + L"-endpoint-with-a-realistic-length-" + std::to_wstring(index);
+        }
+    }
+
+    // The device tables live in per-generation arenas over the collection's memory resource.
+    TEST_CLASS(CollectionMemoryTests)
+    {
+        TEST_METHOD(ResetDropsPreviousGenerationTest)
+        {
+            CountingMemoryResource upstream;
+            EndpointSimulator simulator;
+            for (size_t i = 0; i < 20; ++i)
+            {
+                simulator.AddEndpoint(MakeEndpointId(L"speakers", i), L"Speakers", eRender, 500);
+            }
+            SoundDeviceCollection collection(simulator.GetEnumerator(), &upstream);
+            collection.ResetContent();
+            collection.ReconcileContent();
+            const auto bytesInUse = upstream.GetBytesInUse();
+            const auto deallocations = upstream.GetDeallocations();
+            Assert::IsTrue(bytesInUse > 0);
+
+            for (int i = 0; i < 50; ++i)
+            {
+                collection.ResetContent();
+                collection.ReconcileContent();
+                Assert::AreEqual(bytesInUse, upstream.GetBytesInUse(), L"Each generation replaces the previous one");
+            }
+            Assert::IsTrue(upstream.GetDeallocations() > deallocations, L"The arenas of the previous generations are released");
+            Assert::AreEqual(static_cast<size_t>(20), collection.GetSize());
+        }
+
+        // A day of a busy desk at one simulated minute a step: ten volume changes a minute, a device plugged or
+        // unplugged every five minutes, a reset every hour. The collection's own memory must not grow from one
+        // half of the day to the next; the process figures, which include the bounded device history, are reported.
+        TEST_METHOD(DayOfChurnSoakTest)
+        {
+            constexpr size_t minutes = 24 * 60;
+            CountingMemoryResource upstream;
+            EndpointSimulator simulator;
+            std::vector<std::wstring> fixedEndpoints;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                fixedEndpoints.push_back(MakeEndpointId(L"speakers", i));
+                simulator.AddEndpoint(fixedEndpoints.back(), L"Speakers", eRender, 500);
+                fixedEndpoints.push_back(MakeEndpointId(L"microphone", i));
+                simulator.AddEndpoint(fixedEndpoints.back(), L"Microphone", eCapture, 500, L"headset-" + std::to_wstring(i));
+            }
+            std::vector<std::wstring> pluggedEndpoints;
+            std::vector<bool> isPlugged;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                pluggedEndpoints.push_back(MakeEndpointId(L"dock", i));
+                isPlugged.push_back(false);
+            }
+
+            SoundDeviceCollection collection(simulator.GetEnumerator(), &upstream);
+            IgnoringObserver observer;
+            collection.Subscribe(observer);
+            collection.ResetContent();
+
+            struct HourSample {
+                uint64_t CollectionBytes;
+                uint64_t LiveBlocks;
+                size_t WorkingSetBytes;
+            };
+            std::vector<HourSample> hours;
+            for (size_t minute = 0; minute < minutes; ++minute)
+            {
+                for (size_t i = 0; i < 10; ++i)
+                {
+                    simulator.SetVolume(fixedEndpoints[i % fixedEndpoints.size()], static_cast<uint16_t>((minute * 37 + i * 101) % 1001));
+                }
+                if (minute % 5 == 0)
+                {
+                    const auto index = minute / 5 % pluggedEndpoints.size();
+                    if (isPlugged[index])
+                    {
+                        simulator.RemoveEndpoint(pluggedEndpoints[index]);
+                    }
+                    else
+                    {
+                        simulator.AddEndpoint(pluggedEndpoints[index], L"Dock", eRender, 300);
+                    }
+                    isPlugged[index] = !isPlugged[index];
+                }
+                if (minute % 60 == 59)
+                {
+                    collection.ReconcileContent();
+                    const auto counts = AllocationCounter::GetProcessCounts();
+                    hours.push_back({ upstream.GetBytesInUse(), counts.Allocations - counts.Deallocations, GetWorkingSetBytes() });
+                }
+            }
+            collection.Unsubscribe(observer, true);
+
+            for (size_t hour = 0; hour < hours.size(); hour += 4)
+            {
+                Logger::WriteMessage(std::format("Hour {:2}: collection {} bytes, {} heap blocks alive, working set {:.1f} MB\n",
+                    hour + 1, hours[hour].CollectionBytes, hours[hour].LiveBlocks,
+                    static_cast<double>(hours[hour].WorkingSetBytes) / (1024 * 1024)).c_str());
+            }
+            const auto half = hours.size() / 2;
+            const auto mostBytes = [&hours](size_t from, size_t to)
+            {
+                return std::max_element(hours.begin() + static_cast<ptrdiff_t>(from), hours.begin() + static_cast<ptrdiff_t>(to),
+                    [](const HourSample & a, const HourSample & b) { return a.CollectionBytes < b.CollectionBytes; })->CollectionBytes;
+            };
+            Logger::WriteMessage(std::format("Working set growth over the day: {:+.1f} MB\n",
+                (static_cast<double>(hours.back().WorkingSetBytes) - static_cast<double>(hours.front().WorkingSetBytes)) / (1024 * 1024)).c_str());
+            Assert::IsTrue(mostBytes(half, hours.size()) <= mostBytes(0, half), L"The collection's memory grows");
+        }
+    };
+}
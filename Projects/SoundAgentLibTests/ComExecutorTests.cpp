@@ -0,0 +1,236 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "ComExecutor.h"
+#include "EndpointSimulator.h"
+#include "SoundDeviceCollection.h"
+
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        // Stands in for COM: counts the entries and remembers the thread.
+        struct ApartmentRecord {
+            std::atomic<int> Entered = 0;
+            std::atomic<int> Left = 0;
+            std::thread::id Thread;
+        };
+
+        class FakeApartment final : public ComExecutor::Apartment {
+        public:
+            explicit FakeApartment(ApartmentRecord & record) : record_(record) {}
+            DISALLOW_COPY_MOVE(FakeApartment);
+            ~FakeApartment() override = default;
+
+            bool Enter() override
+            {
+                record_.Thread = std::this_thread::get_id();
+                ++record_.Entered;
+                return true;
+            }
+
+            void Leave() override
+            {
+                ++record_.Left;
+            }
+
+        private:
+            ApartmentRecord & record_;
+        };
+
+        std::unique_ptr<ComExecutor> CreateExecutor(ApartmentRecord & record)
+        {
+            return std::make_unique<ComExecutor>(std::make_unique<FakeApartment>(record));
+        }
+    }
+
+    TEST_CLASS(ComExecutorTests)
+    {
+        TEST_METHOD(CallsFromManyThreadsShareOneApartmentTest)
+        {
+            ApartmentRecord record;
+            auto executor = CreateExecutor(record);
+            std::atomic<int> elsewhere = 0;
+            std::vector<std::thread> callers;
+            for (int i = 0; i < 8; ++i)
+            {
+                callers.emplace_back([&executor, &record, &elsewhere]
+                    {
+                        for (int call = 0; call < 200; ++call)
+                        {
+                            if (executor->Invoke([] { return std::this_thread::get_id(); }) != record.Thread)
+                            {
+                                ++elsewhere;
+                            }
+                        }
+                    });
+            }
+            for (auto & caller : callers)
+            {
+                caller.join();
+            }
+            Assert::AreEqual(static_cast<uint64_t>(1'600), executor->GetStatistics().Requests);
+            executor.reset();
+
+            Assert::AreEqual(0, elsewhere.load());
+            Assert::AreEqual(1, record.Entered.load(), L"One apartment entry for all the calls");
+            Assert::AreEqual(1, record.Left.load());
+        }
+
+        TEST_METHOD(RequestsRunInSubmissionOrderTest)
+        {
+            ApartmentRecord record;
+            auto executor = CreateExecutor(record);
+            std::vector<int> order;
+            std::vector<std::future<int>> results;
+            for (int i = 0; i < 1'000; ++i)
+            {
+                results.push_back(executor->Submit([&order, i] { order.push_back(i); return i * 2; }));
+            }
+            for (int i = 0; i < 1'000; ++i)
+            {
+                Assert::AreEqual(i * 2, results[i].get());
+            }
+
+            Assert::AreEqual(static_cast<size_t>(1'000), order.size());
+            Assert::IsTrue(std::ranges::is_sorted(order));
+        }
+
+        TEST_METHOD(ExceptionReachesCallerTest)
+        {
+            ApartmentRecord record;
+            auto executor = CreateExecutor(record);
+            Assert::ExpectException<std::runtime_error>([&executor]
+                {
+                    executor->Invoke([] { throw std::runtime_error("Enumeration failed"); });
+                });
+            Assert::AreEqual(7, executor->Invoke([] { return 7; }), L"Runs on after a failed request");
+        }
+
+        TEST_METHOD(InvokeFromRequestRunsAtOnceTest)
+        {
+            ApartmentRecord record;
+            auto executor = CreateExecutor(record);
+            const auto nested = executor->Invoke([&executor]
+                {
+                    Assert::IsTrue(executor->IsExecutorThread());
+                    return executor->Invoke([] { return 42; });
+                });
+            Assert::AreEqual(42, nested);
+            Assert::IsFalse(executor->IsExecutorThread());
+        }
+
+        TEST_METHOD(DestructionRunsSubmittedRequestsTest)
+        {
+            ApartmentRecord record;
+            std::atomic<int> ran = 0;
+            {
+                auto executor = CreateExecutor(record);
+                executor->Submit([] { std::this_thread::sleep_for(50ms); });
+                for (int i = 0; i < 10; ++i)
+                {
+                    executor->Submit([&ran] { ++ran; });
+                }
+            }
+            Assert::AreEqual(10, ran.load());
+            Assert::AreEqual(1, record.Left.load());
+        }
+
+        TEST_METHOD(QueuedRequestsRunAsOneBatchTest)
+        {
+            ApartmentRecord record;
+            auto executor = CreateExecutor(record);
+            std::promise<void> started;
+            std::promise<void> release;
+            auto blocker = executor->Submit([&started, released = release.get_future()]
+                {
+                    started.set_value();
+                    released.wait();
+                });
+            started.get_future().wait();
+            std::vector<std::future<void>> queued;
+            for (int i = 0; i < 50; ++i)
+            {
+                queued.push_back(executor->Submit([] {}));
+            }
+            release.set_value();
+            for (auto & request : queued)
+            {
+                request.get();
+            }
+
+            const auto statistics = executor->GetStatistics();
+            Assert::AreEqual(static_cast<uint64_t>(51), statistics.Requests);
+            Assert::AreEqual(static_cast<uint64_t>(50), statistics.LargestBatch, L"The requests queued behind the blocker");
+        }
+
+        // The collection on the simulated backend, reset by callers on many threads: their COM work is serialized
+        // on the executor, and the callers see the latency of the queue plus the reset.
+        TEST_METHOD(CallLatencyBenchmark)
+        {
+            EndpointSimulator simulator;
+            for (int i = 0; i < 8; ++i)
+            {
+                simulator.AddEndpoint(L"endpoint-" + std::to_wstring(i), L"Endpoint " + std::to_wstring(i), i % 2 == 0 ? eRender : eCapture, 500);
+            }
+            ApartmentRecord record;
+            auto executor = CreateExecutor(record);
+            auto collection = executor->Invoke([&simulator] { return std::make_unique<SoundDeviceCollection>(simulator.GetEnumerator()); });
+
+            constexpr int callers = 8;
+            constexpr int calls = 250;
+            std::vector<std::vector<std::chrono::nanoseconds>> latencies(callers);
+            std::vector<std::thread> threads;
+            for (int i = 0; i < callers; ++i)
+            {
+                threads.emplace_back([&executor, &collection, &latencies, i]
+                    {
+                        latencies[i].reserve(calls);
+                        for (int call = 0; call < calls; ++call)
+                        {
+                            const auto start = std::chrono::steady_clock::now();
+                            executor->Invoke([&collection] { collection->ResetContent(); });
+                            latencies[i].push_back(std::chrono::steady_clock::now() - start);
+                        }
+                    });
+            }
+            for (auto & thread : threads)
+            {
+                thread.join();
+            }
+            executor->Invoke([&collection] { collection.reset(); });
+
+            std::vector<std::chrono::nanoseconds> all;
+            for (const auto & callerLatencies : latencies)
+            {
+                all.insert(all.end(), callerLatencies.begin(), callerLatencies.end());
+            }
+            std::ranges::sort(all);
+            const auto statistics = executor->GetStatistics();
+            const auto toMicroseconds = [](std::chrono::nanoseconds duration) { return std::chrono::duration<double, std::micro>(duration).count(); };
+            Logger::WriteMessage(std::format("{} callers x {} resets of 8 endpoints: p50 {:.1f} us, p99 {:.1f} us, max {:.1f} us; "
+                "{} requests in {} batches, largest {}\n",
+                callers, calls, toMicroseconds(all[all.size() / 2]), toMicroseconds(all[all.size() * 99 / 100]), toMicroseconds(all.back()),
+                statistics.Requests, statistics.Batches, statistics.LargestBatch).c_str());
+
+            Assert::AreEqual(static_cast<uint64_t>(callers * calls + 2), statistics.Requests);
+            Assert::IsTrue(statistics.LargestBatch <= static_cast<uint64_t>(callers), L"A caller waits for its request");
+            Assert::AreEqual(1, record.Entered.load());
+        }
+    };
+}
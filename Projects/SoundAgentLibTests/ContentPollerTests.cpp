@@ -0,0 +1,233 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "ContentPoller.h"
+#include "EndpointSimulator.h"
+#include "SoundDeviceCollection.h"
+
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        // Records when each event arrives, on the dispatcher thread.
+        class TimingObserver final : public SoundDeviceObserverInterface {
+        public:
+            using Clock = std::chrono::steady_clock;
+
+            TimingObserver() = default;
+            DISALLOW_COPY_MOVE(TimingObserver);
+            ~TimingObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType event, const std::string &, uint64_t) override
+            {
+                std::lock_guard lock(mutex_);
+                events_.emplace_back(event, Clock::now());
+                changed_.notify_all();
+            }
+
+            // Waits for the next event of the type, skipping others; returns when it arrived.
+            Clock::time_point WaitFor(SoundDeviceEventType event)
+            {
+                std::unique_lock lock(mutex_);
+                for (;;)
+                {
+                    Assert::IsTrue(changed_.wait_for(lock, 10s, [this] { return next_ < events_.size(); }), L"Event expected");
+                    if (const auto & [nextEvent, time] = events_[next_++]; nextEvent == event)
+                    {
+                        return time;
+                    }
+                }
+            }
+
+        private:
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::vector<std::pair<SoundDeviceEventType, Clock::time_point>> events_;
+            size_t next_ = 0;
+        };
+
+        // The executor thread, without COM.
+        class NoApartment final : public ComExecutor::Apartment {
+        public:
+            NoApartment() = default;
+            DISALLOW_COPY_MOVE(NoApartment);
+            ~NoApartment() override = default;
+
+            bool Enter() override { return true; }
+            void Leave() override {}
+        };
+    }
+
+    TEST_CLASS(ContentPollerTests)
+    {
+        TEST_METHOD(ScheduleBacksOffAndTightensTest)
+        {
+            PollingSchedule schedule({ 100ms, 1000ms });
+            Assert::AreEqual(100LL, static_cast<long long>(schedule.GetInterval().count()));
+            for (const auto expected : { 200, 400, 800, 1000, 1000 })
+            {
+                Assert::AreEqual(static_cast<long long>(expected), static_cast<long long>(schedule.Next(false).count()));
+            }
+            Assert::AreEqual(100LL, static_cast<long long>(schedule.Next(true).count()));
+            Assert::AreEqual(200LL, static_cast<long long>(schedule.Next(false).count()));
+        }
+
+        TEST_METHOD(FingerprintTest)
+        {
+            const auto speakers = Fingerprint::Of(std::wstring_view(L"speakers"));
+            const auto headset = Fingerprint::Of(std::wstring_view(L"headset"));
+            Assert::AreEqual(speakers + headset, headset + speakers, L"Sets fingerprint by sum, whatever the order");
+            Assert::AreNotEqual(speakers, headset);
+            Assert::AreNotEqual(Fingerprint::Combine(speakers, 400), Fingerprint::Combine(speakers, 401));
+            Assert::AreNotEqual(Fingerprint::Of(std::string_view("")), Fingerprint::Of(std::string_view("\0", 1)));
+        }
+
+        // The simulated host refuses notifications: the collection learns of each scripted change by polling only.
+        TEST_METHOD(PollsRunOnExecutorTest)
+        {
+            ComExecutor executor(std::make_unique<NoApartment>());
+            std::atomic<int> polls = 0;
+            std::atomic<int> pollsElsewhere = 0;
+            {
+                ContentPoller poller([&executor, &polls, &pollsElsewhere]
+                    {
+                        pollsElsewhere += executor.IsExecutorThread() ? 0 : 1;
+                        ++polls;
+                        return false;
+                    }, PollingSchedule::Options{ .Min = 1ms, .Max = 2ms }, &executor);
+                for (const auto deadline = std::chrono::steady_clock::now() + 5s; polls < 5 && std::chrono::steady_clock::now() < deadline;)
+                {
+                    std::this_thread::sleep_for(1ms);
+                }
+            }
+            Assert::IsTrue(polls >= 5);
+            Assert::AreEqual(0, pollsElsewhere.load());
+        }
+
+        TEST_METHOD(PollingDetectsScriptedChangesTest)
+        {
+            EndpointSimulator simulator;
+            simulator.SetNotificationsAvailable(false);
+            simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400);
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            TimingObserver observer;
+            collection.Subscribe(observer);
+
+            constexpr PollingSchedule::Options options{ 5ms, 80ms };
+            collection.StartPolling(options);
+            observer.WaitFor(SoundDeviceEventType::Discovered);
+
+            using Step = std::pair<std::function<void()>, SoundDeviceEventType>;
+            const std::vector<Step> script{
+                { [&] { simulator.SetVolume(L"speakers", 700); }, SoundDeviceEventType::VolumeRenderChanged },
+                { [&] { simulator.AddEndpoint(L"microphone", L"Microphone", eCapture, 300); }, SoundDeviceEventType::Discovered },
+                { [&] { simulator.SetDefaultEndpoint(L"microphone"); }, SoundDeviceEventType::DefaultCaptureChanged },
+                { [&] { simulator.SetVolume(L"microphone", 0); }, SoundDeviceEventType::VolumeCaptureChanged },
+                { [&] { simulator.RemoveEndpoint(L"microphone"); }, SoundDeviceEventType::Detached },
+            };
+            std::chrono::nanoseconds worst{ 0 };
+            std::chrono::nanoseconds total{ 0 };
+            constexpr int rounds = 4;
+            for (int round = 0; round < rounds; ++round)
+            {
+                for (const auto & [change, expected] : script)
+                {
+                    // lets the schedule back off to its longest interval
+                    std::this_thread::sleep_for(2 * options.Max);
+                    const auto changedAt = TimingObserver::Clock::now();
+                    change();
+                    const auto latency = observer.WaitFor(expected) - changedAt;
+                    worst = std::max(worst, std::chrono::duration_cast<std::chrono::nanoseconds>(latency));
+                    total += latency;
+                }
+                simulator.SetVolume(L"speakers", 400);
+                observer.WaitFor(SoundDeviceEventType::VolumeRenderChanged);
+            }
+            const auto statistics = collection.GetPollingStatistics();
+            collection.StopPolling();
+            collection.Unsubscribe(observer, true);
+
+            Assert::IsTrue(statistics.has_value());
+            Assert::IsFalse(collection.GetPollingStatistics().has_value());
+            const auto changes = static_cast<double>(rounds * script.size());
+            Logger::WriteMessage(std::format("Detection latency at {} to {} ms intervals: mean {:.1f} ms, worst {:.1f} ms; "
+                "{} polls, {} with changes, {:.1f} us per poll\n",
+                options.Min.count(), options.Max.count(),
+                std::chrono::duration<double, std::milli>(total).count() / changes,
+                std::chrono::duration<double, std::milli>(worst).count(),
+                statistics->Polls, statistics->Changes,
+                std::chrono::duration<double, std::micro>(statistics->BusyTime).count() / static_cast<double>(statistics->Polls)).c_str());
+            // a change waits for one interval at most, plus the poll and the delivery
+            Assert::IsTrue(worst < options.Max + 1s);
+        }
+
+        // What an idle host pays: the polls of an hour on the default schedule, at the cost of a poll that finds nothing.
+        TEST_METHOD(IdlePollingCostTest)
+        {
+            EndpointSimulator simulator;
+            simulator.SetNotificationsAvailable(false);
+            for (int i = 0; i < 8; ++i)
+            {
+                simulator.AddEndpoint(L"endpoint-" + std::to_wstring(i), L"Endpoint " + std::to_wstring(i), i % 2 == 0 ? eRender : eCapture, 500);
+            }
+            simulator.SetDefaultEndpoint(L"endpoint-0");
+            simulator.SetDefaultEndpoint(L"endpoint-1");
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            Assert::IsTrue(collection.PollContent());
+            Assert::AreEqual(static_cast<size_t>(8), collection.GetSize());
+
+            constexpr int polls = 2'000;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < polls; ++i)
+            {
+                Assert::IsFalse(collection.PollContent());
+            }
+            const auto perPoll = (std::chrono::steady_clock::now() - start) / polls;
+
+            PollingSchedule schedule({});
+            size_t pollsPerHour = 0;
+            for (std::chrono::milliseconds elapsed{ 0 }; elapsed < 1h; elapsed += schedule.Next(false))
+            {
+                ++pollsPerHour;
+            }
+            const auto perHour = perPoll * pollsPerHour;
+            Logger::WriteMessage(std::format("Idle polling of 8 endpoints: {:.1f} us per poll, {} polls per hour, {:.2f} ms per idle hour\n",
+                std::chrono::duration<double, std::micro>(perPoll).count(), pollsPerHour,
+                std::chrono::duration<double, std::milli>(perHour).count()).c_str());
+            Assert::IsTrue(pollsPerHour < 500);
+        }
+
+        // Where the notifications work, ActivateAndStartLoop leaves them be.
+        TEST_METHOD(PollsOnlyWithoutNotificationsTest)
+        {
+            EndpointSimulator simulator;
+            {
+                SoundDeviceCollection collection(simulator.GetEnumerator());
+                collection.ActivateAndStartLoop();
+                Assert::IsFalse(collection.GetPollingStatistics().has_value());
+            }
+            simulator.SetNotificationsAvailable(false);
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ActivateAndStartLoop();
+            Assert::IsTrue(collection.GetPollingStatistics().has_value());
+            collection.DeactivateAndStopLoop();
+            Assert::IsFalse(collection.GetPollingStatistics().has_value());
+        }
+    };
+}
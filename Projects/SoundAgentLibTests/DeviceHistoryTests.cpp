@@ -0,0 +1,225 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <random>
+
+#include <CppUnitTest.h>
+
+#include "DeviceHistory.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        using Samples = std::vector<SoundDeviceHistorySample>;
+
+        const auto start_time = std::chrono::system_clock::time_point(std::chrono::milliseconds(1'760'000'000'000));
+        const auto speakers = "{0.0.0.00000000}.{5B7BBF93-1CE3-7A17-DC7A-432D3575AF01}"s;
+        const auto microphone = "{0.0.1.00000000}.{5B7BBF93-1CE3-7A17-DC7A-432D3575AF02}"s;
+
+        // A user's volume slider: drags of 20 to 200 steps, about 10 minutes apart. A drag moves by 1%,
+        // at times by 2%, every 15 to 35 ms; now and then it ends muted, which reads as 0.
+        Samples GenerateSliderData(std::chrono::system_clock::duration duration, unsigned seed)
+        {
+            std::mt19937 random(seed);
+            std::exponential_distribution<> pause(1.0 / 600'000);
+            Samples samples;
+            auto time = start_time;
+            int volume = 500;
+            const auto add = [&samples, &time](int value)
+            {
+                if (samples.empty() || samples.back().Value != value)
+                {
+                    samples.push_back({ time, static_cast<uint16_t>(value) });
+                }
+            };
+            while (time < start_time + duration)
+            {
+                time += std::chrono::milliseconds(static_cast<int64_t>(pause(random)));
+                const auto direction = volume < 300 || (volume < 700 && random() % 2 == 0) ? 1 : -1;
+                for (auto steps = 20 + random() % 181; steps > 0; --steps)
+                {
+                    time += std::chrono::milliseconds(15 + random() % 21);
+                    volume = std::clamp(volume + direction * (random() % 8 == 0 ? 20 : 10), 0, 1000);
+                    add(volume);
+                }
+                if (random() % 20 == 0)
+                {
+                    time += std::chrono::milliseconds(500 + random() % 2000);
+                    add(0);
+                }
+            }
+            return samples;
+        }
+
+        void Record(DeviceHistory & history, const std::string & pnpId, SoundDeviceHistoryKind kind, const Samples & samples)
+        {
+            for (const auto & sample : samples)
+            {
+                history.Record(pnpId, kind, sample.Value, sample.Time);
+            }
+        }
+
+        // The samples of the model with from <= time < to.
+        Samples Expected(const Samples & model, std::chrono::system_clock::time_point from, std::chrono::system_clock::time_point to)
+        {
+            const auto first = std::ranges::lower_bound(model, from, {}, &SoundDeviceHistorySample::Time);
+            const auto last = std::ranges::lower_bound(first, model.end(), to, {}, &SoundDeviceHistorySample::Time);
+            return { first, last };
+        }
+
+        void AssertEqual(const Samples & expected, const Samples & actual)
+        {
+            Assert::AreEqual(expected.size(), actual.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                Assert::IsTrue(expected[i].Time == actual[i].Time);
+                Assert::AreEqual(expected[i].Value, actual[i].Value);
+            }
+        }
+    }
+
+    TEST_CLASS(DeviceHistoryTests)
+    {
+        TEST_METHOD(RoundTripTest)
+        {
+            // intervals and values of all encoding classes, repeated times and a clock set back
+            std::mt19937 random(11);
+            DeviceHistory history({ .MaxBlocksPerSeries = 10'000 });
+            Samples model;
+            auto time = start_time;
+            uint16_t value = 0;
+            int step = 0;
+            for (int i = 0; i < 50'000; ++i)
+            {
+                constexpr std::chrono::milliseconds intervals[] = { 0ms, 25ms, 40ms, 300ms, 2s, 1h, 30h };
+                const auto setBack = random() % 100 == 0;
+                const auto sampleTime = setBack ? time - 5s : time + intervals[random() % std::size(intervals)] + std::chrono::milliseconds(random() % 3);
+                switch (random() % 4)
+                {
+                case 0: break; // the step repeats
+                case 1: step = static_cast<int>(random() % 61) - 30; break;
+                case 2: step = static_cast<int>(random() % 2001) - 1000; break;
+                default: step = static_cast<int>(random() % 65536) - value; break;
+                }
+                value = static_cast<uint16_t>(value + step);
+                history.Record(speakers, SoundDeviceHistoryKind::RenderVolume, value, sampleTime);
+
+                if (model.empty() || model.back().Value != value)
+                {
+                    time = std::max(time, sampleTime);
+                    model.push_back({ time, value });
+                }
+            }
+
+            const auto all = history.Query(speakers, SoundDeviceHistoryKind::RenderVolume, start_time - 1h, time + 1ms);
+            AssertEqual(model, all);
+            Assert::AreEqual(static_cast<uint64_t>(model.size()), history.GetStatistics().SamplesRecorded);
+            for (int i = 0; i < 100; ++i)
+            {
+                const auto from = model[random() % model.size()].Time;
+                const auto to = std::max(from, model[random() % model.size()].Time);
+                AssertEqual(Expected(model, from, to), history.Query(speakers, SoundDeviceHistoryKind::RenderVolume, from, to));
+            }
+
+            Assert::IsTrue(history.Query(speakers, SoundDeviceHistoryKind::CaptureVolume, start_time, time).empty());
+            Assert::IsTrue(history.Query(microphone, SoundDeviceHistoryKind::RenderVolume, start_time, time).empty());
+        }
+
+        TEST_METHOD(DefaultTransitionsTest)
+        {
+            DeviceHistory history({});
+            history.Record(speakers, SoundDeviceHistoryKind::RenderDefault, 1, start_time);
+            history.Record(speakers, SoundDeviceHistoryKind::RenderDefault, 1, start_time + 1s);
+            history.Record(speakers, SoundDeviceHistoryKind::RenderDefault, 0, start_time + 2s);
+            history.Record(microphone, SoundDeviceHistoryKind::CaptureDefault, 1, start_time + 2s);
+
+            const auto transitions = history.Query(speakers, SoundDeviceHistoryKind::RenderDefault, start_time, start_time + 1h);
+            AssertEqual({ { start_time, 1 }, { start_time + 2s, 0 } }, transitions);
+            // the end of the range is excluded
+            Assert::AreEqual(static_cast<size_t>(1), history.Query(speakers, SoundDeviceHistoryKind::RenderDefault, start_time, start_time + 2s).size());
+            Assert::AreEqual(static_cast<size_t>(1), history.Query(microphone, SoundDeviceHistoryKind::CaptureDefault, start_time, start_time + 1h).size());
+        }
+
+        TEST_METHOD(OldestBlocksDroppedTest)
+        {
+            DeviceHistory history({ .MaxBlocksPerSeries = 4 });
+            const auto model = GenerateSliderData(std::chrono::days(2), 3);
+            Record(history, speakers, SoundDeviceHistoryKind::RenderVolume, model);
+
+            const auto statistics = history.GetStatistics();
+            Assert::AreEqual(static_cast<uint64_t>(4), statistics.Blocks);
+            Assert::IsTrue(statistics.SamplesDropped > 0);
+            Assert::IsTrue(statistics.MemoryBytes < 5 * DeviceHistory::block_bytes);
+
+            // the newest samples are kept
+            const auto kept = history.Query(speakers, SoundDeviceHistoryKind::RenderVolume, start_time, start_time + std::chrono::days(3));
+            Assert::AreEqual(model.size() - statistics.SamplesDropped, kept.size());
+            AssertEqual(Samples(model.end() - static_cast<std::ptrdiff_t>(kept.size()), model.end()), kept);
+        }
+
+        TEST_METHOD(MemoryPerSampleBudgetTest)
+        {
+            DeviceHistory history({ .MaxBlocksPerSeries = 10'000 });
+            const auto model = GenerateSliderData(std::chrono::days(30), 5);
+            Record(history, speakers, SoundDeviceHistoryKind::RenderVolume, model);
+
+            const auto statistics = history.GetStatistics();
+            const auto bytesPerSample = static_cast<double>(statistics.MemoryBytes) / static_cast<double>(statistics.SamplesRecorded);
+            Logger::WriteMessage(std::format("{} samples in {} blocks, {} bytes: {:.2f} bytes per sample\n",
+                statistics.SamplesRecorded, statistics.Blocks, statistics.MemoryBytes, bytesPerSample).c_str());
+            Assert::AreEqual(static_cast<uint64_t>(model.size()), statistics.SamplesRecorded);
+            Assert::AreEqual(static_cast<uint64_t>(0), statistics.SamplesDropped);
+            Assert::IsTrue(bytesPerSample < 2.0, L"Under 2 bytes per volume sample");
+        }
+
+        TEST_METHOD(MonthOfSliderDataQueryBenchmark)
+        {
+            const auto month = std::chrono::days(30);
+            DeviceHistory history({ .MaxBlocksPerSeries = 10'000 });
+            const auto renderModel = GenerateSliderData(month, 7);
+            const auto captureModel = GenerateSliderData(month, 8);
+            Record(history, speakers, SoundDeviceHistoryKind::RenderVolume, renderModel);
+            Record(history, microphone, SoundDeviceHistoryKind::CaptureVolume, captureModel);
+
+            std::mt19937 random(9);
+            for (const auto range : { std::chrono::system_clock::duration(1h), std::chrono::system_clock::duration(std::chrono::days(1)),
+                std::chrono::system_clock::duration(std::chrono::days(7)) })
+            {
+                constexpr int queryCount = 1000;
+                std::vector<std::chrono::system_clock::time_point> starts;
+                for (int i = 0; i < queryCount; ++i)
+                {
+                    starts.push_back(start_time + std::chrono::milliseconds(random() % std::chrono::duration_cast<std::chrono::milliseconds>(month - range).count()));
+                }
+
+                size_t sampleCount = 0;
+                const auto start = std::chrono::steady_clock::now();
+                for (const auto & from : starts)
+                {
+                    sampleCount += history.Query(speakers, SoundDeviceHistoryKind::RenderVolume, from, from + range).size();
+                }
+                const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                Logger::WriteMessage(std::format("{} h ranges: {:.1f} us per query, {} samples on average, {:.0f} samples/s\n",
+                    std::chrono::duration_cast<std::chrono::hours>(range).count(), seconds * 1e6 / queryCount,
+                    sampleCount / queryCount, static_cast<double>(sampleCount) / seconds).c_str());
+
+                size_t expectedCount = 0;
+                for (const auto & from : starts)
+                {
+                    expectedCount += Expected(renderModel, from, from + range).size();
+                }
+                Assert::AreEqual(expectedCount, sampleCount);
+            }
+            AssertEqual(captureModel, history.Query(microphone, SoundDeviceHistoryKind::CaptureVolume, start_time, start_time + month + 1h));
+        }
+    };
+}
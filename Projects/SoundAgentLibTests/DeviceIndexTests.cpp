@@ -0,0 +1,290 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <format>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "DeviceTable.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        struct DeviceKind {
+            const char * Name;
+            SoundDeviceFlowType Flow;
+            SoundDeviceFormFactor FormFactor;
+        };
+
+        // as Windows names them
+        constexpr std::array<DeviceKind, 8> device_kinds{ {
+            { "Speakers (Realtek High Definition Audio)", SoundDeviceFlowType::Render, SoundDeviceFormFactor::Speakers },
+            { "Headphones (USB Audio Device)", SoundDeviceFlowType::Render, SoundDeviceFormFactor::Headphones },
+            { "Microphone (USB PnP Sound Device)", SoundDeviceFlowType::Capture, SoundDeviceFormFactor::Microphone },
+            { "Headset/Headset Microphone (Jabra Link 380)", SoundDeviceFlowType::RenderAndCapture, SoundDeviceFormFactor::Headphones },
+            { "DELL U2720Q (NVIDIA High Definition Audio)", SoundDeviceFlowType::Render, SoundDeviceFormFactor::DigitalAudioDisplayDevice },
+            { "Digital Output (S/PDIF)", SoundDeviceFlowType::Render, SoundDeviceFormFactor::Spdif },
+            { "Line In (Realtek High Definition Audio)", SoundDeviceFlowType::Capture, SoundDeviceFormFactor::LineLevel },
+            { "Remote Audio", SoundDeviceFlowType::Render, SoundDeviceFormFactor::RemoteNetworkDevice }
+        } };
+
+        SoundDevice MakeDevice(size_t number, size_t kind)
+        {
+            const auto & [name, flow, formFactor] = device_kinds[kind % device_kinds.size()];
+            return { std::format("{{0.0.0.00000000}}.{{{:08}-0000-0000-0000-000000000000}}", number),
+                std::format("{} #{}", name, number), flow, 500, 500, false, false, formFactor };
+        }
+
+        // The devices of the table matching the query, found the slow way.
+        std::vector<DeviceTable::Handle> Scan(const DeviceTable & table, const DeviceQuery & query)
+        {
+            std::vector<DeviceTable::Handle> handles;
+            for (size_t i = 0; i < table.GetSize(); ++i)
+            {
+                const auto & device = table.GetAt(i);
+                const auto flow = device.GetFlow();
+                if ((query.Renders && flow != SoundDeviceFlowType::Render && flow != SoundDeviceFlowType::RenderAndCapture)
+                    || (query.Captures && flow != SoundDeviceFlowType::Capture && flow != SoundDeviceFlowType::RenderAndCapture)
+                    || (query.IsRenderDefault && !device.IsRenderCurrentlyDefault())
+                    || (query.IsCaptureDefault && !device.IsCaptureCurrentlyDefault())
+                    || (query.FormFactor.has_value() && device.GetFormFactor() != *query.FormFactor)
+                    || !DeviceIndex::NameContains(device.GetNameView(), query.NameContains))
+                {
+                    continue;
+                }
+                handles.push_back(table.GetHandleAt(i));
+            }
+            std::ranges::sort(handles);
+            return handles;
+        }
+
+        std::vector<DeviceTable::Handle> Find(const DeviceTable & table, const DeviceQuery & query)
+        {
+            std::vector<DeviceTable::Handle> handles;
+            table.Find(query, handles);
+            return handles;
+        }
+
+        template <typename FunctionT>
+        double MeasureNs(size_t operations, FunctionT && function)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            function();
+            return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                / static_cast<double>(operations);
+        }
+    }
+
+    TEST_CLASS(DeviceIndexTests)
+    {
+        TEST_METHOD(QueryConditionsTest)
+        {
+            StringInterner interner;
+            DeviceTable table(interner);
+            for (size_t i = 0; i < device_kinds.size(); ++i)
+            {
+                table.Put(MakeDevice(i, i));
+            }
+            const auto speakers = *table.FindHandle(MakeDevice(0, 0).GetPnpId());
+            const auto usbMicrophone = *table.FindHandle(MakeDevice(2, 2).GetPnpId());
+            const auto headset = *table.FindHandle(MakeDevice(3, 3).GetPnpId());
+            table.SetRenderDefault(speakers, true);
+            table.SetCaptureDefault(headset, true);
+
+            DeviceQuery capture;
+            capture.Captures = true;
+            Assert::AreEqual(static_cast<size_t>(3), Find(table, capture).size());
+
+            DeviceQuery headphones;
+            headphones.FormFactor = SoundDeviceFormFactor::Headphones;
+            Assert::AreEqual(static_cast<size_t>(2), Find(table, headphones).size());
+
+            DeviceQuery usb;
+            usb.NameContains = "usb";
+            Assert::AreEqual(static_cast<size_t>(2), Find(table, usb).size());
+            usb.Captures = true;
+            Assert::IsTrue(std::vector{ usbMicrophone } == Find(table, usb));
+
+            DeviceQuery defaults;
+            defaults.IsRenderDefault = true;
+            Assert::IsTrue(std::vector{ speakers } == Find(table, defaults));
+            defaults.IsRenderDefault = false;
+            defaults.IsCaptureDefault = true;
+            Assert::IsTrue(std::vector{ headset } == Find(table, defaults));
+
+            // shorter than a trigram, and a trigram no name has
+            DeviceQuery shortName;
+            shortName.NameContains = "#1";
+            Assert::AreEqual(static_cast<size_t>(1), Find(table, shortName).size());
+            DeviceQuery noName;
+            noName.NameContains = "Bluetooth";
+            Assert::IsTrue(Find(table, noName).empty());
+
+            Assert::AreEqual(table.GetSize(), Find(table, DeviceQuery{}).size());
+        }
+
+        TEST_METHOD(IndexFollowsChangesTest)
+        {
+            StringInterner interner;
+            DeviceTable table(interner);
+            const auto handle = table.Put(MakeDevice(1, 1));
+            DeviceQuery headphones;
+            headphones.FormFactor = SoundDeviceFormFactor::Headphones;
+            headphones.NameContains = "USB";
+            Assert::AreEqual(static_cast<size_t>(1), Find(table, headphones).size());
+
+            // replaced by a device of another name and form factor
+            auto renamed = MakeDevice(1, 0);
+            Assert::AreEqual(handle, table.Put(renamed));
+            Assert::IsTrue(Find(table, headphones).empty());
+            DeviceQuery realtek;
+            realtek.NameContains = "realtek";
+            realtek.FormFactor = SoundDeviceFormFactor::Speakers;
+            Assert::IsTrue(std::vector{ handle } == Find(table, realtek));
+
+            DeviceQuery defaultRender;
+            defaultRender.IsRenderDefault = true;
+            table.SetRenderDefault(handle, true);
+            Assert::AreEqual(static_cast<size_t>(1), Find(table, defaultRender).size());
+            table.SetRenderDefault(handle, false);
+            Assert::IsTrue(Find(table, defaultRender).empty());
+
+            table.Put(MakeDevice(2, 2));
+            Assert::IsTrue(table.Erase(handle));
+            Assert::IsTrue(Find(table, realtek).empty());
+            Assert::AreEqual(static_cast<size_t>(1), Find(table, DeviceQuery{}).size());
+
+            table.Clear();
+            Assert::IsTrue(Find(table, DeviceQuery{}).empty());
+            table.Put(MakeDevice(1, 1));
+            Assert::AreEqual(static_cast<size_t>(1), Find(table, headphones).size());
+        }
+
+        // Random changes and queries: the index must find what a scan of the devices finds.
+        TEST_METHOD(RandomQueriesMatchScanTest)
+        {
+            constexpr std::array<const char *, 8> name_parts{ "USB", "audio", "#1", "Head", "phone", "HIGH DEF", "(S/P", "zzz" };
+            std::mt19937 random(45);
+            StringInterner interner;
+            DeviceTable table(interner);
+            for (int step = 0; step < 20'000; ++step)
+            {
+                const auto number = random() % 500;
+                switch (random() % 4)
+                {
+                case 0:
+                case 1:
+                    table.Put(MakeDevice(number, random()));
+                    break;
+                case 2:
+                    if (const auto handle = table.FindHandle(MakeDevice(number, 0).GetPnpId()); handle.has_value())
+                    {
+                        table.Erase(*handle);
+                    }
+                    break;
+                default:
+                    if (table.GetSize() > 0)
+                    {
+                        const auto handle = table.GetHandleAt(random() % table.GetSize());
+                        const auto setDefault = random() % 2 == 0 ? &DeviceTable::SetRenderDefault : &DeviceTable::SetCaptureDefault;
+                        (table.*setDefault)(handle, random() % 2 == 0);
+                    }
+                    break;
+                }
+
+                if (step % 50 == 0)
+                {
+                    DeviceQuery query;
+                    query.Renders = random() % 4 == 0;
+                    query.Captures = random() % 4 == 0;
+                    query.IsRenderDefault = random() % 8 == 0;
+                    query.IsCaptureDefault = random() % 8 == 0;
+                    if (random() % 3 == 0)
+                    {
+                        query.FormFactor = device_kinds[random() % device_kinds.size()].FormFactor;
+                    }
+                    if (random() % 2 == 0)
+                    {
+                        query.NameContains = name_parts[random() % name_parts.size()];
+                    }
+                    Assert::IsTrue(Scan(table, query) == Find(table, query));
+                }
+            }
+        }
+
+        TEST_METHOD(QueryBenchmark)
+        {
+            constexpr size_t device_count = 10'000;
+            StringInterner interner;
+            DeviceTable table(interner);
+            std::mt19937 random(10);
+            for (size_t i = 0; i < device_count; ++i)
+            {
+                table.Put(MakeDevice(i, random()));
+            }
+            table.SetRenderDefault(table.GetHandleAt(device_count / 2), true);
+
+            DeviceQuery capture;
+            capture.Captures = true;
+            DeviceQuery headphones;
+            headphones.FormFactor = SoundDeviceFormFactor::Headphones;
+            DeviceQuery usb;
+            usb.NameContains = "USB";
+            DeviceQuery usbMicrophones;
+            usbMicrophones.Captures = true;
+            usbMicrophones.FormFactor = SoundDeviceFormFactor::Microphone;
+            usbMicrophones.NameContains = "usb";
+            DeviceQuery rareName;
+            rareName.NameContains = "#4242";
+            DeviceQuery defaultRender;
+            defaultRender.IsRenderDefault = true;
+
+            constexpr size_t queries = 200;
+            std::vector<DeviceTable::Handle> handles;
+            for (const auto & [label, query] : { std::pair{ "capture", capture }, std::pair{ "headphones", headphones },
+                std::pair{ "name contains USB", usb }, std::pair{ "USB microphones", usbMicrophones },
+                std::pair{ "rare name", rareName }, std::pair{ "default render", defaultRender } })
+            {
+                size_t scanned = 0;
+                const auto scan = MeasureNs(queries, [&]
+                    {
+                        for (size_t i = 0; i < queries; ++i)
+                        {
+                            scanned = Scan(table, query).size();
+                        }
+                    });
+                const auto indexed = MeasureNs(queries, [&]
+                    {
+                        for (size_t i = 0; i < queries; ++i)
+                        {
+                            table.Find(query, handles);
+                        }
+                    });
+                Assert::AreEqual(scanned, handles.size());
+                Logger::WriteMessage(std::format("{} devices, {}: {} matches, us per query: scan {:.1f}, index {:.1f}\n",
+                    device_count, label, handles.size(), scan / 1000, indexed / 1000).c_str());
+            }
+
+            // the upkeep of the index on the table's changes
+            const auto churn = MeasureNs(device_count, [&]
+                {
+                    for (size_t i = 0; i < device_count; ++i)
+                    {
+                        table.Erase(table.GetHandleAt(random() % table.GetSize()));
+                        table.Put(MakeDevice(device_count + i, random()));
+                    }
+                });
+            Assert::AreEqual(device_count, table.GetSize());
+            Logger::WriteMessage(std::format("{} devices: {:.0f} ns per removal and addition\n", device_count, churn).c_str());
+        }
+    };
+}
@@ -0,0 +1,220 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <format>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "DeviceStateColumns.h"
+#include "DeviceTable.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        using Columns = DeviceStateColumns;
+
+        SoundDevice MakeDevice(const std::string & pnpId, SoundDeviceFlowType flow, uint16_t renderVolume, uint16_t captureVolume)
+        {
+            return { pnpId, "Device " + pnpId, flow, renderVolume, captureVolume, false, false };
+        }
+
+        // Rows of random devices; about one in eight absent.
+        Columns MakeRandomColumns(std::mt19937 & random, size_t rowCount)
+        {
+            Columns columns;
+            for (size_t row = 0; row < rowCount; ++row)
+            {
+                if (random() % 8 == 0)
+                {
+                    continue;
+                }
+                SoundDevice device("", "", static_cast<SoundDeviceFlowType>(1 + random() % 3),
+                    static_cast<uint16_t>(random() % 1001), static_cast<uint16_t>(random() % 1001),
+                    random() % 2 == 0, random() % 2 == 0);
+                columns.Set(static_cast<Columns::Row>(row), device);
+            }
+            return columns;
+        }
+
+        // Changes some of the rows: a volume, a default role, the presence.
+        void Mutate(std::mt19937 & random, Columns & columns, size_t changeCount)
+        {
+            for (size_t i = 0; i < changeCount && columns.GetRowCount() > 0; ++i)
+            {
+                const auto row = static_cast<Columns::Row>(random() % columns.GetRowCount());
+                switch (random() % 5)
+                {
+                case 0:
+                    columns.Clear(row);
+                    break;
+                case 1:
+                    columns.Set(row, SoundDevice("", "", SoundDeviceFlowType::Render, 10, 0, false, false));
+                    break;
+                default:
+                    if (!columns.IsPresent(row))
+                    {
+                        break;
+                    }
+                    if (random() % 2 == 0)
+                    {
+                        columns.SetRenderVolume(row, static_cast<uint16_t>(random() % 1001));
+                    }
+                    else
+                    {
+                        columns.SetCaptureDefault(row, random() % 2 == 0);
+                    }
+                    break;
+                }
+            }
+        }
+
+        template <typename FunctionT>
+        double MeasureNsPerRow(size_t rowCount, int repetitions, FunctionT && function)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < repetitions; ++i)
+            {
+                function();
+            }
+            return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                / repetitions / static_cast<double>(rowCount);
+        }
+    }
+
+    TEST_CLASS(DeviceStateColumnsTests)
+    {
+        TEST_METHOD(DiffRecordsTest)
+        {
+            Columns before;
+            before.Set(0, MakeDevice("A", SoundDeviceFlowType::Render, 100, 0));
+            before.Set(1, MakeDevice("B", SoundDeviceFlowType::Capture, 0, 200));
+            before.Set(40, MakeDevice("C", SoundDeviceFlowType::Render, 300, 0));
+
+            auto after = before;
+            after.SetRenderVolume(0, 150);
+            after.SetRenderDefault(0, true);
+            after.Clear(1);
+            after.Set(100, MakeDevice("D", SoundDeviceFlowType::RenderAndCapture, 1, 2));
+            after.Set(40, MakeDevice("C", SoundDeviceFlowType::RenderAndCapture, 300, 0));
+
+            const auto changes = Columns::Diff(before, after);
+            Assert::AreEqual(static_cast<size_t>(4), changes.size());
+            Assert::AreEqual(0u, changes[0].Device);
+            Assert::AreEqual(static_cast<int>(Columns::change_render_volume | Columns::change_render_default), static_cast<int>(changes[0].Changes));
+            Assert::AreEqual(1u, changes[1].Device);
+            Assert::AreEqual(static_cast<int>(Columns::change_removed), static_cast<int>(changes[1].Changes));
+            Assert::AreEqual(40u, changes[2].Device);
+            Assert::AreEqual(static_cast<int>(Columns::change_flow), static_cast<int>(changes[2].Changes));
+            Assert::AreEqual(100u, changes[3].Device);
+            Assert::AreEqual(static_cast<int>(Columns::change_added), static_cast<int>(changes[3].Changes));
+
+            Assert::IsTrue(Columns::Diff(after, after).empty());
+        }
+
+        TEST_METHOD(TableMirrorsDevicesTest)
+        {
+            StringInterner pnpIds;
+            DeviceTable table(pnpIds);
+            const auto a = table.Put(MakeDevice("A", SoundDeviceFlowType::Render, 100, 0));
+            const auto b = table.Put(MakeDevice("B", SoundDeviceFlowType::Capture, 0, 200));
+            const auto before = table.GetStateColumns();
+
+            table.SetCaptureVolume(b, 250);
+            table.SetRenderDefault(a, true);
+            Assert::AreEqual(static_cast<uint16_t>(250), table.Find(b)->GetCurrentCaptureVolume());
+            Assert::IsTrue(table.Find(a)->IsRenderCurrentlyDefault());
+            table.Erase(a);
+
+            // the records are in the order of the handles, which is not the order of interning
+            auto changes = Columns::Diff(before, table.GetStateColumns());
+            Assert::AreEqual(static_cast<size_t>(2), changes.size());
+            if (changes[0].Device != a)
+            {
+                std::swap(changes[0], changes[1]);
+            }
+            Assert::AreEqual(a, changes[0].Device);
+            Assert::AreEqual(static_cast<int>(Columns::change_removed), static_cast<int>(changes[0].Changes));
+            Assert::AreEqual(b, changes[1].Device);
+            Assert::AreEqual(static_cast<int>(Columns::change_capture_volume), static_cast<int>(changes[1].Changes));
+        }
+
+        TEST_METHOD(BitmapFuzzTest)
+        {
+            std::mt19937 random(4);
+            for (int i = 0; i < 2'000; ++i)
+            {
+                const auto before = MakeRandomColumns(random, random() % 300);
+                auto after = random() % 4 == 0 ? MakeRandomColumns(random, random() % 300) : before;
+                Mutate(random, after, random() % 20);
+                Assert::IsTrue(Columns::ComputeChangeBitmapScalar(before, after) == Columns::ComputeChangeBitmap(before, after));
+            }
+        }
+
+        // The diff of the tree keyed by PnP id the collection used before, against the columns, with 1% of the rows changed.
+        TEST_METHOD(DiffBenchmark)
+        {
+            for (const size_t rowCount : { 100, 1'000, 10'000, 100'000 })
+            {
+                std::mt19937 random(static_cast<unsigned>(rowCount));
+                std::map<std::string, SoundDevice> treeBefore;
+                Columns before;
+                for (size_t row = 0; row < rowCount; ++row)
+                {
+                    const auto device = MakeDevice(std::format("{:08X}-0000-0000-0000-000000000000", random()), SoundDeviceFlowType::Render,
+                        static_cast<uint16_t>(random() % 1001), 0);
+                    treeBefore[device.GetPnpId()] = device;
+                    before.Set(static_cast<Columns::Row>(row), device);
+                }
+                auto treeAfter = treeBefore;
+                auto after = before;
+                for (size_t i = 0; i < rowCount / 100; ++i)
+                {
+                    const auto row = random() % rowCount;
+                    after.SetRenderVolume(static_cast<Columns::Row>(row), 1001);
+                    std::next(treeAfter.begin(), static_cast<ptrdiff_t>(random() % treeAfter.size()))->second.SetCurrentRenderVolume(1001);
+                }
+
+                const int repetitions = static_cast<int>(std::max<size_t>(10, 10'000'000 / rowCount));
+                size_t sink = 0;
+                const auto tree = MeasureNsPerRow(rowCount, repetitions / 10 + 1, [&]
+                    {
+                        std::vector<std::string> changed;
+                        for (const auto & [pnpId, device] : treeBefore)
+                        {
+                            if (const auto found = treeAfter.find(pnpId)
+                                ; found != treeAfter.end() && found->second.GetCurrentRenderVolume() != device.GetCurrentRenderVolume())
+                            {
+                                changed.push_back(pnpId);
+                            }
+                        }
+                        sink += changed.size();
+                    });
+                const auto scalar = MeasureNsPerRow(rowCount, repetitions, [&]
+                    {
+                        sink += Columns::ComputeChangeBitmapScalar(before, after).size();
+                    });
+                const auto bitmap = MeasureNsPerRow(rowCount, repetitions, [&]
+                    {
+                        sink += Columns::ComputeChangeBitmap(before, after).size();
+                    });
+                const auto records = MeasureNsPerRow(rowCount, repetitions, [&]
+                    {
+                        sink += Columns::Diff(before, after).size();
+                    });
+                Assert::IsTrue(sink > 0);
+
+                Logger::WriteMessage(std::format("{} rows, ns per row: tree {:.2f}, scalar bitmap {:.3f}, SSE2 bitmap {:.3f}, "
+                    "SSE2 diff with records {:.3f}\n", rowCount, tree, scalar, bitmap, records).c_str());
+            }
+        }
+    };
+}
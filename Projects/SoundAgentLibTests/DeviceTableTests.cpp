@@ -0,0 +1,204 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "DeviceTable.h"
+#include "IdentifierText.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        SoundDevice MakeDevice(const std::string & pnpId, uint16_t renderVolume)
+        {
+            return { pnpId, "Speakers " + pnpId.substr(0, 4), SoundDeviceFlowType::Render, renderVolume, 0, false, false };
+        }
+
+        // PnP ids as the collection makes them from container ids.
+        std::vector<std::string> MakePnpIds(size_t count, unsigned seed)
+        {
+            std::mt19937 random(seed);
+            std::vector<std::string> pnpIds;
+            for (size_t i = 0; i < count; ++i)
+            {
+                GUID guid{ static_cast<uint32_t>(random()), static_cast<uint16_t>(random()), static_cast<uint16_t>(random()), {} };
+                for (auto & byte : guid.Data4)
+                {
+                    byte = static_cast<uint8_t>(random());
+                }
+                pnpIds.push_back(IdentifierText::FormatGuid(guid));
+            }
+            return pnpIds;
+        }
+
+        template <typename FunctionT>
+        double MeasureNs(size_t operations, FunctionT && function)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            function();
+            return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                / static_cast<double>(operations);
+        }
+    }
+
+    TEST_CLASS(DeviceTableTests)
+    {
+        TEST_METHOD(PutFindEraseTest)
+        {
+            StringInterner pnpIds;
+            DeviceTable table(pnpIds);
+            const auto a = table.Put(MakeDevice("A", 100));
+            const auto b = table.Put(MakeDevice("B", 200));
+            const auto c = table.Put(MakeDevice("C", 300));
+            Assert::AreEqual(static_cast<size_t>(3), table.GetSize());
+
+            Assert::AreEqual(b, table.Put(MakeDevice("B", 250)), L"Replaced in place");
+            Assert::AreEqual(static_cast<size_t>(3), table.GetSize());
+            Assert::AreEqual(static_cast<uint16_t>(250), table.Find("B")->GetCurrentRenderVolume());
+
+            Assert::IsTrue(table.Erase(a));
+            Assert::IsFalse(table.Erase(a));
+            Assert::IsNull(table.Find(a));
+            Assert::AreEqual(static_cast<size_t>(2), table.GetSize());
+            Assert::AreEqual(c, table.GetHandleAt(0), L"The last device moved into the freed slot");
+            Assert::AreEqual(std::string("C"), table.GetAt(0).GetPnpId());
+            Assert::AreEqual(std::string("C"), table.Find(c)->GetPnpId());
+            Assert::AreEqual(std::string("B"), table.Find(b)->GetPnpId());
+
+            Assert::AreEqual(a, table.Put(MakeDevice("A", 100)), L"The handle of a PnP id does not change");
+            table.Clear();
+            Assert::AreEqual(static_cast<size_t>(0), table.GetSize());
+            Assert::IsNull(table.Find("B"));
+        }
+
+        TEST_METHOD(CopiesShareHandlesTest)
+        {
+            StringInterner pnpIds;
+            DeviceTable table(pnpIds);
+            const auto a = table.Put(MakeDevice("A", 100));
+            table.Put(MakeDevice("B", 200));
+
+            const auto copy = table;
+            table.Erase(a);
+            table.Put(MakeDevice("B", 300));
+
+            Assert::AreEqual(static_cast<uint16_t>(100), copy.Find(a)->GetCurrentRenderVolume());
+            Assert::AreEqual(static_cast<uint16_t>(200), copy.Find("B")->GetCurrentRenderVolume());
+            Assert::AreEqual(static_cast<uint16_t>(300), table.Find(*copy.FindHandle("B"))->GetCurrentRenderVolume());
+        }
+
+        TEST_METHOD(LookupDoesNotInternTest)
+        {
+            StringInterner pnpIds;
+            const DeviceTable table(pnpIds);
+            Assert::IsNull(table.Find("Unknown"));
+            Assert::IsFalse(table.FindHandle("Unknown").has_value());
+            Assert::AreEqual(static_cast<size_t>(0), pnpIds.GetSize());
+        }
+
+        // The tree keyed by PnP id the collection used before, against the table.
+        TEST_METHOD(LookupIndexRemovalBenchmark)
+        {
+            for (const size_t deviceCount : { 10, 100, 1'000, 10'000 })
+            {
+                const auto pnpIds = MakePnpIds(deviceCount, static_cast<unsigned>(deviceCount));
+                std::map<std::string, SoundDevice> tree;
+                StringInterner interner;
+                DeviceTable table(interner);
+                for (const auto & pnpId : pnpIds)
+                {
+                    tree[pnpId] = MakeDevice(pnpId, 500);
+                    table.Put(MakeDevice(pnpId, 500));
+                }
+                std::vector<DeviceTable::Handle> handles;
+                for (const auto & pnpId : pnpIds)
+                {
+                    handles.push_back(*table.FindHandle(pnpId));
+                }
+                std::mt19937 random(1);
+                std::vector<size_t> order(deviceCount);
+                for (size_t i = 0; i < deviceCount; ++i)
+                {
+                    order[i] = i;
+                }
+                std::ranges::shuffle(order, random);
+
+                const size_t lookups = std::max<size_t>(100'000, deviceCount * 10);
+                uint64_t sink = 0;
+                const auto treeLookup = MeasureNs(lookups, [&]
+                    {
+                        for (size_t i = 0; i < lookups; ++i)
+                        {
+                            sink += tree.find(pnpIds[order[i % deviceCount]])->second.GetCurrentRenderVolume();
+                        }
+                    });
+                const auto tableLookup = MeasureNs(lookups, [&]
+                    {
+                        for (size_t i = 0; i < lookups; ++i)
+                        {
+                            sink += table.Find(pnpIds[order[i % deviceCount]])->GetCurrentRenderVolume();
+                        }
+                    });
+                const auto handleLookup = MeasureNs(lookups, [&]
+                    {
+                        for (size_t i = 0; i < lookups; ++i)
+                        {
+                            sink += table.Find(handles[order[i % deviceCount]])->GetCurrentRenderVolume();
+                        }
+                    });
+
+                // as CreateItem(index) did: a walk of the tree
+                const size_t indexings = std::min<size_t>(lookups, 100'000'000 / deviceCount);
+                const auto treeIndex = MeasureNs(indexings, [&]
+                    {
+                        for (size_t i = 0; i < indexings; ++i)
+                        {
+                            sink += std::next(tree.begin(), static_cast<ptrdiff_t>(order[i % deviceCount]))->second.GetCurrentRenderVolume();
+                        }
+                    });
+                const auto tableIndex = MeasureNs(lookups, [&]
+                    {
+                        for (size_t i = 0; i < lookups; ++i)
+                        {
+                            sink += table.GetAt(order[i % deviceCount]).GetCurrentRenderVolume();
+                        }
+                    });
+
+                const auto treeRemoval = MeasureNs(deviceCount, [&]
+                    {
+                        for (const auto i : order)
+                        {
+                            tree.erase(pnpIds[i]);
+                        }
+                    });
+                const auto tableRemoval = MeasureNs(deviceCount, [&]
+                    {
+                        for (const auto i : order)
+                        {
+                            table.Erase(*table.FindHandle(pnpIds[i]));
+                        }
+                    });
+                Assert::IsTrue(tree.empty());
+                Assert::AreEqual(static_cast<size_t>(0), table.GetSize());
+                Assert::IsTrue(sink > 0);
+
+                Logger::WriteMessage(std::format(
+                    "{} devices, ns per operation, tree -> table: lookup {:.1f} -> {:.1f} (by handle {:.1f}), "
+                    "indexed access {:.1f} -> {:.1f}, removal {:.1f} -> {:.1f}\n",
+                    deviceCount, treeLookup, tableLookup, handleLookup, treeIndex, tableIndex, treeRemoval, tableRemoval).c_str());
+            }
+        }
+    };
+}
@@ -0,0 +1,177 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "EndpointSimulator.h"
+#include "SoundDeviceCollection.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        class RecordingObserver final : public SoundDeviceObserverInterface {
+        public:
+            RecordingObserver() = default;
+            DISALLOW_COPY_MOVE(RecordingObserver);
+            ~RecordingObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t) override
+            {
+                std::lock_guard lock(mutex_);
+                events_.emplace_back(event, devicePnpId);
+                changed_.notify_all();
+            }
+
+            // Waits for the next event, delivered on the dispatcher thread.
+            std::pair<SoundDeviceEventType, std::string> Next()
+            {
+                std::unique_lock lock(mutex_);
+                Assert::IsTrue(changed_.wait_for(lock, 5s, [this] { return next_ < events_.size(); }), L"Event expected");
+                return events_[next_++];
+            }
+
+        private:
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::vector<std::pair<SoundDeviceEventType, std::string>> events_;
+            size_t next_ = 0;
+        };
+    }
+
+    // The real collection over the simulated endpoint stack.
+    TEST_CLASS(EndpointSimulatorTests)
+    {
+        TEST_METHOD(AddSetDefaultVolumeRemoveTest)
+        {
+            EndpointSimulator simulator;
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            RecordingObserver observer;
+            collection.Subscribe(observer);
+
+            const auto speakers = EndpointSimulator::GetPnpIdOfContainer(L"speakers");
+            Assert::IsTrue(simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::Discovered, speakers));
+            Assert::AreEqual(static_cast<size_t>(1), collection.GetSize());
+
+            Assert::IsTrue(simulator.SetDefaultEndpoint(L"speakers"));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::DefaultRenderChanged, speakers));
+            Assert::IsTrue(collection.GetDefaultRenderDevicePnpId() == speakers);
+
+            Assert::IsTrue(simulator.SetVolume(L"speakers", 700));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::VolumeRenderChanged, speakers));
+            Assert::AreEqual(static_cast<uint16_t>(700), collection.CreateItem(speakers)->GetCurrentRenderVolume());
+
+            Assert::IsTrue(simulator.RemoveEndpoint(L"speakers"));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::Detached, speakers));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::DefaultRenderChanged, ""s));
+            Assert::AreEqual(static_cast<size_t>(0), collection.GetSize());
+            Assert::IsFalse(collection.GetDefaultRenderDevicePnpId().has_value());
+
+            Assert::IsFalse(simulator.RemoveEndpoint(L"speakers"), L"Already removed");
+            collection.Unsubscribe(observer, true);
+        }
+
+        TEST_METHOD(HistoryRecordsVolumesAndDefaultsTest)
+        {
+            EndpointSimulator simulator;
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            RecordingObserver observer;
+            collection.Subscribe(observer);
+            const auto from = std::chrono::system_clock::now() - 1s;
+
+            const auto speakers = EndpointSimulator::GetPnpIdOfContainer(L"speakers");
+            const auto headphones = EndpointSimulator::GetPnpIdOfContainer(L"headphones");
+            simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400);
+            simulator.SetDefaultEndpoint(L"speakers");
+            simulator.SetVolume(L"speakers", 700);
+            simulator.SetVolume(L"speakers", 0);
+            simulator.AddEndpoint(L"headphones", L"Headphones", eRender, 300);
+            simulator.SetDefaultEndpoint(L"headphones");
+            // the history is recorded before the observers are notified; the volume events of the speakers may be
+            // coalesced, so the last event is waited for rather than counted to
+            while (observer.Next() != std::pair(SoundDeviceEventType::DefaultRenderChanged, headphones))
+            {
+            }
+            collection.Unsubscribe(observer, true);
+
+            const auto values = [&collection, from](const std::string & pnpId, SoundDeviceHistoryKind kind)
+            {
+                std::vector<uint16_t> result;
+                for (const auto & sample : collection.GetHistory(pnpId, kind, from, std::chrono::system_clock::now() + 1h))
+                {
+                    result.push_back(sample.Value);
+                }
+                return result;
+            };
+            Assert::IsTrue(values(speakers, SoundDeviceHistoryKind::RenderVolume) == std::vector<uint16_t>{ 400, 700, 0 });
+            Assert::IsTrue(values(speakers, SoundDeviceHistoryKind::RenderDefault) == std::vector<uint16_t>{ 1, 0 });
+            Assert::IsTrue(values(headphones, SoundDeviceHistoryKind::RenderVolume) == std::vector<uint16_t>{ 300 });
+            Assert::IsTrue(values(headphones, SoundDeviceHistoryKind::RenderDefault) == std::vector<uint16_t>{ 1 });
+            Assert::IsTrue(values(speakers, SoundDeviceHistoryKind::CaptureVolume).empty());
+        }
+
+        TEST_METHOD(SharedContainerMergesEndpointsTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"headset-out", L"Headset", eRender, 300, L"headset");
+            simulator.AddEndpoint(L"headset-in", L"Headset", eCapture, 600, L"headset");
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+
+            Assert::AreEqual(static_cast<size_t>(1), collection.GetSize());
+            const auto device = collection.CreateItem(EndpointSimulator::GetPnpIdOfContainer(L"headset"));
+            Assert::IsNotNull(device.get());
+            Assert::IsTrue(device->GetFlow() == SoundDeviceFlowType::RenderAndCapture);
+            Assert::AreEqual(static_cast<uint16_t>(300), device->GetCurrentRenderVolume());
+            Assert::AreEqual(static_cast<uint16_t>(600), device->GetCurrentCaptureVolume());
+        }
+
+        TEST_METHOD(FindDevicesTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"speakers", L"Speakers (USB Audio)", eRender, 400);
+            simulator.AddEndpoint(L"monitor", L"Monitor Speakers", eRender, 500);
+            simulator.AddEndpoint(L"microphone", L"Microphone (USB Audio)", eCapture, 600);
+            simulator.SetDefaultEndpoint(L"monitor");
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+
+            std::vector<std::string> names;
+            const auto collect = [&names](const SoundDevice & device) { names.emplace_back(device.GetName()); };
+
+            DeviceQuery usb;
+            usb.NameContains = "usb";
+            Assert::AreEqual(static_cast<size_t>(2), collection.FindDevices(usb, collect));
+            Assert::AreEqual(static_cast<size_t>(2), names.size());
+
+            names.clear();
+            DeviceQuery microphones;
+            microphones.Captures = true;
+            microphones.FormFactor = SoundDeviceFormFactor::Microphone;
+            collection.FindDevices(microphones, collect);
+            Assert::IsTrue(names == std::vector{ "Microphone (USB Audio)"s });
+
+            names.clear();
+            DeviceQuery defaultRender;
+            defaultRender.IsRenderDefault = true;
+            defaultRender.FormFactor = SoundDeviceFormFactor::Speakers;
+            collection.FindDevices(defaultRender, collect);
+            Assert::IsTrue(names == std::vector{ "Monitor Speakers"s });
+
+            simulator.RemoveEndpoint(L"monitor");
+            collection.ResetContent();
+            Assert::AreEqual(static_cast<size_t>(0), collection.FindDevices(defaultRender, collect));
+        }
+    };
+}
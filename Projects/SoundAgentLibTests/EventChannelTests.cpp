@@ -0,0 +1,396 @@
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <format>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "EndpointSimulator.h"
+#include "EventChannel.h"
+#include "SoundDeviceCollection.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        // A coroutine nobody waits for; it destroys itself when done.
+        struct DetachedTask {
+            struct promise_type {
+                DetachedTask get_return_object() { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+
+        // Resumes the queued coroutines when told to, on the calling thread.
+        class ManualExecutor {
+        public:
+            EventChannel::ExecutorT Get()
+            {
+                return [this](std::coroutine_handle<> handle) { queue_.push_back(handle); };
+            }
+
+            size_t RunAll()
+            {
+                size_t count = 0;
+                while (!queue_.empty())
+                {
+                    const auto handle = queue_.front();
+                    queue_.pop_front();
+                    handle.resume();
+                    ++count;
+                }
+                return count;
+            }
+
+        private:
+            std::deque<std::coroutine_handle<>> queue_;
+        };
+
+        class ThreadPoolExecutor {
+        public:
+            explicit ThreadPoolExecutor(size_t threadCount)
+            {
+                for (size_t i = 0; i < threadCount; ++i)
+                {
+                    threads_.emplace_back([this] { Run(); });
+                }
+            }
+
+            ~ThreadPoolExecutor()
+            {
+                {
+                    std::lock_guard lock(mutex_);
+                    stopRequested_ = true;
+                }
+                wakeUp_.notify_all();
+                for (auto & thread : threads_)
+                {
+                    thread.join();
+                }
+            }
+
+            EventChannel::ExecutorT Get()
+            {
+                return [this](std::coroutine_handle<> handle)
+                {
+                    {
+                        std::lock_guard lock(mutex_);
+                        queue_.push_back(handle);
+                    }
+                    wakeUp_.notify_one();
+                };
+            }
+
+        private:
+            void Run()
+            {
+                std::unique_lock lock(mutex_);
+                for (;;)
+                {
+                    wakeUp_.wait(lock, [this] { return stopRequested_ || !queue_.empty(); });
+                    if (queue_.empty())
+                    {
+                        return;
+                    }
+                    const auto handle = queue_.front();
+                    queue_.pop_front();
+                    lock.unlock();
+                    handle.resume();
+                    lock.lock();
+                }
+            }
+
+            std::mutex mutex_;
+            std::condition_variable wakeUp_;
+            std::deque<std::coroutine_handle<>> queue_;
+            bool stopRequested_ = false;
+            std::vector<std::thread> threads_;
+        };
+
+        DetachedTask ReceiveEvents(EventChannel::Consumer & consumer, size_t count, std::vector<SoundDeviceEvent> & events)
+        {
+            while (events.size() < count)
+            {
+                events.push_back(co_await consumer.NextEvent());
+            }
+        }
+
+        DetachedTask ReceiveChangeSets(EventChannel::Consumer & consumer, size_t count, std::vector<std::vector<SoundDeviceEvent>> & changeSets)
+        {
+            auto generator = consumer.ChangeSets();
+            while (changeSets.size() < count && co_await generator.Next())
+            {
+                changeSets.push_back(std::move(generator.Current()));
+            }
+        }
+
+        DetachedTask CountEvents(EventChannel::Consumer & consumer, uint64_t count, std::latch & done)
+        {
+            uint64_t received = 0;
+            while (received < count)
+            {
+                received += (co_await consumer.NextChangeSet()).size();
+            }
+            done.count_down();
+        }
+
+        // What an observer with a thread of its own does: queue the events for its thread.
+        class ThreadObserver final : public SoundDeviceObserverInterface {
+        public:
+            ThreadObserver(uint64_t count, std::latch & done)
+                : thread_([this, count, &done] { Run(count, done); })
+            {
+            }
+
+            DISALLOW_COPY_MOVE(ThreadObserver);
+            ~ThreadObserver() override { thread_.join(); }
+
+            void OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t stateVersion) override
+            {
+                {
+                    std::lock_guard lock(mutex_);
+                    queue_.push_back({ event, devicePnpId, stateVersion });
+                }
+                wakeUp_.notify_one();
+            }
+
+        private:
+            void Run(uint64_t count, std::latch & done)
+            {
+                uint64_t received = 0;
+                std::unique_lock lock(mutex_);
+                while (received < count)
+                {
+                    wakeUp_.wait(lock, [this] { return !queue_.empty(); });
+                    received += queue_.size();
+                    queue_.clear();
+                }
+                done.count_down();
+            }
+
+            std::mutex mutex_;
+            std::condition_variable wakeUp_;
+            std::deque<SoundDeviceEvent> queue_;
+            std::thread thread_;
+        };
+
+        const auto speakers = "{0.0.0.00000000}.{5B7BBF93-1CE3-7A17-DC7A-432D3575AF01}"s;
+        const auto microphone = "{0.0.1.00000000}.{5B7BBF93-1CE3-7A17-DC7A-432D3575AF02}"s;
+    }
+
+    TEST_CLASS(EventChannelTests)
+    {
+        TEST_METHOD(NextEventResumesOnExecutorTest)
+        {
+            EventChannel channel(16);
+            ManualExecutor executor;
+            const auto consumer = channel.Connect(executor.Get());
+            std::vector<SoundDeviceEvent> events;
+            ReceiveEvents(*consumer, 3, events);
+            Assert::IsTrue(events.empty());
+
+            channel.OnCollectionChanged(SoundDeviceEventType::Discovered, speakers, 1);
+            Assert::IsTrue(events.empty(), L"Resumed by the executor only");
+            Assert::AreEqual(static_cast<size_t>(1), executor.RunAll());
+            Assert::AreEqual(static_cast<size_t>(1), events.size());
+
+            channel.OnCollectionChanged(SoundDeviceEventType::DefaultRenderChanged, speakers, 2);
+            channel.OnCollectionChanged(SoundDeviceEventType::DefaultCaptureChanged, "", 3);
+            Assert::AreEqual(static_cast<size_t>(1), executor.RunAll(), L"The second event is read without suspending");
+
+            Assert::AreEqual(static_cast<size_t>(3), events.size());
+            Assert::IsTrue(events[0].Type == SoundDeviceEventType::Discovered);
+            Assert::AreEqual(speakers, events[0].DevicePnpId);
+            Assert::AreEqual(static_cast<uint64_t>(1), events[0].StateVersion);
+            Assert::IsTrue(events[1].Type == SoundDeviceEventType::DefaultRenderChanged);
+            Assert::IsTrue(events[2].Type == SoundDeviceEventType::DefaultCaptureChanged);
+            Assert::AreEqual(""s, events[2].DevicePnpId);
+            Assert::AreEqual(static_cast<uint64_t>(3), consumer->GetStatistics().Received);
+        }
+
+        TEST_METHOD(ConsumersReadIndependentlyTest)
+        {
+            EventChannel channel(16);
+            ManualExecutor executor;
+            const auto early = channel.Connect(executor.Get());
+            channel.OnCollectionChanged(SoundDeviceEventType::Discovered, speakers, 1);
+            const auto late = channel.Connect(executor.Get());
+            channel.OnCollectionChanged(SoundDeviceEventType::Discovered, microphone, 2);
+
+            std::vector<SoundDeviceEvent> earlyEvents;
+            std::vector<SoundDeviceEvent> lateEvents;
+            ReceiveEvents(*early, 2, earlyEvents);
+            ReceiveEvents(*late, 1, lateEvents);
+            Assert::AreEqual(static_cast<size_t>(0), executor.RunAll(), L"Published before: no suspension");
+
+            Assert::AreEqual(static_cast<size_t>(2), earlyEvents.size());
+            Assert::AreEqual(speakers, earlyEvents[0].DevicePnpId);
+            Assert::AreEqual(static_cast<size_t>(1), lateEvents.size());
+            Assert::AreEqual(microphone, lateEvents[0].DevicePnpId);
+        }
+
+        TEST_METHOD(OverrunGivesContentResetTest)
+        {
+            EventChannel channel(8);
+            ManualExecutor executor;
+            const auto consumer = channel.Connect(executor.Get());
+            for (uint64_t version = 1; version <= 20; ++version)
+            {
+                channel.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, speakers, version);
+            }
+
+            std::vector<SoundDeviceEvent> events;
+            ReceiveEvents(*consumer, 1, events);
+            Assert::IsTrue(events[0].Type == SoundDeviceEventType::ContentReset);
+            Assert::AreEqual(static_cast<uint64_t>(20), events[0].StateVersion);
+            Assert::AreEqual(static_cast<uint64_t>(1), consumer->GetStatistics().Overruns);
+
+            // caught up: reads on from the newest event
+            channel.OnCollectionChanged(SoundDeviceEventType::Detached, speakers, 21);
+            ReceiveEvents(*consumer, 2, events);
+            Assert::IsTrue(events[1].Type == SoundDeviceEventType::Detached);
+            Assert::AreEqual(static_cast<uint64_t>(1), consumer->GetStatistics().Received);
+        }
+
+        TEST_METHOD(ChangeSetGeneratorTest)
+        {
+            EventChannel channel(64);
+            ManualExecutor executor;
+            const auto consumer = channel.Connect(executor.Get());
+            std::vector<std::vector<SoundDeviceEvent>> changeSets;
+            ReceiveChangeSets(*consumer, 2, changeSets);
+
+            for (uint64_t version = 1; version <= 5; ++version)
+            {
+                channel.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, speakers, version);
+            }
+            executor.RunAll();
+            Assert::AreEqual(static_cast<size_t>(1), changeSets.size());
+            Assert::AreEqual(static_cast<size_t>(5), changeSets[0].size(), L"One change set of all events there were");
+            Assert::AreEqual(static_cast<uint64_t>(5), changeSets[0].back().StateVersion);
+
+            channel.OnCollectionChanged(SoundDeviceEventType::Detached, speakers, 6);
+            executor.RunAll();
+            Assert::AreEqual(static_cast<size_t>(2), changeSets.size());
+            Assert::AreEqual(static_cast<size_t>(1), changeSets[1].size());
+        }
+
+        TEST_METHOD(CollectionEventsTest)
+        {
+            EndpointSimulator simulator;
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            EventChannel channel(256);
+            collection.Subscribe(channel);
+            std::vector<SoundDeviceEvent> events;
+            {
+                ThreadPoolExecutor executor(2);
+                const auto consumer = channel.Connect(executor.Get());
+                std::latch done(1);
+                [](EventChannel::Consumer & c, std::vector<SoundDeviceEvent> & received, std::latch & finished) -> DetachedTask
+                {
+                    while (received.size() < 2)
+                    {
+                        received.push_back(co_await c.NextEvent());
+                    }
+                    finished.count_down();
+                }(*consumer, events, done);
+
+                simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400);
+                simulator.SetDefaultEndpoint(L"speakers");
+                done.wait();
+            }
+            collection.Unsubscribe(channel, true);
+
+            const auto speakersPnpId = EndpointSimulator::GetPnpIdOfContainer(L"speakers");
+            Assert::IsTrue(events[0].Type == SoundDeviceEventType::Discovered);
+            Assert::AreEqual(speakersPnpId, events[0].DevicePnpId);
+            Assert::IsTrue(events[1].Type == SoundDeviceEventType::DefaultRenderChanged);
+            Assert::AreEqual(collection.GetStateVersion(), events[1].StateVersion);
+        }
+
+        TEST_METHOD(TenThousandConsumersBenchmark)
+        {
+            constexpr size_t coroutineCount = 10'000;
+            constexpr uint64_t eventCount = 1'000;
+            EventChannel channel(2 * eventCount);
+
+            std::chrono::steady_clock::duration coroutineTime;
+            {
+                ThreadPoolExecutor executor(4);
+                std::vector<std::unique_ptr<EventChannel::Consumer>> consumers;
+                std::latch done(coroutineCount);
+                for (size_t i = 0; i < coroutineCount; ++i)
+                {
+                    consumers.push_back(channel.Connect(executor.Get()));
+                    CountEvents(*consumers.back(), eventCount, done);
+                }
+
+                const auto start = std::chrono::steady_clock::now();
+                for (uint64_t version = 1; version <= eventCount; ++version)
+                {
+                    channel.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, version % 2 == 0 ? speakers : microphone, version);
+                }
+                done.wait();
+                coroutineTime = std::chrono::steady_clock::now() - start;
+
+                for (const auto & consumer : consumers)
+                {
+                    Assert::AreEqual(eventCount, consumer->GetStatistics().Received);
+                    Assert::AreEqual(static_cast<uint64_t>(0), consumer->GetStatistics().Overruns);
+                }
+            }
+
+            // The same with a thread per observer, at a tenth of the consumers: 10k threads would measure the OS.
+            constexpr size_t threadCount = coroutineCount / 10;
+            std::chrono::steady_clock::duration threadTime;
+            {
+                std::latch done(threadCount);
+                std::vector<std::unique_ptr<ThreadObserver>> observers;
+                for (size_t i = 0; i < threadCount; ++i)
+                {
+                    observers.push_back(std::make_unique<ThreadObserver>(eventCount, done));
+                }
+
+                const auto start = std::chrono::steady_clock::now();
+                for (uint64_t version = 1; version <= eventCount; ++version)
+                {
+                    for (const auto & observer : observers)
+                    {
+                        observer->OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, version % 2 == 0 ? speakers : microphone, version);
+                    }
+                }
+                done.wait();
+                threadTime = std::chrono::steady_clock::now() - start;
+            }
+
+            const auto nanosecondsPerDelivery = [](std::chrono::steady_clock::duration time, size_t consumerCount)
+            {
+                return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count())
+                    / static_cast<double>(consumerCount * eventCount);
+            };
+            Logger::WriteMessage(std::format("{} coroutine consumers on 4 threads: {} ms, {:.1f} ns per event and consumer\n",
+                coroutineCount, std::chrono::duration_cast<std::chrono::milliseconds>(coroutineTime).count(),
+                nanosecondsPerDelivery(coroutineTime, coroutineCount)).c_str());
+            Logger::WriteMessage(std::format("{} observers with a thread each: {} ms, {:.1f} ns per event and consumer\n",
+                threadCount, std::chrono::duration_cast<std::chrono::milliseconds>(threadTime).count(),
+                nanosecondsPerDelivery(threadTime, threadCount)).c_str());
+        }
+    };
+}
@@ -0,0 +1,307 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include <CppUnitTest.h>
+
+#include "BlockCompressor.h"
+#include "EventSpool.h"
+#include "SpoolUploader.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        // A spool directory of its own, removed afterwards.
+        class SpoolDirectory {
+        public:
+            explicit SpoolDirectory(const std::string & name)
+                : path_(std::filesystem::temp_directory_path() / std::format("SoundAgentLibTests-{}-{}", name,
+                    std::chrono::steady_clock::now().time_since_epoch().count()))
+            {
+            }
+
+            ~SpoolDirectory()
+            {
+                std::error_code ignored;
+                std::filesystem::remove_all(path_, ignored);
+            }
+
+            [[nodiscard]] const std::filesystem::path & GetPath() const { return path_; }
+
+            [[nodiscard]] size_t CountFiles(const std::string & extension) const
+            {
+                size_t count = 0;
+                for (const auto & entry : std::filesystem::directory_iterator(path_))
+                {
+                    count += entry.path().extension() == extension ? 1 : 0;
+                }
+                return count;
+            }
+
+        private:
+            const std::filesystem::path path_;
+        };
+
+        const auto start_time = std::chrono::system_clock::time_point(std::chrono::milliseconds(1'760'000'000'000));
+
+        // The events of a busy agent: mostly volume changes of a few devices, a few ms apart.
+        uint64_t AppendEvents(EventSpool & spool, uint64_t first, uint64_t count)
+        {
+            uint64_t last = 0;
+            for (uint64_t i = first; i < first + count; ++i)
+            {
+                const auto pnpId = std::format("{{0.0.0.00000000}}.{{5B7BBF93-1CE3-7A17-DC7A-432D3575AF{:02X}}}", i % 5);
+                last = spool.Append(i % 50 == 0 ? SoundDeviceEventType::DefaultRenderChanged : SoundDeviceEventType::VolumeRenderChanged,
+                    pnpId, static_cast<uint16_t>(i % 1001), start_time + std::chrono::milliseconds(i * 7));
+            }
+            return last;
+        }
+
+        void CheckEvents(const std::vector<EventSpool::Record> & records, uint64_t firstSequence)
+        {
+            for (size_t n = 0; n < records.size(); ++n)
+            {
+                const auto & record = records[n];
+                const auto i = firstSequence + n;
+                Assert::AreEqual(i, record.Sequence);
+                Assert::AreEqual(std::format("{{0.0.0.00000000}}.{{5B7BBF93-1CE3-7A17-DC7A-432D3575AF{:02X}}}", i % 5), record.PnpId);
+                Assert::AreEqual(static_cast<uint16_t>(i % 1001), record.Volume);
+                Assert::IsTrue((i % 50 == 0 ? SoundDeviceEventType::DefaultRenderChanged : SoundDeviceEventType::VolumeRenderChanged) == record.Event);
+                Assert::IsTrue(start_time + std::chrono::milliseconds(i * 7) == record.Time);
+            }
+        }
+
+        // Stands in for the collector: takes batches in order, one record once, unless it is switched off.
+        class StandInCollector {
+        public:
+            std::optional<uint64_t> Receive(const std::vector<EventSpool::Record> & batch)
+            {
+                std::lock_guard lock(mutex_);
+                if (!reachable_)
+                {
+                    return std::nullopt;
+                }
+                for (const auto & record : batch)
+                {
+                    if (record.Sequence == lastSequence_ + 1)
+                    {
+                        sequences_.push_back(record.Sequence);
+                        lastSequence_ = record.Sequence;
+                    }
+                    else if (record.Sequence > lastSequence_)
+                    {
+                        ++gaps_;
+                    }
+                }
+                return lastSequence_;
+            }
+
+            void SetReachable(bool reachable)
+            {
+                std::lock_guard lock(mutex_);
+                reachable_ = reachable;
+            }
+
+            bool WaitFor(uint64_t sequence, std::chrono::milliseconds timeout)
+            {
+                for (const auto deadline = std::chrono::steady_clock::now() + timeout; std::chrono::steady_clock::now() < deadline;)
+                {
+                    {
+                        std::lock_guard lock(mutex_);
+                        if (lastSequence_ >= sequence)
+                        {
+                            return true;
+                        }
+                    }
+                    std::this_thread::sleep_for(5ms);
+                }
+                return false;
+            }
+
+            [[nodiscard]] size_t GetReceivedCount() const { std::lock_guard lock(mutex_); return sequences_.size(); }
+            [[nodiscard]] size_t GetGaps() const { std::lock_guard lock(mutex_); return gaps_; }
+
+        private:
+            mutable std::mutex mutex_;
+            bool reachable_ = true;
+            uint64_t lastSequence_ = 0;
+            std::vector<uint64_t> sequences_;
+            size_t gaps_ = 0;
+        };
+    }
+
+    TEST_CLASS(EventSpoolTests)
+    {
+        TEST_METHOD(BlockCompressorTest)
+        {
+            std::mt19937 random(7);
+            std::string noise(100'000, '\0');
+            for (auto & c : noise)
+            {
+                c = static_cast<char>(random());
+            }
+            std::string text;
+            while (text.size() < 200'000)
+            {
+                text += std::format("Speakers (High Definition Audio Device) volume {}; ", random() % 1001);
+            }
+
+            for (const auto & input : { ""s, "abc"s, std::string(70'000, 'x'), noise, text })
+            {
+                std::string compressed;
+                BlockCompressor::Compress(input, compressed);
+                std::string output;
+                BlockCompressor::Decompress(compressed, output);
+                Assert::IsTrue(input == output);
+            }
+
+            std::string compressed;
+            BlockCompressor::Compress(text, compressed);
+            Assert::IsTrue(compressed.size() < text.size() / 4, L"Repetitive text compresses well");
+            compressed[20] = static_cast<char>(~compressed[20]);
+            compressed.resize(compressed.size() - 3);
+            std::string output;
+            Assert::ExpectException<std::runtime_error>([&compressed, &output] { BlockCompressor::Decompress(compressed, output); });
+        }
+
+        TEST_METHOD(AppendReadAcrossRestartTest)
+        {
+            SpoolDirectory directory("restart");
+            const EventSpool::Options options{ .SegmentBytes = 4096, .MaxSealedSegments = 1000 };
+            {
+                EventSpool spool(directory.GetPath(), options);
+                Assert::AreEqual(static_cast<uint64_t>(0), spool.GetLastSequence());
+                Assert::AreEqual(static_cast<uint64_t>(2000), AppendEvents(spool, 1, 2000));
+                Assert::IsTrue(spool.GetStatistics().SegmentsSealed > 2);
+                CheckEvents(spool.Read(0, 5000), 1);
+                CheckEvents(spool.Read(1234, 10), 1235);
+            }
+            Assert::AreEqual(static_cast<size_t>(1), directory.CountFiles(".open"));
+
+            // the process restarts: everything is still there
+            {
+                EventSpool spool(directory.GetPath(), options);
+                Assert::AreEqual(static_cast<uint64_t>(2000), spool.GetLastSequence());
+                const auto records = spool.Read(0, 5000);
+                Assert::AreEqual(static_cast<size_t>(2000), records.size());
+                CheckEvents(records, 1);
+
+                const auto sealedBefore = directory.CountFiles(".sealed");
+                spool.Acknowledge(1500);
+                Assert::IsTrue(directory.CountFiles(".sealed") < sealedBefore, L"Acknowledged segments are deleted");
+                Assert::AreEqual(static_cast<uint64_t>(2001), AppendEvents(spool, 2001, 1));
+            }
+
+            // and once more: reading resumes behind the acknowledged sequence
+            {
+                EventSpool spool(directory.GetPath(), options);
+                Assert::AreEqual(static_cast<uint64_t>(1500), spool.GetAcknowledged());
+                const auto records = spool.Read(spool.GetAcknowledged(), 5000);
+                Assert::AreEqual(static_cast<size_t>(501), records.size());
+                CheckEvents(records, 1501);
+
+                // acknowledged in full, the sequence still goes on
+                spool.Acknowledge(2001);
+            }
+            {
+                EventSpool spool(directory.GetPath(), options);
+                Assert::AreEqual(static_cast<size_t>(0), directory.CountFiles(".sealed"));
+                Assert::AreEqual(static_cast<uint64_t>(2002), AppendEvents(spool, 2002, 1));
+            }
+        }
+
+        TEST_METHOD(OverflowDropsOldestTest)
+        {
+            SpoolDirectory directory("overflow");
+            EventSpool spool(directory.GetPath(), { .SegmentBytes = 4096, .MaxSealedSegments = 2 });
+            AppendEvents(spool, 1, 5000);
+            const auto statistics = spool.GetStatistics();
+            Assert::IsTrue(statistics.SegmentsDropped > 0);
+            Assert::AreEqual(static_cast<size_t>(2), directory.CountFiles(".sealed"));
+
+            // reading starts with the oldest record kept
+            const auto records = spool.Read(0, 10'000);
+            Assert::AreEqual(5000 - statistics.RecordsDropped, static_cast<uint64_t>(records.size()));
+            CheckEvents(records, statistics.RecordsDropped + 1);
+        }
+
+        TEST_METHOD(UploadResumesAfterOutageTest)
+        {
+            SpoolDirectory directory("upload");
+            const EventSpool::Options spoolOptions{ .SegmentBytes = 8192 };
+            const SpoolUploader::Options uploaderOptions{ .BatchRecords = 100, .PollInterval = 20ms,
+                .InitialRetryDelay = 5ms, .MaxRetryDelay = 20ms };
+            StandInCollector collector;
+            const auto upload = [&collector](const std::vector<EventSpool::Record> & batch) { return collector.Receive(batch); };
+
+            collector.SetReachable(false);
+            {
+                EventSpool spool(directory.GetPath(), spoolOptions);
+                SpoolUploader uploader(spool, upload, uploaderOptions);
+                AppendEvents(spool, 1, 1000);
+                uploader.Notify();
+                std::this_thread::sleep_for(100ms);
+                Assert::IsTrue(uploader.GetStatistics().FailedUploads > 0);
+                Assert::AreEqual(static_cast<uint64_t>(0), spool.GetAcknowledged());
+
+                // the collector comes back
+                collector.SetReachable(true);
+                Assert::IsTrue(collector.WaitFor(1000, 5s));
+                Assert::AreEqual(static_cast<uint64_t>(1000), uploader.GetStatistics().RecordsAcknowledged);
+
+                // the agent stops with records not yet uploaded
+                collector.SetReachable(false);
+                AppendEvents(spool, 1001, 500);
+            }
+
+            // after the restart the upload goes on behind the acknowledged records
+            collector.SetReachable(true);
+            {
+                EventSpool spool(directory.GetPath(), spoolOptions);
+                SpoolUploader uploader(spool, upload, uploaderOptions);
+                Assert::IsTrue(collector.WaitFor(1500, 5s));
+                Assert::AreEqual(static_cast<uint64_t>(500), uploader.GetStatistics().RecordsAcknowledged);
+            }
+            Assert::AreEqual(static_cast<size_t>(1500), collector.GetReceivedCount());
+            Assert::AreEqual(static_cast<size_t>(0), collector.GetGaps());
+        }
+
+        TEST_METHOD(AppendAndReplayThroughputTest)
+        {
+            constexpr uint64_t recordCount = 500'000;
+            SpoolDirectory directory("throughput");
+            EventSpool spool(directory.GetPath(), {});
+
+            auto start = std::chrono::steady_clock::now();
+            AppendEvents(spool, 1, recordCount);
+            const auto appendSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const auto statistics = spool.GetStatistics();
+
+            start = std::chrono::steady_clock::now();
+            uint64_t replayed = 0;
+            for (auto records = spool.Read(0, 10'000); !records.empty(); records = spool.Read(records.back().Sequence, 10'000))
+            {
+                replayed += records.size();
+            }
+            const auto replaySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            Logger::WriteMessage(std::format("{} records: {:.0f} appends/s, {:.0f} records/s replayed; {} segments sealed, "
+                "{:.1f} MB of records compressed {:.1f}x\n",
+                recordCount, recordCount / appendSeconds, replayed / replaySeconds, statistics.SegmentsSealed,
+                static_cast<double>(statistics.RawBytesSealed) / 1e6,
+                static_cast<double>(statistics.RawBytesSealed) / static_cast<double>(statistics.CompressedBytesSealed)).c_str());
+            Assert::AreEqual(recordCount, replayed);
+        }
+    };
+}
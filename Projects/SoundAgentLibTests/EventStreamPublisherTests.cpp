@@ -0,0 +1,329 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fcntl.h>
+#include <format>
+#include <io.h>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <CppUnitTest.h>
+
+#include "BinaryEventCodec.h"
+#include "EventStreamPublisher.h"
+#include "FixedCollection.h"
+#include "SoundDevice.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        // Collects what a client receives; its sends can be held back to make it lag.
+        class TestClient {
+        public:
+            EventStreamPublisher::SendFunctionT SendFunction()
+            {
+                return [this](std::string_view bytes)
+                {
+                    std::unique_lock lock(mutex_);
+                    changed_.wait(lock, [this] { return !held_ || aborted_; });
+                    if (aborted_)
+                    {
+                        return false;
+                    }
+                    received_.append(bytes);
+                    changed_.notify_all();
+                    return true;
+                };
+            }
+
+            EventStreamPublisher::AbortFunctionT AbortFunction()
+            {
+                return [this]
+                {
+                    std::lock_guard lock(mutex_);
+                    aborted_ = true;
+                    changed_.notify_all();
+                };
+            }
+
+            void Hold(bool held)
+            {
+                std::lock_guard lock(mutex_);
+                held_ = held;
+                changed_.notify_all();
+            }
+
+            // Waits until a frame with the state version arrived; returns all frames received.
+            std::vector<BinaryEventCodec::Frame> WaitForVersion(uint64_t stateVersion)
+            {
+                std::vector<BinaryEventCodec::Frame> frames;
+                std::unique_lock lock(mutex_);
+                const bool arrived = changed_.wait_for(lock, 5s, [&]
+                {
+                    frames = Decode(received_);
+                    return !frames.empty() && frames.back().StateVersion >= stateVersion;
+                });
+                Assert::IsTrue(arrived, L"Frame expected");
+                return frames;
+            }
+
+            [[nodiscard]] bool IsAborted()
+            {
+                std::lock_guard lock(mutex_);
+                return aborted_;
+            }
+
+            static std::vector<BinaryEventCodec::Frame> Decode(std::string_view bytes)
+            {
+                std::vector<BinaryEventCodec::Frame> frames;
+                BinaryEventCodec::Frame frame;
+                for (size_t size; (size = BinaryEventCodec::DecodeFrame(bytes, frame)) != 0; bytes.remove_prefix(size))
+                {
+                    frames.push_back(frame);
+                }
+                Assert::IsTrue(bytes.empty(), L"Only complete frames expected");
+                return frames;
+            }
+
+        private:
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::string received_;
+            bool held_ = false;
+            bool aborted_ = false;
+        };
+
+        SoundDevice CreateSpeakers()
+        {
+            return SoundDevice("A", "Speakers", SoundDeviceFlowType::Render, 500, 0, true, false);
+        }
+    }
+
+    TEST_CLASS(EventStreamPublisherTests)
+    {
+        TEST_METHOD(CodecRoundTripTest)
+        {
+            FixedCollection collection;
+            collection.Add(CreateSpeakers());
+            collection.Add(SoundDevice("B", "Mic \"\xC3\xA4\"", SoundDeviceFlowType::Capture, 0, 300, false, false));
+            collection.SetDefaultRender("A"s);
+            collection.SetStateVersion(41);
+
+            std::string bytes;
+            BinaryEventCodec::AppendSnapshotFrame(bytes, collection.CreateSnapshot());
+            const auto device = collection.CreateItem("B"s);
+            BinaryEventCodec::AppendEventFrame(bytes, SoundDeviceEventType::VolumeCaptureChanged, "B", 42, device.get());
+            BinaryEventCodec::AppendEventFrame(bytes, SoundDeviceEventType::Detached, "A", 43, nullptr);
+
+            const auto frames = TestClient::Decode(bytes);
+            Assert::AreEqual(static_cast<size_t>(3), frames.size());
+
+            Assert::IsTrue(frames[0].Type == BinaryEventCodec::FrameType::Snapshot);
+            Assert::AreEqual(static_cast<uint64_t>(41), frames[0].StateVersion);
+            Assert::AreEqual("A"s, frames[0].DefaultRenderDevicePnpId);
+            Assert::AreEqual(""s, frames[0].DefaultCaptureDevicePnpId);
+            Assert::AreEqual(static_cast<size_t>(2), frames[0].Devices.size());
+            Assert::AreEqual("Mic \"\xC3\xA4\""s, frames[0].Devices[1].Name);
+
+            Assert::IsTrue(frames[1].Type == BinaryEventCodec::FrameType::Event);
+            Assert::IsTrue(frames[1].Event == SoundDeviceEventType::VolumeCaptureChanged);
+            Assert::AreEqual(static_cast<uint64_t>(42), frames[1].StateVersion);
+            Assert::AreEqual(static_cast<size_t>(1), frames[1].Devices.size());
+            Assert::IsTrue(frames[1].Devices[0].Flow == SoundDeviceFlowType::Capture);
+            Assert::AreEqual(static_cast<uint16_t>(300), frames[1].Devices[0].CaptureVolume);
+
+            Assert::IsTrue(frames[2].Event == SoundDeviceEventType::Detached);
+            Assert::AreEqual("A"s, frames[2].DevicePnpId);
+            Assert::IsTrue(frames[2].Devices.empty());
+
+            BinaryEventCodec::Frame frame;
+            Assert::AreEqual(static_cast<size_t>(0), BinaryEventCodec::DecodeFrame(std::string_view(bytes).substr(0, 10), frame),
+                L"Incomplete frame");
+            std::string malformed("\x02\x00\x00\x00\x09\x00", 6);
+            Assert::ExpectException<std::runtime_error>([&] { BinaryEventCodec::DecodeFrame(malformed, frame); });
+        }
+
+        TEST_METHOD(SnapshotThenEventsTest)
+        {
+            FixedCollection collection;
+            collection.Add(CreateSpeakers());
+            collection.SetStateVersion(5);
+
+            TestClient client;
+            EventStreamPublisher publisher(collection, 64 * 1024, EventStreamPublisher::LagPolicy::Disconnect);
+            client.Hold(true);
+            publisher.AddClient(client.SendFunction(), client.AbortFunction());
+            // already reflected in the snapshot taken once the client is released
+            publisher.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, "A", 5);
+            publisher.OnCollectionChanged(SoundDeviceEventType::Detached, "A", 6);
+            client.Hold(false);
+
+            const auto frames = client.WaitForVersion(6);
+            Assert::AreEqual(static_cast<size_t>(2), frames.size());
+            Assert::IsTrue(frames[0].Type == BinaryEventCodec::FrameType::Snapshot);
+            Assert::AreEqual(static_cast<uint64_t>(5), frames[0].StateVersion);
+            Assert::IsTrue(frames[1].Event == SoundDeviceEventType::Detached);
+            Assert::AreEqual(static_cast<size_t>(1), publisher.GetClientCount());
+        }
+
+        TEST_METHOD(LaggingClientGetsSnapshotTest)
+        {
+            FixedCollection collection;
+            collection.Add(CreateSpeakers());
+
+            TestClient slow;
+            TestClient fast;
+            EventStreamPublisher publisher(collection, 1024, EventStreamPublisher::LagPolicy::CoalesceToSnapshot);
+            publisher.AddClient(slow.SendFunction(), slow.AbortFunction());
+            publisher.AddClient(fast.SendFunction(), fast.AbortFunction());
+            slow.WaitForVersion(0);
+            slow.Hold(true);
+
+            constexpr uint64_t eventCount = 200;
+            for (uint64_t version = 1; version <= eventCount; ++version)
+            {
+                collection.SetStateVersion(version);
+                publisher.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, "A", version);
+                // keeps the fast client from lagging itself
+                fast.WaitForVersion(version);
+            }
+
+            const auto fastFrames = fast.WaitForVersion(eventCount);
+            Assert::AreEqual(static_cast<size_t>(1 + eventCount), fastFrames.size(), L"The fast client gets every event");
+
+            slow.Hold(false);
+            const auto slowFrames = slow.WaitForVersion(eventCount);
+            Assert::IsTrue(slowFrames.size() < fastFrames.size(), L"The slow client skips events");
+            Assert::IsTrue(std::ranges::count_if(slowFrames, [](const BinaryEventCodec::Frame & frame)
+                {
+                    return frame.Type == BinaryEventCodec::FrameType::Snapshot;
+                }) >= 2, L"The slow client resyncs with a snapshot");
+            Assert::IsTrue(publisher.GetStatistics().SnapshotsForLaggingClients > 0);
+        }
+
+        TEST_METHOD(LaggingClientDisconnectedTest)
+        {
+            FixedCollection collection;
+            collection.Add(CreateSpeakers());
+
+            TestClient slow;
+            TestClient fast;
+            EventStreamPublisher publisher(collection, 1024, EventStreamPublisher::LagPolicy::Disconnect);
+            publisher.AddClient(slow.SendFunction(), slow.AbortFunction());
+            publisher.AddClient(fast.SendFunction(), fast.AbortFunction());
+            slow.WaitForVersion(0);
+            slow.Hold(true);
+
+            constexpr uint64_t eventCount = 200;
+            for (uint64_t version = 1; version <= eventCount; ++version)
+            {
+                publisher.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, "A", version);
+                fast.WaitForVersion(version);
+            }
+
+            Assert::AreEqual(static_cast<size_t>(1 + eventCount), fast.WaitForVersion(eventCount).size());
+            Assert::IsTrue(slow.IsAborted());
+            Assert::AreEqual(static_cast<uint64_t>(1), publisher.GetStatistics().ClientsDisconnectedAsLagging);
+            for (auto deadline = std::chrono::steady_clock::now() + 5s;
+                publisher.GetClientCount() != 1 && std::chrono::steady_clock::now() < deadline;)
+            {
+                std::this_thread::sleep_for(10ms);
+            }
+            Assert::AreEqual(static_cast<size_t>(1), publisher.GetClientCount());
+        }
+
+        // 100 clients, each reading its own OS pipe on its own thread.
+        TEST_METHOD(HundredClientsThroughputTest)
+        {
+            constexpr int clientCount = 100;
+            constexpr uint64_t eventCount = 20'000;
+
+            FixedCollection collection;
+            collection.Add(SoundDevice("{0.0.0.00000000}.{5B7BBF93-1CE3-7A17-DC7A-432D3575AFB6}", "Speakers (High Definition Audio Device)",
+                SoundDeviceFlowType::Render, 500, 0, true, false));
+            const auto pnpId = collection.CreateItem(0)->GetPnpId();
+
+            std::vector<std::thread> readers;
+            std::vector<int> writeEnds;
+            std::atomic<uint64_t> bytesRead = 0;
+            std::atomic<int> complete = 0;
+            EventStreamPublisher::Statistics statistics;
+            std::chrono::steady_clock::duration elapsed{};
+            {
+                EventStreamPublisher publisher(collection, 4 * 1024 * 1024, EventStreamPublisher::LagPolicy::CoalesceToSnapshot);
+                for (int i = 0; i < clientCount; ++i)
+                {
+                    int pipeEnds[2];
+                    Assert::AreEqual(0, _pipe(pipeEnds, 64 * 1024, _O_BINARY));
+                    readers.emplace_back([readEnd = pipeEnds[0], &bytesRead, &complete]
+                        {
+                            std::string pending;
+                            std::vector<char> chunk(64 * 1024);
+                            uint64_t lastVersion = 0;
+                            for (int n; (n = _read(readEnd, chunk.data(), static_cast<unsigned>(chunk.size()))) > 0;)
+                            {
+                                bytesRead += n;
+                                pending.append(chunk.data(), static_cast<size_t>(n));
+                                std::string_view bytes(pending);
+                                BinaryEventCodec::Frame frame;
+                                for (size_t size; (size = BinaryEventCodec::DecodeFrame(bytes, frame)) != 0; bytes.remove_prefix(size))
+                                {
+                                    lastVersion = frame.StateVersion;
+                                }
+                                pending.erase(0, pending.size() - bytes.size());
+                                if (lastVersion == eventCount)
+                                {
+                                    ++complete;
+                                    lastVersion = 0;
+                                }
+                            }
+                            _close(readEnd);
+                        });
+                    writeEnds.push_back(pipeEnds[1]);
+                    publisher.AddClient([writeEnd = pipeEnds[1]](std::string_view batch)
+                        {
+                            return _write(writeEnd, batch.data(), static_cast<unsigned>(batch.size())) == static_cast<int>(batch.size());
+                        }, [] {});
+                }
+
+                const auto start = std::chrono::steady_clock::now();
+                for (uint64_t version = 1; version <= eventCount; ++version)
+                {
+                    publisher.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, pnpId, version);
+                }
+                for (auto deadline = start + 30s; complete < clientCount && std::chrono::steady_clock::now() < deadline;)
+                {
+                    std::this_thread::sleep_for(1ms);
+                }
+                elapsed = std::chrono::steady_clock::now() - start;
+                statistics = publisher.GetStatistics();
+            }
+            for (const auto writeEnd : writeEnds)
+            {
+                _close(writeEnd);
+            }
+            for (auto & reader : readers)
+            {
+                reader.join();
+            }
+
+            const auto seconds = std::chrono::duration<double>(elapsed).count();
+            Logger::WriteMessage(std::format("{} clients: {:.0f} events/s published, {:.0f} frames/s delivered in total, {:.1f} MB/s, {} lagging resyncs\n",
+                clientCount, eventCount / seconds, clientCount * eventCount / seconds,
+                static_cast<double>(bytesRead.load()) / seconds / 1e6, statistics.SnapshotsForLaggingClients).c_str());
+
+            Assert::AreEqual(clientCount, complete.load(), L"Every client reaches the last version");
+            Assert::AreEqual(eventCount, statistics.FramesPublished);
+        }
+    };
+}
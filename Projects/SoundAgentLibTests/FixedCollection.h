@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "public/SoundAgentInterface.h"
+#include "SoundDevice.h"
+
+
+namespace ed::audio {
+// Static device list for the stream writer tests, which only use the query side of the collection.
+// The state version may be changed while a writer reads it.
+class FixedCollection final : public SoundDeviceCollectionInterface {
+public:
+    FixedCollection() = default;
+    DISALLOW_COPY_MOVE(FixedCollection);
+    ~FixedCollection() override = default;
+
+    void Add(const SoundDevice & device) { devices_.push_back(device); }
+    void SetStateVersion(uint64_t stateVersion) { stateVersion_ = stateVersion; }
+    void SetDefaultRender(std::optional<std::string> pnpId) { defaultRender_ = std::move(pnpId); }
+
+    [[nodiscard]] size_t GetSize() const override { return devices_.size(); }
+    [[nodiscard]] std::unique_ptr<SoundDeviceInterface> CreateItem(size_t deviceNumber) const override
+    {
+        return std::make_unique<SoundDevice>(devices_[deviceNumber]);
+    }
+    [[nodiscard]] std::unique_ptr<SoundDeviceInterface> CreateItem(const std::string & devicePnpId) const override
+    {
+        for (const auto & device : devices_)
+        {
+            if (device.GetPnpId() == devicePnpId)
+            {
+                return std::make_unique<SoundDevice>(device);
+            }
+        }
+        return nullptr;
+    }
+    [[nodiscard]] std::optional<std::string> GetDefaultRenderDevicePnpId() const override { return defaultRender_; }
+    [[nodiscard]] std::optional<std::string> GetDefaultCaptureDevicePnpId() const override { return std::nullopt; }
+    [[nodiscard]] uint64_t GetStateVersion() const override { return stateVersion_; }
+    [[nodiscard]] SoundDeviceCollectionSnapshot CreateSnapshot() const override
+    {
+        SoundDeviceCollectionSnapshot snapshot;
+        snapshot.StateVersion = stateVersion_;
+        for (const auto & device : devices_)
+        {
+            snapshot.Devices.push_back(std::make_unique<SoundDevice>(device));
+        }
+        snapshot.DefaultRenderDevicePnpId = defaultRender_;
+        return snapshot;
+    }
+    [[nodiscard]] std::vector<SoundDeviceHistorySample> GetHistory(const std::string &, SoundDeviceHistoryKind,
+        std::chrono::system_clock::time_point, std::chrono::system_clock::time_point) const override
+    {
+        return {};
+    }
+
+    void ActivateAndStartLoop() override {}
+    void DeactivateAndStopLoop() override {}
+    void Subscribe(SoundDeviceObserverInterface &) override {}
+    void Unsubscribe(SoundDeviceObserverInterface &, bool) override {}
+    void ResetContent() override {}
+
+private:
+    std::vector<SoundDevice> devices_;
+    std::optional<std::string> defaultRender_;
+    std::atomic<uint64_t> stateVersion_ = 0;
+};
+}
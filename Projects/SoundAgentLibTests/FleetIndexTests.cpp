@@ -0,0 +1,198 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <format>
+#include <thread>
+
+#include <CppUnitTest.h>
+
+#include "BinaryEventCodec.h"
+#include "FixedCollection.h"
+#include "FleetIndex.h"
+#include "SoundDevice.h"
+#include "StringInterner.h"
+
+using namespace std::literals::string_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        SoundDevice CreateDevice(const std::string & pnpId, const std::string & name, SoundDeviceFlowType flow, uint16_t volume)
+        {
+            return SoundDevice(pnpId, name, flow,
+                flow == SoundDeviceFlowType::Render ? volume : 0,
+                flow == SoundDeviceFlowType::Capture ? volume : 0, false, false);
+        }
+
+        std::vector<std::string> Sorted(const std::vector<std::string_view> & hosts)
+        {
+            std::vector<std::string> sorted(hosts.begin(), hosts.end());
+            std::ranges::sort(sorted);
+            return sorted;
+        }
+
+        // What an agent streams: a snapshot, then events.
+        class AgentStream {
+        public:
+            explicit AgentStream(uint64_t stateVersion)
+            {
+                collection_.SetStateVersion(stateVersion);
+            }
+
+            void AddDevice(const SoundDevice & device) { collection_.Add(device); }
+            void SetDefaultRender(const std::string & pnpId) { collection_.SetDefaultRender(pnpId); }
+
+            std::string Snapshot() const
+            {
+                std::string bytes;
+                BinaryEventCodec::AppendSnapshotFrame(bytes, collection_.CreateSnapshot());
+                return bytes;
+            }
+
+            static std::string Event(SoundDeviceEventType event, const std::string & pnpId, uint64_t stateVersion,
+                const SoundDevice * device = nullptr)
+            {
+                std::string bytes;
+                BinaryEventCodec::AppendEventFrame(bytes, event, pnpId, stateVersion, device);
+                return bytes;
+            }
+
+        private:
+            FixedCollection collection_;
+        };
+    }
+
+    TEST_CLASS(FleetIndexTests)
+    {
+        TEST_METHOD(InternerTest)
+        {
+            StringInterner interner;
+            const auto speakers = interner.Intern("Speakers");
+            Assert::AreEqual(speakers, interner.Intern("Speakers"s));
+            Assert::AreNotEqual(speakers, interner.Intern("Headset"));
+            Assert::AreEqual("Speakers"s, std::string(interner.Resolve(speakers)));
+            Assert::IsFalse(interner.Find("Monitor").has_value());
+
+            // threads interning the same strings agree on the ids
+            std::vector<std::vector<StringInterner::Id>> ids(4);
+            std::vector<std::thread> threads;
+            for (auto & threadIds : ids)
+            {
+                threads.emplace_back([&interner, &threadIds]
+                {
+                    for (int i = 0; i < 1000; ++i)
+                    {
+                        threadIds.push_back(interner.Intern(std::format("device-{}", i)));
+                    }
+                });
+            }
+            for (auto & thread : threads)
+            {
+                thread.join();
+            }
+            Assert::IsTrue(std::ranges::all_of(ids, [&ids](const auto & threadIds) { return threadIds == ids[0]; }));
+            Assert::AreEqual(static_cast<size_t>(1002), interner.GetSize());
+        }
+
+        TEST_METHOD(SnapshotsAndEventsTest)
+        {
+            FleetIndex index(4);
+            BinaryEventCodec::Frame frame;
+
+            AgentStream first(10);
+            first.AddDevice(CreateDevice("A1", "Speakers", SoundDeviceFlowType::Render, 500));
+            first.AddDevice(CreateDevice("H1", "Headset", SoundDeviceFlowType::Render, 300));
+            first.SetDefaultRender("A1");
+            AgentStream second(3);
+            second.AddDevice(CreateDevice("H2", "Headset", SoundDeviceFlowType::Render, 200));
+            second.SetDefaultRender("H2");
+
+            const auto ws1 = index.AddHost("ws-1");
+            const auto ws2 = index.AddHost("ws-2");
+            const auto bytes = first.Snapshot();
+            Assert::AreEqual(bytes.size(), index.Ingest(ws1, bytes + bytes.substr(0, 5), frame), L"The partial frame is left");
+            index.Ingest(ws2, second.Snapshot(), frame);
+
+            Assert::IsTrue(Sorted(index.FindHostsWithDevice(FleetIndex::DeviceKey::Name, "Headset")) == std::vector{ "ws-1"s, "ws-2"s });
+            Assert::IsTrue(Sorted(index.FindHostsWithDefault(FleetIndex::DeviceKey::Name, "Headset", SoundDeviceFlowType::Render))
+                == std::vector{ "ws-2"s });
+            Assert::IsTrue(Sorted(index.FindHostsWithDefault(FleetIndex::DeviceKey::PnpId, "A1", SoundDeviceFlowType::Render))
+                == std::vector{ "ws-1"s });
+            Assert::IsTrue(index.FindHostsWithDefault(FleetIndex::DeviceKey::PnpId, "A1", SoundDeviceFlowType::Capture).empty());
+            Assert::IsTrue(index.FindHostsWithDefault(FleetIndex::DeviceKey::Name, "Unknown", SoundDeviceFlowType::Render).empty());
+
+            // ws-1 switches to its headset, changes its volume, then an old event arrives late
+            const auto headset = CreateDevice("H1", "Headset", SoundDeviceFlowType::Render, 700);
+            index.Ingest(ws1, AgentStream::Event(SoundDeviceEventType::DefaultRenderChanged, "H1", 11)
+                + AgentStream::Event(SoundDeviceEventType::VolumeRenderChanged, "H1", 12, &headset)
+                + AgentStream::Event(SoundDeviceEventType::DefaultRenderChanged, "A1", 9), frame);
+            Assert::IsTrue(Sorted(index.FindHostsWithDefault(FleetIndex::DeviceKey::Name, "Headset", SoundDeviceFlowType::Render))
+                == std::vector{ "ws-1"s, "ws-2"s });
+            Assert::IsTrue(index.FindHostsWithDefault(FleetIndex::DeviceKey::Name, "Speakers", SoundDeviceFlowType::Render).empty());
+
+            // ws-2 loses its headset and with it the default
+            index.Ingest(ws2, AgentStream::Event(SoundDeviceEventType::Detached, "H2", 4)
+                + AgentStream::Event(SoundDeviceEventType::DefaultRenderChanged, "", 5), frame);
+            Assert::IsTrue(Sorted(index.FindHostsWithDevice(FleetIndex::DeviceKey::Name, "Headset")) == std::vector{ "ws-1"s });
+            Assert::IsTrue(Sorted(index.FindHostsWithDefault(FleetIndex::DeviceKey::Name, "Headset", SoundDeviceFlowType::Render))
+                == std::vector{ "ws-1"s });
+
+            // a resync snapshot replaces everything
+            AgentStream resync(20);
+            resync.AddDevice(CreateDevice("M1", "Microphone", SoundDeviceFlowType::Capture, 400));
+            index.Ingest(ws1, resync.Snapshot(), frame);
+            Assert::IsTrue(index.FindHostsWithDevice(FleetIndex::DeviceKey::PnpId, "H1").empty());
+            Assert::IsTrue(index.FindHostsWithDefault(FleetIndex::DeviceKey::Name, "Headset", SoundDeviceFlowType::Render).empty());
+
+            const auto statistics = index.GetStatistics();
+            Assert::AreEqual(static_cast<uint64_t>(2), statistics.Hosts);
+            Assert::AreEqual(static_cast<uint64_t>(1), statistics.Devices);
+            Assert::AreEqual(static_cast<uint64_t>(7), statistics.FramesApplied);
+            Assert::AreEqual(static_cast<uint64_t>(1), statistics.StaleFramesDropped);
+        }
+
+        // The agent's dispatcher delivers default and device events before pending volume events, which then
+        // arrive with older state versions than the events ahead of them.
+        TEST_METHOD(InterleavedLanesTest)
+        {
+            FleetIndex index(4);
+            BinaryEventCodec::Frame frame;
+
+            AgentStream agent(10);
+            agent.AddDevice(CreateDevice("A1", "Speakers", SoundDeviceFlowType::Render, 500));
+            agent.AddDevice(CreateDevice("H1", "Headset", SoundDeviceFlowType::Render, 300));
+            agent.AddDevice(CreateDevice("H2", "Headset", SoundDeviceFlowType::Render, 200));
+            agent.SetDefaultRender("A1");
+            const auto ws = index.AddHost("ws");
+            index.Ingest(ws, agent.Snapshot(), frame);
+
+            // volume changes at 11 and 13 are pending while the default changes at 12 and H2 goes at 14
+            const auto headset = CreateDevice("H1", "Headset", SoundDeviceFlowType::Render, 700);
+            const auto speakers = CreateDevice("A1", "Speakers", SoundDeviceFlowType::Render, 100);
+            const auto otherHeadset = CreateDevice("H2", "Headset", SoundDeviceFlowType::Render, 900);
+            index.Ingest(ws, AgentStream::Event(SoundDeviceEventType::DefaultRenderChanged, "H1", 12)
+                + AgentStream::Event(SoundDeviceEventType::Detached, "H2", 14)
+                + AgentStream::Event(SoundDeviceEventType::VolumeRenderChanged, "H1", 11, &headset)
+                + AgentStream::Event(SoundDeviceEventType::VolumeRenderChanged, "A1", 13, &speakers)
+                + AgentStream::Event(SoundDeviceEventType::VolumeRenderChanged, "H2", 12, &otherHeadset), frame);
+
+            Assert::AreEqual(static_cast<uint16_t>(700), index.GetVolume(ws, "H1", SoundDeviceFlowType::Render).value_or(0));
+            Assert::AreEqual(static_cast<uint16_t>(100), index.GetVolume(ws, "A1", SoundDeviceFlowType::Render).value_or(0));
+            Assert::IsFalse(index.GetVolume(ws, "H2", SoundDeviceFlowType::Render).has_value(), L"A detached device stays gone");
+            Assert::IsTrue(Sorted(index.FindHostsWithDefault(FleetIndex::DeviceKey::PnpId, "H1", SoundDeviceFlowType::Render))
+                == std::vector{ "ws"s });
+
+            // a volume event is stale only against the volumes of its device
+            const auto olderHeadset = CreateDevice("H1", "Headset", SoundDeviceFlowType::Render, 400);
+            index.Ingest(ws, AgentStream::Event(SoundDeviceEventType::VolumeRenderChanged, "H1", 11, &olderHeadset), frame);
+            Assert::AreEqual(static_cast<uint16_t>(700), index.GetVolume(ws, "H1", SoundDeviceFlowType::Render).value_or(0));
+
+            const auto statistics = index.GetStatistics();
+            Assert::AreEqual(static_cast<uint64_t>(5), statistics.FramesApplied);
+            Assert::AreEqual(static_cast<uint64_t>(2), statistics.StaleFramesDropped);
+        }
+    };
+}
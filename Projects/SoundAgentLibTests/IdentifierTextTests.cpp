@@ -0,0 +1,226 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <format>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "IdentifierText.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        // The id of an endpoint as the system hands it over: 55 characters.
+        const std::u16string endpoint_id = u"{0.0.0.00000000}.{5b7bbf93-1ce3-7a17-dc7a-432d3575af01}";
+
+        constexpr GUID container_id = { 0x5B7BBF93, 0x1CE3, 0x7A17, { 0xDC, 0x7A, 0x43, 0x2D, 0x35, 0x75, 0xAF, 0x01 } };
+
+        // Mostly ASCII, like ids and names, with runs of other code units and surrogates, paired or not.
+        std::u16string RandomUtf16(std::mt19937 & random, size_t length)
+        {
+            std::u16string text(length, u'\0');
+            for (auto & unit : text)
+            {
+                switch (random() % 8)
+                {
+                case 0:
+                    unit = static_cast<char16_t>(0x80 + random() % 0x780);
+                    break;
+                case 1:
+                    unit = static_cast<char16_t>(random() % 0x10000);
+                    break;
+                case 2:
+                    unit = static_cast<char16_t>(0xD800 + random() % 0x800);
+                    break;
+                default:
+                    unit = static_cast<char16_t>(random() % 0x80);
+                    break;
+                }
+            }
+            return text;
+        }
+
+        std::string RandomIdText(std::mt19937 & random, size_t length)
+        {
+            constexpr std::string_view alphabet = "{}.-0123456789abcdefxyzABCDEFXYZ`@[\x7F\x80\xC3\xE9\xFF";
+            std::string text(length, '\0');
+            for (auto & c : text)
+            {
+                c = alphabet[random() % alphabet.size()];
+            }
+            return text;
+        }
+
+        GUID RandomGuid(std::mt19937 & random)
+        {
+            GUID guid{};
+            guid.Data1 = static_cast<uint32_t>(random());
+            guid.Data2 = static_cast<uint16_t>(random());
+            guid.Data3 = static_cast<uint16_t>(random());
+            for (auto & byte : guid.Data4)
+            {
+                byte = static_cast<uint8_t>(random());
+            }
+            return guid;
+        }
+
+        void AssertSameGuid(const std::optional<GUID> & expected, const std::optional<GUID> & actual)
+        {
+            Assert::AreEqual(expected.has_value(), actual.has_value());
+            if (expected.has_value())
+            {
+                Assert::IsTrue(*expected == *actual);
+            }
+        }
+
+        // Nanoseconds per input byte of the conversion, over many repetitions.
+        double MeasureNsPerByte(const std::function<size_t()> & convert, size_t inputBytes)
+        {
+            constexpr int repetitions = 200'000;
+            size_t sink = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < repetitions; ++i)
+            {
+                sink += convert();
+            }
+            const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            Assert::IsTrue(sink > 0);
+            return elapsed / repetitions / static_cast<double>(inputBytes);
+        }
+    }
+
+    TEST_CLASS(IdentifierTextTests)
+    {
+        TEST_METHOD(KnownValuesTest)
+        {
+            Assert::AreEqual(std::string("{0.0.0.00000000}.{5b7bbf93-1ce3-7a17-dc7a-432d3575af01}"), IdentifierText::Utf16ToAscii(endpoint_id));
+            Assert::AreEqual(std::string("Lautsprecher \xC3\xBC \xE2\x82\xAC \xF0\x9F\x8E\xA7"),
+                IdentifierText::Utf16ToUtf8(u"Lautsprecher ü € \U0001F3A7"));
+            Assert::AreEqual(std::string("a\xEF\xBF\xBD" "b\xEF\xBF\xBD"), IdentifierText::Utf16ToUtf8(std::u16string{ u'a', 0xDC00, u'b', 0xD800 }),
+                L"Lone surrogates");
+
+            auto pnpId = IdentifierText::Utf16ToAscii(endpoint_id);
+            IdentifierText::StripBraces(pnpId);
+            IdentifierText::ToUpperAscii(pnpId);
+            Assert::AreEqual(std::string("0.0.0.00000000.5B7BBF93-1CE3-7A17-DC7A-432D3575AF01"), pnpId);
+
+            Assert::AreEqual(std::string("5B7BBF93-1CE3-7A17-DC7A-432D3575AF01"), IdentifierText::FormatGuid(container_id));
+            for (const auto text : { "5B7BBF93-1CE3-7A17-DC7A-432D3575AF01", "{5b7bbf93-1ce3-7a17-dc7a-432d3575af01}" })
+            {
+                const auto parsed = IdentifierText::ParseGuid(text);
+                Assert::IsTrue(parsed.has_value());
+                Assert::IsTrue(*parsed == container_id);
+            }
+            for (const auto text : { "", "5B7BBF93-1CE3-7A17-DC7A-432D3575AF0", "5B7BBF93-1CE3-7A17-DC7A-432D3575AF0G",
+                "5B7BBF93+1CE3-7A17-DC7A-432D3575AF01", "{5B7BBF93-1CE3-7A17-DC7A-432D3575AF01" })
+            {
+                Assert::IsFalse(IdentifierText::ParseGuid(text).has_value());
+            }
+        }
+
+        TEST_METHOD(Utf16FuzzTest)
+        {
+            std::mt19937 random(1);
+            for (int i = 0; i < 20'000; ++i)
+            {
+                const auto text = RandomUtf16(random, random() % 100);
+                Assert::AreEqual(IdentifierText::Utf16ToAsciiScalar(text), IdentifierText::Utf16ToAscii(text));
+                Assert::AreEqual(IdentifierText::Utf16ToUtf8Scalar(text), IdentifierText::Utf16ToUtf8(text));
+            }
+        }
+
+        TEST_METHOD(NarrowFuzzTest)
+        {
+            std::mt19937 random(2);
+            for (int i = 0; i < 20'000; ++i)
+            {
+                const auto text = RandomIdText(random, random() % 100);
+
+                auto expected = text;
+                auto actual = text;
+                IdentifierText::StripBracesScalar(expected);
+                IdentifierText::StripBraces(actual);
+                Assert::AreEqual(expected, actual);
+
+                expected = text;
+                actual = text;
+                IdentifierText::ToUpperAsciiScalar(expected);
+                IdentifierText::ToUpperAscii(actual);
+                Assert::AreEqual(expected, actual);
+            }
+        }
+
+        TEST_METHOD(GuidFuzzTest)
+        {
+            std::mt19937 random(3);
+            constexpr std::string_view replacements = "0123456789abcdefABCDEFgG-{}/:@`\x80";
+            for (int i = 0; i < 20'000; ++i)
+            {
+                const auto guid = RandomGuid(random);
+                const auto text = IdentifierText::FormatGuid(guid);
+                Assert::AreEqual(IdentifierText::FormatGuidScalar(guid), text);
+                AssertSameGuid(guid, IdentifierText::ParseGuid(text));
+
+                auto damaged = random() % 2 == 0 ? "{" + text + "}" : text;
+                damaged[random() % damaged.size()] = replacements[random() % replacements.size()];
+                AssertSameGuid(IdentifierText::ParseGuidScalar(damaged), IdentifierText::ParseGuid(damaged));
+            }
+        }
+
+        TEST_METHOD(PerByteBenchmark)
+        {
+            if (!IdentifierText::IsVectorized())
+            {
+                Logger::WriteMessage("Scalar build: nothing to compare\n");
+                return;
+            }
+
+            const auto id = IdentifierText::Utf16ToAscii(endpoint_id);
+            const auto guidText = IdentifierText::FormatGuid(container_id);
+            const std::u16string name = u"Lautsprecher (Realtek(R) Audio) ü";
+            const auto report = [](const char * kernel, double scalar, double vectorized)
+            {
+                Logger::WriteMessage(std::format("{}: scalar {:.3f} ns/byte, SSE2 {:.3f} ns/byte, {:.1f}x\n",
+                    kernel, scalar, vectorized, scalar / vectorized).c_str());
+            };
+
+            report("UTF-16 to ASCII, endpoint id",
+                MeasureNsPerByte([&] { return IdentifierText::Utf16ToAsciiScalar(endpoint_id).size(); }, endpoint_id.size() * 2),
+                MeasureNsPerByte([&] { return IdentifierText::Utf16ToAscii(endpoint_id).size(); }, endpoint_id.size() * 2));
+            report("UTF-16 to UTF-8, endpoint name",
+                MeasureNsPerByte([&] { return IdentifierText::Utf16ToUtf8Scalar(name).size(); }, name.size() * 2),
+                MeasureNsPerByte([&] { return IdentifierText::Utf16ToUtf8(name).size(); }, name.size() * 2));
+
+            std::string buffer;
+            report("Brace stripping and upper-casing, endpoint id",
+                MeasureNsPerByte([&]
+                    {
+                        buffer = id;
+                        IdentifierText::StripBracesScalar(buffer);
+                        IdentifierText::ToUpperAsciiScalar(buffer);
+                        return buffer.size();
+                    }, id.size()),
+                MeasureNsPerByte([&]
+                    {
+                        buffer = id;
+                        IdentifierText::StripBraces(buffer);
+                        IdentifierText::ToUpperAscii(buffer);
+                        return buffer.size();
+                    }, id.size()));
+            report("GUID formatting, per text byte",
+                MeasureNsPerByte([&] { return IdentifierText::FormatGuidScalar(container_id).size(); }, guidText.size()),
+                MeasureNsPerByte([&] { return IdentifierText::FormatGuid(container_id).size(); }, guidText.size()));
+            report("GUID parsing",
+                MeasureNsPerByte([&] { return static_cast<size_t>(IdentifierText::ParseGuidScalar(guidText)->Data1 | 1); }, guidText.size()),
+                MeasureNsPerByte([&] { return static_cast<size_t>(IdentifierText::ParseGuid(guidText)->Data1 | 1); }, guidText.size()));
+        }
+    };
+}
@@ -0,0 +1,274 @@
+#include "stdafx.h"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <chrono>
+#include <format>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include <CppUnitTest.h>
+
+#include "EndpointSimulator.h"
+#include "FixedCollection.h"
+#include "HttpStateService.h"
+#include "LocalHttpServer.h"
+#include "SoundDevice.h"
+#include "SoundDeviceCollection.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        struct HttpResponse {
+            int Status = 0;
+            std::string ETag;
+            std::string Body;
+        };
+
+        // Blocking keep-alive client; Winsock is initialized by the server under test.
+        class HttpClient {
+        public:
+            explicit HttpClient(uint16_t port)
+                : socket_(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP))
+            {
+                sockaddr_in address{};
+                address.sin_family = AF_INET;
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                address.sin_port = htons(port);
+                Assert::IsTrue(socket_ != INVALID_SOCKET
+                    && connect(socket_, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0, L"Connected");
+            }
+
+            DISALLOW_COPY_MOVE(HttpClient);
+
+            ~HttpClient()
+            {
+                closesocket(socket_);
+            }
+
+            void Send(std::string_view request) const
+            {
+                Assert::AreEqual(static_cast<int>(request.size()), send(socket_, request.data(), static_cast<int>(request.size()), 0));
+            }
+
+            void Get(std::string_view target) const
+            {
+                Send(std::format("GET {} HTTP/1.1\r\nHost: localhost\r\n\r\n", target));
+            }
+
+            [[nodiscard]] bool HasResponse(std::chrono::milliseconds timeout) const
+            {
+                WSAPOLLFD pollFd{ .fd = socket_, .events = POLLRDNORM, .revents = 0 };
+                return WSAPoll(&pollFd, 1, static_cast<int>(timeout.count())) > 0;
+            }
+
+            HttpResponse Read()
+            {
+                size_t headerEnd;
+                while ((headerEnd = input_.find("\r\n\r\n")) == std::string::npos)
+                {
+                    Receive();
+                }
+                const auto header = input_.substr(0, headerEnd + 2);
+                input_.erase(0, headerEnd + 4);
+
+                HttpResponse response;
+                response.Status = std::stoi(header.substr(header.find(' ') + 1, 3));
+                response.ETag = GetField(header, "ETag");
+                const auto contentLength = GetField(header, "Content-Length");
+                const size_t bodySize = contentLength.empty() ? 0 : std::stoul(contentLength);
+                while (input_.size() < bodySize)
+                {
+                    Receive();
+                }
+                response.Body = input_.substr(0, bodySize);
+                input_.erase(0, bodySize);
+                return response;
+            }
+
+        private:
+            void Receive()
+            {
+                char buffer[4096];
+                const auto received = recv(socket_, buffer, sizeof(buffer), 0);
+                Assert::IsTrue(received > 0, L"Response expected");
+                input_.append(buffer, static_cast<size_t>(received));
+            }
+
+            static std::string GetField(const std::string & header, const std::string & name)
+            {
+                const auto start = header.find("\r\n" + name + ": ");
+                if (start == std::string::npos)
+                {
+                    return {};
+                }
+                const auto valueStart = start + name.size() + 4;
+                return header.substr(valueStart, header.find("\r\n", valueStart) - valueStart);
+            }
+
+        private:
+            SOCKET socket_;
+            std::string input_;
+        };
+
+        SoundDevice CreateSpeakers()
+        {
+            return SoundDevice("A", "Speakers", SoundDeviceFlowType::Render, 500, 0, true, false);
+        }
+
+        // Parks the clients on /defaults?wait=<current version>, changes the state and measures
+        // how long it takes until all of them got the new state.
+        void RunLongPollers(HttpStateService & service, const LocalHttpServer & server, int clientCount,
+            const std::function<void()> & changeState, const std::string & expectedPnpId)
+        {
+            std::vector<std::unique_ptr<HttpClient>> clients;
+            clients.push_back(std::make_unique<HttpClient>(server.GetPort()));
+            clients[0]->Get("/defaults");
+            const auto version = clients[0]->Read().ETag;
+            const auto waitTarget = std::format("/defaults?wait={}", version.substr(1, version.size() - 2));
+
+            const auto before = service.GetStatistics();
+            for (int i = 0; i < clientCount; ++i)
+            {
+                if (i != 0)
+                {
+                    clients.push_back(std::make_unique<HttpClient>(server.GetPort()));
+                }
+                clients.back()->Get(waitTarget);
+            }
+            for (auto deadline = std::chrono::steady_clock::now() + 10s;
+                service.GetStatistics().LongPolls - before.LongPolls < static_cast<uint64_t>(clientCount)
+                && std::chrono::steady_clock::now() < deadline;)
+            {
+                std::this_thread::sleep_for(1ms);
+            }
+            Assert::AreEqual(static_cast<uint64_t>(clientCount), service.GetStatistics().LongPolls - before.LongPolls, L"All clients wait");
+            Assert::IsFalse(clients.back()->HasResponse(50ms), L"No answer before the change");
+
+            const auto start = std::chrono::steady_clock::now();
+            changeState();
+            for (const auto & client : clients)
+            {
+                const auto response = client->Read();
+                Assert::AreEqual(200, response.Status);
+                Assert::IsTrue(response.ETag != version);
+                Assert::IsTrue(response.Body.find(expectedPnpId) != std::string::npos, L"The new default is served");
+            }
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+
+            const auto after = service.GetStatistics();
+            Logger::WriteMessage(std::format("{} long-pollers answered {:.1f} ms after the change, {} document renders\n",
+                clientCount, std::chrono::duration<double, std::milli>(elapsed).count(),
+                after.DocumentRenders - before.DocumentRenders).c_str());
+            // one rendering per state version, not per client; a default change may take two versions
+            Assert::IsTrue(after.DocumentRenders - before.DocumentRenders <= 2);
+            Assert::AreEqual(before.LongPollsExpired, after.LongPollsExpired);
+        }
+    }
+
+    TEST_CLASS(LocalHttpServerTests)
+    {
+        TEST_METHOD(DocumentsAndETagTest)
+        {
+            FixedCollection collection;
+            collection.Add(CreateSpeakers());
+            collection.SetDefaultRender("A"s);
+            collection.SetStateVersion(7);
+            HttpStateService service(collection);
+            LocalHttpServer server(service, 0, 30s);
+            HttpClient client(server.GetPort());
+
+            client.Get("/devices");
+            auto response = client.Read();
+            Assert::AreEqual(200, response.Status);
+            Assert::AreEqual(R"("7")"s, response.ETag);
+            Assert::AreEqual(
+                R"({"version":7,"devices":[{"pnpId":"A","name":"Speakers","flow":"Render","renderVolume":500,"captureVolume":0}]})"s,
+                response.Body);
+
+            client.Get("/defaults");
+            response = client.Read();
+            Assert::AreEqual(
+                R"({"version":7,"defaultRender":{"pnpId":"A","name":"Speakers","flow":"Render","renderVolume":500,"captureVolume":0},"defaultCapture":null})"s,
+                response.Body);
+
+            client.Send("GET /defaults HTTP/1.1\r\nIf-None-Match: \"7\"\r\n\r\n");
+            response = client.Read();
+            Assert::AreEqual(304, response.Status);
+            Assert::IsTrue(response.Body.empty());
+
+            client.Get("/unknown");
+            Assert::AreEqual(404, client.Read().Status);
+            client.Send("DELETE /devices HTTP/1.1\r\n\r\n");
+            Assert::AreEqual(405, client.Read().Status);
+            client.Get("/devices?wait=x");
+            Assert::AreEqual(400, client.Read().Status);
+
+            service.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, "A", 7);
+            client.Get("/metrics");
+            response = client.Read();
+            Assert::AreEqual(200, response.Status);
+            Assert::IsTrue(response.Body.find("sound_agent_events_total{event=\"VolumeRenderChanged\"} 1\n") != std::string::npos);
+            Assert::IsTrue(response.Body.find("sound_agent_http_document_renders_total 1\n") != std::string::npos, L"Rendered once");
+            Assert::IsTrue(response.Body.find("sound_agent_http_not_modified_total 1\n") != std::string::npos);
+            Assert::IsTrue(response.Body.find("sound_agent_http_connections 1\n") != std::string::npos);
+        }
+
+        TEST_METHOD(LongPollTest)
+        {
+            FixedCollection collection;
+            collection.Add(CreateSpeakers());
+            collection.SetStateVersion(1);
+            HttpStateService service(collection);
+            LocalHttpServer server(service, 0, 300ms);
+            HttpClient client(server.GetPort());
+
+            client.Get("/devices?wait=0");
+            Assert::AreEqual(R"("1")"s, client.Read().ETag, L"Already newer: answered at once");
+
+            client.Get("/devices?wait=1");
+            Assert::IsFalse(client.HasResponse(100ms));
+            collection.SetStateVersion(2);
+            service.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, "A", 2);
+            auto response = client.Read();
+            Assert::AreEqual(200, response.Status);
+            Assert::AreEqual(R"("2")"s, response.ETag);
+
+            // pipelined behind a waiting request
+            client.Send("GET /devices?wait=2 HTTP/1.1\r\n\r\nGET /metrics HTTP/1.1\r\n\r\n");
+            response = client.Read();
+            Assert::AreEqual(304, response.Status, L"Wait timed out");
+            Assert::AreEqual(R"("2")"s, response.ETag);
+            response = client.Read();
+            Assert::IsTrue(response.Body.find("sound_agent_http_long_polls_expired_total 1\n") != std::string::npos);
+        }
+
+        // Load test: 1000 concurrent long-pollers against the real collection over the simulated endpoints.
+        TEST_METHOD(ThousandLongPollersTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400);
+            simulator.AddEndpoint(L"headphones", L"Headphones", eRender, 600);
+            simulator.SetDefaultEndpoint(L"speakers");
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+            HttpStateService service(collection);
+            collection.Subscribe(service);
+            {
+                LocalHttpServer server(service, 0, 30s);
+                RunLongPollers(service, server, 1000,
+                    [&simulator] { simulator.SetDefaultEndpoint(L"headphones"); },
+                    EndpointSimulator::GetPnpIdOfContainer(L"headphones"));
+            }
+            collection.Unsubscribe(service, true);
+        }
+    };
+}
@@ -0,0 +1,170 @@
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <format>
+#include <io.h>
+#include <thread>
+
+#include <CppUnitTest.h>
+
+#include "BufferedLineWriter.h"
+#include "FixedCollection.h"
+#include "NdjsonEventWriter.h"
+#include "SoundDevice.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        std::vector<std::string> SplitLines(const std::string & text)
+        {
+            std::vector<std::string> lines;
+            size_t start = 0;
+            for (size_t end; (end = text.find('\n', start)) != std::string::npos; start = end + 1)
+            {
+                lines.push_back(text.substr(start, end - start));
+            }
+            Assert::AreEqual(text.size(), start, L"Output must end with a complete line");
+            return lines;
+        }
+    }
+
+    TEST_CLASS(NdjsonEventWriterTests)
+    {
+        TEST_METHOD(SnapshotThenDeltasTest)
+        {
+            FixedCollection collection;
+            collection.Add(SoundDevice("A", "Speakers", SoundDeviceFlowType::Render, 500, 0, true, false));
+            collection.Add(SoundDevice("B", "Mic", SoundDeviceFlowType::Capture, 0, 300, false, false));
+            collection.SetDefaultRender("A"s);
+            collection.SetStateVersion(7);
+
+            std::string output;
+            {
+                BufferedLineWriter writer([&output](std::string_view batch)
+                    {
+                        output.append(batch);
+                        return true;
+                    }, 4096, 1000ms);
+                NdjsonEventWriter eventWriter(collection, writer);
+
+                eventWriter.WriteSnapshot();
+                // already reflected in the snapshot
+                eventWriter.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, "A", 7);
+                eventWriter.OnCollectionChanged(SoundDeviceEventType::VolumeCaptureChanged, "B", 8);
+                eventWriter.OnCollectionChanged(SoundDeviceEventType::Detached, "A", 9);
+            }
+
+            const auto lines = SplitLines(output);
+            Assert::AreEqual(static_cast<size_t>(3), lines.size());
+            Assert::AreEqual(
+                R"({"type":"snapshot","version":7,"defaultRender":"A","defaultCapture":null,"devices":[)"
+                R"({"pnpId":"A","name":"Speakers","flow":"Render","renderVolume":500,"captureVolume":0},)"
+                R"({"pnpId":"B","name":"Mic","flow":"Capture","renderVolume":0,"captureVolume":300}]})"s,
+                lines[0]);
+            Assert::AreEqual(
+                R"({"type":"event","event":"VolumeCaptureChanged","version":8,"pnpId":"B",)"
+                R"("device":{"pnpId":"B","name":"Mic","flow":"Capture","renderVolume":0,"captureVolume":300}})"s,
+                lines[1]);
+            Assert::AreEqual(R"({"type":"event","event":"Detached","version":9,"pnpId":"A"})"s, lines[2]);
+        }
+
+        TEST_METHOD(JsonEscapingTest)
+        {
+            std::string out;
+            NdjsonEventWriter::AppendJsonString(out, "Head\"set\\ \x01\n\xC3\xA4");
+            Assert::AreEqual(R"("Head\"set\\ \u0001\n)"s + "\xC3\xA4\"", out);
+        }
+
+        TEST_METHOD(FlushOnThresholdAndIntervalTest)
+        {
+            std::atomic<int> flushes = 0;
+            BufferedLineWriter writer([&flushes](std::string_view)
+                {
+                    ++flushes;
+                    return true;
+                }, 64, 50ms);
+
+            writer.WriteLine("short");
+            Assert::AreEqual(0, flushes.load(), L"Below threshold nothing is written at once");
+            std::this_thread::sleep_for(200ms);
+            Assert::AreEqual(1, flushes.load(), L"Interval flush expected");
+
+            writer.WriteLine(std::string(100, 'x'));
+            Assert::AreEqual(2, flushes.load(), L"Threshold flush expected");
+        }
+
+        TEST_METHOD(BrokenSinkDropsOutputTest)
+        {
+            BufferedLineWriter writer([](std::string_view)
+                {
+                    return false;
+                }, 1, 1000ms);
+
+            writer.WriteLine("first");
+            writer.WriteLine("second");
+
+            Assert::IsTrue(writer.IsSinkBroken());
+            Assert::AreEqual(static_cast<uint64_t>(1), writer.GetStatistics().LinesDropped);
+        }
+
+        // Volume events with device payload, written through an OS pipe drained by another thread.
+        TEST_METHOD(ThroughputToPipeTest)
+        {
+            constexpr int eventCount = 200'000;
+
+            FixedCollection collection;
+            collection.Add(SoundDevice("{0.0.0.00000000}.{5B7BBF93-1CE3-7A17-DC7A-432D3575AFB6}", "Speakers (High Definition Audio Device)",
+                SoundDeviceFlowType::Render, 500, 0, true, false));
+            const auto pnpId = collection.CreateItem(0)->GetPnpId();
+
+            int pipeEnds[2];
+            Assert::AreEqual(0, _pipe(pipeEnds, 64 * 1024, _O_BINARY));
+
+            std::atomic<uint64_t> bytesRead = 0;
+            std::thread reader([readEnd = pipeEnds[0], &bytesRead]
+                {
+                    std::vector<char> chunk(64 * 1024);
+                    for (int n; (n = _read(readEnd, chunk.data(), static_cast<unsigned>(chunk.size()))) > 0;)
+                    {
+                        bytesRead += n;
+                    }
+                });
+
+            BufferedLineWriter::Statistics statistics;
+            const auto start = std::chrono::steady_clock::now();
+            {
+                BufferedLineWriter writer([writeEnd = pipeEnds[1]](std::string_view batch)
+                    {
+                        return _write(writeEnd, batch.data(), static_cast<unsigned>(batch.size())) == static_cast<int>(batch.size());
+                    }, 32 * 1024, 20ms);
+                NdjsonEventWriter eventWriter(collection, writer);
+                for (int i = 1; i <= eventCount; ++i)
+                {
+                    eventWriter.OnCollectionChanged(SoundDeviceEventType::VolumeRenderChanged, pnpId, i);
+                }
+                writer.Flush();
+                statistics = writer.GetStatistics();
+            }
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            _close(pipeEnds[1]);
+            reader.join();
+            _close(pipeEnds[0]);
+
+            const auto seconds = std::chrono::duration<double>(elapsed).count();
+            Logger::WriteMessage(std::format("NDJSON to pipe: {:.0f} events/s, {:.1f} MB/s, {} flushes\n",
+                eventCount / seconds, static_cast<double>(bytesRead.load()) / seconds / 1e6, statistics.Flushes).c_str());
+
+            Assert::AreEqual(static_cast<uint64_t>(eventCount), statistics.Lines);
+            Assert::AreEqual(statistics.Bytes, bytesRead.load());
+            Assert::IsTrue(eventCount / seconds > 100'000.0, L"Expected well above 100k events/s");
+        }
+    };
+}
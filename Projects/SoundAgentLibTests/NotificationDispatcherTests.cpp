@@ -0,0 +1,222 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <stdexcept>
+#include <thread>
+
+#include <CppUnitTest.h>
+
+#include "NotificationDispatcher.h"
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        void BusyWait(std::chrono::microseconds duration)
+        {
+            const auto until = std::chrono::steady_clock::now() + duration;
+            while (std::chrono::steady_clock::now() < until)
+            {
+            }
+        }
+    }
+
+    TEST_CLASS(NotificationDispatcherTests)
+    {
+        TEST_METHOD(HighPriorityPreemptsPendingVolumeEventsTest)
+        {
+            std::vector<SoundDeviceEventType> delivered;
+            std::atomic<bool> release = false;
+            NotificationDispatcher dispatcher([&delivered, &release](SoundDeviceEventType event, const std::string&, uint64_t)
+                {
+                    while (!release)
+                    {
+                        std::this_thread::yield();
+                    }
+                    delivered.push_back(event);
+                });
+
+            // the first one blocks the worker, the rest queues up
+            dispatcher.Post(SoundDeviceEventType::VolumeRenderChanged, "A", 1);
+            std::this_thread::sleep_for(20ms);
+            dispatcher.Post(SoundDeviceEventType::VolumeRenderChanged, "B", 1);
+            dispatcher.Post(SoundDeviceEventType::VolumeRenderChanged, "B", 1);
+            dispatcher.Post(SoundDeviceEventType::VolumeCaptureChanged, "C", 1);
+            dispatcher.Post(SoundDeviceEventType::DefaultRenderChanged, "B", 1);
+            dispatcher.Post(SoundDeviceEventType::Detached, "C", 1);
+            release = true;
+            dispatcher.WaitUntilIdle();
+
+            const std::vector expected{
+                SoundDeviceEventType::VolumeRenderChanged,
+                SoundDeviceEventType::DefaultRenderChanged,
+                SoundDeviceEventType::Detached,
+                SoundDeviceEventType::VolumeRenderChanged
+            };
+            Assert::IsTrue(expected == delivered);
+
+            const auto statistics = dispatcher.GetStatistics();
+            Assert::AreEqual(static_cast<uint64_t>(6), statistics.Posted);
+            Assert::AreEqual(static_cast<uint64_t>(4), statistics.Delivered);
+            Assert::AreEqual(static_cast<uint64_t>(1), statistics.Coalesced);
+            Assert::AreEqual(static_cast<uint64_t>(1), statistics.DiscardedAsStale);
+        }
+
+        TEST_METHOD(CoalescedEventCarriesNewestStateVersionTest)
+        {
+            std::vector<uint64_t> deliveredVersions;
+            std::atomic<bool> release = false;
+            NotificationDispatcher dispatcher([&deliveredVersions, &release](SoundDeviceEventType, const std::string&, uint64_t stateVersion)
+                {
+                    while (!release)
+                    {
+                        std::this_thread::yield();
+                    }
+                    deliveredVersions.push_back(stateVersion);
+                });
+
+            dispatcher.Post(SoundDeviceEventType::DefaultCaptureChanged, "A", 10);
+            std::this_thread::sleep_for(20ms);
+            dispatcher.Post(SoundDeviceEventType::VolumeCaptureChanged, "A", 11);
+            dispatcher.Post(SoundDeviceEventType::VolumeCaptureChanged, "A", 12);
+            dispatcher.Post(SoundDeviceEventType::VolumeCaptureChanged, "A", 13);
+            release = true;
+            dispatcher.WaitUntilIdle();
+
+            Assert::IsTrue(std::vector<uint64_t>{ 10, 13 } == deliveredVersions);
+        }
+
+        TEST_METHOD(ContentResetDiscardsPendingVolumeEventsTest)
+        {
+            std::vector<SoundDeviceEventType> delivered;
+            std::atomic<bool> release = false;
+            NotificationDispatcher dispatcher([&delivered, &release](SoundDeviceEventType event, const std::string&, uint64_t)
+                {
+                    while (!release)
+                    {
+                        std::this_thread::yield();
+                    }
+                    delivered.push_back(event);
+                });
+
+            dispatcher.Post(SoundDeviceEventType::Discovered, "A", 1);
+            std::this_thread::sleep_for(20ms);
+            dispatcher.Post(SoundDeviceEventType::VolumeRenderChanged, "A", 2);
+            dispatcher.Post(SoundDeviceEventType::VolumeCaptureChanged, "B", 3);
+            dispatcher.Post(SoundDeviceEventType::ContentReset, "", 4);
+            release = true;
+            dispatcher.WaitUntilIdle();
+
+            Assert::IsTrue(std::vector{ SoundDeviceEventType::Discovered, SoundDeviceEventType::ContentReset } == delivered);
+            Assert::AreEqual(static_cast<uint64_t>(2), dispatcher.GetStatistics().DiscardedAsStale);
+        }
+
+        TEST_METHOD(ThrowingDeliveryKeepsWorkerRunningTest)
+        {
+            std::vector<SoundDeviceEventType> delivered;
+            NotificationDispatcher dispatcher([&delivered](SoundDeviceEventType event, const std::string&, uint64_t)
+                {
+                    delivered.push_back(event);
+                    if (event == SoundDeviceEventType::Discovered)
+                    {
+                        throw std::runtime_error("observer failure");
+                    }
+                });
+
+            dispatcher.Post(SoundDeviceEventType::Discovered, "A", 1);
+            dispatcher.Post(SoundDeviceEventType::VolumeRenderChanged, "A", 2);
+            dispatcher.WaitUntilIdle();
+
+            Assert::IsTrue(std::vector{ SoundDeviceEventType::Discovered, SoundDeviceEventType::VolumeRenderChanged } == delivered);
+            Assert::AreEqual(static_cast<uint64_t>(2), dispatcher.GetStatistics().Delivered);
+        }
+
+        // Not a std::exception: the worker keeps running as well.
+        TEST_METHOD(ThrowingNonStdExceptionKeepsWorkerRunningTest)
+        {
+            struct ForeignFailure {};
+            std::vector<SoundDeviceEventType> delivered;
+            NotificationDispatcher dispatcher([&delivered](SoundDeviceEventType event, const std::string&, uint64_t)
+                {
+                    delivered.push_back(event);
+                    if (event == SoundDeviceEventType::Discovered)
+                    {
+                        throw ForeignFailure{};
+                    }
+                });
+
+            dispatcher.Post(SoundDeviceEventType::Discovered, "A", 1);
+            dispatcher.Post(SoundDeviceEventType::VolumeRenderChanged, "A", 2);
+            dispatcher.WaitUntilIdle();
+
+            Assert::IsTrue(std::vector{ SoundDeviceEventType::Discovered, SoundDeviceEventType::VolumeRenderChanged } == delivered);
+            Assert::AreEqual(static_cast<uint64_t>(2), dispatcher.GetStatistics().Delivered);
+        }
+
+        // A 5 kHz volume storm over 8 devices, delivered to an observer needing 300 us per volume event
+        // (i.e. 1.5 times overloaded); default changes must still get through promptly.
+        TEST_METHOD(DefaultChangeLatencyUnderVolumeStormTest)
+        {
+            using Clock = std::chrono::steady_clock;
+            std::atomic<Clock::rep> defaultPostedAt = 0;
+            std::vector<std::chrono::microseconds> latencies;
+
+            NotificationDispatcher dispatcher([&defaultPostedAt, &latencies](SoundDeviceEventType event, const std::string&, uint64_t)
+                {
+                    if (event == SoundDeviceEventType::DefaultRenderChanged)
+                    {
+                        latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                            Clock::now() - Clock::time_point(Clock::duration(defaultPostedAt.load()))));
+                        return;
+                    }
+                    BusyWait(300us);
+                });
+
+            std::atomic<bool> stop = false;
+            std::thread storm([&dispatcher, &stop]
+                {
+                    constexpr auto period = 200us; // 5 kHz
+                    auto next = Clock::now();
+                    for (uint64_t i = 0; !stop; ++i)
+                    {
+                        dispatcher.Post(SoundDeviceEventType::VolumeRenderChanged, std::format("DEVICE-{}", i % 8), 1);
+                        next += period;
+                        while (Clock::now() < next)
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                });
+
+            for (int i = 0; i < 50; ++i)
+            {
+                std::this_thread::sleep_for(10ms);
+                defaultPostedAt = Clock::now().time_since_epoch().count();
+                dispatcher.Post(SoundDeviceEventType::DefaultRenderChanged, "DEVICE-0", 1);
+            }
+            stop = true;
+            storm.join();
+            dispatcher.WaitUntilIdle();
+
+            std::ranges::sort(latencies);
+            const auto median = latencies[latencies.size() / 2];
+            const auto worst = latencies.back();
+            Logger::WriteMessage(std::format("Default-change delivery under 5 kHz volume storm: median {} us, max {} us\n",
+                median.count(), worst.count()).c_str());
+
+            // At most one volume event is running when the default change arrives.
+            Assert::IsTrue(worst < 20ms, L"Default change was delayed by the volume storm");
+
+            const auto statistics = dispatcher.GetStatistics();
+            Logger::WriteMessage(std::format("Posted {}, delivered {}, coalesced {}\n",
+                statistics.Posted, statistics.Delivered, statistics.Coalesced).c_str());
+        }
+    };
+}
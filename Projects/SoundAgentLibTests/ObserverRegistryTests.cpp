@@ -0,0 +1,380 @@
+#include "stdafx.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <future>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <CppUnitTest.h>
+
+#include "ObserverRegistry.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        class CountingObserver final : public SoundDeviceObserverInterface {
+        public:
+            CountingObserver() = default;
+            DISALLOW_COPY_MOVE(CountingObserver);
+            ~CountingObserver() override
+            {
+                alive_ = false;
+            }
+
+            void OnCollectionChanged(SoundDeviceEventType, const std::string&, uint64_t) override
+            {
+                // A call after destruction is exactly what the registry must prevent.
+                Assert::IsTrue(alive_.load(), L"Observer notified after it had been destroyed");
+                ++count_;
+            }
+
+            [[nodiscard]] uint64_t GetCount() const { return count_.load(); }
+
+        private:
+            std::atomic<bool> alive_ = true;
+            std::atomic<uint64_t> count_ = 0;
+        };
+
+        class SelfRemovingObserver final : public SoundDeviceObserverInterface {
+        public:
+            explicit SelfRemovingObserver(ObserverRegistry& registry) : registry_(registry) {}
+            DISALLOW_COPY_MOVE(SelfRemovingObserver);
+            ~SelfRemovingObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType, const std::string&, uint64_t) override
+            {
+                ++count_;
+                registry_.Remove(*this, true);
+            }
+
+            [[nodiscard]] int GetCount() const { return count_; }
+
+        private:
+            ObserverRegistry& registry_;
+            int count_ = 0;
+        };
+
+        class ThrowingObserver final : public SoundDeviceObserverInterface {
+        public:
+            ThrowingObserver() = default;
+            DISALLOW_COPY_MOVE(ThrowingObserver);
+            ~ThrowingObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType, const std::string&, uint64_t) override
+            {
+                throw std::runtime_error("observer failed");
+            }
+        };
+
+        // Holds each notification in its handler until the PnP id of the notification is released.
+        class BlockingObserver final : public SoundDeviceObserverInterface {
+        public:
+            BlockingObserver() = default;
+            DISALLOW_COPY_MOVE(BlockingObserver);
+            ~BlockingObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType, const std::string& devicePnpId, uint64_t) override
+            {
+                std::unique_lock lock(mutex_);
+                entered_[devicePnpId] = true;
+                changed_.notify_all();
+                changed_.wait(lock, [this, &devicePnpId] { return released_[devicePnpId]; });
+            }
+
+            void WaitUntilEntered(const std::string& devicePnpId)
+            {
+                std::unique_lock lock(mutex_);
+                Assert::IsTrue(changed_.wait_for(lock, 5s, [this, &devicePnpId] { return entered_[devicePnpId]; }));
+            }
+
+            void Release(const std::string& devicePnpId)
+            {
+                std::lock_guard lock(mutex_);
+                released_[devicePnpId] = true;
+                changed_.notify_all();
+            }
+
+        private:
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::map<std::string, bool> entered_;
+            std::map<std::string, bool> released_;
+        };
+
+        // Counts the events per type, through handlers specialized per event type.
+        class CountingTarget final {
+        public:
+            CountingTarget() = default;
+            DISALLOW_COPY_MOVE(CountingTarget);
+            ~CountingTarget() = default;
+
+            template <SoundDeviceEventType Event>
+            void OnEvent(const std::string&, uint64_t)
+            {
+                ++counts_[static_cast<size_t>(Event)];
+            }
+
+            [[nodiscard]] uint64_t GetCount(SoundDeviceEventType event) const { return counts_[static_cast<size_t>(event)]; }
+
+        private:
+            std::array<uint64_t, ObserverRegistry::event_type_count> counts_{};
+        };
+
+        // What a C API adapter does for the default-device and volume events, ignoring the others:
+        // once through a virtual call and runtime branches, once through handlers for the routed events only.
+        class BranchingRouter final : public SoundDeviceObserverInterface {
+        public:
+            BranchingRouter() = default;
+            DISALLOW_COPY_MOVE(BranchingRouter);
+            ~BranchingRouter() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType event, const std::string& devicePnpId, uint64_t) override
+            {
+                if (event == SoundDeviceEventType::DefaultRenderChanged || event == SoundDeviceEventType::DefaultCaptureChanged)
+                {
+                    routed_ += devicePnpId.empty() ? 1 : 2;
+                }
+                if (event == SoundDeviceEventType::VolumeRenderChanged || event == SoundDeviceEventType::VolumeCaptureChanged)
+                {
+                    routed_ += event == SoundDeviceEventType::VolumeRenderChanged ? 4 : 5;
+                }
+            }
+
+            [[nodiscard]] uint64_t GetRouted() const { return routed_; }
+
+        private:
+            uint64_t routed_ = 0;
+        };
+
+        class HandlerRouter final {
+        public:
+            HandlerRouter() = default;
+            DISALLOW_COPY_MOVE(HandlerRouter);
+            ~HandlerRouter() = default;
+
+            template <SoundDeviceEventType Event>
+            void OnEvent(const std::string& devicePnpId, uint64_t)
+            {
+                if constexpr (Event == SoundDeviceEventType::DefaultRenderChanged || Event == SoundDeviceEventType::DefaultCaptureChanged)
+                {
+                    routed_ += devicePnpId.empty() ? 1 : 2;
+                }
+                else
+                {
+                    routed_ += Event == SoundDeviceEventType::VolumeRenderChanged ? 4 : 5;
+                }
+            }
+
+            [[nodiscard]] uint64_t GetRouted() const { return routed_; }
+
+        private:
+            uint64_t routed_ = 0;
+        };
+    }
+
+    TEST_CLASS(ObserverRegistryTests)
+    {
+        TEST_METHOD(AddRemoveTest)
+        {
+            ObserverRegistry registry;
+            CountingObserver first;
+            CountingObserver second;
+
+            registry.Add(first);
+            registry.Add(first);
+            registry.Add(second);
+            Assert::AreEqual(static_cast<size_t>(2), registry.GetSize());
+
+            registry.Notify(SoundDeviceEventType::Discovered, "pnp", 1);
+            registry.Remove(first, false);
+            registry.Notify(SoundDeviceEventType::Detached, "pnp", 1);
+
+            Assert::AreEqual(static_cast<uint64_t>(1), first.GetCount());
+            Assert::AreEqual(static_cast<uint64_t>(2), second.GetCount());
+        }
+
+        TEST_METHOD(RemoveDuringDispatchTest)
+        {
+            ObserverRegistry registry;
+            SelfRemovingObserver selfRemoving(registry);
+            CountingObserver counting;
+            registry.Add(selfRemoving);
+            registry.Add(counting);
+
+            // The running notification keeps its list, the removal is effective with the next one.
+            registry.Notify(SoundDeviceEventType::VolumeRenderChanged, "pnp", 1);
+            registry.Notify(SoundDeviceEventType::VolumeRenderChanged, "pnp", 1);
+
+            Assert::AreEqual(1, selfRemoving.GetCount());
+            Assert::AreEqual(static_cast<uint64_t>(2), counting.GetCount());
+        }
+
+        // A throwing handler does not leave its notification counted as running: waiting removals and the destructor return.
+        TEST_METHOD(ThrowingObserverTest)
+        {
+            ObserverRegistry registry;
+            ThrowingObserver throwing;
+            CountingObserver counting;
+            registry.Add(throwing);
+            registry.Add(counting);
+
+            Assert::ExpectException<std::runtime_error>([&registry] { registry.Notify(SoundDeviceEventType::Discovered, "pnp", 1); });
+            registry.Remove(throwing, true);
+            registry.Notify(SoundDeviceEventType::Discovered, "pnp", 2);
+            registry.Remove(counting, true);
+            Assert::AreEqual(static_cast<uint64_t>(1), counting.GetCount());
+        }
+
+        // A waiting removal waits for the notification running at the call, not for one started afterward.
+        TEST_METHOD(WaitForEarlierNotificationsOnlyTest)
+        {
+            ObserverRegistry registry;
+            BlockingObserver blocking;
+            CountingObserver counting;
+            registry.Add(blocking);
+            registry.Add(counting);
+
+            std::thread earlier([&registry] { registry.Notify(SoundDeviceEventType::Discovered, "earlier", 1); });
+            blocking.WaitUntilEntered("earlier");
+            auto removal = std::async(std::launch::async, [&registry, &counting] { registry.Remove(counting, true); });
+            Assert::IsTrue(removal.wait_for(100ms) == std::future_status::timeout, L"Waits for the earlier notification");
+
+            std::thread later([&registry] { registry.Notify(SoundDeviceEventType::Discovered, "later", 2); });
+            blocking.WaitUntilEntered("later");
+            blocking.Release("earlier");
+            Assert::IsTrue(removal.wait_for(5s) == std::future_status::ready, L"Does not wait for the later notification");
+
+            blocking.Release("later");
+            earlier.join();
+            later.join();
+            registry.Remove(blocking, true);
+        }
+
+        // Subscribe / wait-unsubscribe / destroy observers on several threads while another one dispatches.
+        // Meant to be run under a race detector as well (e.g. /fsanitize=address or a TSan build of the library).
+        TEST_METHOD(ConcurrentSubscribeDispatchStressTest)
+        {
+            ObserverRegistry registry;
+            CountingObserver permanent;
+            registry.Add(permanent);
+
+            std::atomic<bool> stop = false;
+            std::thread dispatcher([&registry, &stop]
+                {
+                    while (!stop)
+                    {
+                        registry.Notify(SoundDeviceEventType::VolumeRenderChanged, "pnp", 1);
+                    }
+                });
+
+            std::vector<std::thread> subscribers;
+            for (int t = 0; t < 4; ++t)
+            {
+                subscribers.emplace_back([&registry]
+                    {
+                        for (int i = 0; i < 2000; ++i)
+                        {
+                            const auto observer = std::make_unique<CountingObserver>();
+                            registry.Add(*observer);
+                            std::this_thread::yield();
+                            registry.Remove(*observer, true);
+                        }
+                    });
+            }
+            for (auto& subscriber : subscribers)
+            {
+                subscriber.join();
+            }
+            stop = true;
+            dispatcher.join();
+
+            Assert::AreEqual(static_cast<size_t>(1), registry.GetSize());
+            Assert::IsTrue(permanent.GetCount() > 0);
+        }
+
+        TEST_METHOD(HandlersTest)
+        {
+            ObserverRegistry registry;
+            CountingTarget target;
+            CountingObserver observer;
+            registry.AddHandlers<SoundDeviceEventType::Discovered, SoundDeviceEventType::Detached>(target);
+            registry.AddHandlers<SoundDeviceEventType::ContentReset>(target);
+            registry.Add(observer);
+            Assert::AreEqual(static_cast<size_t>(2), registry.GetSize());
+
+            registry.Notify(SoundDeviceEventType::Discovered, "pnp", 1);
+            registry.Notify(SoundDeviceEventType::VolumeRenderChanged, "pnp", 2);
+            registry.Notify(SoundDeviceEventType::Detached, "pnp", 3);
+            registry.Notify(SoundDeviceEventType::ContentReset, "", 4);
+
+            Assert::AreEqual(static_cast<uint64_t>(1), target.GetCount(SoundDeviceEventType::Discovered));
+            Assert::AreEqual(static_cast<uint64_t>(0), target.GetCount(SoundDeviceEventType::VolumeRenderChanged));
+            Assert::AreEqual(static_cast<uint64_t>(1), target.GetCount(SoundDeviceEventType::Detached));
+            // registered already: the second registration is ignored
+            Assert::AreEqual(static_cast<uint64_t>(0), target.GetCount(SoundDeviceEventType::ContentReset));
+            Assert::AreEqual(static_cast<uint64_t>(4), observer.GetCount());
+
+            registry.RemoveHandlers(target, false);
+            registry.Notify(SoundDeviceEventType::Discovered, "pnp", 5);
+            Assert::AreEqual(static_cast<uint64_t>(1), target.GetCount(SoundDeviceEventType::Discovered));
+            Assert::AreEqual(static_cast<uint64_t>(5), observer.GetCount());
+            Assert::AreEqual(static_cast<size_t>(1), registry.GetSize());
+        }
+
+        // Per event, over all event types in turn; half of them routed.
+        TEST_METHOD(DispatchMicroBenchmark)
+        {
+            constexpr int notificationCount = 400'000;
+            const auto pnpId = "{0.0.0.00000000}.{5B7BBF93-1CE3-7A17-DC7A-432D3575AFB6}"s;
+            const auto measure = [&pnpId](const ObserverRegistry& registry)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < notificationCount; ++i)
+                {
+                    registry.Notify(static_cast<SoundDeviceEventType>(i % ObserverRegistry::event_type_count), pnpId, 1);
+                }
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+                return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / notificationCount;
+            };
+
+            for (const size_t observerCount : { 1, 2, 4, 8, 16, 32, 64 })
+            {
+                ObserverRegistry virtualRegistry;
+                std::vector<std::unique_ptr<BranchingRouter>> branchingRouters;
+                ObserverRegistry handlerRegistry;
+                std::vector<std::unique_ptr<HandlerRouter>> handlerRouters;
+                for (size_t i = 0; i < observerCount; ++i)
+                {
+                    branchingRouters.push_back(std::make_unique<BranchingRouter>());
+                    virtualRegistry.Add(*branchingRouters.back());
+                    handlerRouters.push_back(std::make_unique<HandlerRouter>());
+                    handlerRegistry.AddHandlers<
+                        SoundDeviceEventType::DefaultRenderChanged,
+                        SoundDeviceEventType::DefaultCaptureChanged,
+                        SoundDeviceEventType::VolumeRenderChanged,
+                        SoundDeviceEventType::VolumeCaptureChanged>(*handlerRouters.back());
+                }
+
+                const auto nsVirtual = measure(virtualRegistry);
+                const auto nsHandlers = measure(handlerRegistry);
+                Logger::WriteMessage(std::format("{} observer(s), ns per event: virtual and branching {:.1f}, handlers per event type {:.1f}\n",
+                    observerCount, nsVirtual, nsHandlers).c_str());
+
+                Assert::AreEqual(branchingRouters.front()->GetRouted(), handlerRouters.front()->GetRouted());
+                Assert::IsTrue(handlerRouters.front()->GetRouted() > 0);
+            }
+        }
+    };
+}
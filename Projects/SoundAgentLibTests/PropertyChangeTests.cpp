@@ -0,0 +1,200 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "EndpointSimulator.h"
+#include "SoundDeviceCollection.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        class RecordingObserver final : public SoundDeviceObserverInterface {
+        public:
+            RecordingObserver() = default;
+            DISALLOW_COPY_MOVE(RecordingObserver);
+            ~RecordingObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t) override
+            {
+                std::lock_guard lock(mutex_);
+                events_.emplace_back(event, devicePnpId);
+                changed_.notify_all();
+            }
+
+            // Waits for the next event, delivered on the dispatcher thread.
+            std::pair<SoundDeviceEventType, std::string> Next()
+            {
+                std::unique_lock lock(mutex_);
+                Assert::IsTrue(changed_.wait_for(lock, 5s, [this] { return next_ < events_.size(); }), L"Event expected");
+                return events_[next_++];
+            }
+
+        private:
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::vector<std::pair<SoundDeviceEventType, std::string>> events_;
+            size_t next_ = 0;
+        };
+
+        // Of no property the collection reads, like the audio engine's device format.
+        constexpr PROPERTYKEY unrelated_key{ { 0xf19f064d, 0x082c, 0x4e27, { 0xbc, 0x73, 0x68, 0x82, 0xa1, 0xbb, 0x8e, 0x4c } }, 0 };
+    }
+
+    // Property changes of registered endpoints update their devices alone, with no reset.
+    TEST_CLASS(PropertyChangeTests)
+    {
+        TEST_METHOD(RenameUpdatesMergedDeviceTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"headset-out", L"Headset", eRender, 300, L"headset");
+            simulator.AddEndpoint(L"headset-in", L"Headset Hands-Free", eCapture, 600, L"headset");
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+            RecordingObserver observer;
+            collection.Subscribe(observer);
+            const auto headset = EndpointSimulator::GetPnpIdOfContainer(L"headset");
+            const auto stateVersion = collection.GetStateVersion();
+
+            Assert::IsTrue(simulator.SetName(L"headset-out", L"Work Headset"));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::PropertyChanged, headset));
+            Assert::AreEqual(stateVersion + 1, collection.GetStateVersion());
+            const auto device = collection.CreateItem(headset);
+            Assert::AreEqual("Headset Hands-Free/Work Headset"s, device->GetName());
+            Assert::IsTrue(device->GetFlow() == SoundDeviceFlowType::RenderAndCapture);
+            Assert::AreEqual(static_cast<uint16_t>(300), device->GetCurrentRenderVolume());
+            Assert::AreEqual(static_cast<uint16_t>(600), device->GetCurrentCaptureVolume());
+
+            // the same name again changes nothing
+            Assert::IsTrue(simulator.SetName(L"headset-out", L"Work Headset"));
+            Assert::AreEqual(stateVersion + 1, collection.GetStateVersion());
+            collection.Unsubscribe(observer, true);
+        }
+
+        // A device of both flows takes the form factor of its render endpoint.
+        TEST_METHOD(FormFactorChangeTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"jack-out", L"Line Out", eRender, 500, L"jack");
+            simulator.AddEndpoint(L"jack-in", L"Line In", eCapture, 500, L"jack");
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+            RecordingObserver observer;
+            collection.Subscribe(observer);
+            const auto jack = EndpointSimulator::GetPnpIdOfContainer(L"jack");
+
+            Assert::IsTrue(simulator.SetFormFactor(L"jack-out", Headphones));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::PropertyChanged, jack));
+            Assert::IsTrue(collection.CreateItem(jack)->GetFormFactor() == SoundDeviceFormFactor::Headphones);
+
+            const auto stateVersion = collection.GetStateVersion();
+            Assert::IsTrue(simulator.SetFormFactor(L"jack-in", LineLevel));
+            Assert::AreEqual(stateVersion, collection.GetStateVersion(), L"The capture endpoint does not describe the device");
+            Assert::IsTrue(collection.CreateItem(jack)->GetFormFactor() == SoundDeviceFormFactor::Headphones);
+            collection.Unsubscribe(observer, true);
+        }
+
+        // A new container moves the endpoint, with its volume and default role, out of its device into another one.
+        TEST_METHOD(ContainerChangeMovesEndpointTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"headset-out", L"Headset", eRender, 300, L"headset");
+            simulator.AddEndpoint(L"microphone", L"Microphone", eCapture, 650);
+            simulator.SetDefaultEndpoint(L"microphone");
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+            RecordingObserver observer;
+            collection.Subscribe(observer);
+            const auto headset = EndpointSimulator::GetPnpIdOfContainer(L"headset");
+            const auto microphone = EndpointSimulator::GetPnpIdOfContainer(L"microphone");
+            Assert::AreEqual(static_cast<size_t>(2), collection.GetSize());
+
+            Assert::IsTrue(simulator.SetContainer(L"microphone", L"headset"));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::Detached, microphone));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::PropertyChanged, headset));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::DefaultCaptureChanged, headset));
+            Assert::AreEqual(static_cast<size_t>(1), collection.GetSize());
+            const auto device = collection.CreateItem(headset);
+            Assert::IsTrue(device->GetFlow() == SoundDeviceFlowType::RenderAndCapture);
+            Assert::AreEqual("Headset/Microphone"s, device->GetName());
+            Assert::AreEqual(static_cast<uint16_t>(650), device->GetCurrentCaptureVolume());
+            Assert::IsTrue(device->IsCaptureCurrentlyDefault());
+            Assert::IsTrue(collection.GetDefaultCaptureDevicePnpId() == headset);
+
+            // and back: the render endpoint stays behind alone
+            Assert::IsTrue(simulator.SetContainer(L"microphone", L""));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::PropertyChanged, headset));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::Discovered, microphone));
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::DefaultCaptureChanged, microphone));
+            Assert::IsTrue(collection.CreateItem(headset)->GetFlow() == SoundDeviceFlowType::Render);
+            Assert::AreEqual(static_cast<uint16_t>(650), collection.CreateItem(microphone)->GetCurrentCaptureVolume());
+
+            const auto audit = collection.Audit();
+            Assert::AreEqual(static_cast<size_t>(0), audit.OrphanEndpoints);
+            Assert::AreEqual(static_cast<size_t>(0), audit.DevicesWithoutEndpoints);
+            collection.Unsubscribe(observer, true);
+        }
+
+        TEST_METHOD(OtherPropertiesIgnoredTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400);
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+            const auto stateVersion = collection.GetStateVersion();
+
+            Assert::IsTrue(simulator.NotifyPropertyValueChanged(L"speakers", unrelated_key));
+            Assert::IsTrue(simulator.NotifyPropertyValueChanged(L"speakers", PKEY_Device_FriendlyName), L"Unchanged");
+            Assert::AreEqual(stateVersion, collection.GetStateVersion());
+        }
+
+        // What a rename costs handled incrementally, against the periodic reset the tooling used to pick it up with.
+        TEST_METHOD(IncrementalUpdateCostTest)
+        {
+            constexpr int containers = 12;
+            EndpointSimulator simulator;
+            for (int i = 0; i < containers; ++i)
+            {
+                const auto number = std::to_wstring(i);
+                simulator.AddEndpoint(L"out-" + number, L"Output " + number, eRender, 500, L"container-" + number);
+                simulator.AddEndpoint(L"in-" + number, L"Input " + number, eCapture, 500, L"container-" + number);
+            }
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+
+            constexpr int changes = 400;
+            const auto incrementalStart = std::chrono::steady_clock::now();
+            for (int i = 0; i < changes; ++i)
+            {
+                simulator.SetName(L"out-" + std::to_wstring(i % containers), L"Renamed " + std::to_wstring(i));
+            }
+            const auto perChange = (std::chrono::steady_clock::now() - incrementalStart) / changes;
+            Assert::AreEqual(static_cast<size_t>(containers), collection.GetSize());
+
+            const auto resetStart = std::chrono::steady_clock::now();
+            for (int i = 0; i < changes; ++i)
+            {
+                collection.ResetContent();
+            }
+            const auto perReset = (std::chrono::steady_clock::now() - resetStart) / changes;
+
+            Logger::WriteMessage(std::format("{} endpoints: {:.1f} us per incremental property change, {:.1f} us per reset, {:.0f}x\n",
+                2 * containers, std::chrono::duration<double, std::micro>(perChange).count(),
+                std::chrono::duration<double, std::micro>(perReset).count(),
+                std::chrono::duration<double>(perReset) / std::chrono::duration<double>(perChange)).c_str());
+            Assert::IsTrue(perChange < perReset);
+        }
+    };
+}
@@ -0,0 +1,147 @@
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "EndpointSimulator.h"
+#include "SerialWorker.h"
+#include "SoundDeviceCollection.h"
+
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        using Readiness = SerialWorker::Readiness;
+
+        int64_t ToMicroseconds(std::chrono::steady_clock::duration duration)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        }
+    }
+
+    TEST_CLASS(SerialWorkerTests)
+    {
+        TEST_METHOD(TasksRunInPostedOrderTest)
+        {
+            std::vector<int> order;
+            SerialWorker worker;
+            for (int i = 0; i < 100; ++i)
+            {
+                worker.Post([&order, i] { order.push_back(i); });
+            }
+            worker.WaitUntilIdle();
+
+            Assert::AreEqual(static_cast<size_t>(100), order.size());
+            for (int i = 0; i < 100; ++i)
+            {
+                Assert::AreEqual(i, order[i]);
+            }
+        }
+
+        TEST_METHOD(FailingTaskDoesNotStopWorkerTest)
+        {
+            std::atomic<int> ran = 0;
+            SerialWorker worker;
+            worker.Post([] { throw std::runtime_error("Enumeration failed"); });
+            worker.Post([&ran] { ++ran; });
+            worker.WaitUntilIdle();
+            Assert::AreEqual(1, ran.load());
+        }
+
+        TEST_METHOD(DestructionRunsPendingTasksTest)
+        {
+            std::atomic<int> ran = 0;
+            {
+                SerialWorker worker;
+                worker.Post([] { std::this_thread::sleep_for(50ms); });
+                for (int i = 0; i < 10; ++i)
+                {
+                    worker.Post([&ran] { ++ran; });
+                }
+            }
+            Assert::AreEqual(10, ran.load());
+        }
+
+        TEST_METHOD(FirstReadinessWinsTest)
+        {
+            SerialWorker worker;
+            Assert::IsTrue(worker.GetReadiness() == Readiness::Pending);
+            Assert::IsTrue(worker.WaitForReadiness(20ms) == Readiness::Pending, L"Times out");
+
+            worker.Post([&worker]
+                {
+                    std::this_thread::sleep_for(50ms);
+                    worker.SetReadiness(Readiness::Failed);
+                });
+            Assert::IsTrue(worker.WaitForReadiness(5s) == Readiness::Failed);
+            worker.SetReadiness(Readiness::Ready);
+            Assert::IsTrue(worker.GetReadiness() == Readiness::Failed);
+        }
+
+        TEST_METHOD(WorkerThreadDetectedTest)
+        {
+            std::atomic<bool> fromTask = false;
+            SerialWorker worker;
+            worker.Post([&worker, &fromTask] { fromTask = worker.IsWorkerThread(); });
+            worker.WaitUntilIdle();
+            Assert::IsTrue(fromTask.load());
+            Assert::IsFalse(worker.IsWorkerThread());
+        }
+
+        TEST_METHOD(CallerBlockingBenchmark)
+        {
+            constexpr auto latency = 200ms;
+            EndpointSimulator simulator;
+            for (int i = 0; i < 20; ++i)
+            {
+                simulator.AddEndpoint(L"endpoint-" + std::to_wstring(i), L"Endpoint " + std::to_wstring(i), i % 2 == 0 ? eRender : eCapture, 500);
+            }
+            simulator.SetDefaultEndpoint(L"endpoint-0");
+            simulator.SetEnumerationLatency(latency);
+
+            // Before: set-up and enumeration on the calling thread, as SaaInitialize and SaaRegisterCallbacks do.
+            auto start = std::chrono::steady_clock::now();
+            {
+                SoundDeviceCollection collection(simulator.GetEnumerator());
+                collection.ResetContent();
+                const auto blocked = std::chrono::steady_clock::now() - start;
+                Assert::AreEqual(static_cast<size_t>(20), collection.GetSize());
+                Logger::WriteMessage(std::format("Synchronous start: caller blocked {} us\n", ToMicroseconds(blocked)).c_str());
+                Assert::IsTrue(blocked >= latency);
+            }
+
+            // After: the same on a worker, as SaaInitializeAsync and SaaRegisterCallbacksAsync do.
+            std::unique_ptr<SoundDeviceCollection> collection;
+            SerialWorker worker;
+            start = std::chrono::steady_clock::now();
+            worker.Post([&collection, &worker, &simulator]
+                {
+                    collection = std::make_unique<SoundDeviceCollection>(simulator.GetEnumerator());
+                    collection->ResetContent();
+                    worker.SetReadiness(Readiness::Ready);
+                });
+            const auto blocked = std::chrono::steady_clock::now() - start;
+            Assert::IsTrue(worker.GetReadiness() == Readiness::Pending, L"Getters answer not ready meanwhile");
+
+            Assert::IsTrue(worker.WaitForReadiness(5s) == Readiness::Ready);
+            const auto ready = std::chrono::steady_clock::now() - start;
+            Assert::AreEqual(static_cast<size_t>(20), collection->GetSize());
+            Logger::WriteMessage(std::format("Asynchronous start: caller blocked {} us, ready after {} us\n",
+                ToMicroseconds(blocked), ToMicroseconds(ready)).c_str());
+            Assert::IsTrue(blocked < latency / 10);
+            worker.WaitUntilIdle();
+            worker.Post([&collection] { collection.reset(); });
+        }
+    };
+}
@@ -0,0 +1,399 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <CppUnitTest.h>
+
+#include "ComExecutor.h"
+#include "EndpointSimulator.h"
+#include "SoundDeviceCollection.h"
+#include "VolumeWriter.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        class RecordingObserver final : public SoundDeviceObserverInterface {
+        public:
+            RecordingObserver() = default;
+            DISALLOW_COPY_MOVE(RecordingObserver);
+            ~RecordingObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t) override
+            {
+                std::lock_guard lock(mutex_);
+                events_.emplace_back(event, devicePnpId);
+                changed_.notify_all();
+            }
+
+            // Waits for the next event, delivered on the dispatcher thread.
+            std::pair<SoundDeviceEventType, std::string> Next()
+            {
+                std::unique_lock lock(mutex_);
+                Assert::IsTrue(changed_.wait_for(lock, 5s, [this] { return next_ < events_.size(); }), L"Event expected");
+                return events_[next_++];
+            }
+
+            size_t GetCount()
+            {
+                std::lock_guard lock(mutex_);
+                return events_.size();
+            }
+
+        private:
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::vector<std::pair<SoundDeviceEventType, std::string>> events_;
+            size_t next_ = 0;
+        };
+
+        // Records the writes of a VolumeWriter; while closed, holds the first write, so that commands pile up behind it.
+        class WriteRecorder final {
+        public:
+            struct Written {
+                VolumeWriter::Key Key;
+                uint16_t Volume;
+                std::chrono::steady_clock::time_point Time;
+            };
+
+        public:
+            bool Write(VolumeWriter::Key key, uint16_t volume)
+            {
+                std::unique_lock lock(mutex_);
+                written_.push_back({ key, volume, std::chrono::steady_clock::now() });
+                changed_.notify_all();
+                changed_.wait(lock, [this] { return open_; });
+                return true;
+            }
+
+            void WaitForWrites(size_t count)
+            {
+                std::unique_lock lock(mutex_);
+                Assert::IsTrue(changed_.wait_for(lock, 5s, [this, count] { return written_.size() >= count; }), L"Write expected");
+            }
+
+            void Open()
+            {
+                std::lock_guard lock(mutex_);
+                open_ = true;
+                changed_.notify_all();
+            }
+
+            void Close()
+            {
+                std::lock_guard lock(mutex_);
+                open_ = false;
+            }
+
+            std::vector<Written> GetWritten() const
+            {
+                std::lock_guard lock(mutex_);
+                return written_;
+            }
+
+        private:
+            mutable std::mutex mutex_;
+            std::condition_variable changed_;
+            bool open_ = true;
+            std::vector<Written> written_;
+        };
+
+        // The executor thread, without COM.
+        class NoApartment final : public ComExecutor::Apartment {
+        public:
+            NoApartment() = default;
+            DISALLOW_COPY_MOVE(NoApartment);
+            ~NoApartment() override = default;
+
+            bool Enter() override { return true; }
+            void Leave() override {}
+        };
+    }
+
+    TEST_CLASS(VolumeWriterTests)
+    {
+        // The commands given while a write runs end up as one write per endpoint, of the latest volume.
+        TEST_METHOD(LatestCommandWinsTest)
+        {
+            WriteRecorder recorder;
+            recorder.Close();
+            VolumeWriter writer([&recorder](VolumeWriter::Key key, uint16_t volume) { return recorder.Write(key, volume); },
+                [](VolumeWriter::Key, bool) { return true; }, VolumeWriter::Options{});
+
+            writer.SetVolume(1, 100);
+            recorder.WaitForWrites(1);
+            for (uint16_t volume = 101; volume <= 200; ++volume)
+            {
+                writer.SetVolume(1, volume);
+                writer.SetVolume(2, static_cast<uint16_t>(volume + 500));
+            }
+            writer.SetVolume(3, 2000);
+            recorder.Open();
+            Assert::IsTrue(writer.WaitUntilIdle(5s));
+
+            const auto written = recorder.GetWritten();
+            Assert::AreEqual(static_cast<size_t>(4), written.size());
+            std::vector<std::pair<VolumeWriter::Key, uint16_t>> latest;
+            for (size_t i = 1; i < written.size(); ++i)
+            {
+                latest.emplace_back(written[i].Key, written[i].Volume);
+            }
+            std::ranges::sort(latest);
+            Assert::IsTrue(latest == std::vector<std::pair<VolumeWriter::Key, uint16_t>>{ { 1, 200 }, { 2, 700 }, { 3, 1000 } },
+                L"The latest volume of each endpoint, clamped");
+
+            const auto statistics = writer.GetStatistics();
+            Assert::AreEqual(static_cast<uint64_t>(202), statistics.Commands);
+            Assert::AreEqual(static_cast<uint64_t>(198), statistics.Coalesced);
+            Assert::AreEqual(statistics.Commands, statistics.Writes + statistics.Coalesced);
+        }
+
+        TEST_METHOD(RampTicksTest)
+        {
+            WriteRecorder recorder;
+            VolumeWriter writer([&recorder](VolumeWriter::Key key, uint16_t volume) { return recorder.Write(key, volume); },
+                [](VolumeWriter::Key, bool) { return true; }, VolumeWriter::Options{ 10ms });
+
+            const auto start = std::chrono::steady_clock::now();
+            writer.RampVolume(1, 1000, 0, 300ms);
+            Assert::IsTrue(writer.WaitUntilIdle(5s));
+            const auto duration = std::chrono::steady_clock::now() - start;
+
+            const auto written = recorder.GetWritten();
+            Assert::AreEqual(static_cast<uint16_t>(1000), written.front().Volume);
+            Assert::AreEqual(static_cast<uint16_t>(0), written.back().Volume);
+            Assert::IsTrue(std::ranges::is_sorted(written, std::ranges::greater{}, &WriteRecorder::Written::Volume));
+            Assert::IsTrue(written.size() <= 31, L"A tick at most every 10 ms");
+            Assert::IsTrue(duration >= 300ms);
+
+            const auto statistics = writer.GetStatistics();
+            Assert::AreEqual(static_cast<uint64_t>(written.size()), statistics.RampTicks);
+            Logger::WriteMessage(std::format("Ramp of 300 ms at 10 ms: {} ticks in {:.1f} ms, lateness {:.2f} ms on average, {:.2f} ms at most\n",
+                statistics.RampTicks, std::chrono::duration<double, std::milli>(duration).count(),
+                std::chrono::duration<double, std::milli>(statistics.TotalTickLateness).count() / static_cast<double>(statistics.RampTicks),
+                std::chrono::duration<double, std::milli>(statistics.MaxTickLateness).count()).c_str());
+        }
+
+        // A plain set cancels a running ramp of the endpoint.
+        TEST_METHOD(SetReplacesRampTest)
+        {
+            WriteRecorder recorder;
+            VolumeWriter writer([&recorder](VolumeWriter::Key key, uint16_t volume) { return recorder.Write(key, volume); },
+                [](VolumeWriter::Key, bool) { return true; }, VolumeWriter::Options{ 10ms });
+
+            writer.RampVolume(1, 0, 1000, 10s);
+            recorder.WaitForWrites(3);
+            writer.SetVolume(1, 333);
+            Assert::IsTrue(writer.WaitUntilIdle(1s));
+            Assert::AreEqual(static_cast<uint16_t>(333), recorder.GetWritten().back().Volume);
+            Assert::AreEqual(static_cast<uint64_t>(1), writer.GetStatistics().Coalesced);
+        }
+
+        // Sets and ramp ticks are written on the executor, not on the writer's thread.
+        TEST_METHOD(WritesRunOnExecutorTest)
+        {
+            ComExecutor executor(std::make_unique<NoApartment>());
+            std::atomic<int> writes = 0;
+            std::atomic<int> writesElsewhere = 0;
+            const auto write = [&executor, &writes, &writesElsewhere]
+                {
+                    writesElsewhere += executor.IsExecutorThread() ? 0 : 1;
+                    ++writes;
+                    return true;
+                };
+            VolumeWriter writer([&write](VolumeWriter::Key, uint16_t) { return write(); }, [&write](VolumeWriter::Key, bool) { return write(); },
+                VolumeWriter::Options{ 10ms }, &executor);
+
+            writer.SetMute(1, true);
+            writer.RampVolume(2, 0, 1000, 50ms);
+            Assert::IsTrue(writer.WaitUntilIdle(5s));
+            Assert::IsTrue(writes >= 3);
+            Assert::AreEqual(0, writesElsewhere.load());
+        }
+
+        // Once stopped, commands are dropped and the writer is never idle.
+        TEST_METHOD(StopDropsCommandsTest)
+        {
+            WriteRecorder recorder;
+            VolumeWriter writer([&recorder](VolumeWriter::Key key, uint16_t volume) { return recorder.Write(key, volume); },
+                [](VolumeWriter::Key, bool) { return true; }, VolumeWriter::Options{});
+
+            writer.SetVolume(1, 100);
+            Assert::IsTrue(writer.WaitUntilIdle(5s));
+            writer.Stop();
+            writer.SetVolume(1, 200);
+            Assert::IsFalse(writer.WaitUntilIdle(10ms));
+            Assert::AreEqual(static_cast<size_t>(1), recorder.GetWritten().size());
+        }
+
+        // The collection takes what it wrote to the endpoint without notifying it; another collection is notified.
+        TEST_METHOD(SimulatedWriteEchoSuppressedTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400);
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+            SoundDeviceCollection other(simulator.GetEnumerator());
+            other.ResetContent();
+            RecordingObserver observer;
+            collection.Subscribe(observer);
+            RecordingObserver otherObserver;
+            other.Subscribe(otherObserver);
+            const auto speakers = EndpointSimulator::GetPnpIdOfContainer(L"speakers");
+            const auto stateVersion = collection.GetStateVersion();
+            const auto from = std::chrono::system_clock::now();
+
+            Assert::IsTrue(collection.SetVolume(speakers, SoundDeviceFlowType::Render, 750));
+            Assert::IsTrue(collection.WaitForVolumeWrites(5s));
+            Assert::AreEqual(static_cast<uint16_t>(750), simulator.GetVolume(L"speakers"));
+            Assert::AreEqual(static_cast<uint16_t>(750), collection.CreateItem(speakers)->GetCurrentRenderVolume());
+            Assert::AreEqual(stateVersion + 1, collection.GetStateVersion());
+            Assert::IsTrue(otherObserver.Next() == std::pair(SoundDeviceEventType::VolumeRenderChanged, speakers));
+            Assert::AreEqual(static_cast<uint16_t>(750), other.CreateItem(speakers)->GetCurrentRenderVolume());
+
+            Assert::IsTrue(collection.SetMute(speakers, SoundDeviceFlowType::Render, true));
+            Assert::IsTrue(collection.WaitForVolumeWrites(5s));
+            Assert::IsTrue(simulator.IsMuted(L"speakers"));
+            Assert::AreEqual(static_cast<uint16_t>(0), collection.CreateItem(speakers)->GetCurrentRenderVolume(), L"Muted reads as 0");
+            const auto history = collection.GetHistory(speakers, SoundDeviceHistoryKind::RenderVolume, from,
+                std::chrono::system_clock::now() + 1h);
+            Assert::AreEqual(static_cast<size_t>(2), history.size());
+            Assert::AreEqual(static_cast<uint16_t>(750), history.front().Value);
+            Assert::AreEqual(static_cast<uint16_t>(0), history.back().Value);
+
+            Assert::IsTrue(collection.SetMute(speakers, SoundDeviceFlowType::Render, false));
+            Assert::IsTrue(collection.WaitForVolumeWrites(5s));
+            Assert::AreEqual(static_cast<uint16_t>(750), collection.CreateItem(speakers)->GetCurrentRenderVolume(), L"The level is kept");
+
+            // the first event is of the change by someone else: the own writes raised none
+            simulator.SetVolume(L"speakers", 500);
+            Assert::IsTrue(observer.Next() == std::pair(SoundDeviceEventType::VolumeRenderChanged, speakers));
+            Assert::AreEqual(static_cast<uint16_t>(500), collection.CreateItem(speakers)->GetCurrentRenderVolume());
+
+            Assert::IsFalse(collection.SetVolume(speakers, SoundDeviceFlowType::Capture, 500), L"No capture endpoint");
+            Assert::IsFalse(collection.SetVolume("unknown", SoundDeviceFlowType::Render, 500));
+            collection.Unsubscribe(observer, true);
+            other.Unsubscribe(otherObserver, true);
+            Assert::AreEqual(static_cast<size_t>(1), observer.GetCount(), L"Only the change by someone else");
+        }
+
+        // Stopped with the collection: later writes are refused.
+        TEST_METHOD(SimulatedWritesStopWithCollectionTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400);
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+            const auto speakers = EndpointSimulator::GetPnpIdOfContainer(L"speakers");
+
+            Assert::IsTrue(collection.SetVolume(speakers, SoundDeviceFlowType::Render, 750));
+            Assert::IsTrue(collection.WaitForVolumeWrites(5s));
+            collection.DeactivateAndStopLoop();
+            Assert::IsFalse(collection.SetVolume(speakers, SoundDeviceFlowType::Render, 500));
+            Assert::IsFalse(collection.RampVolume(speakers, SoundDeviceFlowType::Render, 500, 10ms));
+            Assert::AreEqual(static_cast<uint16_t>(750), simulator.GetVolume(L"speakers"));
+        }
+
+        TEST_METHOD(SimulatedRampTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"headset-out", L"Headset", eRender, 300, L"headset");
+            simulator.AddEndpoint(L"headset-in", L"Headset Hands-Free", eCapture, 650, L"headset");
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+            const auto headset = EndpointSimulator::GetPnpIdOfContainer(L"headset");
+            const auto from = std::chrono::system_clock::now();
+
+            Assert::IsTrue(collection.RampVolume(headset, SoundDeviceFlowType::Capture, 50, 100ms));
+            Assert::IsTrue(collection.WaitForVolumeWrites(5s));
+            Assert::AreEqual(static_cast<uint16_t>(50), simulator.GetVolume(L"headset-in"));
+            Assert::AreEqual(static_cast<uint16_t>(300), simulator.GetVolume(L"headset-out"), L"The other flow is untouched");
+            const auto device = collection.CreateItem(headset);
+            Assert::AreEqual(static_cast<uint16_t>(50), device->GetCurrentCaptureVolume());
+            Assert::AreEqual(static_cast<uint16_t>(300), device->GetCurrentRenderVolume());
+
+            const auto history = collection.GetHistory(headset, SoundDeviceHistoryKind::CaptureVolume, from,
+                std::chrono::system_clock::now() + 1h);
+            Assert::IsTrue(history.size() > 2, L"The steps of the ramp are history");
+        }
+
+        // A ramp of a muted endpoint starts from its level, not from the 0 it reads as.
+        TEST_METHOD(SimulatedRampWhileMutedTest)
+        {
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 600);
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+            const auto speakers = EndpointSimulator::GetPnpIdOfContainer(L"speakers");
+            Assert::IsTrue(collection.SetMute(speakers, SoundDeviceFlowType::Render, true));
+            Assert::IsTrue(collection.WaitForVolumeWrites(5s));
+            Assert::AreEqual(static_cast<uint16_t>(0), collection.CreateItem(speakers)->GetCurrentRenderVolume());
+
+            Assert::IsTrue(collection.RampVolume(speakers, SoundDeviceFlowType::Render, 200, 200ms));
+            uint16_t lowest = 1000;
+            uint16_t highest = 0;
+            while (!collection.WaitForVolumeWrites(1ms))
+            {
+                const auto level = simulator.GetVolume(L"speakers");
+                lowest = std::min(lowest, level);
+                highest = std::max(highest, level);
+            }
+            Assert::IsTrue(lowest >= 200 && highest <= 600, L"Between the level and the target throughout");
+            Assert::AreEqual(static_cast<uint16_t>(200), simulator.GetVolume(L"speakers"));
+            Assert::IsTrue(simulator.IsMuted(L"speakers"), L"Still muted");
+        }
+
+        // Commands against what the simulated endpoints take: the excess is coalesced instead of queued.
+        TEST_METHOD(WritesPerSecondTest)
+        {
+            constexpr int endpoints = 16;
+            EndpointSimulator simulator;
+            std::vector<std::string> pnpIds;
+            for (int i = 0; i < endpoints; ++i)
+            {
+                const auto number = std::to_wstring(i);
+                simulator.AddEndpoint(L"out-" + number, L"Output " + number, eRender, 500);
+                pnpIds.push_back(EndpointSimulator::GetPnpIdOfContainer(L"out-" + number));
+            }
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+
+            constexpr int commands = 100000;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < commands; ++i)
+            {
+                collection.SetVolume(pnpIds[i % endpoints], SoundDeviceFlowType::Render, static_cast<uint16_t>(i % 1001));
+            }
+            Assert::IsTrue(collection.WaitForVolumeWrites(30s));
+            const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+            const auto statistics = *collection.GetVolumeWriteStatistics();
+            Assert::AreEqual(static_cast<uint64_t>(commands), statistics.Commands);
+            Assert::AreEqual(statistics.Commands, statistics.Writes + statistics.Coalesced);
+            Assert::AreEqual(static_cast<uint64_t>(0), statistics.FailedWrites);
+            for (int i = commands - endpoints; i < commands; ++i)
+            {
+                Assert::AreEqual(static_cast<uint16_t>(i % 1001), collection.CreateItem(pnpIds[i % endpoints])->GetCurrentRenderVolume(),
+                    L"The latest command wins");
+            }
+            Logger::WriteMessage(std::format("{} endpoints: {:.0f} commands/s, {:.0f} writes/s, {:.1f}% coalesced\n",
+                endpoints, commands / duration.count(), static_cast<double>(statistics.Writes) / duration.count(),
+                100.0 * static_cast<double>(statistics.Coalesced) / static_cast<double>(statistics.Commands)).c_str());
+        }
+    };
+}
@@ -0,0 +1,324 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <CppUnitTest.h>
+
+#include "EndpointSimulator.h"
+#include "SnapshotFile.h"
+#include "SoundDeviceCollection.h"
+#include "WarmStart.h"
+
+using namespace std::literals::string_literals;
+using namespace std::literals::chrono_literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        // A snapshot file path of its own, in a directory removed afterwards.
+        class SnapshotPath {
+        public:
+            explicit SnapshotPath(const std::string & name)
+                : directory_(std::filesystem::temp_directory_path() / std::format("SoundAgentLibTests-{}-{}", name,
+                    std::chrono::steady_clock::now().time_since_epoch().count()))
+            {
+            }
+
+            ~SnapshotPath()
+            {
+                std::error_code ignored;
+                std::filesystem::remove_all(directory_, ignored);
+            }
+
+            [[nodiscard]] std::filesystem::path Get() const { return directory_ / "devices.snapshot"; }
+
+            void Write(const std::string & bytes) const
+            {
+                std::filesystem::create_directories(directory_);
+                std::ofstream(Get(), std::ios::binary | std::ios::trunc) << bytes;
+            }
+
+        private:
+            const std::filesystem::path directory_;
+        };
+
+        class EventSet final : public SoundDeviceObserverInterface {
+        public:
+            EventSet() = default;
+            DISALLOW_COPY_MOVE(EventSet);
+            ~EventSet() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId, uint64_t) override
+            {
+                std::lock_guard lock(mutex_);
+                events_.emplace(event, devicePnpId);
+            }
+
+            [[nodiscard]] std::set<std::pair<SoundDeviceEventType, std::string>> Get() const
+            {
+                std::lock_guard lock(mutex_);
+                return events_;
+            }
+
+        private:
+            mutable std::mutex mutex_;
+            std::set<std::pair<SoundDeviceEventType, std::string>> events_;
+        };
+
+        void WaitForDelivery(const SoundDeviceCollection & collection)
+        {
+            for (const auto deadline = std::chrono::steady_clock::now() + 5s; std::chrono::steady_clock::now() < deadline;)
+            {
+                if (const auto statistics = collection.GetDeliveryStatistics()
+                    ; statistics.Delivered + statistics.Coalesced + statistics.DiscardedAsStale == statistics.Posted)
+                {
+                    return;
+                }
+                std::this_thread::sleep_for(5ms);
+            }
+            Assert::Fail(L"Events not delivered");
+        }
+
+        SoundDeviceCollectionSnapshot CreateSampleSnapshot()
+        {
+            SoundDeviceCollectionSnapshot snapshot;
+            snapshot.Devices.push_back(std::make_unique<SoundDevice>("{0.0.0.00000000}.{5B7BBF93-1CE3-7A17-DC7A-432D3575AF01}",
+                "Speakers (High Definition Audio Device)", SoundDeviceFlowType::Render, 400, 0, true, false, SoundDeviceFormFactor::Speakers));
+            snapshot.Devices.push_back(std::make_unique<SoundDevice>("{0.0.1.00000000}.{5B7BBF93-1CE3-7A17-DC7A-432D3575AF02}",
+                "Headset/Headset Microphone", SoundDeviceFlowType::RenderAndCapture, 1000, 650, false, true, SoundDeviceFormFactor::Headphones));
+            snapshot.Devices.push_back(std::make_unique<SoundDevice>("{0.0.1.00000000}.{5B7BBF93-1CE3-7A17-DC7A-432D3575AF03}",
+                "", SoundDeviceFlowType::Capture, 0, 0, false, false));
+            snapshot.DefaultRenderDevicePnpId = snapshot.Devices[0]->GetPnpId();
+            snapshot.DefaultCaptureDevicePnpId = snapshot.Devices[1]->GetPnpId();
+            return snapshot;
+        }
+
+        void CheckSampleContent(const SnapshotFile::Content & content)
+        {
+            const auto expected = CreateSampleSnapshot();
+            Assert::AreEqual(expected.Devices.size(), content.Devices.size());
+            for (size_t i = 0; i < expected.Devices.size(); ++i)
+            {
+                const auto & device = content.Devices[i];
+                Assert::AreEqual(expected.Devices[i]->GetPnpId(), device.GetPnpId());
+                Assert::AreEqual(expected.Devices[i]->GetName(), device.GetName());
+                Assert::IsTrue(expected.Devices[i]->GetFlow() == device.GetFlow());
+                Assert::IsTrue(expected.Devices[i]->GetFormFactor() == device.GetFormFactor());
+                Assert::AreEqual(expected.Devices[i]->GetCurrentRenderVolume(), device.GetCurrentRenderVolume());
+                Assert::AreEqual(expected.Devices[i]->GetCurrentCaptureVolume(), device.GetCurrentCaptureVolume());
+                Assert::AreEqual(expected.Devices[i]->IsRenderCurrentlyDefault(), device.IsRenderCurrentlyDefault());
+                Assert::AreEqual(expected.Devices[i]->IsCaptureCurrentlyDefault(), device.IsCaptureCurrentlyDefault());
+            }
+            Assert::IsTrue(expected.DefaultRenderDevicePnpId == content.DefaultRenderDevicePnpId);
+            Assert::IsTrue(expected.DefaultCaptureDevicePnpId == content.DefaultCaptureDevicePnpId);
+        }
+
+        // The devices of the previous run: speakers, a monitor and a headset; a collection saves them.
+        void SetUpPreviousRun(EndpointSimulator & simulator, const std::filesystem::path & snapshotPath)
+        {
+            simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400);
+            simulator.AddEndpoint(L"monitor", L"Monitor", eRender, 300);
+            simulator.AddEndpoint(L"headset", L"Headset", eCapture, 600);
+            simulator.SetDefaultEndpoint(L"speakers");
+            simulator.SetDefaultEndpoint(L"headset");
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            collection.ResetContent();
+            SnapshotFile::Save(snapshotPath, collection.CreateSnapshot(), std::chrono::system_clock::now());
+        }
+    }
+
+    TEST_CLASS(WarmStartTests)
+    {
+        TEST_METHOD(SnapshotFileRoundTripTest)
+        {
+            const auto savedAt = std::chrono::system_clock::time_point(std::chrono::milliseconds(1'760'000'000'123));
+            const auto content = SnapshotFile::Decode(SnapshotFile::Encode(CreateSampleSnapshot(), savedAt));
+            CheckSampleContent(content);
+            Assert::IsTrue(savedAt == content.SavedAt);
+
+            const SnapshotPath path("snapshot-round-trip");
+            SnapshotFile::Save(path.Get(), CreateSampleSnapshot(), savedAt);
+            const auto loaded = SnapshotFile::Load(path.Get());
+            Assert::IsTrue(loaded.has_value());
+            CheckSampleContent(*loaded);
+
+            const auto empty = SnapshotFile::Decode(SnapshotFile::Encode({}, savedAt));
+            Assert::IsTrue(empty.Devices.empty());
+            Assert::IsFalse(empty.DefaultRenderDevicePnpId.has_value());
+        }
+
+        TEST_METHOD(CorruptSnapshotRejectedTest)
+        {
+            const auto bytes = SnapshotFile::Encode(CreateSampleSnapshot(), std::chrono::system_clock::now());
+            for (size_t i = 0; i < bytes.size(); ++i)
+            {
+                auto damaged = bytes;
+                damaged[i] = static_cast<char>(damaged[i] ^ 0x10);
+                Assert::ExpectException<std::runtime_error>([&damaged] { (void)SnapshotFile::Decode(damaged); });
+                Assert::ExpectException<std::runtime_error>([&bytes, i] { (void)SnapshotFile::Decode(std::string_view(bytes).substr(0, i)); });
+            }
+
+            const SnapshotPath path("snapshot-corrupt");
+            Assert::IsFalse(SnapshotFile::Load(path.Get()).has_value(), L"Missing");
+            path.Write("");
+            Assert::IsFalse(SnapshotFile::Load(path.Get()).has_value(), L"Empty");
+            path.Write(bytes.substr(0, bytes.size() - 1));
+            Assert::IsFalse(SnapshotFile::Load(path.Get()).has_value(), L"Truncated");
+            path.Write(bytes);
+            Assert::IsTrue(SnapshotFile::Load(path.Get()).has_value());
+        }
+
+        TEST_METHOD(VersionMismatchFallsBackToColdStartTest)
+        {
+            auto bytes = SnapshotFile::Encode(CreateSampleSnapshot(), std::chrono::system_clock::now());
+            bytes[4] = static_cast<char>(SnapshotFile::format_version + 1);
+            try
+            {
+                (void)SnapshotFile::Decode(bytes);
+                Assert::Fail(L"Version mismatch expected");
+            }
+            catch (const std::runtime_error & ex)
+            {
+                Assert::IsTrue(std::string(ex.what()).starts_with("Format version"));
+            }
+
+            const SnapshotPath path("snapshot-version");
+            path.Write(bytes);
+            EndpointSimulator simulator;
+            simulator.AddEndpoint(L"speakers", L"Speakers", eRender, 400);
+            SoundDeviceCollection collection(simulator.GetEnumerator());
+            {
+                WarmStart warmStart(collection, path.Get());
+                Assert::IsFalse(warmStart.IsSnapshotLoaded());
+                Assert::IsFalse(collection.CreateSnapshot().IsStale);
+                Assert::IsTrue(warmStart.JoinReconciliation());
+                Assert::IsFalse(warmStart.JoinReconciliation(), L"Joined once");
+            }
+            Assert::AreEqual(static_cast<size_t>(1), collection.GetSize());
+            // replaced by a usable one
+            Assert::AreEqual(static_cast<size_t>(1), SnapshotFile::Load(path.Get())->Devices.size());
+        }
+
+        TEST_METHOD(ReconciliationNotifiesDifferencesOnlyTest)
+        {
+            const SnapshotPath path("snapshot-reconcile");
+            EndpointSimulator simulator;
+            SetUpPreviousRun(simulator, path.Get());
+
+            // changed while the agent was not running
+            simulator.SetVolume(L"speakers", 450);
+            simulator.RemoveEndpoint(L"monitor");
+            simulator.AddEndpoint(L"usb", L"USB Speakers", eRender, 800);
+            simulator.SetDefaultEndpoint(L"usb");
+            simulator.SetEnumerationLatency(200ms);
+
+            const auto speakers = EndpointSimulator::GetPnpIdOfContainer(L"speakers");
+            const auto usb = EndpointSimulator::GetPnpIdOfContainer(L"usb");
+            {
+                SoundDeviceCollection collection(simulator.GetEnumerator());
+                WarmStart warmStart(collection, path.Get());
+                Assert::IsTrue(warmStart.IsSnapshotLoaded());
+                const auto stale = collection.CreateSnapshot();
+                Assert::IsTrue(stale.IsStale);
+                Assert::AreEqual(static_cast<size_t>(3), stale.Devices.size());
+                Assert::IsTrue(stale.DefaultRenderDevicePnpId == speakers);
+                Assert::AreEqual(static_cast<uint16_t>(400), collection.CreateItem(speakers)->GetCurrentRenderVolume());
+
+                WaitForDelivery(collection);
+                EventSet events;
+                collection.Subscribe(events);
+                Assert::IsTrue(warmStart.JoinReconciliation());
+                WaitForDelivery(collection);
+                collection.Unsubscribe(events, true);
+
+                const std::set<std::pair<SoundDeviceEventType, std::string>> expected{
+                    { SoundDeviceEventType::VolumeRenderChanged, speakers },
+                    { SoundDeviceEventType::Detached, EndpointSimulator::GetPnpIdOfContainer(L"monitor") },
+                    { SoundDeviceEventType::Discovered, usb },
+                    { SoundDeviceEventType::DefaultRenderChanged, usb }
+                };
+                Assert::IsTrue(expected == events.Get());
+                Assert::IsFalse(collection.CreateSnapshot().IsStale);
+                Assert::IsTrue(collection.GetDefaultRenderDevicePnpId() == usb);
+            }
+            const auto saved = SnapshotFile::Load(path.Get());
+            Assert::IsTrue(saved.has_value() && saved->DefaultRenderDevicePnpId == usb);
+
+            // nothing changed since: nothing to notify
+            {
+                SoundDeviceCollection collection(simulator.GetEnumerator());
+                WarmStart warmStart(collection, path.Get());
+                WaitForDelivery(collection);
+                EventSet events;
+                collection.Subscribe(events);
+                warmStart.JoinReconciliation();
+                WaitForDelivery(collection);
+                collection.Unsubscribe(events, true);
+                Assert::IsTrue(events.Get().empty());
+
+                // the initial state of a new registrant, as SaaRegisterCallbacks asks for it
+                EventSet initial;
+                collection.Subscribe(initial);
+                collection.NotifyCurrentDefaults();
+                WaitForDelivery(collection);
+                collection.Unsubscribe(initial, true);
+                const std::set<std::pair<SoundDeviceEventType, std::string>> expected{
+                    { SoundDeviceEventType::DefaultRenderChanged, usb },
+                    { SoundDeviceEventType::DefaultCaptureChanged, EndpointSimulator::GetPnpIdOfContainer(L"headset") }
+                };
+                Assert::IsTrue(expected == initial.Get());
+            }
+        }
+
+        TEST_METHOD(TimeToFirstAnswerBenchmark)
+        {
+            constexpr auto latency = 300ms;
+            const SnapshotPath path("snapshot-startup");
+            EndpointSimulator simulator;
+            for (int i = 0; i < 40; ++i)
+            {
+                simulator.AddEndpoint(L"endpoint-" + std::to_wstring(i), L"Endpoint " + std::to_wstring(i), i % 2 == 0 ? eRender : eCapture, 500);
+            }
+            simulator.SetDefaultEndpoint(L"endpoint-0");
+            simulator.SetEnumerationLatency(latency);
+
+            auto start = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::duration cold;
+            {
+                SoundDeviceCollection collection(simulator.GetEnumerator());
+                collection.ResetContent();
+                Assert::IsTrue(collection.GetDefaultRenderDevicePnpId().has_value());
+                cold = std::chrono::steady_clock::now() - start;
+                SnapshotFile::Save(path.Get(), collection.CreateSnapshot(), std::chrono::system_clock::now());
+            }
+
+            start = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::duration warm;
+            {
+                SoundDeviceCollection collection(simulator.GetEnumerator());
+                WarmStart warmStart(collection, path.Get());
+                Assert::IsTrue(collection.GetDefaultRenderDevicePnpId().has_value());
+                warm = std::chrono::steady_clock::now() - start;
+                Assert::AreEqual(static_cast<size_t>(40), collection.GetSize());
+            }
+
+            const auto toMicroseconds = [](std::chrono::steady_clock::duration duration)
+            {
+                return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+            };
+            Logger::WriteMessage(std::format("Time to first answer with a {} ms enumeration: cold {} us, warm {} us\n",
+                latency.count(), toMicroseconds(cold), toMicroseconds(warm)).c_str());
+            Assert::IsTrue(cold >= latency);
+            Assert::IsTrue(warm < latency / 10);
+        }
+    };
+}
@@ -0,0 +1,505 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <format>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "SoundAgentApi.h"
+#include "SoundAgentApiSimulation.h"
+
+// Drives SoundAgentApi over its simulated endpoint backend at a target event rate and reports
+// throughput, event-to-callback latency and the dispatcher's coalesced / dropped counts.
+// Exits with 1 if a given threshold is missed, so that a build can be gated on it.
+
+namespace
+{
+    enum class Operation : uint8_t { Add, Remove, SetDefault, SetVolume };
+    constexpr size_t operation_count = 4;
+    constexpr std::array<const char*, operation_count> operation_names = { "add", "remove", "default", "volume" };
+
+    struct CommandLineOptions
+    {
+        double Rate = 10'000.0;
+        double DurationSeconds = 10.0;
+        size_t EndpointsPerFlow = 4;
+        std::array<double, operation_count> Mix = { 1.0, 1.0, 2.0, 16.0 };
+        std::optional<double> MaxP99Milliseconds;
+        std::optional<double> MinThroughput;
+    };
+
+    bool ParseNumber(std::wstring_view text, double & value)
+    {
+        const std::wstring copy(text);
+        wchar_t * end = nullptr;
+        value = std::wcstod(copy.c_str(), &end);
+        return !copy.empty() && end == copy.c_str() + copy.size() && value >= 0.0;
+    }
+
+    // "add=1,remove=1,default=2,volume=16"; omitted operations get weight 0.
+    bool ParseMix(std::wstring_view text, std::array<double, operation_count> & mix)
+    {
+        mix.fill(0.0);
+        while (!text.empty())
+        {
+            const auto comma = text.find(L',');
+            const auto item = text.substr(0, comma);
+            text = comma == std::wstring_view::npos ? std::wstring_view() : text.substr(comma + 1);
+
+            const auto equals = item.find(L'=');
+            if (equals == std::wstring_view::npos)
+            {
+                return false;
+            }
+            const auto name = item.substr(0, equals);
+            const auto found = std::ranges::find_if(operation_names, [name](const char * operationName)
+            {
+                return std::ranges::equal(name, std::string_view(operationName));
+            });
+            if (found == operation_names.end()
+                || !ParseNumber(item.substr(equals + 1), mix[static_cast<size_t>(found - operation_names.begin())]))
+            {
+                return false;
+            }
+        }
+        return std::ranges::any_of(mix, [](double weight) { return weight > 0.0; });
+    }
+
+    bool ParseCommandLine(int argc, _TCHAR * argv[], CommandLineOptions & options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::wstring_view arg = argv[i];
+            std::wstring_view value;
+            const auto isOption = [arg, &value](std::wstring_view prefix)
+            {
+                value = arg.starts_with(prefix) ? arg.substr(prefix.size()) : std::wstring_view();
+                return arg.starts_with(prefix);
+            };
+
+            double number = 0.0;
+            if (isOption(L"--rate="))
+            {
+                if (!ParseNumber(value, options.Rate) || options.Rate <= 0.0) return false;
+            }
+            else if (isOption(L"--duration="))
+            {
+                if (!ParseNumber(value, options.DurationSeconds) || options.DurationSeconds <= 0.0) return false;
+            }
+            else if (isOption(L"--devices="))
+            {
+                if (!ParseNumber(value, number) || number < 1.0 || number > 1000.0) return false;
+                options.EndpointsPerFlow = static_cast<size_t>(number);
+            }
+            else if (isOption(L"--mix="))
+            {
+                if (!ParseMix(value, options.Mix)) return false;
+            }
+            else if (isOption(L"--max-p99-ms="))
+            {
+                if (!ParseNumber(value, number)) return false;
+                options.MaxP99Milliseconds = number;
+            }
+            else if (isOption(L"--min-throughput="))
+            {
+                if (!ParseNumber(value, number)) return false;
+                options.MinThroughput = number;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    // Matches callbacks to the injections expected to cause them, per callback event type.
+    // Default changes are delivered one by one: a callback answers the oldest pending injection.
+    // Volume changes are coalesced: a callback answers all pending injections, measured from the oldest one.
+    class LatencyTracker
+    {
+    public:
+        void Expect(SaaEventType event, Clock::time_point injected)
+        {
+            std::lock_guard lock(mutex_);
+            pending_[event].push_back(injected);
+        }
+
+        // The callback of the pending volume injections would not come anymore, e.g. as the default changed.
+        void Abandon(SaaEventType event)
+        {
+            std::lock_guard lock(mutex_);
+            abandoned_ += pending_[event].size();
+            pending_[event].clear();
+        }
+
+        void OnCallback(SaaEventType event)
+        {
+            const auto now = Clock::now();
+            std::lock_guard lock(mutex_);
+            ++callbacks_;
+            auto & pending = pending_[event];
+            if (pending.empty())
+            {
+                ++unmatchedCallbacks_;
+                return;
+            }
+            samplesMicroseconds_.push_back(std::chrono::duration<double, std::micro>(now - pending.front()).count());
+            if (event == SaaVolumeRenderChanged || event == SaaVolumeCaptureChanged)
+            {
+                pending.clear();
+            }
+            else
+            {
+                pending.pop_front();
+            }
+        }
+
+        struct Report
+        {
+            uint64_t Callbacks = 0;
+            uint64_t UnmatchedCallbacks = 0;
+            uint64_t Abandoned = 0;
+            uint64_t StillPending = 0;
+            std::vector<double> SamplesMicroseconds;
+        };
+
+        // Starts counting anew.
+        Report TakeReport()
+        {
+            std::lock_guard lock(mutex_);
+            Report report{ callbacks_, unmatchedCallbacks_, abandoned_, 0, std::exchange(samplesMicroseconds_, {}) };
+            for (auto & pending : pending_ | std::views::values)
+            {
+                report.StillPending += pending.size();
+                pending.clear();
+            }
+            callbacks_ = 0;
+            unmatchedCallbacks_ = 0;
+            abandoned_ = 0;
+            std::ranges::sort(report.SamplesMicroseconds);
+            return report;
+        }
+
+    private:
+        std::mutex mutex_;
+        std::map<SaaEventType, std::deque<Clock::time_point>> pending_;
+        std::vector<double> samplesMicroseconds_;
+        uint64_t callbacks_ = 0;
+        uint64_t unmatchedCallbacks_ = 0;
+        uint64_t abandoned_ = 0;
+    };
+
+    SaaHandle handle = 0;
+    LatencyTracker latency_tracker;
+
+    // Behaves like a real client: re-reads the default device on every callback.
+    void __stdcall OnDefaultRenderChanged(SaaEventType event)
+    {
+        latency_tracker.OnCallback(event);
+        SaaDescription description;
+        SaaGetDefaultRender(handle, &description);
+    }
+
+    void __stdcall OnDefaultCaptureChanged(SaaEventType event)
+    {
+        latency_tracker.OnCallback(event);
+        SaaDescription description;
+        SaaGetDefaultCapture(handle, &description);
+    }
+
+    struct Endpoint
+    {
+        std::string Id;
+        bool IsRender;
+        bool Active = true;
+        UINT16 Volume = 500;
+    };
+
+    // Injects the operations of the mix in random order, keeping its own model of the simulated state
+    // to pick valid targets and to know which callback each injection should cause.
+    class Injector
+    {
+    public:
+        explicit Injector(const CommandLineOptions & options)
+            : mix_(options.Mix.begin(), options.Mix.end())
+        {
+            for (size_t i = 0; i < options.EndpointsPerFlow; ++i)
+            {
+                endpoints_.push_back({ std::format("sim-render-{}", i), true });
+                endpoints_.push_back({ std::format("sim-capture-{}", i), false });
+            }
+        }
+
+        bool SetUp()
+        {
+            for (const auto & endpoint : endpoints_)
+            {
+                if (SaaSimAddDevice(handle, endpoint.Id.c_str(), endpoint.Id.c_str(), endpoint.IsRender, endpoint.Volume) != SaaResultCodeSuccess)
+                {
+                    return false;
+                }
+            }
+            // the first endpoint of each flow
+            return SetDefault(0, false) && SetDefault(1, false);
+        }
+
+        // Returns false if no valid target exists for the drawn operation.
+        bool InjectNext()
+        {
+            const auto operation = static_cast<Operation>(mix_(random_));
+            auto & endpoint = endpoints_[std::uniform_int_distribution<size_t>(0, endpoints_.size() - 1)(random_)];
+            const size_t index = static_cast<size_t>(&endpoint - endpoints_.data());
+
+            bool injected = false;
+            switch (operation)
+            {
+            case Operation::Add:
+                if (!endpoint.Active)
+                {
+                    injected = SaaSimAddDevice(handle, endpoint.Id.c_str(), endpoint.Id.c_str(), endpoint.IsRender, endpoint.Volume) == SaaResultCodeSuccess;
+                    endpoint.Active = injected;
+                }
+                break;
+            case Operation::Remove:
+                if (endpoint.Active)
+                {
+                    injected = Remove(index);
+                }
+                break;
+            case Operation::SetDefault:
+                if (endpoint.Active)
+                {
+                    injected = SetDefault(index, true);
+                }
+                break;
+            case Operation::SetVolume:
+                if (endpoint.Active)
+                {
+                    injected = SetVolume(index);
+                }
+                break;
+            }
+            if (injected)
+            {
+                ++injectedCounts_[static_cast<size_t>(operation)];
+            }
+            else
+            {
+                ++skipped_;
+            }
+            return injected;
+        }
+
+        [[nodiscard]] const std::array<uint64_t, operation_count> & GetInjectedCounts() const { return injectedCounts_; }
+        [[nodiscard]] uint64_t GetSkipped() const { return skipped_; }
+
+    private:
+        std::optional<size_t> & DefaultOf(bool isRender) { return isRender ? defaultRender_ : defaultCapture_; }
+
+        static SaaEventType VolumeEventOf(bool isRender) { return isRender ? SaaVolumeRenderChanged : SaaVolumeCaptureChanged; }
+
+        bool SetDefault(size_t index, bool expectCallback)
+        {
+            const auto & endpoint = endpoints_[index];
+            latency_tracker.Abandon(VolumeEventOf(endpoint.IsRender));
+            if (expectCallback)
+            {
+                latency_tracker.Expect(endpoint.IsRender ? SaaDefaultRenderAttached : SaaDefaultCaptureAttached, Clock::now());
+            }
+            if (SaaSimSetDefaultDevice(handle, endpoint.Id.c_str()) != SaaResultCodeSuccess)
+            {
+                return false;
+            }
+            DefaultOf(endpoint.IsRender) = index;
+            return true;
+        }
+
+        bool Remove(size_t index)
+        {
+            auto & endpoint = endpoints_[index];
+            auto & defaultIndex = DefaultOf(endpoint.IsRender);
+            const bool isDefault = defaultIndex == index;
+            if (isDefault)
+            {
+                latency_tracker.Abandon(VolumeEventOf(endpoint.IsRender));
+                latency_tracker.Expect(endpoint.IsRender ? SaaDefaultRenderDetached : SaaDefaultCaptureDetached, Clock::now());
+            }
+            if (SaaSimRemoveDevice(handle, endpoint.Id.c_str()) != SaaResultCodeSuccess)
+            {
+                return false;
+            }
+            endpoint.Active = false;
+            if (isDefault)
+            {
+                defaultIndex.reset();
+            }
+            return true;
+        }
+
+        bool SetVolume(size_t index)
+        {
+            auto & endpoint = endpoints_[index];
+            // always a change, otherwise the collection raises no event
+            endpoint.Volume = static_cast<UINT16>((endpoint.Volume + 1 + std::uniform_int_distribution<int>(0, 998)(random_)) % 1001);
+            if (DefaultOf(endpoint.IsRender) == index)
+            {
+                latency_tracker.Expect(VolumeEventOf(endpoint.IsRender), Clock::now());
+            }
+            return SaaSimSetVolume(handle, endpoint.Id.c_str(), endpoint.Volume) == SaaResultCodeSuccess;
+        }
+
+    private:
+        std::mt19937_64 random_{ 20240611 }; // fixed seed: runs are comparable
+        std::discrete_distribution<size_t> mix_;
+        std::vector<Endpoint> endpoints_;
+        std::optional<size_t> defaultRender_;
+        std::optional<size_t> defaultCapture_;
+        std::array<uint64_t, operation_count> injectedCounts_{};
+        uint64_t skipped_ = 0;
+    };
+
+    bool WaitUntilDrained(std::chrono::milliseconds timeout, SaaSimDeliveryStatistics & statistics)
+    {
+        const auto deadline = Clock::now() + timeout;
+        do
+        {
+            if (SaaSimGetDeliveryStatistics(handle, &statistics) != SaaResultCodeSuccess)
+            {
+                return false;
+            }
+            if (statistics.Delivered + statistics.Coalesced + statistics.DiscardedAsStale >= statistics.Posted)
+            {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        } while (Clock::now() < deadline);
+        return false;
+    }
+
+    double Percentile(const std::vector<double> & sorted, double fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0.0;
+        }
+        const auto rank = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+}
+
+
+int _tmain(int argc, _TCHAR * argv[])
+{
+    CommandLineOptions options;
+    if (!ParseCommandLine(argc, argv, options))
+    {
+        std::cerr << "Usage: SoundAgentLoadGen [--rate=<events/s>] [--duration=<s>] [--devices=<endpoints per flow>]\n"
+            "  [--mix=add=<w>,remove=<w>,default=<w>,volume=<w>] [--max-p99-ms=<ms>] [--min-throughput=<events/s>]\n";
+        return 2;
+    }
+
+    if (SaaSimInitialize(&handle, nullptr, "SoundAgentLoadGen", nullptr) != SaaResultCodeSuccess)
+    {
+        std::cerr << "SaaSimInitialize failed.\n";
+        return 3;
+    }
+
+    Injector injector(options);
+    if (!injector.SetUp()
+        || SaaRegisterCallbacks(handle, OnDefaultRenderChanged, OnDefaultCaptureChanged) != SaaResultCodeSuccess)
+    {
+        std::cerr << "Setting up the simulated devices failed.\n";
+        SaaUnInitialize(handle);
+        return 3;
+    }
+    SaaSimDeliveryStatistics baseline{};
+    WaitUntilDrained(std::chrono::seconds(5), baseline);
+    latency_tracker.TakeReport(); // set-up callbacks are not measured
+
+    const auto period = std::chrono::duration<double>(1.0 / options.Rate);
+    const auto runLength = std::chrono::duration<double>(options.DurationSeconds);
+    const auto start = Clock::now();
+    uint64_t attempts = 0;
+    for (auto now = start; now - start < runLength; now = Clock::now())
+    {
+        const auto due = start + std::chrono::duration_cast<Clock::duration>(period * static_cast<double>(attempts));
+        if (now < due)
+        {
+            if (due - now > std::chrono::milliseconds(2))
+            {
+                std::this_thread::sleep_for(due - now - std::chrono::milliseconds(1));
+            }
+            continue;
+        }
+        injector.InjectNext();
+        ++attempts;
+    }
+    const auto injectionEnd = Clock::now();
+
+    SaaSimDeliveryStatistics statistics{};
+    const bool drained = WaitUntilDrained(std::chrono::seconds(10), statistics);
+    const auto drainEnd = Clock::now();
+    // callbacks of the last delivered events may still be running
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto report = latency_tracker.TakeReport();
+
+    SaaUnInitialize(handle);
+    handle = 0;
+
+    const auto injectionSeconds = std::chrono::duration<double>(injectionEnd - start).count();
+    const auto totalSeconds = std::chrono::duration<double>(drainEnd - start).count();
+    const auto & injected = injector.GetInjectedCounts();
+    uint64_t injectedTotal = 0;
+    for (const auto count : injected)
+    {
+        injectedTotal += count;
+    }
+    const auto posted = statistics.Posted - baseline.Posted;
+    const auto delivered = statistics.Delivered - baseline.Delivered;
+    const auto coalesced = statistics.Coalesced - baseline.Coalesced;
+    const auto discarded = statistics.DiscardedAsStale - baseline.DiscardedAsStale;
+    const auto throughput = static_cast<double>(posted) / totalSeconds;
+    const auto p99Milliseconds = Percentile(report.SamplesMicroseconds, 0.99) / 1000.0;
+
+    std::cout << std::format("injected:   {} operations in {:.2f} s ({:.0f}/s, target {:.0f}/s); add {}, remove {}, default {}, volume {}; {} drawn without valid target\n",
+        injectedTotal, injectionSeconds, static_cast<double>(injectedTotal) / injectionSeconds, options.Rate,
+        injected[0], injected[1], injected[2], injected[3], injector.GetSkipped());
+    std::cout << std::format("events:     {} posted, {} delivered, {} coalesced, {} dropped as stale{}\n",
+        posted, delivered, coalesced, discarded, drained ? "" : " (NOT DRAINED)");
+    std::cout << std::format("throughput: {:.0f} events/s sustained, until drained\n", throughput);
+    std::cout << std::format("callbacks:  {} received, {} measured, {} unmatched, {} abandoned, {} never answered\n",
+        report.Callbacks, report.SamplesMicroseconds.size(), report.UnmatchedCallbacks, report.Abandoned, report.StillPending);
+    std::cout << std::format("latency:    p50 {:.3f} ms, p99 {:.3f} ms, p999 {:.3f} ms, max {:.3f} ms\n",
+        Percentile(report.SamplesMicroseconds, 0.5) / 1000.0, p99Milliseconds,
+        Percentile(report.SamplesMicroseconds, 0.999) / 1000.0,
+        report.SamplesMicroseconds.empty() ? 0.0 : report.SamplesMicroseconds.back() / 1000.0);
+
+    bool passed = drained;
+    if (options.MaxP99Milliseconds.has_value() && p99Milliseconds > *options.MaxP99Milliseconds)
+    {
+        std::cout << std::format("FAILED: p99 latency {:.3f} ms above {:.3f} ms\n", p99Milliseconds, *options.MaxP99Milliseconds);
+        passed = false;
+    }
+    if (options.MinThroughput.has_value() && throughput < *options.MinThroughput)
+    {
+        std::cout << std::format("FAILED: throughput {:.0f} events/s below {:.0f} events/s\n", throughput, *options.MinThroughput);
+        passed = false;
+    }
+    if (!drained)
+    {
+        std::cout << "FAILED: events still pending 10 s after the injection stopped\n";
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <sdkddkver.h>
+
+#undef _WIN32_WINNT
+#define _WIN32_WINNT                   _WIN32_WINNT_WIN10
@@ -22,6 +22,15 @@ public struct SaaDescription
     public ushort CaptureVolume;
 }
 
+[StructLayout(LayoutKind.Sequential)]
+public struct SaaSnapshotInfo
+{
+    public ulong StateVersion;
+    public uint DeviceCount;
+    public int DefaultRenderIndex; // -1 if none
+    public int DefaultCaptureIndex; // -1 if none
+}
+
 [StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
 public struct SaaLogMessage
 {
@@ -52,7 +61,10 @@ public enum SaaResult : int
     SaaResultCodeSuccess = 0,
     SaaResultCodeInvalidArgument = 1,
     SaaResultCodeInvalidHandle = 2,
-    SaaResultCodeInternalError = 3
+    SaaResultCodeInternalError = 3,
+    SaaResultCodeBufferTooSmall = 4,
+    SaaResultCodeNotReady = 5,
+    SaaResultCodeWrongThread = 6
 }
 
 [UnmanagedFunctionPointer(CallingConvention.StdCall)]
@@ -96,6 +108,21 @@ internal static class SoundAgentApi
         out SaaDescription description
     );
 
+    [DllImport("SoundAgentApi.dll", CallingConvention = CallingConvention.StdCall)]
+    internal static extern SaaResult SaaGetStateVersion(
+        ulong handle,
+        out ulong stateVersion
+    );
+
+    // With a devices array shorter than info.DeviceCount, returns SaaResultCodeBufferTooSmall with only info filled.
+    [DllImport("SoundAgentApi.dll", CallingConvention = CallingConvention.StdCall, CharSet = CharSet.Ansi)]
+    internal static extern SaaResult SaaGetSnapshot(
+        ulong handle,
+        out SaaSnapshotInfo info,
+        [Out] SaaDescription[]? devices,
+        uint capacity
+    );
+
     [DllImport("SoundAgentApi.dll", CallingConvention = CallingConvention.StdCall)]
     internal static extern SaaResult SaaUnInitialize(
         ulong handle
@@ -9,6 +9,8 @@ package soundlibwrap
 */
 import "C"
 
+import "fmt"
+
 //export cgoSaaDefaultRenderChanged
 func cgoSaaDefaultRenderChanged(event C.SaaEventType) {
 	switch event {
@@ -40,3 +42,12 @@ func cgoSaaGotLogMessage(msg C.SaaLogMessage) {
 	content := C.GoString(&msg.Content[0])
 	NotifyGotLogMessage(timestamp, level, content)
 }
+
+//export cgoSaaReady
+func cgoSaaReady(handle C.SaaHandle, result C.SaaResult) {
+	var err error
+	if result != C.SaaResultCodeSuccess {
+		err = fmt.Errorf("asynchronous call failed: rc=%d", int32(result))
+	}
+	NotifyReady(Handle(handle), err)
+}
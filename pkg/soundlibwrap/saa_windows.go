@@ -16,12 +16,14 @@ package soundlibwrap
 void __stdcall cgoSaaDefaultRenderChanged(SaaEventType event);
 void __stdcall cgoSaaDefaultCaptureChanged(SaaEventType event);
 void __stdcall cgoSaaGotLogMessage(SaaLogMessage message);
+void __stdcall cgoSaaReady(SaaHandle handle, SaaResult result);
 */
 import "C"
 
 import (
 	"errors"
 	"fmt"
+	"time"
 	"unsafe"
 )
 
@@ -40,6 +42,9 @@ type DefaultChangedCallback func(present bool)
 type GotLogMessageCallback func(timestamp, level, content string)
 type VolumeChangedCallback func()
 
+// ReadyCallback runs on the handle's worker thread: Uninitialize of the handle fails there, call it from another goroutine.
+type ReadyCallback func(h Handle, err error)
+
 // Handlers set by app.
 var (
 	logHandler           GotLogMessageCallback
@@ -47,6 +52,7 @@ var (
 	captureHandler       DefaultChangedCallback
 	renderVolumeHandler  VolumeChangedCallback
 	captureVolumeHandler VolumeChangedCallback
+	readyHandler         ReadyCallback
 )
 
 func SetLogHandler(h GotLogMessageCallback)                  { logHandler = h }
@@ -54,6 +60,7 @@ func SetDefaultRenderHandler(h DefaultChangedCallback)       { renderHandler = h
 func SetDefaultCaptureHandler(h DefaultChangedCallback)      { captureHandler = h }
 func SetRenderVolumeChangedHandler(h VolumeChangedCallback)  { renderVolumeHandler = h }
 func SetCaptureVolumeChangedHandler(h VolumeChangedCallback) { captureVolumeHandler = h }
+func SetReadyHandler(h ReadyCallback)                        { readyHandler = h }
 
 func NotifyDefaultRenderChanged(present bool) {
 	if renderHandler != nil {
@@ -83,6 +90,12 @@ func NotifyCaptureVolumeChanged() {
 	}
 }
 
+func NotifyReady(h Handle, err error) {
+	if readyHandler != nil {
+		readyHandler(h, err)
+	}
+}
+
 func Initialize(appName, appVersion string) (Handle, error) {
 	var h C.SaaHandle
 	var cAppName, cAppVersion *C.char
@@ -116,6 +129,56 @@ func RegisterCallbacks(h Handle) error {
 	return nil
 }
 
+// InitializeAsync returns at once; the ready handler is called when the first
+// snapshot is published. Getters fail with rc=5 (not ready) until then.
+func InitializeAsync(appName, appVersion string) (Handle, error) {
+	var h C.SaaHandle
+	var cAppName, cAppVersion *C.char
+	if appName != "" {
+		cAppName = C.CString(appName)
+		defer C.free(unsafe.Pointer(cAppName))
+	}
+	if appVersion != "" {
+		cAppVersion = C.CString(appVersion)
+		defer C.free(unsafe.Pointer(cAppVersion))
+	}
+	rc := C.SaaInitializeAsync(
+		&h,
+		(C.TSaaGotLogMessageCallback)(C.cgoSaaGotLogMessage),
+		cAppName,
+		cAppVersion,
+		(C.TSaaReadyCallback)(C.cgoSaaReady),
+	)
+	if rc != 0 {
+		return 0, fmt.Errorf("SaaInitializeAsync failed: rc=%d", int32(rc))
+	}
+	return Handle(h), nil
+}
+
+// RegisterCallbacksAsync returns at once on a handle of InitializeAsync.
+func RegisterCallbacksAsync(h Handle) error {
+	renderCb := (C.TSaaDefaultChangedCallback)(C.cgoSaaDefaultRenderChanged)
+	captureCb := (C.TSaaDefaultChangedCallback)(C.cgoSaaDefaultCaptureChanged)
+	rc := C.SaaRegisterCallbacksAsync(C.SaaHandle(h), renderCb, captureCb, nil)
+	if rc != 0 {
+		return fmt.Errorf("SaaRegisterCallbacksAsync failed: rc=%d", int32(rc))
+	}
+	return nil
+}
+
+// WaitUntilReady reports false if the handle is not ready within timeout.
+func WaitUntilReady(h Handle, timeout time.Duration) (bool, error) {
+	rc := C.SaaWaitUntilReady(C.SaaHandle(h), C.DWORD(timeout.Milliseconds()))
+	switch rc {
+	case C.SaaResultCodeSuccess:
+		return true, nil
+	case C.SaaResultCodeNotReady:
+		return false, nil
+	default:
+		return false, fmt.Errorf("SaaWaitUntilReady failed: rc=%d", int32(rc))
+	}
+}
+
 func GetDefaultRender(h Handle) (Description, error) {
 	var cd C.SaaDescription
 	rc := C.SaaGetDefaultRender(C.SaaHandle(h), &cd)
@@ -134,6 +197,158 @@ func GetDefaultCapture(h Handle) (Description, error) {
 	return fromCDesc(&cd), nil
 }
 
+func GetStateVersion(h Handle) (uint64, error) {
+	var version C.UINT64
+	rc := C.SaaGetStateVersion(C.SaaHandle(h), &version)
+	if rc != 0 {
+		return 0, fmt.Errorf("SaaGetStateVersion failed: rc=%d", int32(rc))
+	}
+	return uint64(version), nil
+}
+
+// IsStale tells whether the devices are still those persisted by the previous run.
+func IsStale(h Handle) (bool, error) {
+	var stale C.BOOL
+	rc := C.SaaIsStale(C.SaaHandle(h), &stale)
+	if rc != 0 {
+		return false, fmt.Errorf("SaaIsStale failed: rc=%d", int32(rc))
+	}
+	return stale != 0, nil
+}
+
+type Snapshot struct {
+	StateVersion        uint64
+	Devices             []Description
+	DefaultRenderIndex  int // -1 if none
+	DefaultCaptureIndex int // -1 if none
+}
+
+// GetSnapshot returns all devices at one state version; the buffer is grown while devices get added.
+func GetSnapshot(h Handle) (Snapshot, error) {
+	var info C.SaaSnapshotInfo
+	devices := make([]C.SaaDescription, 16)
+	for {
+		rc := C.SaaGetSnapshot(C.SaaHandle(h), &info, &devices[0], C.UINT32(len(devices)))
+		if rc == C.SaaResultCodeBufferTooSmall {
+			devices = make([]C.SaaDescription, int(info.DeviceCount)+8)
+			continue
+		}
+		if rc != 0 {
+			return Snapshot{}, fmt.Errorf("SaaGetSnapshot failed: rc=%d", int32(rc))
+		}
+		break
+	}
+	snapshot := Snapshot{
+		StateVersion:        uint64(info.StateVersion),
+		Devices:             make([]Description, 0, int(info.DeviceCount)),
+		DefaultRenderIndex:  int(info.DefaultRenderIndex),
+		DefaultCaptureIndex: int(info.DefaultCaptureIndex),
+	}
+	for i := 0; i < int(info.DeviceCount); i++ {
+		snapshot.Devices = append(snapshot.Devices, fromCDesc(&devices[i]))
+	}
+	return snapshot, nil
+}
+
+type HistoryKind int32
+
+const (
+	HistoryRenderVolume   HistoryKind = C.SaaHistoryRenderVolume
+	HistoryCaptureVolume  HistoryKind = C.SaaHistoryCaptureVolume
+	HistoryRenderDefault  HistoryKind = C.SaaHistoryRenderDefault
+	HistoryCaptureDefault HistoryKind = C.SaaHistoryCaptureDefault
+)
+
+type HistorySample struct {
+	TimeMs int64 // milliseconds since the Unix epoch
+	Value  uint16
+}
+
+// GetHistory returns the transitions of a device with fromMs <= time < toMs, oldest first.
+func GetHistory(h Handle, pnpID string, kind HistoryKind, fromMs, toMs int64) ([]HistorySample, error) {
+	cPnpID := C.CString(pnpID)
+	defer C.free(unsafe.Pointer(cPnpID))
+	var count C.UINT32
+	samples := make([]C.SaaHistorySample, 256)
+	for {
+		rc := C.SaaGetHistory(C.SaaHandle(h), cPnpID, C.SaaHistoryKind(kind), C.INT64(fromMs), C.INT64(toMs),
+			&samples[0], C.UINT32(len(samples)), &count)
+		if rc == C.SaaResultCodeBufferTooSmall {
+			samples = make([]C.SaaHistorySample, int(count)+64)
+			continue
+		}
+		if rc != 0 {
+			return nil, fmt.Errorf("SaaGetHistory failed: rc=%d", int32(rc))
+		}
+		break
+	}
+	history := make([]HistorySample, 0, int(count))
+	for i := 0; i < int(count); i++ {
+		history = append(history, HistorySample{TimeMs: int64(samples[i].TimeMs), Value: uint16(samples[i].Value)})
+	}
+	return history, nil
+}
+
+type FormFactor int32
+
+const (
+	FormFactorAny                       FormFactor = -1
+	FormFactorRemoteNetworkDevice       FormFactor = C.SaaFormFactorRemoteNetworkDevice
+	FormFactorSpeakers                  FormFactor = C.SaaFormFactorSpeakers
+	FormFactorLineLevel                 FormFactor = C.SaaFormFactorLineLevel
+	FormFactorHeadphones                FormFactor = C.SaaFormFactorHeadphones
+	FormFactorMicrophone                FormFactor = C.SaaFormFactorMicrophone
+	FormFactorHeadset                   FormFactor = C.SaaFormFactorHeadset
+	FormFactorHandset                   FormFactor = C.SaaFormFactorHandset
+	FormFactorUnknownDigitalPassthrough FormFactor = C.SaaFormFactorUnknownDigitalPassthrough
+	FormFactorSpdif                     FormFactor = C.SaaFormFactorSpdif
+	FormFactorDigitalAudioDisplayDevice FormFactor = C.SaaFormFactorDigitalAudioDisplayDevice
+	FormFactorUnknown                   FormFactor = C.SaaFormFactorUnknown
+)
+
+// DeviceQuery holds the conditions of FindDevices; a device must meet all that are set.
+type DeviceQuery struct {
+	IsRender         bool
+	IsCapture        bool
+	IsDefaultRender  bool
+	IsDefaultCapture bool
+	FormFactor       FormFactor // FormFactorAny for any
+	NameContains     string     // case-insensitive for ASCII letters; empty for any
+}
+
+// FindDevices returns the devices meeting the conditions of the query.
+func FindDevices(h Handle, query DeviceQuery) ([]Description, error) {
+	cQuery := C.SaaDeviceQuery{
+		IsRender:         toCBool(query.IsRender),
+		IsCapture:        toCBool(query.IsCapture),
+		IsDefaultRender:  toCBool(query.IsDefaultRender),
+		IsDefaultCapture: toCBool(query.IsDefaultCapture),
+		FormFactor:       C.INT32(query.FormFactor),
+	}
+	if query.NameContains != "" {
+		cQuery.NameContains = C.CString(query.NameContains)
+		defer C.free(unsafe.Pointer(cQuery.NameContains))
+	}
+	var count C.UINT32
+	devices := make([]C.SaaDescription, 16)
+	for {
+		rc := C.SaaFindDevices(C.SaaHandle(h), &cQuery, &devices[0], C.UINT32(len(devices)), &count)
+		if rc == C.SaaResultCodeBufferTooSmall {
+			devices = make([]C.SaaDescription, int(count)+8)
+			continue
+		}
+		if rc != 0 {
+			return nil, fmt.Errorf("SaaFindDevices failed: rc=%d", int32(rc))
+		}
+		break
+	}
+	found := make([]Description, 0, int(count))
+	for i := 0; i < int(count); i++ {
+		found = append(found, fromCDesc(&devices[i]))
+	}
+	return found, nil
+}
+
 func GetExtendedOperatingSystemName(h Handle) (string, error) {
 	var osInfo C.SaaOsInfo
 	rc := C.SaaGetOperationSystemName(C.SaaHandle(h), &osInfo)
@@ -164,3 +379,10 @@ func fromCDesc(cd *C.SaaDescription) Description {
 		CaptureVolume: uint16(cd.CaptureVolume),
 	}
 }
+
+func toCBool(value bool) C.BOOL {
+	if value {
+		return 1
+	}
+	return 0
+}